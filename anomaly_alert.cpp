@@ -0,0 +1,145 @@
+#include "anomaly_alert.h"
+#include "config.h"
+#include "mqtt_handler.h"
+
+static PendingAlert queue[ANOMALY_ALERT_QUEUE_SIZE];
+static uint16_t head = 0; // oldest alert
+
+// Alerts in the MQTT outbound queue, by sequence number; the oldest is
+// overwritten if they are never sent (dropped by the queue)
+typedef struct {
+    uint32_t sequence;
+    uint64_t detected_us;
+    bool used;
+} QueuedAlert;
+
+static QueuedAlert queued[ANOMALY_ALERT_QUEUE_SIZE];
+static uint16_t queued_next = 0;
+
+static AnomalyAlertStats stats;
+static uint64_t total_latency_us = 0;
+static Timer alert_clock;
+// The main thread raises and queues alerts, the network thread sends them
+static Mutex alert_mutex;
+
+static uint64_t now_us() {
+    return (uint64_t)alert_clock.elapsed_time().count();
+}
+
+void anomaly_alert_init() {
+    head = 0;
+    queued_next = 0;
+    memset(queued, 0, sizeof(queued));
+    memset(&stats, 0, sizeof(stats));
+    total_latency_us = 0;
+    alert_clock.reset();
+    alert_clock.start();
+}
+
+void anomaly_alert_push(const AnomalyEvent& event) {
+    alert_mutex.lock();
+    if (stats.pending == ANOMALY_ALERT_QUEUE_SIZE) {
+        head = (head + 1) % ANOMALY_ALERT_QUEUE_SIZE;
+        stats.pending--;
+        stats.dropped++;
+    }
+
+    PendingAlert& slot = queue[(head + stats.pending) % ANOMALY_ALERT_QUEUE_SIZE];
+    slot.detected_us = now_us();
+    slot.event = event;
+    stats.pending++;
+    stats.raised++;
+    alert_mutex.unlock();
+}
+
+static uint32_t age_ms(const PendingAlert& alert) {
+    return (uint32_t)((now_us() - alert.detected_us) / 1000);
+}
+
+// Oldest pending alert, registered as queued so anomaly_alert_sent() finds
+// it even if the MQTT handler sends it before mqtt_publish_anomaly() returns
+static bool begin_oldest(PendingAlert* alert) {
+    alert_mutex.lock();
+    bool found = stats.pending > 0;
+    if (found) {
+        *alert = queue[head];
+        QueuedAlert& q = queued[queued_next];
+        if (q.used) {
+            stats.queued--;
+        }
+        q.sequence = alert->event.sequence;
+        q.detected_us = alert->detected_us;
+        q.used = true;
+        queued_next = (queued_next + 1) % ANOMALY_ALERT_QUEUE_SIZE;
+        stats.queued++;
+    }
+    alert_mutex.unlock();
+    return found;
+}
+
+// The handler took the alert: it leaves the pending ones. A push that found
+// the list full may have dropped it meanwhile.
+static void end_queued(const PendingAlert& alert) {
+    alert_mutex.lock();
+    if (stats.pending > 0 && queue[head].event.sequence == alert.event.sequence) {
+        head = (head + 1) % ANOMALY_ALERT_QUEUE_SIZE;
+        stats.pending--;
+    }
+    alert_mutex.unlock();
+}
+
+// The handler refused the alert: it stays pending, and is not queued
+static void end_refused(const PendingAlert& alert) {
+    alert_mutex.lock();
+    for (int i = 0; i < ANOMALY_ALERT_QUEUE_SIZE; i++) {
+        QueuedAlert& q = queued[i];
+        if (q.used && q.sequence == alert.event.sequence) {
+            q.used = false;
+            stats.queued--;
+            break;
+        }
+    }
+    alert_mutex.unlock();
+}
+
+void anomaly_alert_publish() {
+    PendingAlert alert;
+    while (begin_oldest(&alert)) {
+        if (!mqtt_publish_anomaly(alert.event, age_ms(alert))) {
+            end_refused(alert);
+            break;
+        }
+        end_queued(alert);
+    }
+}
+
+void anomaly_alert_sent(uint32_t sequence) {
+    alert_mutex.lock();
+    for (int i = 0; i < ANOMALY_ALERT_QUEUE_SIZE; i++) {
+        QueuedAlert& q = queued[i];
+        if (!q.used || q.sequence != sequence) {
+            continue;
+        }
+        uint64_t elapsed_us = now_us() - q.detected_us;
+        uint32_t latency_us = elapsed_us > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed_us;
+        q.used = false;
+        stats.queued--;
+
+        stats.published++;
+        stats.last_latency_us = latency_us;
+        if (latency_us > stats.max_latency_us) {
+            stats.max_latency_us = latency_us;
+        }
+        total_latency_us += latency_us;
+        stats.mean_latency_us = (uint32_t)(total_latency_us / stats.published);
+        break;
+    }
+    alert_mutex.unlock();
+}
+
+AnomalyAlertStats anomaly_alert_get_stats() {
+    alert_mutex.lock();
+    AnomalyAlertStats current = stats;
+    alert_mutex.unlock();
+    return current;
+}
@@ -0,0 +1,42 @@
+#ifndef ANOMALY_ALERT_H
+#define ANOMALY_ALERT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "anomaly_detector.h"
+
+// Anomaly events waiting to go out on MQTT_TOPIC_ANOMALY. They are
+// published ahead of any other report, straight after detection when the
+// session is up. Otherwise they are kept (ANOMALY_ALERT_QUEUE_SIZE, oldest
+// dropped when full) until it is. Each event is stamped when it is raised,
+// and its latency is taken when the MQTT handler puts its packet on the wire
+// (anomaly_alert_sent()), so time spent in the outbound queue is counted.
+typedef struct {
+    uint64_t detected_us;   // alert clock when raised
+    AnomalyEvent event;
+} PendingAlert;
+
+typedef struct {
+    uint32_t raised;            // events raised since anomaly_alert_init()
+    uint32_t published;         // sent to the broker
+    uint32_t dropped;           // oldest events overwritten when full
+    uint32_t last_latency_us;   // detection -> sent, of the last one sent
+    uint32_t max_latency_us;
+    uint32_t mean_latency_us;
+    uint16_t pending;           // not yet taken by the MQTT handler
+    uint16_t queued;            // handed over, not yet sent
+} AnomalyAlertStats;
+
+void anomaly_alert_init();
+void anomaly_alert_push(const AnomalyEvent& event);
+// Hands the pending alerts, oldest first, to mqtt_publish_anomaly(); stops
+// at the first it refuses (no session, or the alert class is full). Each is
+// registered before it is handed over, as the network thread may send it
+// at once.
+void anomaly_alert_publish();
+// The alert with this sequence number was sent: records its latency. Called
+// from whichever thread drains the MQTT queue.
+void anomaly_alert_sent(uint32_t sequence);
+AnomalyAlertStats anomaly_alert_get_stats();
+
+#endif // ANOMALY_ALERT_H
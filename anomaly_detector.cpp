@@ -1,84 +1,61 @@
 #include "anomaly_detector.h"
 #include "config.h"
-#include <cmath> // For sqrtf() and fabsf()
 
-// Internal state for anomaly detection
-static float rate_buffer[RATE_BUFFER_SIZE] = {0.0f};
-static int buffer_index = 0;
-static float current_mean = 0.0f;
-static float current_std_dev = 0.0f;
-static float last_temp_reading = 0.0f;
-static bool is_first_temp_reading = true;
-
-// --- Helper Functions ---
-static void update_rate_buffer(float new_rate) {
-    rate_buffer[buffer_index] = new_rate;
-    buffer_index = (buffer_index + 1) % RATE_BUFFER_SIZE;
+AnomalyDetector::AnomalyDetector() {
+    reset();
 }
 
-static void calculate_statistics() {
-    // 1. Calculate Mean
-    float sum = 0.0f;
-    for (int i = 0; i < RATE_BUFFER_SIZE; i++) {
-        sum += rate_buffer[i];
-    }
-    current_mean = sum / RATE_BUFFER_SIZE;
+void AnomalyDetector::reset() {
+    anomaly_core_reset(_core);
+}
 
-    // 2. Calculate Standard Deviation
-    float sum_sq_diff = 0.0f;
-    for (int i = 0; i < RATE_BUFFER_SIZE; i++) {
-        sum_sq_diff += (rate_buffer[i] - current_mean) * (rate_buffer[i] - current_mean);
-    }
-    // Use N instead of N-1 for population standard deviation on the rolling window
-    current_std_dev = sqrtf(sum_sq_diff / RATE_BUFFER_SIZE);
+AnomalyStatus AnomalyDetector::process(float value, uint32_t elapsed_ms) {
+    return anomaly_core_process(_core, value, elapsed_ms);
 }
-// -----------------------
 
-void anomaly_detector_init() {
-    // Initialize buffer and state variables
-    memset(rate_buffer, 0, sizeof(rate_buffer));
-    buffer_index = 0;
-    current_mean = 0.0f;
-    current_std_dev = 0.0f;
-    last_temp_reading = 0.0f;
-    is_first_temp_reading = true;
-    printf("Anomaly Detector Initialized.\n");
+bool AnomalyDetector::take_event(AnomalyEvent* event) {
+    return anomaly_core_take_event(_core, event);
 }
 
-AnomalyStatus anomaly_detector_process(float current_temp) {
-    AnomalyStatus status = {false, current_mean, current_std_dev};
+void AnomalyDetector::get_state(AnomalyDetectorState* state) const {
+    memcpy(state->rate_buffer, _core.rate_buffer, sizeof(_core.rate_buffer));
+    state->buffer_index = _core.buffer_index;
+    state->current_mean = _core.current_mean;
+    state->current_std_dev = _core.current_std_dev;
+}
 
-    if (is_first_temp_reading) {
-        last_temp_reading = current_temp; // Initialize
-        is_first_temp_reading = false;
-        return status; // Can't calculate a rate yet
-    }
+void AnomalyDetector::set_state(const AnomalyDetectorState* state) {
+    memcpy(_core.rate_buffer, state->rate_buffer, sizeof(_core.rate_buffer));
+    _core.buffer_index = state->buffer_index % RATE_BUFFER_SIZE;
+    _core.current_mean = state->current_mean;
+    _core.current_std_dev = state->current_std_dev;
+    _core.last_temp_reading = 0.0f;
+    _core.is_first_temp_reading = true;
+    _core.elapsed_since_last_rate_ms = 0;
+    _core.last_is_anomalous = false;
+    _core.event_pending = false;
+}
 
-    // 1. Calculate the feature: "rate of change"
-    float new_rate = current_temp - last_temp_reading;
-    last_temp_reading = current_temp;
+// --- Default instance ---
+static AnomalyDetector detector;
 
-    // 2. Perform "Inference" (Detect Anomaly)
-    // Only check if model is "trained" enough (std_dev is not near zero)
-    if (current_std_dev > 0.001f) {
-        float z_score = (new_rate - current_mean) / current_std_dev;
+void anomaly_detector_init() {
+    detector.reset();
+    printf("Anomaly Detector Initialized.\n");
+}
 
-        // 3. The AI Decision!
-        if (fabsf(z_score) > ANOMALY_Z_SCORE_THRESHOLD) {
-            status.is_anomalous = true;
-        }
-    } else {
-        // Model is still stabilizing, don't flag anomalies yet
-        status.is_anomalous = false;
-    }
+AnomalyStatus anomaly_detector_process(float current_temp, uint32_t elapsed_ms) {
+    return detector.process(current_temp, elapsed_ms);
+}
 
-    // 4. "Re-Train" the model with the new data
-    update_rate_buffer(new_rate);
-    calculate_statistics();
+bool anomaly_detector_take_event(AnomalyEvent* event) {
+    return detector.take_event(event);
+}
 
-    // Update status with the latest stats
-    status.current_mean = current_mean;
-    status.current_std_dev = current_std_dev;
+void anomaly_detector_get_state(AnomalyDetectorState* state) {
+    detector.get_state(state);
+}
 
-    return status;
-}
\ No newline at end of file
+void anomaly_detector_set_state(const AnomalyDetectorState* state) {
+    detector.set_state(state);
+}
@@ -2,14 +2,53 @@
 #define ANOMALY_DETECTOR_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "anomaly_detector_core.h"
 
+// Learned model, for saving across resets
 typedef struct {
-    bool is_anomalous;
+    float rate_buffer[RATE_BUFFER_SIZE];
+    int32_t buffer_index;
     float current_mean;
     float current_std_dev;
-} AnomalyStatus;
+} AnomalyDetectorState;
 
+// Rate-of-change detector for one stream of readings. Instances are
+// independent: one per sensor channel, or per device in a host-side
+// aggregator. Not thread-safe; each instance is used from one thread.
+class AnomalyDetector {
+public:
+    AnomalyDetector();
+
+    // Forgets the model, as after a cold boot
+    void reset();
+    // elapsed_ms is the time since the previous reading. The model learns the
+    // rate of change per SAMPLE_INTERVAL_MS: faster readings are accumulated
+    // until that much time has passed (the last decision is returned meanwhile),
+    // slower ones have their rate scaled down to it. The window holds the last
+    // RATE_BUFFER_SIZE rates whatever their span; when the span drops to less
+    // than half the previous one, nothing is flagged until the window has
+    // been refilled at the new span.
+    AnomalyStatus process(float value, uint32_t elapsed_ms = SAMPLE_INTERVAL_MS);
+    // The reading flagged by the last process() call, once: false if that
+    // call flagged nothing new (readings between two rate evaluations repeat
+    // the last decision but are not new events)
+    bool take_event(AnomalyEvent* event);
+    void get_state(AnomalyDetectorState* state) const;
+    // Resumes with a saved model. The next reading starts a new rate: the time
+    // since the save is not a sample interval.
+    void set_state(const AnomalyDetectorState* state);
+
+private:
+    AnomalyDetectorCore<MonitorConfig> _core;
+};
+
+// The firmware's temperature detector: a default instance
 void anomaly_detector_init();
-AnomalyStatus anomaly_detector_process(float current_temp);
+AnomalyStatus anomaly_detector_process(float current_temp, uint32_t elapsed_ms = SAMPLE_INTERVAL_MS);
+bool anomaly_detector_take_event(AnomalyEvent* event);
+void anomaly_detector_get_state(AnomalyDetectorState* state);
+void anomaly_detector_set_state(const AnomalyDetectorState* state);
 
-#endif // ANOMALY_DETECTOR_H
\ No newline at end of file
+#endif // ANOMALY_DETECTOR_H
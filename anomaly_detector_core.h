@@ -0,0 +1,200 @@
+#ifndef ANOMALY_DETECTOR_CORE_H
+#define ANOMALY_DETECTOR_CORE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+
+typedef struct {
+    bool is_anomalous;
+    float current_mean;
+    float current_std_dev;
+} AnomalyStatus;
+
+// A reading the detector flagged, with what the decision was based on
+typedef struct {
+    uint32_t sequence;      // counts flagged readings since init
+    float z_score;
+    float rate;             // change per SAMPLE_INTERVAL_MS that was flagged
+    float mean;             // model the rate was judged against
+    float std_dev;
+    float previous_temp;    // the two readings the rate was taken from
+    float current_temp;
+} AnomalyEvent;
+
+// The detector's per-sample work, templated on a configuration type (see
+// MonitorConfig in config.h) so the rate window is a compile-time constant:
+// the statistics loops unroll for small windows and a power-of-two window
+// wraps with a mask. AnomalyDetector (anomaly_detector.h) wraps the
+// MonitorConfig instantiation.
+
+template <typename Config>
+struct AnomalyDetectorCore {
+    float rate_buffer[Config::rate_window];
+    int32_t buffer_index;
+    int32_t window;                     // rate_window unless Config::runtime_window
+    float z_threshold;                  // Config::z_threshold unless Config::runtime_threshold
+    float current_mean;
+    float current_std_dev;
+    float last_temp_reading;
+    bool is_first_temp_reading;
+    uint32_t elapsed_since_last_rate_ms;
+    uint32_t rate_span_ms;              // time the last rate was taken over
+    int32_t settling;                   // rates to learn before judging again
+    bool last_is_anomalous;
+    bool event_pending;
+    AnomalyEvent last_event;
+
+    int32_t size() const
+    {
+        return Config::runtime_window ? window : Config::rate_window;
+    }
+
+    float threshold() const
+    {
+        return Config::runtime_threshold ? z_threshold : Config::z_threshold;
+    }
+
+    int32_t next_index(int32_t i) const
+    {
+        if (!Config::runtime_window && (Config::rate_window & (Config::rate_window - 1)) == 0) {
+            return (i + 1) & (Config::rate_window - 1);
+        }
+        return i + 1 == size() ? 0 : i + 1;
+    }
+};
+
+// window is used only with Config::runtime_window, clamped to 1..rate_window;
+// z_threshold only with Config::runtime_threshold
+template <typename Config>
+void anomaly_core_reset(AnomalyDetectorCore<Config>& core, int window = Config::rate_window,
+                        float z_threshold = Config::z_threshold)
+{
+    memset(core.rate_buffer, 0, sizeof(core.rate_buffer));
+    core.buffer_index = 0;
+    core.window = window < 1 ? 1 : (window > Config::rate_window ? Config::rate_window : window);
+    core.z_threshold = z_threshold;
+    core.current_mean = 0.0f;
+    core.current_std_dev = 0.0f;
+    core.last_temp_reading = 0.0f;
+    core.is_first_temp_reading = true;
+    core.elapsed_since_last_rate_ms = 0;
+    core.rate_span_ms = 0;
+    core.settling = 0;
+    core.last_is_anomalous = false;
+    core.event_pending = false;
+    memset(&core.last_event, 0, sizeof(core.last_event));
+}
+
+template <typename Config>
+void anomaly_core_statistics(AnomalyDetectorCore<Config>& core)
+{
+    const int32_t n = core.size();
+
+    // 1. Calculate Mean
+    float sum = 0.0f;
+    for (int32_t i = 0; i < n; i++) {
+        sum += core.rate_buffer[i];
+    }
+    core.current_mean = sum / n;
+
+    // 2. Calculate Standard Deviation
+    float sum_sq_diff = 0.0f;
+    for (int32_t i = 0; i < n; i++) {
+        sum_sq_diff += (core.rate_buffer[i] - core.current_mean) * (core.rate_buffer[i] - core.current_mean);
+    }
+    // Use N instead of N-1 for population standard deviation on the rolling window
+    core.current_std_dev = sqrtf(sum_sq_diff / n);
+}
+
+// See anomaly_detector_process()
+template <typename Config>
+AnomalyStatus anomaly_core_process(AnomalyDetectorCore<Config>& core, float current_temp, uint32_t elapsed_ms)
+{
+    AnomalyStatus status = {false, core.current_mean, core.current_std_dev};
+    core.event_pending = false;
+
+    if (core.is_first_temp_reading) {
+        core.last_temp_reading = current_temp; // Initialize
+        core.is_first_temp_reading = false;
+        return status; // Can't calculate a rate yet
+    }
+
+    // Wait for a full sample interval before taking the next rate
+    core.elapsed_since_last_rate_ms += elapsed_ms;
+    if (core.elapsed_since_last_rate_ms < Config::sample_interval_ms) {
+        status.is_anomalous = core.last_is_anomalous;
+        return status;
+    }
+
+    // 1. Calculate the feature: "rate of change" per sample interval
+    float new_rate = current_temp - core.last_temp_reading;
+    if (core.elapsed_since_last_rate_ms != Config::sample_interval_ms) {
+        new_rate = new_rate * Config::sample_interval_ms / core.elapsed_since_last_rate_ms;
+    }
+    float previous_temp = core.last_temp_reading;
+    core.last_temp_reading = current_temp;
+
+    // The window is a number of rates, not a time: at slow intervals it
+    // reaches further back, which keeps enough rates for a stable spread.
+    // Scaling a slow rate down scales its sensor noise down too, so a rate
+    // over a much shorter span would be judged against a spread too narrow
+    // for it: the window is learnt again at the new span first.
+    if (core.elapsed_since_last_rate_ms * 2 < core.rate_span_ms) {
+        core.settling = core.size();
+    }
+    core.rate_span_ms = core.elapsed_since_last_rate_ms;
+    core.elapsed_since_last_rate_ms = 0;
+
+    // 2. Perform "Inference" (Detect Anomaly)
+    // Only check if model is "trained" enough (std_dev is not near zero)
+    if (core.settling > 0) {
+        core.settling--;
+    } else if (core.current_std_dev > Config::min_std_dev) {
+        float z_score = (new_rate - core.current_mean) / core.current_std_dev;
+
+        // 3. The AI Decision!
+        if (fabsf(z_score) > core.threshold()) {
+            status.is_anomalous = true;
+
+            // Keep the evidence for the alert, before the model learns this rate
+            core.last_event.sequence++;
+            core.last_event.z_score = z_score;
+            core.last_event.rate = new_rate;
+            core.last_event.mean = core.current_mean;
+            core.last_event.std_dev = core.current_std_dev;
+            core.last_event.previous_temp = previous_temp;
+            core.last_event.current_temp = current_temp;
+            core.event_pending = true;
+        }
+    }
+
+    // 4. "Re-Train" the model with the new data
+    core.rate_buffer[core.buffer_index] = new_rate;
+    core.buffer_index = core.next_index(core.buffer_index);
+    anomaly_core_statistics(core);
+
+    core.last_is_anomalous = status.is_anomalous;
+
+    // Update status with the latest stats
+    status.current_mean = core.current_mean;
+    status.current_std_dev = core.current_std_dev;
+
+    return status;
+}
+
+// See anomaly_detector_take_event()
+template <typename Config>
+bool anomaly_core_take_event(AnomalyDetectorCore<Config>& core, AnomalyEvent* event)
+{
+    if (!core.event_pending) {
+        return false;
+    }
+    *event = core.last_event;
+    core.event_pending = false;
+    return true;
+}
+
+#endif // ANOMALY_DETECTOR_CORE_H
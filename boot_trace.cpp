@@ -0,0 +1,56 @@
+#include "boot_trace.h"
+#include "config.h"
+
+static const char* const event_names[BOOT_EVENT_COUNT] = {
+    "sensors_ready", "first_sample", "wifi_up", "mqtt_up", "first_publish"
+};
+
+static Timer boot_clock;
+static uint32_t event_ms[BOOT_EVENT_COUNT];
+
+void boot_trace_start() {
+    for (int i = 0; i < BOOT_EVENT_COUNT; i++) {
+        event_ms[i] = BOOT_TRACE_NOT_REACHED;
+    }
+    boot_clock.reset();
+    boot_clock.start();
+}
+
+void boot_trace_mark(BootEvent event) {
+    uint32_t now_ms = (uint32_t)boot_clock.read_ms();
+    core_util_critical_section_enter();
+    bool first = event_ms[event] == BOOT_TRACE_NOT_REACHED;
+    if (first) {
+        event_ms[event] = now_ms;
+    }
+    core_util_critical_section_exit();
+
+    if (first) {
+        printf("Boot: %s at %lu ms\n", event_names[event], (unsigned long)now_ms);
+        if (event == BOOT_FIRST_PUBLISH) {
+            boot_trace_print();
+        }
+    }
+}
+
+uint32_t boot_trace_time_ms(BootEvent event) {
+    core_util_critical_section_enter();
+    uint32_t ms = event_ms[event];
+    core_util_critical_section_exit();
+    return ms;
+}
+
+const char* boot_trace_event_name(BootEvent event) {
+    return event_names[event];
+}
+
+void boot_trace_print() {
+    printf("Boot timeline:");
+    for (int i = 0; i < BOOT_EVENT_COUNT; i++) {
+        uint32_t ms = boot_trace_time_ms((BootEvent)i);
+        if (ms != BOOT_TRACE_NOT_REACHED) {
+            printf(" %s=%lums", event_names[i], (unsigned long)ms);
+        }
+    }
+    printf("\n");
+}
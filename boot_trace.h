@@ -0,0 +1,28 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Milestones of the start-up, timed from boot_trace_start(). Each is
+// recorded the first time it is reached, from whichever thread reaches it.
+typedef enum {
+    BOOT_SENSORS_READY,
+    BOOT_FIRST_SAMPLE,
+    BOOT_WIFI_UP,
+    BOOT_MQTT_UP,
+    BOOT_FIRST_PUBLISH,
+    BOOT_EVENT_COUNT
+} BootEvent;
+
+#define BOOT_TRACE_NOT_REACHED UINT32_MAX
+
+void boot_trace_start();
+void boot_trace_mark(BootEvent event);
+// ms from boot_trace_start() to the event, or BOOT_TRACE_NOT_REACHED
+uint32_t boot_trace_time_ms(BootEvent event);
+const char* boot_trace_event_name(BootEvent event);
+// One line with every milestone reached so far
+void boot_trace_print();
+
+#endif // BOOT_TRACE_H
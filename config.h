@@ -21,7 +21,8 @@
 // (HIGH) Threshold for triggering a "High Temperature" warning.
 #define TEMP_THRESHOLD_HIGH 30.0f
 
-// (CRITICAL) Threshold for triggering a "Critical Temperature" warning.
+// (CRITICAL) Threshold for triggering a "Critical Temperature" warning
+// (double blink, overrides every other warning).
 #define TEMP_THRESHOLD_CRITICAL 35.0f
 
 // (LOW) Threshold for triggering a "Low Temperature" warning.
@@ -46,16 +47,195 @@
 #define SENSOR_UPDATE_INTERVAL_MS 2000
 #define SAMPLE_INTERVAL_MS SENSOR_UPDATE_INTERVAL_MS
 
+// --- Adaptive Sampling ---
+// When enabled, sampling.cpp moves the interval between SAMPLE_INTERVAL_MIN_MS
+// and SAMPLE_INTERVAL_MAX_MS: fastest near a threshold or while an anomaly is
+// flagged, slower and slower while the temperature stays flat. Otherwise the
+// sensors are read every SENSOR_UPDATE_INTERVAL_MS.
+#ifndef ADAPTIVE_SAMPLING
+#define ADAPTIVE_SAMPLING 1
+#endif
+
+// Fastest interval: one reading per HTS221 conversion at its top ODR (12.5 Hz)
+#define SAMPLE_INTERVAL_MIN_MS 80
+
+// Slowest interval while the temperature is flat
+#define SAMPLE_INTERVAL_MAX_MS 32000
+
+// Sample fast when the temperature is within this many degC of the LOW,
+// HIGH or CRITICAL threshold
+#define SAMPLING_THRESHOLD_MARGIN 1.0f
+
+// Keep sampling fast for this long after the last trigger. A threshold only
+// triggers fast sampling while the temperature has left its flat band within
+// this time.
+#define SAMPLING_FAST_HOLD_MS 4000
+
+// The temperature counts as flat while it stays within this band (degC) of
+// the reading that started the band; leaving it restores the nominal interval
+#define SAMPLING_FLAT_BAND 0.2f
+
+// Number of flat readings after which the interval is doubled
+#define SAMPLING_FLAT_SAMPLES 5
+
 // --- Temperature Tracking ---
-// Number of samples per hour (for rolling 1-hour statistics)
+// Length of the min/max statistics period
+#define TEMP_STATS_PERIOD_MS (60UL * 60UL * 1000UL)
+
+// Number of samples per hour at the nominal interval
 // At 2000ms intervals: 60 minutes * 60 seconds / 2 seconds = 1800 samples per hour
-// Using a practical value: 1800 samples = exactly 1 hour at 2000ms intervals
-#define SAMPLES_PER_HOUR 1800
+#define SAMPLES_PER_HOUR (TEMP_STATS_PERIOD_MS / SAMPLE_INTERVAL_MS)
+
+// --- State Persistence ---
+// When enabled, the detector model and the tracker statistics are saved to
+// the last STATE_FLASH_SIZE bytes of internal flash and restored at boot, so
+// a reset does not leave the monitor untrained (see persistence.h).
+#ifndef STATE_PERSISTENCE
+#define STATE_PERSISTENCE 1
+#endif
+
+// Flash reserved for saved state: four 2 KB pages on the STM32L475. Records
+// go to the pages in turn, so each page is erased once per 4 * 21 saves.
+#define STATE_FLASH_SIZE (8 * 1024)
+
+// How often the state is saved. At 10 minutes each page is erased about
+// every 14 hours: over 10 000 cycles last more than 15 years.
+#define STATE_SAVE_INTERVAL_MS (10UL * 60UL * 1000UL)
+
+// Bumped when MonitorSnapshot changes; older snapshots are then ignored
+#define STATE_SNAPSHOT_VERSION 1
+
+// --- Reading History ---
+// When enabled, every reading is also logged to the first HISTORY_STORE_SIZE
+// bytes of the board's QSPI flash (history_store.h), so days of history
+// survive a reset. Readings are stamped from the RTC once SNTP has set it
+// (time_sync.h); until then the stamps carry on from the newest one stored.
+#ifndef HISTORY_STORE
+#define HISTORY_STORE 1
+#endif
+
+// 1 MB of the 8 MB part: 256 segments of one 4 KB sector, about eight days
+// of readings at the nominal interval
+#define HISTORY_STORE_SIZE (1024 * 1024)
+
+// Remote history queries (history_query.h): chunks sent per pass of the
+// main loop at most, chunks a client may have unacknowledged unless its
+// request says otherwise, and how long a query waits for an acknowledgement
+// before it is given up
+#define HISTORY_QUERY_CHUNKS_PER_PASS 4
+#define HISTORY_QUERY_WINDOW 8
+#define HISTORY_QUERY_TIMEOUT_MS 30000
+
+// --- Memory ---
+// "No heap after init": once the network thread has made its first broker
+// connect attempt, whatever the outcome, any further heap allocation is a
+// fatal error, raised inside the allocation with the caller's address
+// (heap_guard.h). Build with mbed_app_no_heap.json, which sets this and the
+// memory tracing it needs.
+#ifndef NO_HEAP_AFTER_INIT
+#define NO_HEAP_AFTER_INIT 0
+#endif
+
+// How often the system statistics are sampled and published
+#define SYSTEM_STATS_INTERVAL_MS 60000
+
+// Threads reported by system_stats (main, idle, timer, WiFi read thread, ...)
+#define SYSTEM_STATS_MAX_THREADS 8
+
+// --- Display ---
+// The user button flips the console dashboard between the sensor page and
+// the system statistics page; edges within DISPLAY_BUTTON_DEBOUNCE_MS of a
+// flip are contact bounce
+#define DISPLAY_PAGE_BUTTON BUTTON1
+#define DISPLAY_BUTTON_DEBOUNCE_MS 50
 
 // --- MQTT Configuration ---
 #define MQTT_BROKER_HOSTNAME "192.168.29.45"
 #define MQTT_BROKER_PORT 1883
 
+// --- MQTT Delivery ---
+// QoS for sensor data publishes: 0 = at most once, 1 = at least once
+// (retransmitted after a reconnect until the broker acknowledges it).
+#ifndef MQTT_DATA_QOS
+#define MQTT_DATA_QOS 1
+#endif
+
+// Maximum number of QoS 1 publishes awaiting PUBACK. Publishing keeps going
+// while acknowledgements are outstanding and only waits once this many are.
+// Each slot holds one serialized packet (mqtt.max-packet-size bytes of RAM).
+#ifndef MQTT_INFLIGHT_WINDOW
+#define MQTT_INFLIGHT_WINDOW 8
+#endif
+
+// How long to wait for CONNACK, a free in-flight slot or PINGRESP
+#define MQTT_COMMAND_TIMEOUT_MS 10000
+
+// Keep alive interval sent in CONNECT, in seconds
+#define MQTT_KEEPALIVE_INTERVAL_S 60
+
+// Minimum time between data publishes (and display refreshes) while sampling
+// faster than the nominal interval. A change in the anomaly flag, or a
+// reading crossing a threshold, is published straight away.
+#define MQTT_PUBLISH_MIN_INTERVAL_MS SENSOR_UPDATE_INTERVAL_MS
+
+// A reading has to come back this far (degC) inside a threshold before it
+// counts as crossing it again, so noise does not trigger a publish per reading
+#define REPORT_THRESHOLD_HYSTERESIS 0.2f
+
+// --- Network Thread ---
+// WiFi association and the MQTT connect run on their own thread at boot, so
+// sampling starts straight away (see network_task.h)
+#define NETWORK_TASK_STACK_SIZE 4096
+#define NETWORK_TASK_PRIORITY osPriorityBelowNormal
+
+// WiFi link supervision (link_manager.h): how often the link is polled, the
+// rejoin backoff range, and how often the AP is looked for while rejoining
+#define LINK_CHECK_INTERVAL_MS 5000
+#define LINK_RETRY_MIN_MS 1000
+#define LINK_RETRY_MAX_MS 30000
+#define LINK_SCAN_INTERVAL_MS 2000
+#define LINK_SCAN_MAX_APS 8
+#ifndef LINK_FAST_REJOIN
+#define LINK_FAST_REJOIN 1
+#endif
+
+// MQTT reconnect backoff range while the link is up (network_task.cpp)
+#define MQTT_RETRY_MIN_MS 1000
+#define MQTT_RETRY_MAX_MS 30000
+
+// RTC sync over SNTP (time_sync.h): the server, how long a request may
+// take, and how often the clock is set again, or retried until it has been.
+// The server's name is looked up once, when the link first comes up; with
+// NO_HEAP_AFTER_INIT a failed lookup is not retried (mbed's DNS client
+// allocates), so an IP address is the safer choice there.
+#ifndef TIME_SYNC_SERVER
+#define TIME_SYNC_SERVER "pool.ntp.org"
+#endif
+#define TIME_SYNC_TIMEOUT_MS 2000
+#ifndef TIME_SYNC_INTERVAL_MS
+#define TIME_SYNC_INTERVAL_MS (6UL * 60UL * 60UL * 1000UL)
+#endif
+#define TIME_SYNC_RETRY_MS 60000
+
+// Reports kept while there is no MQTT session, published once it is up.
+// They are compressed (series_codec.h) into SAMPLE_BACKLOG_BLOCKS blocks of
+// SAMPLE_BACKLOG_BLOCK_SIZE bytes; a block holds about 70 reports of a
+// steady room, so the default covers some ten minutes at the nominal
+// interval. When all are full the oldest block is dropped.
+#define SAMPLE_BACKLOG_BLOCKS 4
+#define SAMPLE_BACKLOG_BLOCK_SIZE 256
+
+// Trailing-window statistics (window_stats.h): readings are folded into
+// WINDOW_STATS_SLOTS slots of WINDOW_STATS_SLOT_MS, 512 x 8 s = 68 minutes,
+// enough for the 60-minute window. The slots must be a power of two; the
+// tree takes 12 bytes a slot, twice over (12 KB).
+#define WINDOW_STATS_SLOT_MS 8000
+#define WINDOW_STATS_SLOTS 512
+
+// Backlogged reports published per pass of the main loop, so catching up
+// does not delay sampling
+#define SAMPLE_BACKLOG_DRAIN_PER_PASS 4
+
 // --- MQTT Topics ---
 // Topic for publishing sensor data (temperature, humidity, pressure).
 #define MQTT_TOPIC_DATA "iot-temp-monitor/data"
@@ -63,12 +243,53 @@
 // Topic for publishing system status and alerts (e.g., "High Temp", "OK").
 #define MQTT_TOPIC_STATUS "iot-temp-monitor/status"
 
-// Topic for publishing AI-detected anomalies.
+// Topic for publishing heap, stack and CPU statistics (see system_stats.h).
+#define MQTT_TOPIC_METRICS "iot-temp-monitor/metrics"
+// and for the outbound queue's per-class depth, drops and latency
+#define MQTT_TOPIC_QUEUE_METRICS "iot-temp-monitor/metrics/queue"
+
+// Topic for publishing AI-detected anomalies (anomaly_alert.h): one event
+// per flagged reading, published ahead of any queued report.
 #define MQTT_TOPIC_ANOMALY "iot-temp-monitor/anomaly"
 
+// Remote history queries (history_query.h): requests and acknowledgements
+// are received on the first, compressed chunks of readings published on the
+// second
+#define MQTT_TOPIC_HISTORY_REQUEST "iot-temp-monitor/history/request"
+#define MQTT_TOPIC_HISTORY_DATA "iot-temp-monitor/history/data"
+
+// Messages received on MQTT_TOPIC_HISTORY_REQUEST kept until the main loop
+// takes them, and their size; longer ones are cut
+#define MQTT_REQUEST_SLOTS 4
+#define MQTT_REQUEST_MAX_LEN 128
+
+// Outbound queue (mqtt_handler.h): message slots per priority class, each
+// MBED_CONF_MQTT_MAX_PACKET_SIZE bytes, and how many messages each class
+// may send per drain round. Backlogged readings are drained into the
+// backfill pool a few per pass, so it needs the most room. Telemetry takes
+// a reading and the two metrics records in the same pass.
+#define MQTT_QUEUE_ALERT_SLOTS 2
+#define MQTT_QUEUE_STATUS_SLOTS 2
+#define MQTT_QUEUE_TELEMETRY_SLOTS 3
+#define MQTT_QUEUE_BACKFILL_SLOTS SAMPLE_BACKLOG_DRAIN_PER_PASS
+#define MQTT_QUEUE_HISTORY_SLOTS HISTORY_QUERY_CHUNKS_PER_PASS
+#define MQTT_QUEUE_ALERT_WEIGHT 4
+#define MQTT_QUEUE_STATUS_WEIGHT 2
+#define MQTT_QUEUE_TELEMETRY_WEIGHT 2
+#define MQTT_QUEUE_BACKFILL_WEIGHT 1
+#define MQTT_QUEUE_HISTORY_WEIGHT 1
+
+// Anomaly events kept while there is no MQTT session, and their QoS
+#define ANOMALY_ALERT_QUEUE_SIZE 4
+#define MQTT_ANOMALY_QOS 1
+
 // --- Anomaly Detection ---
 // The number of data points to use for the Simple Moving Average (SMA).
+// Can be overridden from the build; for several sizes in one build, see
+// MonitorConfig below.
+#ifndef SMA_WINDOW_SIZE
 #define SMA_WINDOW_SIZE 10
+#endif
 
 // Buffer size for rate of change measurements (used in anomaly detector)
 #define RATE_BUFFER_SIZE SMA_WINDOW_SIZE
@@ -96,4 +317,45 @@
 #define MQTT_USERNAME ""
 #define MQTT_PASSWORD ""
 
+#ifdef __cplusplus
+// --- Compile-time Tuning ---
+// The detector and tracker kernels (anomaly_detector_core.h,
+// temp_tracker_core.h) are templates over a configuration type. MonitorConfig
+// holds the values above and is what the firmware uses; a differently tuned
+// variant derives from it and overrides members, e.g.
+//   struct FastConfig : MonitorConfig { static constexpr int rate_window = 4; };
+struct MonitorConfig {
+    static constexpr uint32_t sample_interval_ms = SAMPLE_INTERVAL_MS;
+    static constexpr uint32_t stats_period_ms = TEMP_STATS_PERIOD_MS;
+    static constexpr int rate_window = RATE_BUFFER_SIZE;
+    static constexpr float z_threshold = ANOMALY_Z_SCORE_THRESHOLD;
+    // Anomalies are flagged once the model's spread exceeds this
+    static constexpr float min_std_dev = 0.001f;
+    // When set, rate_window is only the buffer capacity and the window is
+    // chosen at reset: one instantiation for any size, without unrolling
+    static constexpr bool runtime_window = false;
+    // When set, z_threshold is only the default and the threshold is chosen
+    // at reset, e.g. to re-score recorded history with another one
+    static constexpr bool runtime_threshold = false;
+};
+
+// MonitorConfig (or Base) with another rate window
+template <int Window, typename Base = MonitorConfig>
+struct MonitorConfigWindow : Base {
+    static constexpr int rate_window = Window;
+};
+
+// Window chosen at run time, up to Capacity
+template <int Capacity, typename Base = MonitorConfig>
+struct MonitorConfigRuntimeWindow : MonitorConfigWindow<Capacity, Base> {
+    static constexpr bool runtime_window = true;
+};
+
+// Base with the z-score threshold chosen at run time
+template <typename Base = MonitorConfig>
+struct MonitorConfigRuntimeThreshold : Base {
+    static constexpr bool runtime_threshold = true;
+};
+#endif // __cplusplus
+
 #endif // CONFIG_H
\ No newline at end of file
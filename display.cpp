@@ -1,7 +1,57 @@
 #include "display.h"
 #include "config.h"
 
-void display_update(const SensorData& current_data, const TempStats1Hour& stats, const AnomalyStatus& anomaly_status) {
+// User button toggling between the dashboard and the system statistics page
+static InterruptIn page_button(DISPLAY_PAGE_BUTTON);
+static volatile bool system_page_active = false;
+static Timer since_toggle;
+
+// Runs in interrupt context. A press bounces: edges soon after a toggle are
+// ignored.
+static void toggle_page() {
+    if (since_toggle.elapsed_time() < chrono::milliseconds(DISPLAY_BUTTON_DEBOUNCE_MS)) {
+        return;
+    }
+    since_toggle.reset();
+    system_page_active = !system_page_active;
+}
+
+void display_init() {
+    since_toggle.start();
+    page_button.fall(&toggle_page);
+}
+
+bool display_system_page_active() {
+    return system_page_active;
+}
+
+void display_system_stats(const SystemStats& stats) {
+    printf("\033[2J\033[H");
+
+    printf("--- System Stats ---\n\n");
+    printf("Uptime:   %lu s\n", (unsigned long)stats.uptime_s);
+    printf("CPU idle: %u %%\n", (unsigned)stats.cpu_idle_pct);
+    printf("\n");
+
+    printf("Heap:\n");
+    printf("  Current:  %lu bytes\n", (unsigned long)stats.heap_current);
+    printf("  Peak:     %lu bytes\n", (unsigned long)stats.heap_max);
+    printf("  Reserved: %lu bytes\n", (unsigned long)stats.heap_reserved);
+    printf("  Failed allocations: %lu\n", (unsigned long)stats.heap_alloc_fail);
+    printf("\n");
+
+    printf("Thread Stacks (peak used / size):\n");
+    for (int i = 0; i < stats.thread_count; i++) {
+        const ThreadStackStats& t = stats.threads[i];
+        printf("  %-11s %5lu / %5lu bytes\n", t.name, (unsigned long)t.stack_used, (unsigned long)t.stack_size);
+    }
+    printf("\n");
+
+    printf("----------------------------------\n");
+    printf("Press the user button for the sensor dashboard\n");
+}
+
+void display_update(const SensorData& current_data, const TempStats1Hour& stats, const WindowStats* windows, const AnomalyStatus& anomaly_status) {
     // ANSI escape codes: Clear screen and move cursor to top-left
     printf("\033[2J\033[H");
 
@@ -22,6 +72,19 @@ void display_update(const SensorData& current_data, const TempStats1Hour& stats,
     }
     printf("\n");
 
+    printf("Trailing Windows:     Min      Max     Mean\n");
+    for (int i = 0; i < WINDOW_STATS_COUNT; i++) {
+        const WindowStats& w = windows[i];
+        unsigned long minutes = (unsigned long)(window_stats_span_ms(i) / 60000);
+        if (w.valid) {
+            printf("  Last %2lu min:  %6.2f C %6.2f C %6.2f C%s\n", minutes, w.min_temp, w.max_temp, w.mean_temp,
+                   w.covered_ms < window_stats_span_ms(i) ? " (partial)" : "");
+        } else {
+            printf("  Last %2lu min:  (No readings yet)\n", minutes);
+        }
+    }
+    printf("\n");
+
     printf("System Status:\n");
     printf("  AI Status: %s\n", anomaly_status.is_anomalous ? "🚨 ANOMALY DETECTED! 🚨" : "✅ Normal");
     // Optional: Display AI model stats for debugging
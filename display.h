@@ -4,8 +4,16 @@
 #include "sensors.h"
 #include "temp_tracker.h"
 #include "anomaly_detector.h"
+#include "system_stats.h"
+#include "window_stats.h"
 #include <stdbool.h>
 
-void display_update(const SensorData& current_data, const TempStats1Hour& stats, const AnomalyStatus& anomaly_status);
+void display_init();
+// windows: the WINDOW_STATS_COUNT trailing windows of window_stats.h
+void display_update(const SensorData& current_data, const TempStats1Hour& stats, const WindowStats* windows, const AnomalyStatus& anomaly_status);
+
+// Hidden page, shown instead of the dashboard after a press of DISPLAY_PAGE_BUTTON
+bool display_system_page_active();
+void display_system_stats(const SystemStats& stats);
 
 #endif // DISPLAY_H
\ No newline at end of file
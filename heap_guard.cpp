@@ -0,0 +1,46 @@
+#include "heap_guard.h"
+#include "config.h"
+
+#if NO_HEAP_AFTER_INIT
+#include <stdarg.h>
+#include "mbed_mem_trace.h"
+#include "mbed_stats.h"
+
+#if !MBED_MEM_TRACING_ENABLED
+#error "NO_HEAP_AFTER_INIT needs \"platform.memory-tracing-enabled\": true (build with mbed_app_no_heap.json)"
+#endif
+
+// Called by the allocator with the trace lock held; error() halts without
+// allocating
+static void heap_trace(uint8_t op, void* res, void* caller, ...) {
+    if (op == MBED_MEM_TRACE_FREE) {
+        return;
+    }
+    va_list args;
+    va_start(args, caller);
+    size_t size;
+    if (op == MBED_MEM_TRACE_REALLOC) {
+        (void)va_arg(args, void*);
+        size = va_arg(args, size_t);
+    } else if (op == MBED_MEM_TRACE_CALLOC) {
+        size = va_arg(args, size_t);
+        size *= va_arg(args, size_t);
+    } else {
+        size = va_arg(args, size_t);
+    }
+    va_end(args);
+    error("Heap allocation after init: %lu bytes from %p (%s)\n", (unsigned long)size, caller,
+          res ? "allocated" : "failed");
+}
+#endif
+
+void heap_guard_lock() {
+#if NO_HEAP_AFTER_INIT
+    mbed_stats_heap_t stats;
+    mbed_stats_heap_get(&stats);
+    printf("Heap locked: %lu bytes in %lu blocks (peak %lu bytes)\n",
+           (unsigned long)stats.current_size, (unsigned long)stats.alloc_cnt,
+           (unsigned long)stats.max_size);
+    mbed_mem_trace_set_callback(heap_trace);
+#endif
+}
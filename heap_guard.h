@@ -0,0 +1,15 @@
+#ifndef HEAP_GUARD_H
+#define HEAP_GUARD_H
+
+// "No heap after init" mode, enabled with NO_HEAP_AFTER_INIT in config.h.
+// heap_guard_lock() does nothing when it is disabled.
+//
+// Hooks the allocator through mbed's memory tracing: once locked, the next
+// malloc, calloc or realloc is a fatal error raised inside that call, before
+// it returns, naming its size and the caller's address (look it up in the
+// linker map). Frees are allowed.
+
+// Call once initialization is over, including the first MQTT connect
+void heap_guard_lock();
+
+#endif // HEAP_GUARD_H
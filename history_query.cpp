@@ -0,0 +1,329 @@
+#include "history_query.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "history_store.h"
+#include "mqtt_handler.h"
+#include "sample_history.h"
+#include "series_codec.h"
+#include "time_sync.h"
+
+// The query in progress
+static bool active = false;
+static uint16_t query_id = 0;
+static uint16_t window = 0;
+static uint16_t seq = 0;                // chunks sent
+static uint16_t acked = 0;              // chunks acknowledged
+static uint32_t started_ms = 0;
+static uint32_t progress_ms = 0;        // last chunk sent or acknowledgement that moved
+static uint32_t readings_sent = 0;
+static uint32_t bytes_sent = 0;
+static HistoryCursor cursor;
+static bool exhausted = false;          // every reading in the range has been taken
+
+// The record being read from, and a reading taken from it that did not fit
+// the last chunk
+static uint8_t record[HISTORY_STORE_BLOCK_SIZE];
+static HistoryRecordInfo record_info;
+static SeriesDecoder decoder;
+static bool record_open = false;
+static bool held = false;
+static uint64_t held_ms = 0;
+static int32_t held_values[SAMPLE_HISTORY_CHANNELS];
+
+// The next message, built and waiting for room in the outbound queue
+static uint8_t reply[HISTORY_QUERY_HEADER_SIZE + HISTORY_QUERY_BLOCK_SIZE];
+static int reply_len = 0;
+static HistoryReplyKind reply_kind = HISTORY_REPLY_CHUNK;
+static uint16_t reply_readings = 0;
+
+static char request[MQTT_REQUEST_MAX_LEN + 1];
+static HistoryQueryStats stats;
+
+// --- Helper Functions ---
+static void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put_u64(uint8_t* p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static void put_header(uint8_t* p, HistoryReplyKind kind, uint16_t id, uint64_t first_ms) {
+    p[0] = HISTORY_QUERY_VERSION;
+    p[1] = (uint8_t)kind;
+    put_u16(p + 2, id);
+    put_u16(p + 4, seq);
+    put_u16(p + 6, 0);
+    put_u64(p + 8, first_ms);
+}
+
+// Builds a message that ends a query into p; returns its length
+static int put_end(uint8_t* p, HistoryReplyKind kind, uint16_t id, uint32_t now_ms) {
+    int len = HISTORY_QUERY_HEADER_SIZE + 16;
+    put_header(p, kind, id, 0);
+    put_u32(p + HISTORY_QUERY_HEADER_SIZE, seq);
+    put_u32(p + HISTORY_QUERY_HEADER_SIZE + 4, readings_sent);
+    put_u32(p + HISTORY_QUERY_HEADER_SIZE + 8, bytes_sent + len);
+    put_u32(p + HISTORY_QUERY_HEADER_SIZE + 12, now_ms - started_ms);
+    return len;
+}
+
+// The integer after "key": in a flat JSON object
+static bool json_field(const char* json, const char* key, long long* value) {
+    char pattern[16];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char* p = strstr(json, pattern);
+    if (!p) {
+        return false;
+    }
+    p += strlen(pattern);
+    while (*p == ' ') {
+        p++;
+    }
+    if (*p++ != ':') {
+        return false;
+    }
+    char* end;
+    *value = strtoll(p, &end, 10);
+    return end != p;
+}
+
+// Takes the next reading in the range from the history into held
+static bool next_reading() {
+    while (!exhausted) {
+        uint32_t offset_ms;
+        if (record_open && series_decoder_next(&decoder, &offset_ms, held_values)) {
+            uint64_t t = record_info.first_ms + offset_ms;
+            if (t < cursor.from_ms) {
+                continue;
+            }
+            if (t > cursor.to_ms) {
+                exhausted = true;
+                break;
+            }
+            held_ms = t;
+            held = true;
+            return true;
+        }
+        if (!history_store_next(&cursor, &record_info, record)) {
+            exhausted = true;
+            break;
+        }
+        record_open = series_decoder_init(&decoder, record, record_info.size);
+    }
+    return false;
+}
+
+// Compresses readings into the next chunk until it is full; 0 when none are left
+static uint16_t build_chunk() {
+    SeriesEncoder encoder;
+    uint64_t first_ms = 0;
+    series_encoder_init(&encoder, reply + HISTORY_QUERY_HEADER_SIZE, HISTORY_QUERY_BLOCK_SIZE, SAMPLE_HISTORY_CHANNELS);
+    while (held || next_reading()) {
+        if (encoder.count == 0) {
+            first_ms = held_ms;
+        }
+        if (held_ms - first_ms > UINT32_MAX ||
+                !series_encoder_append(&encoder, (uint32_t)(held_ms - first_ms), held_values)) {
+            break;
+        }
+        held = false;
+    }
+    if (encoder.count == 0) {
+        return 0;
+    }
+    put_header(reply, HISTORY_REPLY_CHUNK, query_id, first_ms);
+    reply_len = HISTORY_QUERY_HEADER_SIZE + series_encoder_bytes(&encoder);
+    reply_kind = HISTORY_REPLY_CHUNK;
+    return encoder.count;
+}
+
+static void end_query(HistoryReplyKind kind, uint32_t now_ms) {
+    active = false;
+    reply_len = 0;
+    uint32_t latency_ms = now_ms - started_ms;
+    if (kind == HISTORY_REPLY_END) {
+        stats.completed++;
+        stats.last_latency_ms = latency_ms;
+        if (latency_ms > stats.max_latency_ms) {
+            stats.max_latency_ms = latency_ms;
+        }
+        stats.last_bytes = bytes_sent;
+    } else if (kind == HISTORY_REPLY_TIMED_OUT) {
+        stats.timed_out++;
+    } else {
+        stats.cancelled++;
+    }
+    printf("History Query: #%u %s, %lu readings in %u chunks, %lu bytes, %lu ms\n", query_id,
+           kind == HISTORY_REPLY_END ? "done" : (kind == HISTORY_REPLY_TIMED_OUT ? "timed out" : "cancelled"),
+           (unsigned long)readings_sent, seq, (unsigned long)bytes_sent, (unsigned long)latency_ms);
+}
+
+// Queues the message in reply; false if the queue has no room for it yet
+static bool send_reply(uint32_t now_ms) {
+    if (!mqtt_publish_history(reply, reply_len)) {
+        return false;
+    }
+    bytes_sent += reply_len;
+    stats.bytes += reply_len;
+    progress_ms = now_ms;
+    reply_len = 0;
+    if (reply_kind == HISTORY_REPLY_CHUNK) {
+        seq++;
+        readings_sent += reply_readings;
+        stats.chunks++;
+        stats.readings += reply_readings;
+    } else {
+        end_query(reply_kind, now_ms);
+    }
+    return true;
+}
+
+// A query that cannot make progress is told so once, if the queue has room
+static void give_up(HistoryReplyKind kind, uint32_t now_ms) {
+    reply_len = put_end(reply, kind, query_id, now_ms);
+    reply_kind = kind;
+    if (!send_reply(now_ms)) {
+        end_query(kind, now_ms);
+    }
+}
+
+// Answers a request that does not start a query; sent once, if there is room
+static void reject(HistoryReplyKind kind, uint16_t id) {
+    uint8_t notice[HISTORY_QUERY_HEADER_SIZE + 16];
+    memset(notice, 0, sizeof(notice));
+    put_header(notice, kind, id, 0);
+    put_u16(notice + 4, 0);
+    stats.rejected++;
+    mqtt_publish_history(notice, sizeof(notice));
+}
+
+static void handle_request(const char* json, uint32_t now_ms) {
+    long long id, value;
+    stats.requests++;
+    if (!json_field(json, "id", &id)) {
+        reject(HISTORY_REPLY_BAD_REQUEST, 0);
+        return;
+    }
+
+    // Acknowledgements and cancels, for the query in progress only
+    bool is_ack = json_field(json, "ack", &value);
+    if (is_ack || json_field(json, "cancel", &value)) {
+        if (!active || (uint16_t)id != query_id) {
+            return;
+        }
+        if (!is_ack) {
+            give_up(HISTORY_REPLY_CANCELLED, now_ms);
+        } else if (value >= 0 && (uint16_t)(value - acked) > 0 && (uint16_t)(value - acked) <= (uint16_t)(seq - acked)) {
+            acked = (uint16_t)value;
+            progress_ms = now_ms;
+        }
+        return;
+    }
+    if (active) {
+        reject(HISTORY_REPLY_BUSY, (uint16_t)id);
+        return;
+    }
+
+    // The range, in the history's time
+    HistoryStoreStats store = history_store_get_stats();
+    uint64_t from_ms;
+    uint64_t to_ms = store.newest_ms;
+    bool absolute = false;
+    if (json_field(json, "to", &value) && value >= 0) {
+        to_ms = (uint64_t)value * 1000 + 999;
+        absolute = true;
+    }
+    if (json_field(json, "last_s", &value) && value > 0) {
+        from_ms = to_ms > (uint64_t)value * 1000 ? to_ms - (uint64_t)value * 1000 : 0;
+    } else if (json_field(json, "from", &value) && value >= 0) {
+        from_ms = (uint64_t)value * 1000;
+        absolute = true;
+    } else {
+        reject(HISTORY_REPLY_BAD_REQUEST, (uint16_t)id);
+        return;
+    }
+    // Unix times mean nothing to the history until the RTC has been set
+    if (absolute && !time_sync_is_synced()) {
+        reject(HISTORY_REPLY_NO_CLOCK, (uint16_t)id);
+        return;
+    }
+    if (from_ms > to_ms) {
+        reject(HISTORY_REPLY_BAD_REQUEST, (uint16_t)id);
+        return;
+    }
+    window = HISTORY_QUERY_WINDOW;
+    if (json_field(json, "window", &value)) {
+        window = value < 0 ? 0 : (value > 1024 ? 1024 : (uint16_t)value);
+    }
+
+    active = true;
+    query_id = (uint16_t)id;
+    seq = 0;
+    acked = 0;
+    started_ms = now_ms;
+    progress_ms = now_ms;
+    readings_sent = 0;
+    bytes_sent = 0;
+    exhausted = false;
+    record_open = false;
+    held = false;
+    reply_len = 0;
+    history_store_find(&cursor, from_ms, to_ms);
+    stats.queries++;
+    printf("History Query: #%u for %llu-%llu\n", query_id, (unsigned long long)(from_ms / 1000),
+           (unsigned long long)(to_ms / 1000));
+}
+// -----------------------
+
+void history_query_init() {
+    memset(&stats, 0, sizeof(stats));
+    active = false;
+    reply_len = 0;
+}
+
+void history_query_service(uint32_t now_ms) {
+    while (mqtt_take_request(request, sizeof(request)) >= 0) {
+        handle_request(request, now_ms);
+    }
+    if (!active) {
+        return;
+    }
+    // Nothing sent or acknowledged for a while: the client or the session is gone
+    if (now_ms - progress_ms >= HISTORY_QUERY_TIMEOUT_MS) {
+        give_up(HISTORY_REPLY_TIMED_OUT, now_ms);
+        return;
+    }
+    for (int i = 0; i < HISTORY_QUERY_CHUNKS_PER_PASS && active; i++) {
+        if (reply_len == 0) {
+            if (window > 0 && (uint16_t)(seq - acked) >= window) {
+                stats.waits++;
+                break;
+            }
+            reply_readings = build_chunk();
+            if (reply_readings == 0) {
+                reply_len = put_end(reply, HISTORY_REPLY_END, query_id, now_ms);
+                reply_kind = HISTORY_REPLY_END;
+            }
+        }
+        if (!send_reply(now_ms)) {
+            stats.waits++;
+            break;
+        }
+    }
+}
+
+HistoryQueryStats history_query_get_stats() {
+    HistoryQueryStats current = stats;
+    current.active = active;
+    return current;
+}
@@ -0,0 +1,85 @@
+#ifndef HISTORY_QUERY_H
+#define HISTORY_QUERY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Answers requests for a time range of the reading history (history_store.h)
+// over MQTT, one query at a time, a few chunks per pass of the main loop so
+// sampling and live publishing carry on. A request is JSON on
+// MQTT_TOPIC_HISTORY_REQUEST:
+//
+//   {"id":7,"from":1718000000,"to":1718010800,"window":8}
+//   {"id":7,"last_s":10800}
+//
+// from and to are Unix seconds; to defaults to the newest reading, and
+// last_s asks for that many seconds up to it. Readings are stamped in Unix
+// time only once SNTP has set the RTC (time_sync.h), so until then a
+// request with from or to is answered HISTORY_REPLY_NO_CLOCK, and only
+// last_s alone works. Readings taken before the first sync after a power
+// loss keep stamps carried on from the history (history_store.h), which an
+// absolute range may not match. The answer is a series of
+// binary messages on MQTT_TOPIC_HISTORY_DATA (below), published at QoS 0 in
+// the lowest outbound class. The client acknowledges chunks as they arrive,
+// {"id":7,"ack":12} for chunks 0-11, and no more than window chunks are
+// sent ahead of the acknowledgements (HISTORY_QUERY_WINDOW if not given, 0
+// for none). A query with nothing acknowledged for HISTORY_QUERY_TIMEOUT_MS
+// is given up, and {"id":7,"cancel":1} ends it early. Chunks lost with a
+// dropped session show as a gap in seq; the client can ask again from the
+// last reading it has.
+//
+// Every message starts with a 16-byte header, little-endian:
+//
+//   0  u8   HISTORY_QUERY_VERSION
+//   1  u8   kind (HistoryReplyKind)
+//   2  u16  id of the request
+//   4  u16  seq: chunks sent before this message
+//   6  u16  0
+//   8  u64  HISTORY_REPLY_CHUNK: time of the chunk's first reading, ms
+//           since the epoch; 0 otherwise
+//
+// A chunk is followed by a series_codec.h block of at most
+// HISTORY_QUERY_BLOCK_SIZE bytes, with the channels of sample_history.h and
+// sample times in ms after the first reading. Every other kind ends the
+// query and is followed by four u32: chunks, readings and bytes (headers
+// included) sent, and ms from the request to this message.
+#define HISTORY_QUERY_VERSION 1
+#define HISTORY_QUERY_HEADER_SIZE 16
+// Fits a chunk and its topic in mqtt.max-packet-size (256)
+#define HISTORY_QUERY_BLOCK_SIZE 192
+
+typedef enum {
+    HISTORY_REPLY_CHUNK,
+    HISTORY_REPLY_END,          // every reading in the range has been sent
+    HISTORY_REPLY_BUSY,         // another query is running
+    HISTORY_REPLY_BAD_REQUEST,
+    HISTORY_REPLY_TIMED_OUT,
+    HISTORY_REPLY_CANCELLED,
+    HISTORY_REPLY_NO_CLOCK      // from or to given before the RTC has been set
+} HistoryReplyKind;
+
+typedef struct {
+    uint32_t requests;          // taken since history_query_init(), acknowledgements included
+    uint32_t queries;           // started
+    uint32_t completed;
+    uint32_t rejected;          // busy, bad or needing a synced clock
+    uint32_t timed_out;
+    uint32_t cancelled;
+    uint32_t chunks;
+    uint32_t readings;
+    uint64_t bytes;             // published, headers included
+    uint32_t waits;             // passes a ready chunk waited for the queue or the window
+    uint32_t last_latency_ms;   // request -> end of the last completed query
+    uint32_t max_latency_ms;
+    uint32_t last_bytes;
+    bool active;
+} HistoryQueryStats;
+
+void history_query_init();
+// Takes the requests received (mqtt_take_request()) and sends what the
+// query in progress may; call on every pass of the main loop while the
+// MQTT session is up, after the live publishes
+void history_query_service(uint32_t now_ms);
+HistoryQueryStats history_query_get_stats();
+
+#endif // HISTORY_QUERY_H
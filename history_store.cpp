@@ -0,0 +1,448 @@
+#include "history_store.h"
+#include <stddef.h>
+#include "config.h"
+#include "sample_history.h"
+#include "series_codec.h"
+
+#define SEGMENT_MAGIC 0x47455348u // "HSEG"
+#define RECORD_MAGIC 0x43455248u  // "HREC"
+#define STORE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;       // 1 for the first segment written, then incrementing
+    uint32_t version;   // STORE_VERSION
+    uint32_t crc;       // CRC-32 of seq and version
+} SegmentHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t size;      // bytes of the compressed block that follows
+    uint16_t count;     // readings in it
+    uint64_t first_ms;
+    uint32_t span_ms;   // last reading - first
+    uint32_t crc;       // CRC-32 of the fields above after magic, and the block
+} RecordHeader;
+
+// Largest program/read unit handled; headers and records are padded to it
+#define MAX_UNIT 64
+
+static BlockDevice* store_bd = nullptr;
+static uint32_t segment_size = 0;
+static uint32_t segments = 0;
+static uint32_t unit = 1;
+static int erase_value = -1;
+
+// Segments in use run from oldest_segment to active_segment, in address
+// order around the device
+static uint32_t oldest_segment = 0;
+static uint32_t used_segments = 0;
+static uint32_t active_seq = 0;
+static uint32_t write_offset = 0;    // in the active segment
+static bool active_open = false;     // more records can go in the active segment
+static uint64_t segment_first_ms[HISTORY_STORE_MAX_SEGMENTS];
+static uint16_t segment_records[HISTORY_STORE_MAX_SEGMENTS];
+
+// Readings not yet programmed
+static uint8_t block[HISTORY_STORE_BLOCK_SIZE];
+static SeriesEncoder encoder;
+static uint64_t block_first_ms = 0;
+
+// A record as programmed or read back (no heap)
+static uint8_t io_buffer[sizeof(RecordHeader) + HISTORY_STORE_BLOCK_SIZE + MAX_UNIT];
+static HistoryStoreStats stats;
+
+// --- Helper Functions ---
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t round_up(uint32_t size) {
+    return (size + unit - 1) / unit * unit;
+}
+
+static uint32_t segment_header_size() {
+    return round_up(sizeof(SegmentHeader));
+}
+
+static bd_addr_t segment_address(uint32_t segment) {
+    return (bd_addr_t)segment * segment_size;
+}
+
+static uint32_t segment_at(uint32_t position) {
+    return (oldest_segment + position) % segments;
+}
+
+static uint32_t active_segment() {
+    return segment_at(used_segments - 1);
+}
+
+// Sequence number of the oldest segment in use
+static uint32_t oldest_seq() {
+    return active_seq + 1 - used_segments;
+}
+
+static uint32_t segment_crc(const SegmentHeader* header) {
+    return crc32_update(0, (const uint8_t*)&header->seq, sizeof(header->seq) + sizeof(header->version));
+}
+
+static uint32_t record_crc(const RecordHeader* header, const uint8_t* data) {
+    uint32_t crc = crc32_update(0, (const uint8_t*)&header->size, offsetof(RecordHeader, crc) - offsetof(RecordHeader, size));
+    return crc32_update(crc, data, header->size);
+}
+
+static bool read_segment_header(uint32_t segment, uint32_t* seq) {
+    SegmentHeader header;
+    if (store_bd->read(io_buffer, segment_address(segment), segment_header_size()) != 0) {
+        return false;
+    }
+    memcpy(&header, io_buffer, sizeof(header));
+    *seq = header.seq;
+    return header.magic == SEGMENT_MAGIC && header.version == STORE_VERSION && header.crc == segment_crc(&header);
+}
+
+// The record header at offset, if there is one that fits the segment
+static bool read_record_header(uint32_t segment, uint32_t offset, RecordHeader* header) {
+    if (offset + round_up(sizeof(RecordHeader)) > segment_size ||
+            store_bd->read(io_buffer, segment_address(segment) + offset, round_up(sizeof(RecordHeader))) != 0) {
+        return false;
+    }
+    memcpy(header, io_buffer, sizeof(*header));
+    return header->magic == RECORD_MAGIC && header->size <= HISTORY_STORE_BLOCK_SIZE && header->count > 0 &&
+           offset + round_up(sizeof(RecordHeader) + header->size) <= segment_size;
+}
+
+// Reads the record's block into data and checks it
+static bool read_record(uint32_t segment, uint32_t offset, const RecordHeader* header, uint8_t* data) {
+    uint32_t length = round_up(sizeof(RecordHeader) + header->size);
+    if (store_bd->read(io_buffer, segment_address(segment) + offset, length) != 0) {
+        return false;
+    }
+    memcpy(data, io_buffer + sizeof(RecordHeader), header->size);
+    return header->crc == record_crc(header, data);
+}
+
+static bool erased(uint32_t segment, uint32_t offset) {
+    if (erase_value < 0) {
+        return false;
+    }
+    while (offset < segment_size) {
+        uint32_t length = segment_size - offset < sizeof(io_buffer) / unit * unit ? segment_size - offset
+                                                                                    : sizeof(io_buffer) / unit * unit;
+        if (store_bd->read(io_buffer, segment_address(segment) + offset, length) != 0) {
+            return false;
+        }
+        for (uint32_t i = 0; i < length; i++) {
+            if (io_buffer[i] != (uint8_t)erase_value) {
+                return false;
+            }
+        }
+        offset += length;
+    }
+    return true;
+}
+
+// Walks a segment's records. Only the last record of a segment can be torn,
+// so that one is read and checked, and for the active segment all of them;
+// the write offset is set after the last good record.
+static void scan_segment(uint32_t segment, bool active) {
+    uint32_t offset = segment_header_size();
+    RecordHeader header;
+    RecordHeader following;
+    segment_records[segment] = 0;
+    // An empty segment sorts after every reading before it
+    segment_first_ms[segment] = stats.newest_ms + 1;
+    bool more = read_record_header(segment, offset, &header);
+    while (more) {
+        uint32_t next = offset + round_up(sizeof(RecordHeader) + header.size);
+        more = read_record_header(segment, next, &following);
+        if ((active || !more) && !read_record(segment, offset, &header, block)) {
+            stats.torn_records++;
+            break;
+        }
+        if (segment_records[segment] == 0) {
+            segment_first_ms[segment] = header.first_ms;
+        }
+        segment_records[segment]++;
+        stats.records++;
+        stats.newest_ms = header.first_ms + header.span_ms;
+        offset = next;
+        header = following;
+    }
+    if (active) {
+        // Anything but erased flash after the last record is a torn write:
+        // nothing more goes into this segment
+        write_offset = offset;
+        active_open = erased(segment, offset);
+    }
+}
+
+// Erases the segment after the active one, dropping the oldest if the log
+// has wrapped, and makes it the active one
+static bool open_segment() {
+    uint32_t next = used_segments == 0 ? oldest_segment : (active_segment() + 1) % segments;
+    if (used_segments == segments) {
+        stats.records -= segment_records[oldest_segment];
+        oldest_segment = (oldest_segment + 1) % segments;
+        used_segments--;
+    }
+    active_open = false;
+    if (store_bd->erase(segment_address(next), segment_size) != 0) {
+        printf("History Store Error: Erase failed!\n");
+        return false;
+    }
+    stats.erases++;
+
+    SegmentHeader header;
+    header.magic = SEGMENT_MAGIC;
+    header.seq = active_seq + 1;
+    header.version = STORE_VERSION;
+    header.crc = segment_crc(&header);
+    memset(io_buffer, erase_value < 0 ? 0xFF : erase_value, segment_header_size());
+    memcpy(io_buffer, &header, sizeof(header));
+    // The segment is in use from here, even if the header does not make it
+    if (used_segments == 0) {
+        oldest_segment = next;
+    }
+    used_segments++;
+    active_seq = header.seq;
+    segment_records[next] = 0;
+    segment_first_ms[next] = stats.newest_ms + 1;
+    if (store_bd->program(io_buffer, segment_address(next), segment_header_size()) != 0) {
+        printf("History Store Error: Program failed!\n");
+        return false;
+    }
+    stats.programmed_bytes += segment_header_size();
+    write_offset = segment_header_size();
+    active_open = true;
+    return true;
+}
+// -----------------------
+
+bool history_store_init(BlockDevice* bd) {
+    memset(&stats, 0, sizeof(stats));
+    store_bd = nullptr;
+    oldest_segment = 0;
+    used_segments = 0;
+    active_seq = 0;
+    active_open = false;
+    encoder.count = 0;
+
+    if (!bd || bd->init() != 0) {
+        printf("History Store Error: Block device init failed!\n");
+        return false;
+    }
+    uint32_t erase_size = (uint32_t)bd->get_erase_size(0);
+    unit = (uint32_t)(bd->get_program_size() > bd->get_read_size() ? bd->get_program_size() : bd->get_read_size());
+    uint64_t blocks = bd->size() / erase_size;
+    // Few enough segments to index them all
+    uint64_t per_segment = (blocks + HISTORY_STORE_MAX_SEGMENTS - 1) / HISTORY_STORE_MAX_SEGMENTS;
+    segments = (uint32_t)(blocks / per_segment);
+    if (unit > MAX_UNIT || erase_size % unit || segments < 2 || per_segment * erase_size > UINT32_MAX ||
+            per_segment * erase_size < round_up(sizeof(SegmentHeader)) + round_up(sizeof(io_buffer) - MAX_UNIT)) {
+        printf("History Store Error: Device geometry not supported!\n");
+        return false;
+    }
+    store_bd = bd;
+    segment_size = (uint32_t)(per_segment * erase_size);
+    erase_value = bd->get_erase_value();
+
+    // The newest segment, then back from it while the sequence is unbroken
+    uint32_t newest = 0;
+    bool found = false;
+    for (uint32_t s = 0; s < segments; s++) {
+        uint32_t seq;
+        if (read_segment_header(s, &seq) && (!found || seq > active_seq)) {
+            found = true;
+            newest = s;
+            active_seq = seq;
+        }
+    }
+    if (found) {
+        used_segments = 1;
+        while (used_segments < segments) {
+            uint32_t seq;
+            uint32_t s = (newest + segments - used_segments) % segments;
+            if (!read_segment_header(s, &seq) || seq != active_seq - used_segments) {
+                break;
+            }
+            used_segments++;
+        }
+        oldest_segment = (newest + segments + 1 - used_segments) % segments;
+        for (uint32_t p = 0; p < used_segments; p++) {
+            scan_segment(segment_at(p), p + 1 == used_segments);
+        }
+    }
+
+    printf("History Store Initialized: %lu segments of %lu bytes, %lu records (seq %lu)\n",
+           (unsigned long)segments, (unsigned long)segment_size, (unsigned long)stats.records,
+           (unsigned long)active_seq);
+    return true;
+}
+
+bool history_store_flush() {
+    if (!store_bd || encoder.count == 0) {
+        return store_bd != nullptr;
+    }
+    uint16_t size = series_encoder_bytes(&encoder);
+    uint32_t length = round_up(sizeof(RecordHeader) + size);
+    bool ok = (active_open && write_offset + length <= segment_size) || open_segment();
+    if (ok) {
+        RecordHeader header;
+        header.magic = RECORD_MAGIC;
+        header.size = size;
+        header.count = encoder.count;
+        header.first_ms = block_first_ms;
+        header.span_ms = encoder.last_ms;
+        header.crc = record_crc(&header, block);
+        memset(io_buffer, erase_value < 0 ? 0xFF : erase_value, length);
+        memcpy(io_buffer, &header, sizeof(header));
+        memcpy(io_buffer + sizeof(header), block, size);
+
+        uint32_t segment = active_segment();
+        // Whatever happens the space is used; a failed program closes the
+        // segment, and the next record starts a new one
+        write_offset += length;
+        ok = store_bd->program(io_buffer, segment_address(segment) + write_offset - length, length) == 0;
+        if (ok) {
+            if (segment_records[segment] == 0) {
+                segment_first_ms[segment] = block_first_ms;
+            }
+            segment_records[segment]++;
+            stats.records++;
+            stats.flushes++;
+            stats.programmed_bytes += length;
+        } else {
+            printf("History Store Error: Program failed!\n");
+            active_open = false;
+        }
+    }
+    // Readings that did not make it are not kept either
+    encoder.count = 0;
+    return ok;
+}
+
+bool history_store_add(uint64_t time_ms, const SensorData& data) {
+    if (!store_bd) {
+        return false;
+    }
+    if (time_ms < stats.newest_ms) {
+        stats.out_of_order++;
+        return false;
+    }
+    int32_t values[SAMPLE_HISTORY_CHANNELS];
+    values[SAMPLE_HISTORY_TEMPERATURE] = series_scale(data.temperature);
+    values[SAMPLE_HISTORY_HUMIDITY] = series_scale(data.humidity);
+    values[SAMPLE_HISTORY_PRESSURE] = series_scale(data.pressure);
+    values[SAMPLE_HISTORY_VALID] = (data.temp_valid ? 1 : 0) | (data.humidity_valid ? 2 : 0) |
+                                   (data.pressure_valid ? 4 : 0);
+
+    // Times in a block are 32-bit offsets from its first reading
+    if (encoder.count > 0 && (time_ms - block_first_ms > UINT32_MAX ||
+            !series_encoder_append(&encoder, (uint32_t)(time_ms - block_first_ms), values))) {
+        history_store_flush();
+    }
+    if (encoder.count == 0) {
+        series_encoder_init(&encoder, block, HISTORY_STORE_BLOCK_SIZE, SAMPLE_HISTORY_CHANNELS);
+        block_first_ms = time_ms;
+        series_encoder_append(&encoder, 0, values);
+    }
+    stats.readings++;
+    stats.newest_ms = time_ms;
+    return true;
+}
+
+void history_store_find(HistoryCursor* cursor, uint64_t from_ms, uint64_t to_ms) {
+    cursor->from_ms = from_ms;
+    cursor->to_ms = to_ms;
+    cursor->pending_done = false;
+    cursor->offset = segment_header_size();
+
+    // The last segment starting at or before from_ms; first times never
+    // decrease from the oldest segment on
+    uint32_t lo = 0, hi = used_segments;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (segment_first_ms[segment_at(mid)] <= from_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    cursor->seq = oldest_seq() + (lo > 0 ? lo - 1 : 0);
+}
+
+bool history_store_next(HistoryCursor* cursor, HistoryRecordInfo* info, uint8_t* data) {
+    if (cursor->seq < oldest_seq()) {
+        // The segment was reused since the last call
+        cursor->seq = oldest_seq();
+        cursor->offset = segment_header_size();
+    }
+    while (store_bd && cursor->seq - oldest_seq() < used_segments) {
+        uint32_t segment = segment_at(cursor->seq - oldest_seq());
+        RecordHeader header;
+        if (!read_record_header(segment, cursor->offset, &header)) {
+            // End of the segment's records
+            cursor->seq++;
+            cursor->offset = segment_header_size();
+            continue;
+        }
+        uint32_t offset = cursor->offset;
+        cursor->offset += round_up(sizeof(RecordHeader) + header.size);
+        if (header.first_ms + header.span_ms < cursor->from_ms && header.first_ms <= cursor->to_ms) {
+            continue;
+        }
+        // The times of a torn record cannot be trusted to end the walk
+        if (!read_record(segment, offset, &header, data)) {
+            stats.torn_records++;
+            continue;
+        }
+        if (header.first_ms > cursor->to_ms) {
+            // Past the range: neither later records nor the RAM block are in it
+            cursor->seq = UINT32_MAX;
+            cursor->pending_done = true;
+            break;
+        }
+        info->first_ms = header.first_ms;
+        info->last_ms = header.first_ms + header.span_ms;
+        info->count = header.count;
+        info->size = header.size;
+        return true;
+    }
+
+    // Then the readings still in RAM
+    if (!cursor->pending_done) {
+        cursor->pending_done = true;
+        if (encoder.count > 0 && block_first_ms <= cursor->to_ms && stats.newest_ms >= cursor->from_ms) {
+            info->first_ms = block_first_ms;
+            info->last_ms = stats.newest_ms;
+            info->count = encoder.count;
+            info->size = series_encoder_bytes(&encoder);
+            memcpy(data, block, info->size);
+            return true;
+        }
+    }
+    return false;
+}
+
+HistoryStoreStats history_store_get_stats() {
+    HistoryStoreStats current = stats;
+    current.segments = segments;
+    current.segment_size = segment_size;
+    current.active_segment = used_segments ? active_segment() : 0;
+    current.oldest_ms = encoder.count ? block_first_ms : 0;
+    for (uint32_t p = 0; p < used_segments; p++) {
+        if (segment_records[segment_at(p)] > 0) {
+            current.oldest_ms = segment_first_ms[segment_at(p)];
+            break;
+        }
+    }
+    return current;
+}
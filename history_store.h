@@ -0,0 +1,85 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "BlockDevice.h"
+#include "sensors.h"
+
+// Days of readings on a BlockDevice, as a log. The device is split into
+// segments of one or more erase blocks, written in address order and reused
+// in turn: each segment is erased once per pass over the device, and when
+// the log wraps the oldest segment's readings are the ones given up.
+//
+// Readings are compressed (series_codec.h, the channels of sample_history.h)
+// into a block in RAM. A full block is programmed as one record: a header
+// with its time span, count and a CRC-32, then the block. A segment starts
+// with a header carrying a sequence number, so mounting finds the newest
+// segment and the order of the rest. Records are only ever appended, so a
+// reset loses at most the readings still in RAM; a record torn by a power
+// loss fails its CRC, and the segment it is in is closed at the next mount.
+//
+// Times are ms on the caller's clock and must not go backwards; readings
+// older than the newest one stored are dropped (out_of_order). The firmware
+// stamps readings with the RTC once SNTP has set it (time_sync.h), and
+// before that carries on from newest_ms, so stamps are ms since the epoch
+// only from the first sync on. The first reading of every segment
+// is kept in RAM (one entry per segment), so a range lookup is a binary
+// search over segments and a walk over the records of a few.
+
+// Payload of a record: the RAM block
+#define HISTORY_STORE_BLOCK_SIZE 256
+// Segments tracked at most; a bigger device gets bigger segments
+#define HISTORY_STORE_MAX_SEGMENTS 256
+
+typedef struct {
+    uint64_t first_ms;
+    uint64_t last_ms;
+    uint16_t count;             // readings
+    uint16_t size;              // bytes of the compressed block
+} HistoryRecordInfo;
+
+// A range lookup in progress (history_store_find)
+typedef struct {
+    uint64_t from_ms;
+    uint64_t to_ms;
+    uint32_t seq;               // of the segment being walked
+    uint32_t offset;            // of the next record in it
+    bool pending_done;          // the block still in RAM has been visited
+} HistoryCursor;
+
+typedef struct {
+    uint32_t segments;
+    uint32_t segment_size;
+    uint32_t active_segment;
+    uint32_t records;           // records stored now
+    uint32_t readings;          // added since history_store_init()
+    uint32_t out_of_order;      // readings dropped for going back in time
+    uint32_t flushes;           // records programmed since init
+    uint32_t erases;            // segments erased since init
+    uint32_t torn_records;      // records failing their CRC (at mount or read)
+    uint64_t programmed_bytes;
+    uint64_t oldest_ms;         // of the oldest reading held, 0 while empty
+    uint64_t newest_ms;
+} HistoryStoreStats;
+
+// Mounts the log on bd, formatting nothing: an empty device is written from
+// the first segment on. False if the device cannot be used.
+bool history_store_init(BlockDevice* bd);
+bool history_store_add(uint64_t time_ms, const SensorData& data);
+// Programs the readings held in RAM now (for example before a planned
+// reset), rather than when the block is full
+bool history_store_flush();
+
+// Starts a lookup of the records overlapping [from_ms, to_ms]. A lookup may
+// be walked a little at a time while readings are added; if the log wraps
+// meanwhile it carries on from the oldest segment left.
+void history_store_find(HistoryCursor* cursor, uint64_t from_ms, uint64_t to_ms);
+// Copies the next record's block, oldest first, into block (at least
+// HISTORY_STORE_BLOCK_SIZE bytes); the readings still in RAM come last.
+// Sample times in the block are ms after info->first_ms. False when done.
+bool history_store_next(HistoryCursor* cursor, HistoryRecordInfo* info, uint8_t* block);
+
+HistoryStoreStats history_store_get_stats();
+
+#endif // HISTORY_STORE_H
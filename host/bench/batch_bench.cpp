@@ -0,0 +1,180 @@
+/* Throughput of the batch anomaly detector (host/fleet/anomaly_batch.h)
+ *
+ * Runs --streams streams for --ticks ticks through each AnomalyBatch kernel
+ * the CPU supports, and through as many AnomalyDetector instances for
+ * reference, on one thread. Each stream reads the bench inputs from its own
+ * offset, cycling through the distributions, so some streams are flat, some
+ * noisy and some step.
+ *
+ * Before timing, every kernel is checked against AnomalyDetector over
+ * --verify-ticks ticks: decisions, means and standard deviations must match
+ * bit for bit on every stream. A mismatch is reported and the exit code is 1.
+ *
+ * Output is one JSON record per kernel with the time per tick and the
+ * streams updated per second on the core.
+ *
+ * Usage: batch_bench [--streams N] [--ticks N] [--verify-ticks N] [--kernel NAME]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "bench_harness.h"
+#include "bench_inputs.h"
+
+#include "anomaly_batch.h"
+#include "anomaly_detector.h"
+
+struct Options {
+    size_t streams = 16384;
+    int ticks = 2000;
+    int verify_ticks = 1000;
+    const char *kernel = nullptr;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [--streams N] [--ticks N] [--verify-ticks N] [--kernel scalar|sse2|avx2]\n", prog);
+}
+
+static std::vector<float> inputs[DIST_COUNT];
+
+static const size_t INPUT_MASK = BENCH_INPUT_SIZE - 1;
+
+// Stream s's reading at tick t
+static float reading(size_t s, int t)
+{
+    return inputs[s % DIST_COUNT][(s * 37 + (size_t)t) & INPUT_MASK];
+}
+
+static void fill_tick(std::vector<float> &values, int t)
+{
+    for (size_t s = 0; s < values.size(); s++) {
+        values[s] = reading(s, t);
+    }
+}
+
+static bool same_bits(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static bool verify(AnomalyBatch::Kernel kernel, size_t streams, int ticks)
+{
+    AnomalyBatch batch(streams, kernel);
+    std::vector<AnomalyDetector> detectors(streams);
+    std::vector<float> values(streams);
+    std::vector<uint8_t> flags(streams);
+    size_t flagged = 0;
+    for (int t = 0; t < ticks; t++) {
+        fill_tick(values, t);
+        batch.process(values.data(), flags.data());
+        for (size_t s = 0; s < streams; s++) {
+            AnomalyStatus status = detectors[s].process(values[s]);
+            if (status.is_anomalous != (flags[s] != 0) || !same_bits(status.current_mean, batch.means()[s]) ||
+                    !same_bits(status.current_std_dev, batch.std_devs()[s])) {
+                fprintf(stderr, "batch_bench: %s differs from AnomalyDetector at stream %zu, tick %d\n",
+                        AnomalyBatch::kernel_name(kernel), s, t);
+                return false;
+            }
+            flagged += flags[s];
+        }
+    }
+    if (flagged == 0) {
+        fprintf(stderr, "batch_bench: no anomaly flagged while verifying %s\n", AnomalyBatch::kernel_name(kernel));
+        return false;
+    }
+    return true;
+}
+
+static void report(const char *kernel, const Options &options, uint64_t elapsed_ns, double reference_ns)
+{
+    double ns_per_tick = (double)elapsed_ns / options.ticks;
+    printf("{\"kernel\":\"%s\",\"streams\":%zu,\"window\":%d,\"ticks\":%d,\"ns_per_tick\":%.0f,"
+           "\"ns_per_stream\":%.2f,\"streams_per_s\":%.0f,\"speedup\":%.2f}\n",
+           kernel, options.streams, RATE_BUFFER_SIZE, options.ticks, ns_per_tick, ns_per_tick / options.streams,
+           options.streams * 1e9 / ns_per_tick, reference_ns > 0 ? reference_ns / ns_per_tick : 1.0);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--streams") && has_value) {
+            options.streams = (size_t)atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--ticks") && has_value) {
+            options.ticks = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--verify-ticks") && has_value) {
+            options.verify_ticks = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--kernel") && has_value) {
+            options.kernel = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.streams == 0 || options.ticks <= 0 || options.verify_ticks < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (int d = 0; d < DIST_COUNT; d++) {
+        inputs[d] = bench_make_temperatures((BenchDistribution)d);
+    }
+    // Tick inputs are generated up front so only the detectors are timed
+    std::vector<std::vector<float>> ticks(options.ticks < 64 ? options.ticks : 64,
+                                          std::vector<float>(options.streams));
+    for (size_t t = 0; t < ticks.size(); t++) {
+        fill_tick(ticks[t], (int)t);
+    }
+    std::vector<uint8_t> flags(options.streams);
+
+    // Reference: one AnomalyDetector per stream
+    std::vector<AnomalyDetector> detectors(options.streams);
+    uint64_t start = bench_now_ns();
+    for (int t = 0; t < options.ticks; t++) {
+        const std::vector<float> &values = ticks[t % ticks.size()];
+        for (size_t s = 0; s < options.streams; s++) {
+            flags[s] = detectors[s].process(values[s]).is_anomalous;
+        }
+    }
+    double reference_ns = (double)(bench_now_ns() - start) / options.ticks;
+    bench_sink(flags[0]);
+    if (!options.kernel || !strcmp(options.kernel, "detector")) {
+        report("detector", options, (uint64_t)(reference_ns * options.ticks), 0.0);
+    }
+
+    static const AnomalyBatch::Kernel kernels[] = {
+        AnomalyBatch::KERNEL_SCALAR, AnomalyBatch::KERNEL_SSE2, AnomalyBatch::KERNEL_AVX2,
+    };
+    bool ok = true;
+    bool matched = !options.kernel || !strcmp(options.kernel, "detector");
+    for (AnomalyBatch::Kernel kernel : kernels) {
+        const char *name = AnomalyBatch::kernel_name(kernel);
+        if ((options.kernel && strcmp(options.kernel, name)) || !AnomalyBatch::kernel_supported(kernel)) {
+            continue;
+        }
+        matched = true;
+        if (options.verify_ticks > 0 && !verify(kernel, options.streams, options.verify_ticks)) {
+            ok = false;
+            continue;
+        }
+
+        AnomalyBatch batch(options.streams, kernel);
+        start = bench_now_ns();
+        for (int t = 0; t < options.ticks; t++) {
+            batch.process(ticks[t % ticks.size()].data(), flags.data());
+        }
+        uint64_t elapsed = bench_now_ns() - start;
+        bench_sink(flags[0]);
+        report(name, options, elapsed, reference_ns);
+    }
+    if (!matched) {
+        usage(argv[0]);
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
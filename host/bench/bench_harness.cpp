@@ -0,0 +1,114 @@
+#include "bench_harness.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> alloc_bytes(0);
+static std::atomic<uint64_t> alloc_count(0);
+static volatile double sink_value;
+
+uint64_t bench_alloc_bytes()
+{
+    return alloc_bytes.load(std::memory_order_relaxed);
+}
+
+uint64_t bench_alloc_count()
+{
+    return alloc_count.load(std::memory_order_relaxed);
+}
+
+void bench_sink(double value)
+{
+    sink_value = value;
+}
+
+uint64_t bench_now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// --- Heap accounting ---
+// Every C++ allocation made by the code under test goes through these.
+
+static void *counted_alloc(std::size_t size)
+{
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(std::size_t size)
+{
+    return counted_alloc(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return counted_alloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// --- Runner ---
+
+BenchRunner::BenchRunner(const BenchOptions &options)
+    : _options(options), _cases_run(0), _header_written(false)
+{
+}
+
+bool BenchRunner::selected(const BenchParams &params) const
+{
+    if (_options.filter.empty()) {
+        return true;
+    }
+    std::string id = params.name + "/" + params.variant + "/" + params.dist;
+    return id.find(_options.filter) != std::string::npos;
+}
+
+void BenchRunner::report(const BenchResult &r)
+{
+    _cases_run++;
+    if (_options.csv) {
+        if (!_header_written) {
+            fprintf(_options.out, "label,name,variant,window,dist,iterations,ns_per_op,ns_per_op_min,bytes_per_op,allocs_per_op\n");
+            _header_written = true;
+        }
+        fprintf(_options.out, "%s,%s,%s,%d,%s,%llu,%.3f,%.3f,%.3f,%.4f\n",
+                _options.label.c_str(), r.params.name.c_str(), r.params.variant.c_str(),
+                r.params.window, r.params.dist.c_str(), (unsigned long long)r.iterations,
+                r.ns_per_op, r.ns_per_op_min, r.bytes_per_op, r.allocs_per_op);
+    } else {
+        fprintf(_options.out, "{\"label\":\"%s\",\"name\":\"%s\",\"variant\":\"%s\",\"window\":%d,\"dist\":\"%s\","
+                "\"iterations\":%llu,\"ns_per_op\":%.3f,\"ns_per_op_min\":%.3f,"
+                "\"bytes_per_op\":%.3f,\"allocs_per_op\":%.4f}\n",
+                _options.label.c_str(), r.params.name.c_str(), r.params.variant.c_str(),
+                r.params.window, r.params.dist.c_str(), (unsigned long long)r.iterations,
+                r.ns_per_op, r.ns_per_op_min, r.bytes_per_op, r.allocs_per_op);
+    }
+    fflush(_options.out);
+}
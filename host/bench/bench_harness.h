@@ -0,0 +1,144 @@
+/* Minimal timing harness shared by the host benchmarks.
+ *
+ * Each case is run in batches until it has accumulated at least the
+ * configured minimum time, several times over; the median ns/op is reported
+ * together with the C++ heap traffic observed per operation. Results are
+ * written one record per line as JSON (default) or CSV.
+ */
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+struct BenchParams {
+    std::string name;     // kernel under test, e.g. "anomaly_detector_process"
+    std::string variant;  // free-form sub-case, e.g. "put_get"
+    int window;           // window/buffer size the kernel was built or run with (0 if n/a)
+    std::string dist;     // input distribution
+};
+
+struct BenchResult {
+    BenchParams params;
+    uint64_t iterations;
+    double ns_per_op;
+    double ns_per_op_min;
+    double bytes_per_op;
+    double allocs_per_op;
+};
+
+struct BenchOptions {
+    int min_time_ms = 50;
+    int repetitions = 5;
+    bool csv = false;
+    std::string filter;
+    std::string label;
+    FILE *out = stdout;
+};
+
+/** Allocation counters fed by the global operator new overrides */
+uint64_t bench_alloc_bytes();
+uint64_t bench_alloc_count();
+
+/** Keep a value alive so the optimiser cannot drop the work producing it */
+void bench_sink(double value);
+
+class BenchRunner {
+public:
+    explicit BenchRunner(const BenchOptions &options);
+
+    /** True if the case should run under the current --filter */
+    bool selected(const BenchParams &params) const;
+
+    /** Time @p op, called as op(i) with a running iteration index, and report it.
+     *  @p setup is called before each repetition to reset kernel state. */
+    template <typename Setup, typename Op>
+    void run(const BenchParams &params, Setup setup, Op op);
+
+    int cases_run() const
+    {
+        return _cases_run;
+    }
+
+private:
+    void report(const BenchResult &result);
+
+    BenchOptions _options;
+    int _cases_run;
+    bool _header_written;
+};
+
+uint64_t bench_now_ns();
+
+template <typename Setup, typename Op>
+void BenchRunner::run(const BenchParams &params, Setup setup, Op op)
+{
+    if (!selected(params)) {
+        return;
+    }
+
+    // Calibrate a batch size that takes roughly 1/10 of the minimum time
+    uint64_t batch = 1;
+    const uint64_t target_ns = (uint64_t)_options.min_time_ms * 100000ull;
+    setup();
+    for (;;) {
+        uint64_t start = bench_now_ns();
+        for (uint64_t i = 0; i < batch; i++) {
+            op(i);
+        }
+        uint64_t elapsed = bench_now_ns() - start;
+        if (elapsed >= target_ns || batch >= (1ull << 30)) {
+            break;
+        }
+        batch *= 2;
+    }
+
+    double samples[32];
+    int reps = _options.repetitions > 32 ? 32 : _options.repetitions;
+    uint64_t total_iterations = 0;
+    uint64_t alloc_bytes = 0;
+    uint64_t alloc_count = 0;
+
+    for (int r = 0; r < reps; r++) {
+        setup();
+        uint64_t iterations = 0;
+        uint64_t bytes_before = bench_alloc_bytes();
+        uint64_t count_before = bench_alloc_count();
+        uint64_t start = bench_now_ns();
+        uint64_t elapsed = 0;
+        do {
+            for (uint64_t i = 0; i < batch; i++) {
+                op(iterations + i);
+            }
+            iterations += batch;
+            elapsed = bench_now_ns() - start;
+        } while (elapsed < target_ns * 10);
+        alloc_bytes += bench_alloc_bytes() - bytes_before;
+        alloc_count += bench_alloc_count() - count_before;
+        total_iterations += iterations;
+        samples[r] = (double)elapsed / (double)iterations;
+    }
+
+    // Insertion sort: reps is tiny
+    for (int i = 1; i < reps; i++) {
+        double v = samples[i];
+        int j = i - 1;
+        while (j >= 0 && samples[j] > v) {
+            samples[j + 1] = samples[j];
+            j--;
+        }
+        samples[j + 1] = v;
+    }
+
+    BenchResult result;
+    result.params = params;
+    result.iterations = total_iterations;
+    result.ns_per_op = samples[reps / 2];
+    result.ns_per_op_min = samples[0];
+    result.bytes_per_op = (double)alloc_bytes / (double)total_iterations;
+    result.allocs_per_op = (double)alloc_count / (double)total_iterations;
+    report(result);
+}
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,82 @@
+#include "bench_inputs.h"
+
+#include <math.h>
+#include <stdint.h>
+
+// Small xorshift generator so inputs do not depend on the C library's rand()
+static uint32_t next_random(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static float uniform(uint32_t &state)
+{
+    return (next_random(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+static float gaussian(uint32_t &state)
+{
+    // Box-Muller; the second value is discarded to keep the code simple
+    float u1 = uniform(state);
+    float u2 = uniform(state);
+    if (u1 < 1e-7f) {
+        u1 = 1e-7f;
+    }
+    return sqrtf(-2.0f * logf(u1)) * cosf(6.2831853f * u2);
+}
+
+const char *bench_distribution_name(BenchDistribution dist)
+{
+    switch (dist) {
+        case DIST_FLAT:
+            return "flat";
+        case DIST_NOISY:
+            return "noisy";
+        case DIST_RAMP:
+            return "ramp";
+        case DIST_SINE:
+            return "sine";
+        case DIST_SPIKES:
+            return "spikes";
+        default:
+            return "unknown";
+    }
+}
+
+std::vector<float> bench_make_temperatures(BenchDistribution dist)
+{
+    std::vector<float> samples(BENCH_INPUT_SIZE);
+    uint32_t state = 0x9E3779B9u;
+
+    for (size_t i = 0; i < BENCH_INPUT_SIZE; i++) {
+        float t = (float)i / (float)BENCH_INPUT_SIZE;
+        float value = 22.0f;
+        switch (dist) {
+            case DIST_FLAT:
+                value = 22.0f + 0.01f * gaussian(state);
+                break;
+            case DIST_NOISY:
+                value = 22.0f + 0.5f * gaussian(state);
+                break;
+            case DIST_RAMP:
+                value = 15.0f + 20.0f * t;
+                break;
+            case DIST_SINE:
+                value = 22.0f + 5.0f * sinf(6.2831853f * 4.0f * t);
+                break;
+            case DIST_SPIKES:
+                value = 22.0f + 0.05f * gaussian(state);
+                if (next_random(state) % 97 == 0) {
+                    value += 5.0f;
+                }
+                break;
+            default:
+                break;
+        }
+        samples[i] = value;
+    }
+    return samples;
+}
@@ -0,0 +1,26 @@
+/* Deterministic synthetic sensor inputs for the host benchmarks */
+#ifndef BENCH_INPUTS_H
+#define BENCH_INPUTS_H
+
+#include <stddef.h>
+#include <vector>
+
+// Number of samples in each generated input; a power of two so the
+// benchmarks can cycle through it with a mask.
+static const size_t BENCH_INPUT_SIZE = 4096;
+
+enum BenchDistribution {
+    DIST_FLAT,    // steady indoor temperature with sensor-level noise
+    DIST_NOISY,   // gaussian noise, sigma 0.5 C
+    DIST_RAMP,    // monotonic rise from 15 C to 35 C (new maximum every sample)
+    DIST_SINE,    // slow +/-5 C oscillation
+    DIST_SPIKES,  // flat signal with occasional 5 C steps (anomalies)
+    DIST_COUNT
+};
+
+const char *bench_distribution_name(BenchDistribution dist);
+
+/** Temperatures in C, BENCH_INPUT_SIZE samples, reproducible across runs */
+std::vector<float> bench_make_temperatures(BenchDistribution dist);
+
+#endif // BENCH_INPUTS_H
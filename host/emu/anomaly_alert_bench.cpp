@@ -0,0 +1,247 @@
+/* Feeds the detector readings with a sudden jump every --every samples and
+ * measures how long each anomaly takes to reach the broker, on its own topic
+ * and inside the data message.
+ *
+ * network_task.cpp brings WiFi and MQTT up on its own thread as on the
+ * board; this tool's main thread plays main(): detect, alert, then drain the
+ * backlog and publish the reading. The WiFi module is the emulated ISM43362
+ * and the broker is the loopback test broker. --backlog queues that many
+ * reports ahead of each anomalous reading, as after an outage.
+ *
+ * Output is one JSON record per anomaly and a summary. alert_ms and data_ms
+ * are from detection to the broker receiving the alert and the data message
+ * flagging the same reading; the summary adds the firmware's own
+ * detection-to-publish figures (anomaly_alert_get_stats()).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <vector>
+
+#include "config.h"
+#include "anomaly_alert.h"
+#include "anomaly_detector.h"
+#include "mqtt_handler.h"
+#include "network_task.h"
+#include "sample_backlog.h"
+#include "temp_tracker.h"
+
+#include "ism43362_emulator.h"
+#include "mqtt_test_broker.h"
+#include "tool_common.h"
+
+struct BenchOptions {
+    int readings = 200;
+    int every = 25;
+    float jump = 2.5f;
+    int interval_ms = 20;
+    int backlog = 0;
+    int latency_us = 0;
+    bool summary_only = false;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--readings N] [--every N] [--jump DEGC] [--interval-ms N] [--backlog N]\n"
+            "       [--latency-us N] [--summary-only]\n",
+            prog);
+}
+
+// Small deterministic noise, so the model has a spread to judge against
+static float noise(int i)
+{
+    uint32_t x = (uint32_t)i * 2654435761u;
+    x ^= x >> 15;
+    return ((x % 1000) / 1000.0f - 0.5f) * 0.1f;
+}
+
+// Broker-side arrival times, in ms on the tool's clock
+struct Arrivals {
+    std::mutex mutex;
+    std::vector<double> alerts;
+    std::vector<double> flagged_data;
+};
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--readings") && has_value) {
+            options.readings = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--every") && has_value) {
+            options.every = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--jump") && has_value) {
+            options.jump = (float)atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval-ms") && has_value) {
+            options.interval_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--backlog") && has_value) {
+            options.backlog = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--latency-us") && has_value) {
+            options.latency_us = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--summary-only")) {
+            options.summary_only = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.readings <= 0 || options.every < 2 || options.interval_ms < 0 || options.backlog < 0 ||
+            options.latency_us < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("anomaly_alert_bench");
+    if (!out) {
+        return 1;
+    }
+
+    Timer clock;
+    clock.start();
+    Arrivals arrivals;
+    MQTTTestBroker broker;
+    if (!broker.start()) {
+        perror("anomaly_alert_bench: broker");
+        return 1;
+    }
+    broker.on_publish([&](const std::string &topic, const std::string &payload, int qos) {
+        double now_ms = clock.elapsed_time().count() / 1000.0;
+        std::lock_guard<std::mutex> lock(arrivals.mutex);
+        if (topic == MQTT_TOPIC_ANOMALY) {
+            arrivals.alerts.push_back(now_ms);
+        } else if (topic == MQTT_TOPIC_DATA && payload.find("\"anomaly\":\"true\"") != std::string::npos) {
+            arrivals.flagged_data.push_back(now_ms);
+        }
+    });
+    ISM43362Emulator &emu = ism43362_board_module();
+    emu.redirect(MQTT_BROKER_HOSTNAME, MQTT_BROKER_PORT, "127.0.0.1", broker.port());
+    emu.set_join_delay_ms(0);
+    emu.set_command_latency_us(options.latency_us);
+
+    anomaly_detector_init();
+    temp_tracker_init();
+    sample_backlog_init();
+    anomaly_alert_init();
+    network_task_start();
+    while (!(network_task_get_state() == NETWORK_TASK_ONLINE && mqtt_is_connected()) && clock.read_ms() < 10000) {
+        ThisThread::sleep_for(10ms);
+    }
+    if (!mqtt_is_connected()) {
+        fprintf(stderr, "anomaly_alert_bench: network did not come up\n");
+        return 1;
+    }
+
+    // main()'s loop at the nominal interval, without the sensor read
+    std::vector<double> detected_ms;
+    std::vector<float> z_scores;
+    float level = 22.0f;
+    uint32_t uptime_ms = 0;
+    for (int i = 0; i < options.readings; i++) {
+        int start_ms = clock.read_ms();
+        bool jump = i > 0 && i % options.every == 0;
+        if (jump) {
+            level += (i / options.every) % 2 ? options.jump : -options.jump;
+        }
+        float temp = level + noise(i);
+        SensorData data = {temp, 45.0f, 1013.25f, true, true, true};
+        uptime_ms += SAMPLE_INTERVAL_MS;
+        temp_tracker_update(temp);
+        AnomalyStatus anomaly = anomaly_detector_process(temp);
+        TempStats1Hour stats = temp_tracker_get_stats();
+
+        AnomalyEvent event;
+        if (anomaly_detector_take_event(&event)) {
+            detected_ms.push_back(clock.elapsed_time().count() / 1000.0);
+            z_scores.push_back(event.z_score);
+            anomaly_alert_push(event);
+            if (mqtt_is_connected()) {
+                anomaly_alert_publish();
+            }
+        }
+
+        // Reports still queued from an outage when the jump comes
+        if (jump) {
+            for (int b = 0; b < options.backlog; b++) {
+                sample_backlog_push(uptime_ms - SAMPLE_INTERVAL_MS, data, stats, AnomalyStatus{});
+            }
+        }
+
+        if (mqtt_is_connected()) {
+            anomaly_alert_publish();
+            BacklogSample backlogged;
+            for (int b = 0; b < SAMPLE_BACKLOG_DRAIN_PER_PASS && sample_backlog_peek(&backlogged); b++) {
+                if (!mqtt_publish_data(backlogged.data, backlogged.stats, backlogged.anomaly,
+                                       uptime_ms - backlogged.taken_ms)) {
+                    break;
+                }
+                sample_backlog_pop();
+            }
+            if (!mqtt_publish_data(data, stats, anomaly)) {
+                sample_backlog_push(uptime_ms, data, stats, anomaly);
+            }
+        }
+
+        int busy_ms = clock.read_ms() - start_ms;
+        if (busy_ms < options.interval_ms) {
+            ThisThread::sleep_for(std::chrono::milliseconds(options.interval_ms - busy_ms));
+        }
+    }
+
+    // Let the backlog and the last acknowledgements through
+    Timer drain;
+    drain.start();
+    while (drain.read_ms() < 5000 && mqtt_is_connected() &&
+            (sample_backlog_depth() > 0 || mqtt_get_stats().inflight > 0)) {
+        BacklogSample backlogged;
+        if (sample_backlog_peek(&backlogged) &&
+                mqtt_publish_data(backlogged.data, backlogged.stats, backlogged.anomaly,
+                                  uptime_ms - backlogged.taken_ms)) {
+            sample_backlog_pop();
+        }
+        ThisThread::sleep_for(std::chrono::milliseconds(options.interval_ms));
+    }
+    broker.wait_publishes(broker.stats().publishes + 1, 200);
+
+    std::lock_guard<std::mutex> lock(arrivals.mutex);
+    size_t events = detected_ms.size();
+    double alert_sum = 0.0, alert_max = 0.0, data_sum = 0.0, data_max = 0.0;
+    size_t alerts_matched = 0, data_matched = 0;
+    for (size_t e = 0; e < events; e++) {
+        double alert_ms = e < arrivals.alerts.size() ? arrivals.alerts[e] - detected_ms[e] : -1.0;
+        double data_ms = e < arrivals.flagged_data.size() ? arrivals.flagged_data[e] - detected_ms[e] : -1.0;
+        if (alert_ms >= 0) {
+            alerts_matched++;
+            alert_sum += alert_ms;
+            alert_max = alert_ms > alert_max ? alert_ms : alert_max;
+        }
+        if (data_ms >= 0) {
+            data_matched++;
+            data_sum += data_ms;
+            data_max = data_ms > data_max ? data_ms : data_max;
+        }
+        if (!options.summary_only) {
+            fprintf(out, "{\"phase\":\"anomaly\",\"index\":%zu,\"z\":%.1f,\"alert_ms\":%.2f,\"data_ms\":%.2f}\n",
+                    e, z_scores[e], alert_ms, data_ms);
+        }
+    }
+
+    AnomalyAlertStats stats = anomaly_alert_get_stats();
+    fprintf(out, "{\"phase\":\"summary\",\"readings\":%d,\"backlog\":%d,\"interval_ms\":%d,\"anomalies\":%zu,"
+            "\"alerts_received\":%zu,\"mean_alert_ms\":%.2f,\"max_alert_ms\":%.2f,\"mean_data_ms\":%.2f,"
+            "\"max_data_ms\":%.2f,\"raised\":%u,\"published\":%u,\"dropped\":%u,\"queued\":%u,"
+            "\"mean_latency_us\":%u,\"max_latency_us\":%u}\n",
+            options.readings, options.backlog, options.interval_ms, events, alerts_matched,
+            alerts_matched ? alert_sum / alerts_matched : 0.0, alert_max,
+            data_matched ? data_sum / data_matched : 0.0, data_max,
+            stats.raised, stats.published, stats.dropped, stats.queued, stats.mean_latency_us,
+            stats.max_latency_us);
+    fflush(out);
+
+    // The network thread never returns; leave without unwinding it
+    _exit(events > 0 && alerts_matched == events ? 0 : 1);
+}
@@ -0,0 +1,257 @@
+/* Boots the firmware's modules the way main() does and reports when the
+ * first sample is taken and when the first reading reaches the broker.
+ *
+ * The sensors are the emulated HTS221 and LPS22HB on the I2C bus, the WiFi
+ * module is the emulated ISM43362 with a join that takes --join-ms (a real
+ * association takes 10-15 s), and the broker is the loopback test broker.
+ * By default the boot follows main(): network_task.cpp brings WiFi and MQTT
+ * up on its own thread while the loop samples into sample_backlog.cpp. With
+ * --sequential it follows the old order instead: network_init() and
+ * mqtt_connect() first, then the loop.
+ *
+ * Output is JSON lines: one record per boot milestone (boot_trace.h), as
+ * reached, one per outbound MQTT class (mqtt_get_class_stats()), then a
+ * summary with the backlog figures and the number of data messages the
+ * broker received live and backlogged.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+
+#include "config.h"
+#include "sensors.h"
+#include "temp_tracker.h"
+#include "anomaly_detector.h"
+#include "network_manager.h"
+#include "network_task.h"
+#include "mqtt_handler.h"
+#include "sample_backlog.h"
+#include "boot_trace.h"
+#include "HTS221_driver.h"
+#include "LPS22HB_driver.h"
+
+#include "hts221_model.h"
+#include "i2c_bus_emulator.h"
+#include "ism43362_emulator.h"
+#include "lps22hb_model.h"
+#include "mqtt_test_broker.h"
+#include "sensor_signal.h"
+#include "tool_common.h"
+
+struct TimelineOptions {
+    int duration_ms = 8000;
+    int interval_ms = 500;
+    int join_ms = 3000;
+    int latency_us = 0;
+    const char *signal = "temperature=sine:22:4:600~0.05";
+    bool sequential = false;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--duration-ms N] [--interval-ms N] [--join-ms N] [--latency-us N]\n"
+            "       [--signal SPEC] [--sequential]\n",
+            prog);
+}
+
+// The old boot: the network is up (or has failed) before the first sample
+static bool sequential_network_init()
+{
+    if (network_init() != NSAPI_ERROR_OK) {
+        return false;
+    }
+    boot_trace_mark(BOOT_WIFI_UP);
+    if (!mqtt_init(network_get_interface())) {
+        return false;
+    }
+    if (mqtt_connect()) {
+        boot_trace_mark(BOOT_MQTT_UP);
+        mqtt_publish_status("System Booted");
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    TimelineOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--duration-ms") && has_value) {
+            options.duration_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval-ms") && has_value) {
+            options.interval_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--join-ms") && has_value) {
+            options.join_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--latency-us") && has_value) {
+            options.latency_us = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--signal") && has_value) {
+            options.signal = argv[++i];
+        } else if (!strcmp(argv[i], "--sequential")) {
+            options.sequential = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.duration_ms <= 0 || options.interval_ms <= 0 || options.join_ms < 0 || options.latency_us < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string error;
+    SensorSignal *signal = sensor_signal_from_spec(options.signal, error);
+    if (!signal) {
+        fprintf(stderr, "boot_timeline: %s\n", error.c_str());
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("boot_timeline");
+    if (!out) {
+        return 1;
+    }
+
+    std::atomic<uint32_t> live_received(0);
+    std::atomic<uint32_t> backlog_received(0);
+    MQTTTestBroker broker;
+    if (!broker.start()) {
+        perror("boot_timeline: broker");
+        return 1;
+    }
+    broker.on_publish([&](const std::string &topic, const std::string &payload, int qos) {
+        if (topic == MQTT_TOPIC_DATA) {
+            (payload.find("\"age_ms\"") != std::string::npos ? backlog_received : live_received)++;
+        }
+    });
+    ISM43362Emulator &emu = ism43362_board_module();
+    emu.redirect(MQTT_BROKER_HOSTNAME, MQTT_BROKER_PORT, "127.0.0.1", broker.port());
+    emu.set_join_delay_ms(options.join_ms);
+    emu.set_command_latency_us(options.latency_us);
+
+    HTS221Model hts221(*signal);
+    LPS22HBModel lps22hb(*signal);
+    I2CBusEmulator bus(100000);
+    bus.add_device(HTS221_I2C_ADDRESS, &hts221);
+    bus.add_device(LPS22HB_ADDRESS_HIGH, &lps22hb);
+    host_i2c_attach(&bus);
+
+    // Start-up as in main(); the run lasts --duration-ms from here
+    Timer since_boot;
+    since_boot.start();
+    boot_trace_start();
+    sensors_init();
+    anomaly_detector_init();
+    temp_tracker_init();
+    sample_backlog_init();
+    boot_trace_mark(BOOT_SENSORS_READY);
+    bool sequential_online = false;
+    if (options.sequential) {
+        sequential_online = sequential_network_init();
+    } else {
+        network_task_start();
+    }
+
+    // The main loop's sampling and publishing, every reading reported
+    uint32_t samples = 0;
+    uint32_t published = 0;
+    bool reported[BOOT_EVENT_COUNT] = {false};
+    while (since_boot.read_ms() < options.duration_ms) {
+        uint32_t now_ms = (uint32_t)since_boot.read_ms();
+        bus.advance_us((uint64_t)options.interval_ms * 1000);
+        SensorData data = sensors_read();
+        boot_trace_mark(BOOT_FIRST_SAMPLE);
+        samples++;
+        temp_tracker_update(data.temperature, options.interval_ms);
+        AnomalyStatus anomaly = anomaly_detector_process(data.temperature, options.interval_ms);
+        TempStats1Hour stats = temp_tracker_get_stats();
+
+        bool online = options.sequential ? sequential_online : network_task_get_state() == NETWORK_TASK_ONLINE;
+        if (online && mqtt_is_connected()) {
+            BacklogSample backlogged;
+            for (int i = 0; i < SAMPLE_BACKLOG_DRAIN_PER_PASS && sample_backlog_peek(&backlogged); i++) {
+                if (!mqtt_publish_data(backlogged.data, backlogged.stats, backlogged.anomaly,
+                                       now_ms - backlogged.taken_ms)) {
+                    break;
+                }
+                sample_backlog_pop();
+                published++;
+                boot_trace_mark(BOOT_FIRST_PUBLISH);
+            }
+            if (mqtt_publish_data(data, stats, anomaly)) {
+                published++;
+                boot_trace_mark(BOOT_FIRST_PUBLISH);
+            } else {
+                sample_backlog_push(now_ms, data, stats, anomaly);
+            }
+            // The network thread services the session; without it, poll
+            if (options.sequential) {
+                mqtt_yield(10);
+            }
+        } else if (network_task_get_state() != NETWORK_TASK_OFFLINE) {
+            sample_backlog_push(now_ms, data, stats, anomaly);
+        }
+
+        for (int e = 0; e < BOOT_EVENT_COUNT; e++) {
+            uint32_t ms = boot_trace_time_ms((BootEvent)e);
+            if (!reported[e] && ms != BOOT_TRACE_NOT_REACHED) {
+                fprintf(out, "{\"phase\":\"milestone\",\"event\":\"%s\",\"t_ms\":%u}\n",
+                        boot_trace_event_name((BootEvent)e), ms);
+                reported[e] = true;
+            }
+        }
+
+        int busy_ms = since_boot.read_ms() - (int)now_ms;
+        if (busy_ms < options.interval_ms) {
+            ThisThread::sleep_for(std::chrono::milliseconds(options.interval_ms - busy_ms));
+        }
+    }
+
+    // Let the last QoS 1 publishes be acknowledged before counting
+    Timer drain;
+    drain.start();
+    while (mqtt_is_connected() && mqtt_get_stats().inflight > 0 && drain.read_ms() < 2000) {
+        if (options.sequential) {
+            mqtt_yield(10);
+        } else {
+            ThisThread::sleep_for(10ms);
+        }
+    }
+    broker.wait_publishes(published, 500);
+
+    static const char *const class_names[MQTT_CLASS_COUNT] = {"alert", "status", "telemetry", "backfill", "history"};
+    for (int c = 0; c < MQTT_CLASS_COUNT; c++) {
+        MqttClassStats cls = mqtt_get_class_stats((MqttClass)c);
+        fprintf(out, "{\"phase\":\"queue\",\"class\":\"%s\",\"queued\":%u,\"sent\":%u,\"dropped\":%u,"
+                "\"max_depth\":%u,\"mean_latency_us\":%u,\"max_latency_us\":%u}\n",
+                class_names[c], cls.queued, cls.sent, cls.dropped, cls.max_depth, cls.mean_latency_us,
+                cls.max_latency_us);
+    }
+
+    SampleBacklogStats backlog = sample_backlog_get_stats();
+    uint32_t first_sample = boot_trace_time_ms(BOOT_FIRST_SAMPLE);
+    uint32_t first_publish = boot_trace_time_ms(BOOT_FIRST_PUBLISH);
+    fprintf(out, "{\"phase\":\"summary\",\"boot\":\"%s\",\"join_ms\":%d,\"interval_ms\":%d,"
+            "\"time_to_first_sample_ms\":%ld,\"time_to_first_publish_ms\":%ld,\"samples\":%u,\"published\":%u,"
+            "\"backlogged\":%u,\"backlog_dropped\":%u,\"backlog_max_depth\":%u,\"backlog_left\":%u,"
+            "\"broker_live\":%u,\"broker_backlogged\":%u}\n",
+            options.sequential ? "sequential" : "parallel", options.join_ms, options.interval_ms,
+            first_sample == BOOT_TRACE_NOT_REACHED ? -1L : (long)first_sample,
+            first_publish == BOOT_TRACE_NOT_REACHED ? -1L : (long)first_publish,
+            samples, published, backlog.buffered, backlog.dropped, backlog.max_depth, backlog.depth,
+            live_received.load(), backlog_received.load());
+    fflush(out);
+
+    // The network thread stays on to supervise the link; leave without
+    // unwinding it
+    if (options.sequential) {
+        host_i2c_attach(nullptr);
+        broker.stop();
+        delete signal;
+        return 0;
+    }
+    _exit(0);
+}
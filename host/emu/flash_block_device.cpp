@@ -0,0 +1,147 @@
+#include "flash_block_device.h"
+
+#include <string.h>
+
+FlashBlockDevice::FlashBlockDevice(bd_size_t size, bd_size_t erase_size, bd_size_t program_size)
+    : _data(size, 0xFF),
+      _erase_counts(size / erase_size, 0),
+      _erase_size(erase_size),
+      _program_size(program_size),
+      _cut_after(-1),
+      _power_cut(false),
+      _programmed(0)
+{
+}
+
+int FlashBlockDevice::init()
+{
+    _power_cut = false;
+    return BD_ERROR_OK;
+}
+
+int FlashBlockDevice::deinit()
+{
+    return BD_ERROR_OK;
+}
+
+bool FlashBlockDevice::valid_range(bd_addr_t addr, bd_size_t size, bd_size_t unit) const
+{
+    return addr % unit == 0 && size % unit == 0 && addr + size <= _data.size();
+}
+
+int FlashBlockDevice::read(void *buffer, bd_addr_t addr, bd_size_t size)
+{
+    if (!valid_range(addr, size, 1)) {
+        return BD_ERROR_DEVICE_ERROR;
+    }
+    memcpy(buffer, &_data[addr], size);
+    return BD_ERROR_OK;
+}
+
+int FlashBlockDevice::program(const void *buffer, bd_addr_t addr, bd_size_t size)
+{
+    if (!valid_range(addr, size, _program_size)) {
+        return BD_ERROR_DEVICE_ERROR;
+    }
+    for (bd_size_t i = 0; i < size; i++) {
+        if (_data[addr + i] != 0xFF) {
+            return BD_ERROR_DEVICE_ERROR;
+        }
+    }
+
+    bd_size_t count = size;
+    if (_cut_after >= 0 && (bd_size_t)_cut_after < size) {
+        count = (bd_size_t)_cut_after;
+    }
+    memcpy(&_data[addr], buffer, count);
+    _programmed += count;
+    if (_cut_after >= 0) {
+        _cut_after -= count;
+        if (count < size) {
+            _cut_after = -1;
+            _power_cut = true;
+            return BD_ERROR_DEVICE_ERROR;
+        }
+    }
+    return BD_ERROR_OK;
+}
+
+int FlashBlockDevice::erase(bd_addr_t addr, bd_size_t size)
+{
+    if (!valid_range(addr, size, _erase_size)) {
+        return BD_ERROR_DEVICE_ERROR;
+    }
+    memset(&_data[addr], 0xFF, size);
+    for (bd_addr_t block = addr / _erase_size; block < (addr + size) / _erase_size; block++) {
+        _erase_counts[block]++;
+    }
+    return BD_ERROR_OK;
+}
+
+bd_size_t FlashBlockDevice::get_read_size() const
+{
+    return 1;
+}
+
+bd_size_t FlashBlockDevice::get_program_size() const
+{
+    return _program_size;
+}
+
+bd_size_t FlashBlockDevice::get_erase_size() const
+{
+    return _erase_size;
+}
+
+int FlashBlockDevice::get_erase_value() const
+{
+    return 0xFF;
+}
+
+bd_size_t FlashBlockDevice::size() const
+{
+    return _data.size();
+}
+
+const char *FlashBlockDevice::get_type() const
+{
+    return "FLASH_EMU";
+}
+
+void FlashBlockDevice::cut_power_after(int64_t bytes)
+{
+    _cut_after = bytes;
+}
+
+bool FlashBlockDevice::power_was_cut() const
+{
+    return _power_cut;
+}
+
+uint32_t FlashBlockDevice::erase_count(uint32_t block) const
+{
+    return block < _erase_counts.size() ? _erase_counts[block] : 0;
+}
+
+uint32_t FlashBlockDevice::max_erase_count() const
+{
+    uint32_t max_count = 0;
+    for (uint32_t count : _erase_counts) {
+        max_count = count > max_count ? count : max_count;
+    }
+    return max_count;
+}
+
+uint64_t FlashBlockDevice::total_erases() const
+{
+    uint64_t total = 0;
+    for (uint32_t count : _erase_counts) {
+        total += count;
+    }
+    return total;
+}
+
+uint64_t FlashBlockDevice::programmed_bytes() const
+{
+    return _programmed;
+}
@@ -0,0 +1,62 @@
+/* NOR flash behind mbed's BlockDevice interface, for running the firmware's
+ * storage code on the host in place of FlashIAPBlockDevice.
+ *
+ * Erased bytes read 0xFF and a byte can only be programmed once per erase,
+ * as on the STM32L4's internal flash: programming a location that is not
+ * erased fails. Erases are counted per block for wear figures.
+ *
+ * cut_power_after() makes a later program() stop after the given number of
+ * bytes, as if power was lost in the middle of the write: the bytes before
+ * the cut are written and the call fails.
+ */
+#ifndef FLASH_BLOCK_DEVICE_H
+#define FLASH_BLOCK_DEVICE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "BlockDevice.h"
+
+class FlashBlockDevice : public BlockDevice {
+public:
+    /** Defaults match the STM32L475's internal flash pages */
+    FlashBlockDevice(bd_size_t size, bd_size_t erase_size = 2048, bd_size_t program_size = 8);
+
+    int init() override;
+    int deinit() override;
+    int read(void *buffer, bd_addr_t addr, bd_size_t size) override;
+    int program(const void *buffer, bd_addr_t addr, bd_size_t size) override;
+    int erase(bd_addr_t addr, bd_size_t size) override;
+
+    bd_size_t get_read_size() const override;
+    bd_size_t get_program_size() const override;
+    bd_size_t get_erase_size() const override;
+    using BlockDevice::get_erase_size;
+    int get_erase_value() const override;
+    bd_size_t size() const override;
+    const char *get_type() const override;
+
+    /** The program() call that reaches @p bytes more programmed bytes is cut
+     *  short there; negative disarms */
+    void cut_power_after(int64_t bytes);
+    bool power_was_cut() const;
+
+    uint32_t erase_count(uint32_t block) const;
+    uint32_t max_erase_count() const;
+    uint64_t total_erases() const;
+    uint64_t programmed_bytes() const;
+
+private:
+    bool valid_range(bd_addr_t addr, bd_size_t size, bd_size_t unit) const;
+
+    std::vector<uint8_t> _data;
+    std::vector<uint32_t> _erase_counts;
+    bd_size_t _erase_size;
+    bd_size_t _program_size;
+    int64_t _cut_after;
+    bool _power_cut;
+    uint64_t _programmed;
+};
+
+#endif // FLASH_BLOCK_DEVICE_H
@@ -0,0 +1,171 @@
+/* Runs the SNTP resync with the heap locked, as NO_HEAP_AFTER_INIT builds
+ * do once the first connect attempt is over.
+ *
+ * Built only with -DHOST_HEAP_LOCK_CHECK=ON: time_sync.cpp and heap_guard.cpp
+ * are compiled into the tool with NO_HEAP_AFTER_INIT=1, and heap_trap.cpp
+ * stands in for the allocator so heap_guard's trace callback sees every
+ * malloc. The WiFi module is the emulated ISM43362; the time server is an
+ * SNTP responder on loopback, reached under a name (TIME_SYNC_SERVER is
+ * "localhost" here) so the lookup path is the one the board takes.
+ *
+ * Before the lock the tool joins through the link manager, runs
+ * time_sync_init() and the first sync. It then calls heap_guard_lock() and
+ * runs --resyncs more syncs, each after the (shortened) interval. An
+ * allocation in any of them halts the tool in error(), as it would halt
+ * the board; otherwise the output is a record with the heap at the lock,
+ * one JSON record per resync and a summary, and the exit status is 0 if
+ * every resync succeeded.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <thread>
+
+#include "config.h"
+#include "heap_guard.h"
+#include "link_manager.h"
+#include "mbed_stats.h"
+#include "network_manager.h"
+#include "time_sync.h"
+
+#include "ism43362_emulator.h"
+#include "tool_common.h"
+
+#define NTP_UNIX_OFFSET 2208988800UL
+
+struct CheckOptions {
+    int resyncs = 3;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [--resyncs N]\n", prog);
+}
+
+static void put_u32_be(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// Answers every request with the host clock, in mode 4 (server). Runs on
+// its own thread once the heap is locked, so it keeps to stack buffers.
+static void ntp_responder(int fd)
+{
+    uint8_t packet[48];
+    struct sockaddr_in from;
+    for (;;) {
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len);
+        if (n < (ssize_t)sizeof(packet)) {
+            continue;
+        }
+        uint32_t now = (uint32_t)(time(nullptr) + NTP_UNIX_OFFSET);
+        packet[0] = (0 << 6) | (4 << 3) | 4;    // LI 0, VN 4, mode 4
+        packet[1] = 2;                          // stratum
+        put_u32_be(packet + 32, now);           // receive time
+        put_u32_be(packet + 40, now);           // transmit time
+        sendto(fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, from_len);
+    }
+}
+
+static int start_ntp_responder()
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            getsockname(fd, (struct sockaddr *)&addr, &len) < 0) {
+        close(fd);
+        return -1;
+    }
+    std::thread(ntp_responder, fd).detach();
+    return ntohs(addr.sin_port);
+}
+
+int main(int argc, char **argv)
+{
+    CheckOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--resyncs") && has_value) {
+            options.resyncs = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.resyncs <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("heap_lock_check");
+    if (!out) {
+        return 1;
+    }
+
+    int ntp_port = start_ntp_responder();
+    if (ntp_port < 0) {
+        perror("heap_lock_check: SNTP responder");
+        return 1;
+    }
+    ism43362_board_module().redirect("*", 123, "127.0.0.1", (uint16_t)ntp_port);
+
+    // Init, as network_task.cpp does it: everything here may allocate
+    if (network_set_credentials() != NSAPI_ERROR_OK) {
+        fprintf(stderr, "heap_lock_check: no WiFi interface\n");
+        return 1;
+    }
+    link_manager_init(network_get_wifi_interface());
+    link_manager_connect();
+    time_sync_init(network_get_interface());
+    uint32_t wait_ms = time_sync_poll();
+    if (!time_sync_is_synced()) {
+        fprintf(stderr, "heap_lock_check: first sync failed\n");
+        return 1;
+    }
+    // The first record also gets the report stream's buffer allocated
+    mbed_stats_heap_t init;
+    mbed_stats_heap_get(&init);
+    fprintf(out, "{\"phase\":\"init\",\"heap_bytes\":%u,\"heap_blocks\":%u,\"rtt_ms\":%u}\n",
+            init.current_size, init.alloc_cnt, time_sync_get_stats().last_rtt_ms);
+    fflush(out);
+    heap_guard_lock();
+
+    int ok = 0;
+    for (int r = 0; r < options.resyncs; r++) {
+        ThisThread::sleep_for(std::chrono::milliseconds(wait_ms + 10));
+        TimeSyncStats before = time_sync_get_stats();
+        wait_ms = time_sync_poll();
+        TimeSyncStats after = time_sync_get_stats();
+        bool synced = after.syncs > before.syncs;
+        ok += synced;
+        fprintf(out, "{\"phase\":\"resync\",\"index\":%d,\"synced\":%s,\"attempts\":%u,\"rtt_ms\":%u}\n",
+                r, synced ? "true" : "false", after.attempts - before.attempts, after.last_rtt_ms);
+        fflush(out);
+    }
+
+    mbed_stats_heap_t now;
+    mbed_stats_heap_get(&now);
+    fprintf(out, "{\"phase\":\"summary\",\"resyncs\":%d,\"synced\":%d,\"heap_bytes\":%u,"
+            "\"heap_blocks\":%u}\n",
+            options.resyncs, ok, now.current_size, now.alloc_cnt);
+    fflush(out);
+
+    // The responder thread never returns; leave without unwinding it
+    _exit(ok == options.resyncs ? 0 : 1);
+}
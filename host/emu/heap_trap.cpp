@@ -0,0 +1,103 @@
+/* Replaces malloc and friends for a host tool so the firmware's
+ * mbed_mem_trace callback sees its allocations, as the mbed allocator
+ * wrappers do on the board, and keeps the figures mbed_stats_heap_get()
+ * reports.
+ *
+ * Allocations made while tracing is suspended (HostMemTraceSuspend: the
+ * peripheral emulators and the callback itself) are counted but not traced.
+ */
+#include <malloc.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "mbed.h"
+#include "mbed_stats.h"
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t num, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static std::atomic<uint32_t> current_size(0);
+static std::atomic<uint32_t> max_size(0);
+static std::atomic<uint32_t> total_size(0);
+static std::atomic<uint32_t> alloc_cnt(0);
+static std::atomic<uint32_t> alloc_fail_cnt(0);
+
+static void count_alloc(void *ptr)
+{
+    if (!ptr) {
+        alloc_fail_cnt++;
+        return;
+    }
+    uint32_t size = (uint32_t)malloc_usable_size(ptr);
+    uint32_t now = current_size += size;
+    uint32_t peak = max_size;
+    while (now > peak && !max_size.compare_exchange_weak(peak, now)) {
+    }
+    total_size += size;
+    alloc_cnt++;
+}
+
+static void count_free(void *ptr)
+{
+    if (ptr) {
+        current_size -= (uint32_t)malloc_usable_size(ptr);
+        alloc_cnt--;
+    }
+}
+
+extern "C" void *malloc(size_t size)
+{
+    void *res = __libc_malloc(size);
+    count_alloc(res);
+    if (mbed_mem_trace_cb_t cb = host_mem_trace_callback()) {
+        HostMemTraceSuspend callback;
+        cb(MBED_MEM_TRACE_MALLOC, res, __builtin_return_address(0), size);
+    }
+    return res;
+}
+
+extern "C" void *calloc(size_t num, size_t size)
+{
+    void *res = __libc_calloc(num, size);
+    count_alloc(res);
+    if (mbed_mem_trace_cb_t cb = host_mem_trace_callback()) {
+        HostMemTraceSuspend callback;
+        cb(MBED_MEM_TRACE_CALLOC, res, __builtin_return_address(0), num, size);
+    }
+    return res;
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    count_free(ptr);
+    void *res = __libc_realloc(ptr, size);
+    count_alloc(res);
+    if (mbed_mem_trace_cb_t cb = host_mem_trace_callback()) {
+        HostMemTraceSuspend callback;
+        cb(MBED_MEM_TRACE_REALLOC, res, __builtin_return_address(0), ptr, size);
+    }
+    return res;
+}
+
+extern "C" void free(void *ptr)
+{
+    count_free(ptr);
+    __libc_free(ptr);
+    if (mbed_mem_trace_cb_t cb = host_mem_trace_callback()) {
+        HostMemTraceSuspend callback;
+        cb(MBED_MEM_TRACE_FREE, nullptr, __builtin_return_address(0), ptr);
+    }
+}
+
+void mbed_stats_heap_get(mbed_stats_heap_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->current_size = current_size;
+    stats->max_size = max_size;
+    stats->total_size = total_size;
+    stats->alloc_cnt = alloc_cnt;
+    stats->alloc_fail_cnt = alloc_fail_cnt;
+}
@@ -0,0 +1,262 @@
+/* Measures the history compression (series_codec.h) on readings taken the
+ * way the firmware takes them.
+ *
+ * The signal goes through the emulated HTS221/LPS22HB and the firmware's
+ * sensors.cpp at a fixed interval on the simulated clock, so the readings
+ * carry the sensors' resolution as well as the signal's noise. They are
+ * then compressed four ways:
+ *
+ *   temperature, humidity, pressure   each channel on its own, with its time
+ *   reading                           what history_store.cpp keeps per reading
+ *
+ * in blocks of --block-size bytes, and each stream is decoded again and
+ * checked against what went in. The ratio is against the uncompressed
+ * sample, a uint32_t time and a float per channel. Encode and decode times
+ * are host figures; the board is much slower, but the ratio between them
+ * carries over.
+ *
+ * The readings also go through sample_backlog.cpp, as if the session were
+ * down throughout, using the firmware's settings.
+ * The reports the backlog still holds at the end are drained and each
+ * payload is compared with the one the report would have had when taken.
+ *
+ * Output is one JSON record per stream, one for the backlog and a summary. The exit status is 1 if anything fails to come
+ * back as it went in.
+ *
+ * Usage: history_codec_report [--reads N] [--interval-ms N] [--block-size N]
+ *                             [--signal SPEC | --trace FILE]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "history_store.h"
+#include "mqtt_payload.h"
+#include "sample_backlog.h"
+#include "sample_history.h"
+#include "sensors.h"
+#include "series_codec.h"
+#include "HTS221_driver.h"
+#include "LPS22HB_driver.h"
+
+#include "hts221_model.h"
+#include "i2c_bus_emulator.h"
+#include "lps22hb_model.h"
+#include "sensor_signal.h"
+#include "tool_common.h"
+
+// An indoor day: slow swings with sensor-level noise
+#define DEFAULT_SIGNAL "temperature=sine:21.5:1.5:86400~0.02;humidity=sine:45:5:86400~0.1;" \
+                       "pressure=sine:1013:2:43200~0.01"
+
+struct Options {
+    int reads = 43200;
+    int interval_ms = SENSOR_UPDATE_INTERVAL_MS;
+    int block_size = HISTORY_STORE_BLOCK_SIZE;
+    const char *signal = DEFAULT_SIGNAL;
+    const char *trace = nullptr;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [--reads N] [--interval-ms N] [--block-size N] [--signal SPEC | --trace FILE]\n",
+            prog);
+}
+
+struct Reading {
+    uint32_t t_ms;
+    SensorData data;
+};
+
+static double now_ns()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void reading_values(const Reading &r, int32_t *values)
+{
+    values[SAMPLE_HISTORY_TEMPERATURE] = series_scale(r.data.temperature);
+    values[SAMPLE_HISTORY_HUMIDITY] = series_scale(r.data.humidity);
+    values[SAMPLE_HISTORY_PRESSURE] = series_scale(r.data.pressure);
+    values[SAMPLE_HISTORY_VALID] = (r.data.temp_valid ? 1 : 0) | (r.data.humidity_valid ? 2 : 0) |
+                                   (r.data.pressure_valid ? 4 : 0);
+}
+
+// Compresses one stream (channels [first, first + count) of the reading) in
+// blocks, decodes it and reports; false if it did not round-trip
+static bool measure(FILE *out, const char *name, const std::vector<Reading> &readings, int first, int count,
+                    int block_size)
+{
+    size_t n = readings.size();
+    std::vector<int32_t> input(n * count);
+    for (size_t i = 0; i < n; i++) {
+        int32_t values[SAMPLE_HISTORY_CHANNELS];
+        reading_values(readings[i], values);
+        memcpy(&input[i * count], values + first, count * sizeof(int32_t));
+    }
+
+    // Encode into a ring of blocks as the firmware does, keeping them all
+    std::vector<std::vector<uint8_t>> blocks;
+    std::vector<uint16_t> sizes;
+    SeriesEncoder enc;
+    double start = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        if (blocks.empty() || !series_encoder_append(&enc, readings[i].t_ms, &input[i * count])) {
+            if (!blocks.empty()) {
+                sizes.back() = series_encoder_bytes(&enc);
+            }
+            blocks.emplace_back(block_size);
+            sizes.push_back(0);
+            series_encoder_init(&enc, blocks.back().data(), (uint16_t)block_size, (uint8_t)count);
+            series_encoder_append(&enc, readings[i].t_ms, &input[i * count]);
+        }
+    }
+    double encode_ns = now_ns() - start;
+    sizes.back() = series_encoder_bytes(&enc);
+
+    size_t mismatches = 0, decoded = 0;
+    int32_t values[SERIES_MAX_CHANNELS];
+    uint32_t t_ms;
+    start = now_ns();
+    for (size_t b = 0; b < blocks.size(); b++) {
+        SeriesDecoder dec;
+        series_decoder_init(&dec, blocks[b].data(), sizes[b]);
+        while (series_decoder_next(&dec, &t_ms, values)) {
+            if (decoded < n && (t_ms != readings[decoded].t_ms ||
+                                memcmp(values, &input[decoded * count], count * sizeof(int32_t)) != 0)) {
+                mismatches++;
+            }
+            decoded++;
+        }
+    }
+    double decode_ns = now_ns() - start;
+    mismatches += decoded > n ? decoded - n : n - decoded;
+
+    // Blocks are fixed-size: all but the last count in full
+    double stored = (double)(blocks.size() - 1) * block_size + sizes.back();
+    double used = 0;
+    for (uint16_t size : sizes) {
+        used += size;
+    }
+    double raw = (double)n * (sizeof(uint32_t) + count * sizeof(float));
+    fprintf(out, "{\"stream\":\"%s\",\"channels\":%d,\"samples\":%zu,\"blocks\":%zu,\"raw_bytes\":%.0f,"
+            "\"stored_bytes\":%.0f,\"ratio\":%.1f,\"bits_per_sample\":%.2f,\"block_fill\":%.3f,"
+            "\"encode_ns_per_sample\":%.1f,\"decode_ns_per_sample\":%.1f,\"mismatches\":%zu}\n",
+            name, count, n, blocks.size(), raw, stored, raw / stored, used * 8 / n,
+            used / ((double)blocks.size() * block_size), encode_ns / n, decode_ns / n, mismatches);
+    return mismatches == 0;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--reads") && has_value) {
+            options.reads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval-ms") && has_value) {
+            options.interval_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--block-size") && has_value) {
+            options.block_size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--signal") && has_value) {
+            options.signal = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && has_value) {
+            options.trace = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.reads <= 0 || options.interval_ms <= 0 || options.block_size > UINT16_MAX ||
+            options.block_size < SERIES_BLOCK_MIN_SIZE(SAMPLE_HISTORY_CHANNELS)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string error;
+    SensorSignal *signal = options.trace ? sensor_signal_from_trace(options.trace, error)
+                                         : sensor_signal_from_spec(options.signal, error);
+    if (!signal) {
+        fprintf(stderr, "history_codec_report: %s\n", error.c_str());
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("history_codec_report");
+    if (!out) {
+        return 1;
+    }
+
+    HTS221Model hts221(*signal);
+    LPS22HBModel lps22hb(*signal);
+    I2CBusEmulator bus(400000);
+    bus.add_device(HTS221_I2C_ADDRESS, &hts221);
+    bus.add_device(LPS22HB_ADDRESS_HIGH, &lps22hb);
+    host_i2c_attach(&bus);
+    sensors_init();
+    sensors_set_interval_ms(options.interval_ms);
+
+    std::vector<Reading> readings(options.reads);
+    for (Reading &r : readings) {
+        bus.advance_us((uint64_t)options.interval_ms * 1000);
+        r.t_ms = (uint32_t)(bus.now_us() / 1000);
+        r.data = sensors_read();
+    }
+
+    bool ok = true;
+    ok = measure(out, "temperature", readings, SAMPLE_HISTORY_TEMPERATURE, 1, options.block_size) && ok;
+    ok = measure(out, "humidity", readings, SAMPLE_HISTORY_HUMIDITY, 1, options.block_size) && ok;
+    ok = measure(out, "pressure", readings, SAMPLE_HISTORY_PRESSURE, 1, options.block_size) && ok;
+    ok = measure(out, "reading", readings, 0, SAMPLE_HISTORY_CHANNELS, options.block_size) && ok;
+
+    // The backlog through an outage as long as the run: whatever it still
+    // holds must come back with the payload it was taken with
+    sample_backlog_init();
+    std::vector<TempStats1Hour> stats(readings.size());
+    std::vector<AnomalyStatus> anomalies(readings.size());
+    for (size_t i = 0; i < readings.size(); i++) {
+        // Stand-ins that change now and then, as the real ones do
+        stats[i].min_temp = 20.0f + (float)(i / 1800) * 0.01f;
+        stats[i].max_temp = 23.0f + (float)(i / 1800) * 0.01f;
+        stats[i].valid = i >= 1800;
+        anomalies[i].is_anomalous = i % 5000 == 0;
+        sample_backlog_push(readings[i].t_ms, readings[i].data, stats[i], anomalies[i]);
+    }
+    SampleBacklogStats backlog = sample_backlog_get_stats();
+    size_t first = readings.size() - backlog.depth;
+    size_t payload_mismatches = 0, drained = 0;
+    BacklogSample sample;
+    while (sample_backlog_peek(&sample)) {
+        size_t i = first + drained;
+        char expected[MBED_CONF_MQTT_MAX_PACKET_SIZE], actual[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+        mqtt_format_data_payload(expected, sizeof(expected), readings[i].data, stats[i], anomalies[i], 1,
+                                 "dev");
+        mqtt_format_data_payload(actual, sizeof(actual), sample.data, sample.stats, sample.anomaly, 1, "dev");
+        if (strcmp(expected, actual) != 0 || sample.taken_ms != readings[i].t_ms) {
+            payload_mismatches++;
+        }
+        sample_backlog_pop();
+        drained++;
+    }
+    payload_mismatches += drained != backlog.depth;
+    double raw_backlog = (double)backlog.depth * sizeof(BacklogSample);
+    fprintf(out, "{\"backlog\":true,\"blocks\":%u,\"bytes\":%u,\"held\":%u,\"dropped\":%u,"
+            "\"uncompressed_bytes\":%.0f,\"ratio\":%.1f,\"span_s\":%.0f,\"payload_mismatches\":%zu}\n",
+            backlog.blocks, backlog.bytes, backlog.depth, backlog.dropped, raw_backlog,
+            raw_backlog / (SAMPLE_BACKLOG_BLOCKS * SAMPLE_BACKLOG_BLOCK_SIZE),
+            backlog.depth * options.interval_ms / 1000.0, payload_mismatches);
+    ok = ok && payload_mismatches == 0;
+
+    fprintf(out, "{\"summary\":true,\"reads\":%d,\"interval_ms\":%d,\"block_size\":%d,\"ok\":%s}\n",
+            options.reads, options.interval_ms, options.block_size, ok ? "true" : "false");
+    fflush(out);
+
+    host_i2c_attach(nullptr);
+    delete signal;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,445 @@
+/* Asks the firmware for ranges of its reading history over MQTT while it
+ * keeps sampling and publishing, and reports what each query costs.
+ *
+ * network_task.cpp brings WiFi and MQTT up on its own thread as on the
+ * board, over the emulated ISM43362 and the loopback test broker. The
+ * history store (history_store.h) sits on FlashBlockDevice and is filled
+ * with --hours of readings from the signal before the run. This tool's main
+ * thread then plays main() every --pass-ms: one reading into the history, a
+ * live data publish, and history_query_service(). A client on a thread of
+ * its own sends --queries requests for the last --query-s seconds, one
+ * after the other, acknowledges the chunks as they arrive, decodes them and
+ * checks the readings against the ones added.
+ *
+ * Output is one JSON record per query and a summary. For a query:
+ *   first_chunk_ms  request -> first chunk at the client
+ *   latency_ms      request -> end message at the client
+ *   passes          main loop passes the query took; on the board a pass
+ *                   is SAMPLE_INTERVAL_MS, so board_latency_s is passes
+ *                   times that
+ *   payload_bytes   chunk and end payloads; mqtt_bytes adds the PUBLISH
+ *                   headers and topic
+ * The summary compares the main loop's pass time and the live data
+ * publishes' queue latency (queued -> socket) without and with a query
+ * running. The exit status is 1 if a query did not complete or returned
+ * readings other than those added in its range.
+ *
+ * Usage: history_query_bench [--hours N] [--query-s N] [--queries N]
+ *                            [--window N] [--pass-ms N] [--latency-us N]
+ *                            [--signal SPEC] [--summary-only]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "history_query.h"
+#include "history_store.h"
+#include "mqtt_handler.h"
+#include "network_task.h"
+#include "sample_history.h"
+#include "series_codec.h"
+
+#include "flash_block_device.h"
+#include "ism43362_emulator.h"
+#include "mqtt_test_broker.h"
+#include "mqtt_wire.h"
+#include "sensor_signal.h"
+#include "tool_common.h"
+
+static const uint64_t START_MS = 1704067200000ull; // 2024-01-01
+
+struct Options {
+    int hours = 24;
+    int query_s = 3 * 3600;
+    int queries = 5;
+    int window = HISTORY_QUERY_WINDOW;
+    int pass_ms = 20;
+    int latency_us = 0;
+    const char *signal = "temperature=sine:21.5:1.5:86400~0.02;humidity=sine:45:5:86400~0.1;"
+                         "pressure=sine:1013:2:43200~0.01";
+    bool summary_only = false;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--hours N] [--query-s N] [--queries N] [--window N] [--pass-ms N]\n"
+            "       [--latency-us N] [--signal SPEC] [--summary-only]\n",
+            prog);
+}
+
+static double now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+struct Reading {
+    uint64_t t_ms;
+    int32_t values[SAMPLE_HISTORY_CHANNELS];
+};
+
+// Readings added to the history, appended by the main thread
+struct Added {
+    std::mutex mutex;
+    std::vector<Reading> readings;
+};
+
+static Reading make_reading(const SensorSignal &signal, uint64_t t_ms, SensorData *data)
+{
+    SensorTruth truth = signal.at((t_ms - START_MS) * 1000);
+    data->temperature = truth.temperature;
+    data->humidity = truth.humidity;
+    data->pressure = truth.pressure;
+    data->temp_valid = data->humidity_valid = data->pressure_valid = true;
+    Reading r;
+    r.t_ms = t_ms;
+    r.values[SAMPLE_HISTORY_TEMPERATURE] = series_scale(data->temperature);
+    r.values[SAMPLE_HISTORY_HUMIDITY] = series_scale(data->humidity);
+    r.values[SAMPLE_HISTORY_PRESSURE] = series_scale(data->pressure);
+    r.values[SAMPLE_HISTORY_VALID] = 7;
+    return r;
+}
+
+static uint32_t get_u32(const unsigned char *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+struct QueryResult {
+    int id;
+    double first_chunk_ms = -1;
+    double latency_ms = -1;
+    uint32_t passes = 0;
+    int kind = -1;              // of the message that ended it
+    uint32_t chunks = 0;
+    uint32_t readings = 0;
+    uint64_t payload_bytes = 0;
+    uint64_t mqtt_bytes = 0;
+    uint32_t device_bytes = 0;  // as reported in the end message
+    uint32_t device_ms = 0;
+    uint32_t gaps = 0;          // chunks missing from seq
+    bool correct = false;
+};
+
+// The client's side of the queries; runs on its own thread
+class QueryClient {
+public:
+    QueryClient(const Options &options, Added &added, std::atomic<uint32_t> &passes)
+        : _options(options), _added(added), _passes(passes)
+    {
+    }
+
+    bool open(uint16_t port)
+    {
+        return _wire.open("127.0.0.1", port, "history-client") && _wire.subscribe(MQTT_TOPIC_HISTORY_DATA);
+    }
+
+    void run()
+    {
+        for (int q = 0; q < _options.queries; q++) {
+            results.push_back(query(q + 1));
+        }
+        done = true;
+    }
+
+    std::vector<QueryResult> results;
+    std::atomic<bool> active{false};
+    std::atomic<bool> done{false};
+
+private:
+    QueryResult query(int id)
+    {
+        QueryResult result;
+        result.id = id;
+        std::vector<Reading> got;
+        uint16_t next_seq = 0;
+        bool decoded = true;
+
+        char request[96];
+        int len = snprintf(request, sizeof(request), "{\"id\":%d,\"last_s\":%d,\"window\":%d}", id,
+                           _options.query_s, _options.window);
+        double start = now_ms();
+        uint32_t start_pass = _passes;
+        active = true;
+        _wire.publish(MQTT_TOPIC_HISTORY_REQUEST, request, len);
+
+        auto handler = [&](const char *topic, size_t topic_len, const char *payload, size_t size) {
+            const unsigned char *p = (const unsigned char *)payload;
+            if (size < HISTORY_QUERY_HEADER_SIZE || p[0] != HISTORY_QUERY_VERSION || (p[2] | p[3] << 8) != id) {
+                return;
+            }
+            result.payload_bytes += size;
+            size_t remaining = 2 + topic_len + size;
+            result.mqtt_bytes += 1 + (remaining < 128 ? 1 : 2) + remaining;
+            uint16_t seq = p[4] | p[5] << 8;
+            if (p[1] != HISTORY_REPLY_CHUNK) {
+                result.kind = p[1];
+                result.latency_ms = now_ms() - start;
+                if (size >= HISTORY_QUERY_HEADER_SIZE + 16) {
+                    result.device_bytes = get_u32(p + HISTORY_QUERY_HEADER_SIZE + 8);
+                    result.device_ms = get_u32(p + HISTORY_QUERY_HEADER_SIZE + 12);
+                }
+                return;
+            }
+            if (result.first_chunk_ms < 0) {
+                result.first_chunk_ms = now_ms() - start;
+            }
+            result.chunks++;
+            result.gaps += (uint16_t)(seq - next_seq);
+            next_seq = seq + 1;
+
+            uint64_t first_ms = get_u32(p + 8) | (uint64_t)get_u32(p + 12) << 32;
+            SeriesDecoder dec;
+            Reading r;
+            uint32_t offset_ms;
+            decoded = series_decoder_init(&dec, p + HISTORY_QUERY_HEADER_SIZE,
+                                          (uint16_t)(size - HISTORY_QUERY_HEADER_SIZE)) && decoded;
+            while (series_decoder_next(&dec, &offset_ms, r.values)) {
+                r.t_ms = first_ms + offset_ms;
+                got.push_back(r);
+            }
+
+            // Acknowledge every chunk, as a client on a slow link would in batches
+            char ack[48];
+            int ack_len = snprintf(ack, sizeof(ack), "{\"id\":%d,\"ack\":%u}", id, next_seq);
+            _wire.publish(MQTT_TOPIC_HISTORY_REQUEST, ack, ack_len);
+        };
+        while (result.kind < 0 && now_ms() - start < HISTORY_QUERY_TIMEOUT_MS + 5000.0) {
+            if (!_wire.receive(handler)) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        result.passes = _passes - start_pass;
+        result.readings = (uint32_t)got.size();
+        active = false;
+
+        // The end of the range is the newest reading when the request was
+        // taken, and the last one returned; everything added in the
+        // --query-s before it must be there, once and unchanged
+        if (result.kind == HISTORY_REPLY_END && decoded && !got.empty()) {
+            std::lock_guard<std::mutex> lock(_added.mutex);
+            const std::vector<Reading> &all = _added.readings;
+            uint64_t to = got.back().t_ms;
+            uint64_t from = to - (uint64_t)_options.query_s * 1000;
+            auto by_time = [](const Reading &r, uint64_t t) { return r.t_ms < t; };
+            size_t first = std::lower_bound(all.begin(), all.end(), from, by_time) - all.begin();
+            bool match = first + got.size() <= all.size() && all[first + got.size() - 1].t_ms == to;
+            for (size_t i = 0; match && i < got.size(); i++) {
+                match = got[i].t_ms == all[first + i].t_ms &&
+                        memcmp(got[i].values, all[first + i].values, sizeof(got[i].values)) == 0;
+            }
+            result.correct = match;
+        }
+        return result;
+    }
+
+    const Options &_options;
+    Added &_added;
+    std::atomic<uint32_t> &_passes;
+    MqttWire _wire;
+};
+
+// Pass times and live publish latency over a stretch of the run
+struct LoopFigures {
+    uint32_t passes = 0;
+    double busy_ms = 0;
+    double max_busy_ms = 0;
+    uint32_t published = 0;
+    uint64_t latency_us = 0;    // sum of the telemetry class's last latency per pass
+    uint32_t max_latency_us = 0;
+    uint32_t refused = 0;       // live publishes the queue had no room for
+
+    void add(double busy, bool sent, uint32_t latency)
+    {
+        passes++;
+        busy_ms += busy;
+        max_busy_ms = std::max(max_busy_ms, busy);
+        if (sent) {
+            published++;
+            latency_us += latency;
+            max_latency_us = std::max(max_latency_us, latency);
+        } else {
+            refused++;
+        }
+    }
+    void print(FILE *out, const char *name) const
+    {
+        fprintf(out, "\"%s\":{\"passes\":%u,\"mean_pass_ms\":%.3f,\"max_pass_ms\":%.3f,\"live_published\":%u,"
+                "\"live_refused\":%u,\"live_mean_queue_us\":%.0f,\"live_max_queue_us\":%u}",
+                name, passes, passes ? busy_ms / passes : 0.0, max_busy_ms, published, refused,
+                published ? (double)latency_us / published : 0.0, max_latency_us);
+    }
+};
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--hours") && has_value) {
+            options.hours = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--query-s") && has_value) {
+            options.query_s = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--queries") && has_value) {
+            options.queries = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--window") && has_value) {
+            options.window = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--pass-ms") && has_value) {
+            options.pass_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--latency-us") && has_value) {
+            options.latency_us = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--signal") && has_value) {
+            options.signal = argv[++i];
+        } else if (!strcmp(argv[i], "--summary-only")) {
+            options.summary_only = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.hours <= 0 || options.query_s <= 0 || options.queries <= 0 || options.window < 0 ||
+            options.pass_ms < 0 || options.latency_us < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::string error;
+    SensorSignal *signal = sensor_signal_from_spec(options.signal, error);
+    if (!signal) {
+        fprintf(stderr, "history_query_bench: %s\n", error.c_str());
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("history_query_bench");
+    if (!out) {
+        return 1;
+    }
+
+    // The history, as main() keeps it
+    FlashBlockDevice flash(HISTORY_STORE_SIZE, 4096, 1);
+    Added added;
+    history_store_init(&flash);
+    history_query_init();
+    uint64_t clock_ms = START_MS;
+    uint64_t prefill = (uint64_t)options.hours * 3600000 / SAMPLE_INTERVAL_MS;
+    for (uint64_t i = 0; i < prefill; i++, clock_ms += SAMPLE_INTERVAL_MS) {
+        SensorData data;
+        added.readings.push_back(make_reading(*signal, clock_ms, &data));
+        history_store_add(clock_ms, data);
+    }
+
+    MQTTTestBroker broker;
+    if (!broker.start()) {
+        perror("history_query_bench: broker");
+        return 1;
+    }
+    ISM43362Emulator &emu = ism43362_board_module();
+    emu.redirect(MQTT_BROKER_HOSTNAME, MQTT_BROKER_PORT, "127.0.0.1", broker.port());
+    emu.set_join_delay_ms(0);
+    emu.set_command_latency_us(options.latency_us);
+    network_task_start();
+    double start = now_ms();
+    while (!(network_task_get_state() == NETWORK_TASK_ONLINE && mqtt_is_connected()) && now_ms() - start < 10000) {
+        ThisThread::sleep_for(10ms);
+    }
+    if (!mqtt_is_connected()) {
+        fprintf(stderr, "history_query_bench: network did not come up\n");
+        return 1;
+    }
+
+    std::atomic<uint32_t> passes{0};
+    QueryClient client(options, added, passes);
+    if (!client.open(broker.port())) {
+        fprintf(stderr, "history_query_bench: client could not connect\n");
+        return 1;
+    }
+
+    // main()'s loop, without the sensor read and the detector. A stretch
+    // without queries first, then the queries one after the other.
+    LoopFigures idle, querying;
+    std::thread client_thread;
+    int idle_passes = 50;
+    uint32_t uptime_ms = 0;
+    double run_start = now_ms();
+    while (!client.done && now_ms() - run_start < 600000.0) {
+        double pass_start = now_ms();
+        SensorData data;
+        Reading r = make_reading(*signal, clock_ms, &data);
+        {
+            std::lock_guard<std::mutex> lock(added.mutex);
+            added.readings.push_back(r);
+        }
+        history_store_add(clock_ms, data);
+        clock_ms += SAMPLE_INTERVAL_MS;
+        uptime_ms += SAMPLE_INTERVAL_MS;
+
+        bool during_query = client.active;
+        bool sent = mqtt_publish_data(data, TempStats1Hour{}, AnomalyStatus{});
+        history_query_service(uptime_ms);
+        double busy = now_ms() - pass_start;
+        uint32_t latency = mqtt_get_class_stats(MQTT_CLASS_TELEMETRY).last_latency_us;
+        (during_query ? querying : idle).add(busy, sent, latency);
+        passes++;
+
+        if (--idle_passes == 0) {
+            client_thread = std::thread([&] { client.run(); });
+        }
+        if (busy < options.pass_ms) {
+            std::this_thread::sleep_for(std::chrono::microseconds((int)((options.pass_ms - busy) * 1000)));
+        }
+    }
+    if (client_thread.joinable()) {
+        client_thread.join();
+    }
+
+    bool ok = client.results.size() == (size_t)options.queries;
+    double latency_sum = 0, max_latency = 0;
+    uint64_t bytes = 0, readings = 0;
+    for (const QueryResult &q : client.results) {
+        bool good = q.kind == HISTORY_REPLY_END && q.correct && q.gaps == 0;
+        ok = ok && good;
+        latency_sum += q.latency_ms;
+        max_latency = std::max(max_latency, q.latency_ms);
+        bytes += q.mqtt_bytes;
+        readings += q.readings;
+        if (!options.summary_only) {
+            fprintf(out, "{\"phase\":\"query\",\"id\":%d,\"kind\":%d,\"readings\":%u,\"chunks\":%u,\"gaps\":%u,"
+                    "\"first_chunk_ms\":%.1f,\"latency_ms\":%.1f,\"passes\":%u,\"board_latency_s\":%.0f,"
+                    "\"payload_bytes\":%llu,\"mqtt_bytes\":%llu,\"bytes_per_reading\":%.2f,\"device_bytes\":%u,"
+                    "\"device_ms\":%u,\"correct\":%s}\n",
+                    q.id, q.kind, q.readings, q.chunks, q.gaps, q.first_chunk_ms, q.latency_ms, q.passes,
+                    q.passes * SAMPLE_INTERVAL_MS / 1000.0, (unsigned long long)q.payload_bytes,
+                    (unsigned long long)q.mqtt_bytes, q.readings ? (double)q.mqtt_bytes / q.readings : 0.0,
+                    q.device_bytes, q.device_ms, q.correct ? "true" : "false");
+        }
+    }
+
+    HistoryQueryStats stats = history_query_get_stats();
+    size_t n = client.results.size() ? client.results.size() : 1;
+    fprintf(out, "{\"phase\":\"summary\",\"hours\":%d,\"query_s\":%d,\"queries\":%d,\"window\":%d,"
+            "\"chunks_per_pass\":%d,\"mean_latency_ms\":%.1f,\"max_latency_ms\":%.1f,\"mean_mqtt_bytes\":%.0f,"
+            "\"bytes_per_reading\":%.2f,\"completed\":%u,\"waits\":%u,",
+            options.hours, options.query_s, options.queries, options.window, HISTORY_QUERY_CHUNKS_PER_PASS,
+            latency_sum / n, max_latency, (double)bytes / n, readings ? (double)bytes / readings : 0.0,
+            stats.completed, stats.waits);
+    idle.print(out, "idle");
+    fputc(',', out);
+    querying.print(out, "querying");
+    fprintf(out, ",\"ok\":%s}\n", ok ? "true" : "false");
+    fflush(out);
+    delete signal;
+
+    // The network thread never returns; leave without unwinding it
+    _exit(ok ? 0 : 1);
+}
@@ -0,0 +1,420 @@
+/* Appends days of readings to the firmware's history store (history_store.h)
+ * on an emulated NOR flash, then times range lookups and checks recovery
+ * from power cuts.
+ *
+ * The flash is FlashBlockDevice with the geometry of the board's QSPI part
+ * (4 KB sectors, byte-programmable) and --flash-kb of it, like the slice
+ * main.cpp gives the store. Readings come straight from the signal every
+ * --interval-ms (no sensor emulation) and are timestamped from 2024-01-01.
+ *
+ *   append       host time per history_store_add(), records and segments
+ *                written, erase counts per sector, and the flash time they
+ *                would take on the board by the typical MX25R6435F figures
+ *                below
+ *   query        --queries lookups of a --window-s span at random points of
+ *                what the store holds: host time, records and bytes read,
+ *                and a check that the readings returned are exactly those
+ *                added in the span, for the span the store still holds
+ *   power_loss   --power-cuts resets, each cutting power a random number of
+ *                bytes into the writes that follow; after each the store is
+ *                mounted again and must hold every record completed before
+ *                the cut, in order, with no torn data returned
+ *
+ * Flash timing (MX25R6435F high-performance mode, typical):
+ *   page program    0.85 ms per 256-byte page or part of one
+ *   sector erase    40 ms per 4 KB sector
+ *   read            20 MB/s (quad I/O at 40 MHz), plus 2 us per command
+ *
+ * Output is one JSON record per phase and a summary; the exit status is 1
+ * if any check fails.
+ *
+ * Usage: history_store_bench [--days N] [--interval-ms N] [--flash-kb N]
+ *                            [--queries N] [--window-s N] [--power-cuts N]
+ *                            [--signal SPEC | --trace FILE]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "history_store.h"
+#include "sample_history.h"
+#include "series_codec.h"
+
+#include "flash_block_device.h"
+#include "sensor_signal.h"
+#include "tool_common.h"
+
+// Flash timing, see the top of the file
+static const double PAGE_PROGRAM_US = 850.0;
+static const double SECTOR_ERASE_US = 40000.0;
+static const double READ_US_PER_BYTE = 1.0 / 20.0;
+static const double READ_COMMAND_US = 2.0;
+
+static const uint32_t SECTOR_SIZE = 4096;
+static const uint64_t START_MS = 1704067200000ull; // 2024-01-01
+
+struct Options {
+    int days = 10;
+    int interval_ms = SAMPLE_INTERVAL_MS;
+    int flash_kb = HISTORY_STORE_SIZE / 1024;
+    int queries = 1000;
+    int window_s = 3600;
+    int power_cuts = 100;
+    const char *signal = "temperature=sine:21.5:1.5:86400~0.02;humidity=sine:45:5:86400~0.1;"
+                         "pressure=sine:1013:2:43200~0.01";
+    const char *trace = nullptr;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--days N] [--interval-ms N] [--flash-kb N] [--queries N] [--window-s N]\n"
+            "       [--power-cuts N] [--signal SPEC | --trace FILE]\n", prog);
+}
+
+// Counts what reaches the flash, for the timing model
+class CountingBlockDevice : public BlockDevice {
+public:
+    explicit CountingBlockDevice(FlashBlockDevice &flash) : _flash(flash)
+    {
+        reset();
+    }
+
+    int init() override
+    {
+        return _flash.init();
+    }
+    int deinit() override
+    {
+        return _flash.deinit();
+    }
+    int read(void *buffer, bd_addr_t addr, bd_size_t size) override
+    {
+        reads++;
+        read_bytes += size;
+        return _flash.read(buffer, addr, size);
+    }
+    int program(const void *buffer, bd_addr_t addr, bd_size_t size) override
+    {
+        // A program cannot cross a 256-byte page
+        pages += (addr + size + 255) / 256 - addr / 256;
+        return _flash.program(buffer, addr, size);
+    }
+    int erase(bd_addr_t addr, bd_size_t size) override
+    {
+        sectors += size / SECTOR_SIZE;
+        return _flash.erase(addr, size);
+    }
+    bd_size_t get_read_size() const override
+    {
+        return _flash.get_read_size();
+    }
+    bd_size_t get_program_size() const override
+    {
+        return _flash.get_program_size();
+    }
+    bd_size_t get_erase_size() const override
+    {
+        return _flash.get_erase_size();
+    }
+    using BlockDevice::get_erase_size;
+    int get_erase_value() const override
+    {
+        return _flash.get_erase_value();
+    }
+    bd_size_t size() const override
+    {
+        return _flash.size();
+    }
+    const char *get_type() const override
+    {
+        return "COUNTING";
+    }
+
+    void reset()
+    {
+        reads = read_bytes = pages = sectors = 0;
+    }
+    double flash_us() const
+    {
+        return reads * READ_COMMAND_US + read_bytes * READ_US_PER_BYTE + pages * PAGE_PROGRAM_US +
+               sectors * SECTOR_ERASE_US;
+    }
+
+    uint64_t reads, read_bytes, pages, sectors;
+
+private:
+    FlashBlockDevice &_flash;
+};
+
+struct Reading {
+    uint64_t t_ms;
+    int32_t values[SAMPLE_HISTORY_CHANNELS];
+};
+
+static double now_us()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static Reading make_reading(const SensorSignal &signal, uint64_t t_ms, SensorData *data)
+{
+    SensorTruth truth = signal.at((t_ms - START_MS) * 1000);
+    data->temperature = truth.temperature;
+    data->humidity = truth.humidity;
+    data->pressure = truth.pressure;
+    data->temp_valid = data->humidity_valid = data->pressure_valid = true;
+    Reading r;
+    r.t_ms = t_ms;
+    r.values[SAMPLE_HISTORY_TEMPERATURE] = series_scale(data->temperature);
+    r.values[SAMPLE_HISTORY_HUMIDITY] = series_scale(data->humidity);
+    r.values[SAMPLE_HISTORY_PRESSURE] = series_scale(data->pressure);
+    r.values[SAMPLE_HISTORY_VALID] = 7;
+    return r;
+}
+
+// Decodes everything the store returns for [from, to]; false if a block
+// does not decode or times go backwards
+static bool collect(uint64_t from_ms, uint64_t to_ms, std::vector<Reading> &out, uint32_t *records)
+{
+    static uint8_t block[HISTORY_STORE_BLOCK_SIZE];
+    HistoryCursor cursor;
+    HistoryRecordInfo info;
+    history_store_find(&cursor, from_ms, to_ms);
+    bool ok = true;
+    *records = 0;
+    while (history_store_next(&cursor, &info, block)) {
+        (*records)++;
+        SeriesDecoder dec;
+        Reading r;
+        uint32_t offset_ms;
+        ok = series_decoder_init(&dec, block, info.size) && ok;
+        uint16_t decoded = 0;
+        while (series_decoder_next(&dec, &offset_ms, r.values)) {
+            r.t_ms = info.first_ms + offset_ms;
+            decoded++;
+            if (!out.empty() && r.t_ms <= out.back().t_ms) {
+                ok = false;
+            }
+            if (r.t_ms >= from_ms && r.t_ms <= to_ms) {
+                out.push_back(r);
+            }
+        }
+        ok = ok && decoded == info.count;
+    }
+    return ok;
+}
+
+static bool same(const Reading &a, const Reading &b)
+{
+    return a.t_ms == b.t_ms && memcmp(a.values, b.values, sizeof(a.values)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--days") && has_value) {
+            options.days = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval-ms") && has_value) {
+            options.interval_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--flash-kb") && has_value) {
+            options.flash_kb = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--queries") && has_value) {
+            options.queries = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--window-s") && has_value) {
+            options.window_s = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--power-cuts") && has_value) {
+            options.power_cuts = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--signal") && has_value) {
+            options.signal = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && has_value) {
+            options.trace = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.days <= 0 || options.interval_ms <= 0 || options.flash_kb < 8 || options.flash_kb % 4 ||
+            options.queries < 0 || options.window_s <= 0 || options.power_cuts < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string error;
+    SensorSignal *signal = options.trace ? sensor_signal_from_trace(options.trace, error)
+                                         : sensor_signal_from_spec(options.signal, error);
+    if (!signal) {
+        fprintf(stderr, "history_store_bench: %s\n", error.c_str());
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("history_store_bench");
+    if (!out) {
+        return 1;
+    }
+
+    FlashBlockDevice flash((bd_size_t)options.flash_kb * 1024, SECTOR_SIZE, 1);
+    CountingBlockDevice device(flash);
+    bool ok = true;
+
+    // --- append ---
+    double start = now_us();
+    bool mounted = history_store_init(&device);
+    double mount_us = now_us() - start;
+    if (!mounted) {
+        fprintf(stderr, "history_store_bench: the store does not fit %d KB\n", options.flash_kb);
+        return 2;
+    }
+    uint64_t count = (uint64_t)options.days * 86400000ull / options.interval_ms;
+    std::vector<Reading> readings;
+    readings.reserve(count);
+    double add_us = 0, worst_add_us = 0;
+    uint64_t durable_ms = 0;    // newest reading in a programmed record
+    device.reset();
+    for (uint64_t i = 0; i < count; i++) {
+        SensorData data;
+        readings.push_back(make_reading(*signal, START_MS + i * options.interval_ms, &data));
+        uint32_t flushes = history_store_get_stats().flushes;
+        start = now_us();
+        ok = history_store_add(readings.back().t_ms, data) && ok;
+        double took = now_us() - start;
+        if (history_store_get_stats().flushes != flushes) {
+            durable_ms = readings[i - 1].t_ms;
+        }
+        add_us += took;
+        worst_add_us = std::max(worst_add_us, took);
+    }
+    HistoryStoreStats stats = history_store_get_stats();
+    uint32_t max_erases = flash.max_erase_count();
+    double mean_erases = (double)flash.total_erases() / (flash.size() / SECTOR_SIZE);
+    fprintf(out, "{\"phase\":\"append\",\"readings\":%llu,\"days\":%d,\"flash_kb\":%d,\"segments\":%u,"
+            "\"segment_size\":%u,\"records\":%u,\"flushes\":%u,\"erases\":%u,\"programmed_bytes\":%llu,"
+            "\"bytes_per_reading\":%.2f,\"held_days\":%.2f,\"host_us_per_add\":%.3f,\"host_worst_add_us\":%.1f,"
+            "\"max_sector_erases\":%u,\"mean_sector_erases\":%.2f,\"board_flash_ms_per_day\":%.1f,"
+            "\"mount_us\":%.0f}\n",
+            (unsigned long long)count, options.days, options.flash_kb, stats.segments, stats.segment_size,
+            stats.records, stats.flushes, stats.erases, (unsigned long long)stats.programmed_bytes,
+            (double)stats.programmed_bytes / count, (stats.newest_ms - stats.oldest_ms) / 86400000.0,
+            add_us / count, worst_add_us, max_erases, mean_erases, device.flash_us() / 1000.0 / options.days,
+            mount_us);
+
+    // --- query ---
+    // Readings still held start at oldest_ms
+    size_t held_from = std::lower_bound(readings.begin(), readings.end(), stats.oldest_ms,
+                                        [](const Reading &r, uint64_t t) { return r.t_ms < t; }) - readings.begin();
+    srand(1);
+    double query_us = 0, worst_query_us = 0, board_us = 0, worst_board_us = 0;
+    uint64_t query_records = 0, query_bytes = 0, returned = 0;
+    uint32_t wrong = 0;
+    uint64_t window_ms = (uint64_t)options.window_s * 1000;
+    for (int q = 0; q < options.queries; q++) {
+        uint64_t span = stats.newest_ms - stats.oldest_ms;
+        uint64_t from = stats.oldest_ms + (span > window_ms ? (uint64_t)rand() * (uint64_t)rand() % (span - window_ms) : 0);
+        uint64_t to = from + window_ms;
+        std::vector<Reading> got;
+        uint32_t records;
+        device.reset();
+        start = now_us();
+        bool decoded = collect(from, to, got, &records);
+        double took = now_us() - start;
+        query_us += took;
+        worst_query_us = std::max(worst_query_us, took);
+        board_us += device.flash_us();
+        worst_board_us = std::max(worst_board_us, device.flash_us());
+        query_records += records;
+        query_bytes += device.read_bytes;
+        returned += got.size();
+
+        size_t first = std::lower_bound(readings.begin() + held_from, readings.end(), from,
+                                        [](const Reading &r, uint64_t t) { return r.t_ms < t; }) - readings.begin();
+        size_t last = std::upper_bound(readings.begin() + held_from, readings.end(), to,
+                                       [](uint64_t t, const Reading &r) { return t < r.t_ms; }) - readings.begin();
+        bool match = decoded && got.size() == last - first;
+        for (size_t i = 0; match && i < got.size(); i++) {
+            match = same(got[i], readings[first + i]);
+        }
+        wrong += !match;
+    }
+    int queries = options.queries > 0 ? options.queries : 1;
+    fprintf(out, "{\"phase\":\"query\",\"queries\":%d,\"window_s\":%d,\"readings_per_query\":%.1f,"
+            "\"records_per_query\":%.1f,\"bytes_read_per_query\":%.0f,\"host_us_per_query\":%.1f,"
+            "\"host_worst_us\":%.1f,\"board_flash_ms_per_query\":%.2f,\"board_flash_worst_ms\":%.2f,"
+            "\"wrong\":%u}\n",
+            options.queries, options.window_s, (double)returned / queries, (double)query_records / queries,
+            (double)query_bytes / queries, query_us / queries, worst_query_us, board_us / queries / 1000.0,
+            worst_board_us / 1000.0, wrong);
+    ok = ok && wrong == 0;
+
+    // --- power_loss ---
+    // Carry on from where the append phase stopped. Each cut lands somewhere
+    // in the next few records, segment erases and headers included. The
+    // readings in RAM and in a torn record are lost; everything in records
+    // completed before the cut must come back, and nothing else.
+    std::vector<char> lost(readings.size(), 0);
+    uint64_t t_ms = readings.back().t_ms;
+    uint32_t cuts = 0, bad_mounts = 0, torn_held = 0;
+    uint64_t lost_readings = 0;
+    double remount_us = 0;
+    for (int c = 0; c < options.power_cuts; c++) {
+        flash.cut_power_after(rand() % (8 * (HISTORY_STORE_BLOCK_SIZE + 32)));
+        while (!flash.power_was_cut()) {
+            SensorData data;
+            t_ms += options.interval_ms;
+            readings.push_back(make_reading(*signal, t_ms, &data));
+            lost.push_back(0);
+            uint32_t flushes = history_store_get_stats().flushes;
+            history_store_add(t_ms, data);
+            if (history_store_get_stats().flushes != flushes && !flash.power_was_cut()) {
+                // The block before this reading is on flash
+                durable_ms = readings[readings.size() - 2].t_ms;
+            }
+        }
+        cuts++;
+        for (size_t i = readings.size(); i-- > 0 && readings[i].t_ms > durable_ms && !lost[i];) {
+            lost[i] = 1;
+            lost_readings++;
+        }
+
+        start = now_us();
+        history_store_init(&device);
+        remount_us += now_us() - start;
+        HistoryStoreStats after = history_store_get_stats();
+        torn_held = after.torn_records;
+        std::vector<Reading> got;
+        uint32_t records;
+        bool match = collect(after.oldest_ms, UINT64_MAX, got, &records) && after.newest_ms == durable_ms;
+        size_t next = std::lower_bound(readings.begin(), readings.end(), after.oldest_ms,
+                                       [](const Reading &r, uint64_t t) { return r.t_ms < t; }) - readings.begin();
+        for (size_t i = 0; match && i < got.size(); i++, next++) {
+            while (next < readings.size() && lost[next]) {
+                next++;
+            }
+            match = next < readings.size() && same(got[i], readings[next]);
+        }
+        while (match && next < readings.size() && lost[next]) {
+            next++;
+        }
+        match = match && next == readings.size();
+        bad_mounts += !match;
+    }
+    fprintf(out, "{\"phase\":\"power_loss\",\"cuts\":%u,\"torn_records_held\":%u,\"lost_readings\":%llu,"
+            "\"lost_per_cut\":%.1f,\"host_us_per_mount\":%.0f,\"bad_mounts\":%u}\n",
+            cuts, torn_held, (unsigned long long)lost_readings, cuts ? (double)lost_readings / cuts : 0.0,
+            cuts ? remount_us / cuts : 0.0, bad_mounts);
+    ok = ok && bad_mounts == 0;
+
+    fprintf(out, "{\"summary\":true,\"ok\":%s}\n", ok ? "true" : "false");
+    fflush(out);
+    delete signal;
+    return ok ? 0 : 1;
+}
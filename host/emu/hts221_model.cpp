@@ -0,0 +1,208 @@
+#include "hts221_model.h"
+
+#include <math.h>
+
+#include "HTS221_driver.h"
+
+// Calibration programmed into the model. Same shape as a real part: two
+// points per channel, temperatures in 1/8 degC, humidity in 1/2 %rH.
+#define CAL_T0_DEGC_X8   160   // 20 degC
+#define CAL_T1_DEGC_X8   280   // 35 degC
+#define CAL_T0_OUT       300
+#define CAL_T1_OUT       1000
+#define CAL_H0_RH_X2     66    // 33 %rH
+#define CAL_H1_RH_X2     150   // 75 %rH
+#define CAL_H0_T0_OUT    0
+#define CAL_H1_T0_OUT    8000
+
+// One-shot conversion time. The real figure depends on AV_CONF; the model
+// uses a single typical value.
+#define ONE_SHOT_CONVERSION_US 4500
+
+static void put16(uint8_t *regs, uint8_t reg, int value)
+{
+    regs[reg] = (uint8_t)(value & 0xFF);
+    regs[reg + 1] = (uint8_t)((value >> 8) & 0xFF);
+}
+
+static int16_t to_counts(float value, float x0, float x1, int out0, int out1)
+{
+    float counts = out0 + (value - x0) * (float)(out1 - out0) / (x1 - x0);
+    counts = roundf(counts);
+    if (counts > 32767.0f) {
+        counts = 32767.0f;
+    } else if (counts < -32768.0f) {
+        counts = -32768.0f;
+    }
+    return (int16_t)counts;
+}
+
+HTS221Model::HTS221Model(const SensorSignal &signal) : _signal(signal), _now_us(0)
+{
+    reset();
+}
+
+float HTS221Model::temperature_lsb()
+{
+    return (CAL_T1_DEGC_X8 - CAL_T0_DEGC_X8) / 8.0f / (float)(CAL_T1_OUT - CAL_T0_OUT);
+}
+
+float HTS221Model::humidity_lsb()
+{
+    return (CAL_H1_RH_X2 - CAL_H0_RH_X2) / 2.0f / (float)(CAL_H1_T0_OUT - CAL_H0_T0_OUT);
+}
+
+void HTS221Model::reset()
+{
+    for (int i = 0; i < 256; i++) {
+        _regs[i] = 0;
+    }
+    _regs[HTS221_WHO_AM_I_REG] = HTS221_WHO_AM_I_VAL;
+    _regs[HTS221_AV_CONF_REG] = 0x1B;
+
+    _regs[HTS221_H0_RH_X2] = CAL_H0_RH_X2;
+    _regs[HTS221_H1_RH_X2] = CAL_H1_RH_X2;
+    _regs[HTS221_T0_DEGC_X8] = CAL_T0_DEGC_X8 & 0xFF;
+    _regs[HTS221_T1_DEGC_X8] = CAL_T1_DEGC_X8 & 0xFF;
+    _regs[HTS221_T0_T1_DEGC_H2] = ((CAL_T0_DEGC_X8 >> 8) & 0x03) | (((CAL_T1_DEGC_X8 >> 8) & 0x03) << 2);
+    put16(_regs, HTS221_H0_T0_OUT_L, CAL_H0_T0_OUT);
+    put16(_regs, HTS221_H1_T0_OUT_L, CAL_H1_T0_OUT);
+    put16(_regs, HTS221_T0_OUT_L, CAL_T0_OUT);
+    put16(_regs, HTS221_T1_OUT_L, CAL_T1_OUT);
+
+    _next_conversion_us = 0;
+    _one_shot_pending = false;
+    _one_shot_due_us = 0;
+    _conversions = 0;
+    _humidity[0] = _humidity[1] = 0;
+    _temperature[0] = _temperature[1] = 0;
+    _humidity_held = false;
+    _temperature_held = false;
+}
+
+uint64_t HTS221Model::period_us() const
+{
+    switch (_regs[HTS221_CTRL_REG1] & HTS221_ODR_MASK) {
+        case HTS221_ODR_1HZ:
+            return 1000000;
+        case HTS221_ODR_7HZ:
+            return 142857;
+        case HTS221_ODR_12_5HZ:
+            return 80000;
+        default:
+            return 0;
+    }
+}
+
+void HTS221Model::convert(uint64_t t_us)
+{
+    SensorTruth truth = _signal.at(t_us);
+    int16_t h = to_counts(truth.humidity, CAL_H0_RH_X2 / 2.0f, CAL_H1_RH_X2 / 2.0f, CAL_H0_T0_OUT, CAL_H1_T0_OUT);
+    int16_t t = to_counts(truth.temperature, CAL_T0_DEGC_X8 / 8.0f, CAL_T1_DEGC_X8 / 8.0f, CAL_T0_OUT, CAL_T1_OUT);
+    _humidity[0] = (uint8_t)(h & 0xFF);
+    _humidity[1] = (uint8_t)((h >> 8) & 0xFF);
+    _temperature[0] = (uint8_t)(t & 0xFF);
+    _temperature[1] = (uint8_t)((t >> 8) & 0xFF);
+
+    bool bdu = _regs[HTS221_CTRL_REG1] & HTS221_BDU_MASK;
+    if (!bdu || !_humidity_held) {
+        _regs[HTS221_HR_OUT_L_REG] = _humidity[0];
+        _regs[HTS221_HR_OUT_H_REG] = _humidity[1];
+    }
+    if (!bdu || !_temperature_held) {
+        _regs[HTS221_TEMP_OUT_L_REG] = _temperature[0];
+        _regs[HTS221_TEMP_OUT_H_REG] = _temperature[1];
+    }
+    _regs[HTS221_STATUS_REG] |= HTS221_HDA_MASK | HTS221_TDA_MASK;
+    _conversions++;
+}
+
+void HTS221Model::tick(uint64_t now_us)
+{
+    _now_us = now_us;
+    if (!(_regs[HTS221_CTRL_REG1] & HTS221_PD_MASK)) {
+        return;
+    }
+
+    uint64_t period = period_us();
+    if (period) {
+        // Only the latest conversion is observable, so skip whole periods
+        if (_next_conversion_us + period < now_us) {
+            _next_conversion_us += (now_us - _next_conversion_us) / period * period - period;
+        }
+        while (_next_conversion_us <= now_us) {
+            convert(_next_conversion_us);
+            _next_conversion_us += period;
+        }
+    }
+
+    if (_one_shot_pending && _one_shot_due_us <= now_us) {
+        convert(_one_shot_due_us);
+        _one_shot_pending = false;
+        _regs[HTS221_CTRL_REG2] &= ~HTS221_ONE_SHOT_MASK;
+    }
+}
+
+uint8_t HTS221Model::select(uint8_t sub_address, bool &increment)
+{
+    increment = sub_address & 0x80;
+    return sub_address & 0x7F;
+}
+
+uint8_t HTS221Model::read_register(uint8_t reg)
+{
+    uint8_t value = _regs[reg];
+    switch (reg) {
+        case HTS221_HR_OUT_L_REG:
+            _humidity_held = true;
+            break;
+        case HTS221_HR_OUT_H_REG:
+            _humidity_held = false;
+            _regs[HTS221_HR_OUT_L_REG] = _humidity[0];
+            _regs[HTS221_HR_OUT_H_REG] = _humidity[1];
+            _regs[HTS221_STATUS_REG] &= ~HTS221_HDA_MASK;
+            break;
+        case HTS221_TEMP_OUT_L_REG:
+            _temperature_held = true;
+            break;
+        case HTS221_TEMP_OUT_H_REG:
+            _temperature_held = false;
+            _regs[HTS221_TEMP_OUT_L_REG] = _temperature[0];
+            _regs[HTS221_TEMP_OUT_H_REG] = _temperature[1];
+            _regs[HTS221_STATUS_REG] &= ~HTS221_TDA_MASK;
+            break;
+        default:
+            break;
+    }
+    return value;
+}
+
+void HTS221Model::write_register(uint8_t reg, uint8_t value)
+{
+    switch (reg) {
+        case HTS221_AV_CONF_REG:
+        case HTS221_CTRL_REG3:
+            _regs[reg] = value;
+            break;
+        case HTS221_CTRL_REG1: {
+            uint8_t old = _regs[reg];
+            _regs[reg] = value;
+            // Power-up or a new rate restarts the conversion schedule
+            if ((old ^ value) & (HTS221_PD_MASK | HTS221_ODR_MASK)) {
+                _next_conversion_us = _now_us + period_us();
+            }
+            break;
+        }
+        case HTS221_CTRL_REG2:
+            // BOOT reloads the calibration, which never changes here
+            _regs[reg] = value & ~HTS221_BOOT_MASK;
+            if ((value & HTS221_ONE_SHOT_MASK) && (_regs[HTS221_CTRL_REG1] & HTS221_PD_MASK)) {
+                _one_shot_pending = true;
+                _one_shot_due_us = _now_us + ONE_SHOT_CONVERSION_US;
+            }
+            break;
+        default:
+            // Read-only or reserved
+            break;
+    }
+}
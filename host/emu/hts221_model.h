@@ -0,0 +1,57 @@
+/* Register-level model of the HTS221 humidity/temperature sensor.
+ *
+ * Covers what the ST driver uses: WHO_AM_I, AV_CONF, CTRL_REG1..3, the
+ * factory calibration block (0x30-0x3F), STATUS_REG and the output
+ * registers. Conversions happen at the ODR selected in CTRL_REG1 (or once per
+ * ONE_SHOT request) and sample the attached signal at the conversion time.
+ * Multi-byte accesses auto-increment only when bit 7 of the sub-address is
+ * set; with BDU enabled an output pair is frozen between reading its low and
+ * high byte, and T_DA/H_DA clear when the high byte is read.
+ */
+#ifndef HTS221_MODEL_H
+#define HTS221_MODEL_H
+
+#include "register_device.h"
+#include "sensor_signal.h"
+
+class HTS221Model : public RegisterDevice {
+public:
+    explicit HTS221Model(const SensorSignal &signal);
+
+    void tick(uint64_t now_us) override;
+
+    /** Conversions completed since construction */
+    uint32_t conversions() const
+    {
+        return _conversions;
+    }
+
+    /** Resolution of one output LSB in the model's calibration */
+    static float temperature_lsb();
+    static float humidity_lsb();
+
+protected:
+    uint8_t select(uint8_t sub_address, bool &increment) override;
+    uint8_t read_register(uint8_t reg) override;
+    void write_register(uint8_t reg, uint8_t value) override;
+
+private:
+    void reset();
+    void convert(uint64_t t_us);
+    uint64_t period_us() const;
+
+    const SensorSignal &_signal;
+    uint64_t _now_us;
+    uint64_t _next_conversion_us;
+    uint64_t _one_shot_due_us;
+    bool _one_shot_pending;
+    uint32_t _conversions;
+
+    // Latest conversion, copied to the output registers unless BDU holds them
+    uint8_t _humidity[2];
+    uint8_t _temperature[2];
+    bool _humidity_held;
+    bool _temperature_held;
+};
+
+#endif // HTS221_MODEL_H
@@ -0,0 +1,98 @@
+#include "i2c_bus_emulator.h"
+
+I2CBusEmulator::I2CBusEmulator(int hz)
+    : _hz(hz > 0 ? hz : 100000), _in_transaction(false), _now_ns(0)
+{
+    reset_stats();
+}
+
+void I2CBusEmulator::add_device(uint8_t address, I2CDeviceModel *model)
+{
+    _devices[address & 0xFE] = model;
+}
+
+void I2CBusEmulator::frequency(int hz)
+{
+    if (hz > 0) {
+        _hz = hz;
+    }
+}
+
+void I2CBusEmulator::advance_us(uint64_t us)
+{
+    _now_ns += us * 1000;
+}
+
+void I2CBusEmulator::reset_stats()
+{
+    _stats.transfers = 0;
+    _stats.transactions = 0;
+    _stats.bytes = 0;
+    _stats.nacks = 0;
+    _stats.bus_ns = 0;
+}
+
+// Bus time is counted in SCL periods: one for a (repeated) START, nine per
+// byte including the address byte (8 data bits + ACK) and one for the STOP.
+// Clock stretching and the controller's own latency are not modelled.
+I2CDeviceModel *I2CBusEmulator::begin_transfer(int address, int length, bool repeated)
+{
+    if (!_in_transaction) {
+        _stats.transactions++;
+    }
+    _stats.transfers++;
+
+    std::map<uint8_t, I2CDeviceModel *>::iterator it = _devices.find((uint8_t)(address & 0xFE));
+    uint64_t bits = 1 + 9;
+    I2CDeviceModel *model = nullptr;
+    if (it != _devices.end()) {
+        model = it->second;
+        bits += 9 * (uint64_t)length;
+    } else {
+        // Address NACKed: the master issues STOP straight away
+        repeated = false;
+    }
+    if (!repeated) {
+        bits++;
+    }
+    _in_transaction = repeated;
+
+    uint64_t ns = bits * 1000000000ull / (uint64_t)_hz;
+    _stats.bus_ns += ns;
+    _now_ns += ns;
+
+    if (model) {
+        model->tick(now_us());
+    } else {
+        _stats.nacks++;
+    }
+    return model;
+}
+
+int I2CBusEmulator::read(int address, char *data, int length, bool repeated)
+{
+    I2CDeviceModel *model = begin_transfer(address, length, repeated);
+    if (!model) {
+        return -1;
+    }
+    _stats.bytes += length;
+    if (!model->on_read((uint8_t *)data, length)) {
+        _stats.nacks++;
+        return -1;
+    }
+    return 0;
+}
+
+int I2CBusEmulator::write(int address, const char *data, int length, bool repeated)
+{
+    I2CDeviceModel *model = begin_transfer(address, length, repeated);
+    if (!model) {
+        return -1;
+    }
+    _stats.bytes += length;
+    if (!model->on_write((const uint8_t *)data, length)) {
+        _stats.nacks++;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/* Emulated I2C bus for the host build.
+ *
+ * Attached with host_i2c_attach(), it receives every mbed::I2C transfer the
+ * drivers make, hands it to the device model registered at that address and
+ * keeps count of what went over the wire. Time on the bus is simulated: each
+ * transfer advances a clock by the time the bytes would take at the
+ * configured SCL frequency, and tools move the clock forward explicitly to
+ * model time spent between reads. Device models see that clock, so data-ready
+ * flags and FIFOs fill at their configured output data rate.
+ */
+#ifndef I2C_BUS_EMULATOR_H
+#define I2C_BUS_EMULATOR_H
+
+#include <stdint.h>
+#include <map>
+
+#include "host_bus.h"
+
+/** A slave on the emulated bus */
+class I2CDeviceModel {
+public:
+    virtual ~I2CDeviceModel() {}
+
+    /** Bring internal state (conversions, FIFO) up to simulated time @p now_us */
+    virtual void tick(uint64_t now_us) = 0;
+
+    /** Bytes written by the master after the address byte. false NACKs. */
+    virtual bool on_write(const uint8_t *data, int length) = 0;
+
+    /** Bytes clocked out to the master. false NACKs. */
+    virtual bool on_read(uint8_t *data, int length) = 0;
+};
+
+struct I2CBusStats {
+    uint32_t transfers;     // read()/write() calls, i.e. address phases
+    uint32_t transactions;  // START ... STOP sequences
+    uint32_t bytes;         // data bytes, excluding address bytes
+    uint32_t nacks;         // transfers refused by the addressed device
+    uint64_t bus_ns;        // simulated time the bus was busy
+};
+
+class I2CBusEmulator : public HostI2CBus {
+public:
+    explicit I2CBusEmulator(int hz = 100000);
+
+    /** Register @p model at the 8-bit address @p address (R/W bit ignored) */
+    void add_device(uint8_t address, I2CDeviceModel *model);
+
+    // HostI2CBus
+    void frequency(int hz) override;
+    int read(int address, char *data, int length, bool repeated) override;
+    int write(int address, const char *data, int length, bool repeated) override;
+
+    /** Move simulated time forward without bus traffic */
+    void advance_us(uint64_t us);
+
+    uint64_t now_us() const
+    {
+        return _now_ns / 1000;
+    }
+
+    int hz() const
+    {
+        return _hz;
+    }
+
+    const I2CBusStats &stats() const
+    {
+        return _stats;
+    }
+
+    void reset_stats();
+
+private:
+    I2CDeviceModel *begin_transfer(int address, int length, bool repeated);
+
+    std::map<uint8_t, I2CDeviceModel *> _devices;
+    int _hz;
+    bool _in_transaction;
+    uint64_t _now_ns;
+    I2CBusStats _stats;
+};
+
+#endif // I2C_BUS_EMULATOR_H
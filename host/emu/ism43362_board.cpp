@@ -0,0 +1,14 @@
+#include "ism43362_emulator.h"
+
+ISM43362Emulator &ism43362_board_module()
+{
+    static ISM43362Emulator emulator(MBED_CONF_ISM43362_WIFI_NSS, MBED_CONF_ISM43362_WIFI_RESET,
+                                     MBED_CONF_ISM43362_WIFI_DATAREADY);
+    return emulator;
+}
+
+// Overrides the shim's empty default for every tool that uses the module
+void host_board_setup()
+{
+    ism43362_board_module().attach();
+}
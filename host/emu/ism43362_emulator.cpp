@@ -0,0 +1,492 @@
+#include "ism43362_emulator.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+// Identity the driver parses: the second field is the firmware revision
+#define EMU_FIRMWARE "ISM43362-M3G-L44-SPI,C3.5.2.5.STM,v3.5.2,v1.4.0.rc1,v8.2.1,120000000,Inventek eS-WiFi"
+#define EMU_MAC "C4:7F:51:01:12:31"
+#define EMU_IP "192.168.29.120"
+#define EMU_NETMASK "255.255.255.0"
+#define EMU_GATEWAY "192.168.29.1"
+#define EMU_RSSI "-52"
+
+#define EMU_MAX_RX_PACKET 1200
+#define EMU_CONNECT_TIMEOUT_MS 3000
+
+ISM43362Emulator::ISM43362Emulator(PinName nss, PinName reset, PinName dataready)
+    : _nss(nss), _reset(reset), _dataready(dataready), _state(OFF), _hz(1000000), _tx_pos(0),
+      _check_ap(false), _ap_bssid("A4:2B:B0:10:20:30"), _ap_channel(6), _scan_next(0), _link_up(true), _latency_us(0), _join_delay_ms(0), _security(0), _joined(false), _active(0)
+{
+    for (int i = 0; i < ISM43362_EMU_SOCKETS; i++) {
+        _sockets[i].fd = -1;
+        stop_client(_sockets[i]);
+    }
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+ISM43362Emulator::~ISM43362Emulator()
+{
+    for (int i = 0; i < ISM43362_EMU_SOCKETS; i++) {
+        stop_client(_sockets[i]);
+    }
+}
+
+void ISM43362Emulator::attach()
+{
+    host_spi_attach(this);
+    host_gpio_listen(this);
+    host_gpio_set(_dataready, 0);
+}
+
+void ISM43362Emulator::detach()
+{
+    host_spi_attach(nullptr);
+    host_gpio_listen(nullptr);
+}
+
+void ISM43362Emulator::set_access_point(const char *ssid, const char *password)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _check_ap = ssid != nullptr;
+    _ap_ssid = ssid ? ssid : "";
+    _ap_password = password ? password : "";
+}
+
+void ISM43362Emulator::redirect(const char *addr, uint16_t port, const char *to_addr, uint16_t to_port)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Redirect r = {addr, port, to_addr, to_port};
+    _redirects.push_back(r);
+}
+
+void ISM43362Emulator::set_access_point_radio(const char *bssid, int channel)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _ap_bssid = bssid;
+    _ap_channel = channel;
+}
+
+void ISM43362Emulator::set_link_up(bool up)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _link_up = up;
+    if (!up) {
+        _joined = false;
+        for (int i = 0; i < ISM43362_EMU_SOCKETS; i++) {
+            if (_sockets[i].fd >= 0) {
+                ::close(_sockets[i].fd);
+                _sockets[i].fd = -1;
+                _sockets[i].closed_by_peer = true;
+            }
+        }
+    }
+}
+
+ISM43362Stats ISM43362Emulator::stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void ISM43362Emulator::reset_stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void ISM43362Emulator::format(int bits, int mode)
+{
+}
+
+void ISM43362Emulator::frequency(int hz)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hz = hz > 0 ? hz : 1;
+}
+
+int ISM43362Emulator::transfer(int value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.frames++;
+    _stats.bus_ns += 16ULL * 1000000000ULL / (uint64_t)_hz;
+
+    if (_state == RECEIVING) {
+        _rx.push_back((char)(value & 0xFF));
+        _rx.push_back((char)((value >> 8) & 0xFF));
+        return 0;
+    }
+    if (_state != READING) {
+        return 0x1515;
+    }
+
+    int word = 0x1515;
+    if (_tx_pos + 1 < _tx.size()) {
+        word = (uint8_t)_tx[_tx_pos] | ((uint8_t)_tx[_tx_pos + 1] << 8);
+        _tx_pos += 2;
+    }
+    if (_tx_pos + 1 >= _tx.size()) {
+        // Last word out: the host stops clocking when the line drops
+        host_gpio_set(_dataready, 0);
+    }
+    return word;
+}
+
+void ISM43362Emulator::pin_written(int pin, int value)
+{
+    if (pin != _nss && pin != _reset) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (pin == _reset) {
+        if (!value) {
+            _state = OFF;
+            host_gpio_set(_dataready, 0);
+        } else if (_state == OFF) {
+            boot();
+        }
+        return;
+    }
+
+    if (_state == OFF) {
+        return;
+    }
+    if (!value) {
+        _stats.transactions++;
+        if (_state == READY) {
+            _rx.clear();
+            _state = RECEIVING;
+            host_gpio_set(_dataready, 0);
+        } else if (_state == RESPONDING) {
+            _state = READING;
+        }
+        return;
+    }
+
+    if (_state == RECEIVING) {
+        if (_rx.empty()) {
+            _state = READY;
+            host_gpio_set(_dataready, 1);
+            return;
+        }
+        process(_rx);
+        if (_latency_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(_latency_us));
+        }
+        _state = RESPONDING;
+        host_gpio_set(_dataready, 1);
+    } else if (_state == READING) {
+        if (_tx_pos + 1 >= _tx.size()) {
+            _state = READY;
+            host_gpio_set(_dataready, 1);
+        } else {
+            _state = RESPONDING;
+        }
+    }
+}
+
+void ISM43362Emulator::boot()
+{
+    _joined = false;
+    _active = 0;
+    for (int i = 0; i < ISM43362_EMU_SOCKETS; i++) {
+        stop_client(_sockets[i]);
+    }
+    _tx = "\r\n> ";
+    _tx_pos = 0;
+    _state = RESPONDING;
+    host_gpio_set(_dataready, 1);
+}
+
+void ISM43362Emulator::respond(const std::string &data, bool ok)
+{
+    _tx = "\r\n";
+    _tx += data;
+    if (!data.empty()) {
+        _tx += "\r\n";
+    }
+    _tx += ok ? "OK\r\n> " : "ERROR\r\n> ";
+    if (_tx.size() & 1) {
+        _tx.push_back(0x15);
+    }
+    _tx_pos = 0;
+    if (!ok) {
+        _stats.errors++;
+    }
+}
+
+std::string ISM43362Emulator::scan_entry(int index) const
+{
+    // #index,"SSID",BSSID,RSSI,rate,type,security,band,channel; one AP, and
+    // none while it is down
+    if (index != 0 || !_link_up) {
+        return "";
+    }
+    const std::string &ssid = _check_ap ? _ap_ssid : (_ssid.empty() ? std::string("EMU-AP") : _ssid);
+    return "#001,\"" + ssid + "\"," + _ap_bssid + "," EMU_RSSI ",72.2,Infrastructure,WPA2 AES,2.4GHz," +
+           std::to_string(_ap_channel);
+}
+
+std::string ISM43362Emulator::status_line() const
+{
+    // SSID,Password,Security,DHCP,IPVersion,IP,Mask,Gateway,DNS1,DNS2,...
+    std::string line = _ssid + "," + _password + "," + std::to_string(_security) + ",1,0,";
+    line += _joined ? EMU_IP "," EMU_NETMASK "," EMU_GATEWAY "," EMU_GATEWAY
+                    : "0.0.0.0,0.0.0.0,0.0.0.0,0.0.0.0";
+    line += ",0.0.0.0,5,0,0,US,";
+    line += _joined ? "1" : "0";
+    return line;
+}
+
+void ISM43362Emulator::process(const std::string &raw)
+{
+    _stats.commands++;
+
+    // S3 carries its payload in the same transaction: "S3=<n>\r<data>"
+    if (raw.compare(0, 3, "S3=") == 0) {
+        size_t cr = raw.find('\r');
+        size_t length = (size_t)atoi(raw.c_str() + 3);
+        if (cr == std::string::npos || cr + 1 + length > raw.size()) {
+            respond("-1", false);
+            return;
+        }
+        send_data(raw.data() + cr + 1, length);
+        return;
+    }
+
+    std::string command = raw;
+    while (!command.empty() && (command.back() == '\n' || command.back() == '\r')) {
+        command.pop_back();
+    }
+    std::string name = command.substr(0, 2);
+    std::string arg = command.size() > 3 && command[2] == '=' ? command.substr(3) : "";
+    Socket &s = _sockets[_active];
+
+    if (name == "I?") {
+        respond(EMU_FIRMWARE, true);
+    } else if (name == "Z5") {
+        respond(EMU_MAC, true);
+    } else if (name == "C1") {
+        _ssid = arg;
+        respond("", true);
+    } else if (name == "C2") {
+        _password = arg;
+        respond("", true);
+    } else if (name == "C3") {
+        _security = atoi(arg.c_str());
+        respond("", true);
+    } else if (name == "C4" || name == "CN") {
+        respond("", true);
+    } else if (name == "C0") {
+        _stats.joins++;
+        if (_join_delay_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(_join_delay_ms));
+        }
+        if (!_link_up) {
+            respond("[JOIN   ] " + _ssid + "\r\n[JOIN   ] Failed", false);
+        } else if (_check_ap && (_ssid != _ap_ssid || _password != _ap_password)) {
+            respond("[JOIN   ] " + _ssid + "\r\n[JOIN   ] Failed", false);
+        } else {
+            _joined = true;
+            respond("[JOIN   ] " + _ssid + "," EMU_IP ",0,0", true);
+        }
+    } else if (name == "F0") {
+        // F0=2 returns one AP per command, MR the next one
+        _stats.scans++;
+        _scan_next = 0;
+        if (arg == "2") {
+            respond(scan_entry(_scan_next++), true);
+        } else {
+            std::string list;
+            for (std::string entry; !(entry = scan_entry(_scan_next++)).empty();) {
+                list += (list.empty() ? "" : "\r\n") + entry;
+            }
+            respond(list, true);
+        }
+    } else if (name == "MR") {
+        respond(scan_entry(_scan_next++), true);
+    } else if (name == "CD") {
+        _joined = false;
+        respond("", true);
+    } else if (name == "C?") {
+        respond(status_line(), true);
+    } else if (name == "CR") {
+        respond(_joined ? EMU_RSSI : "0", true);
+    } else if (name == "P0") {
+        int id = atoi(arg.c_str());
+        if (id < 0 || id >= ISM43362_EMU_SOCKETS) {
+            respond("-1", false);
+            return;
+        }
+        _active = id;
+        respond("", true);
+    } else if (name == "P1") {
+        s.protocol = atoi(arg.c_str());
+        respond("", true);
+    } else if (name == "P2") {
+        s.local_port = atoi(arg.c_str());
+        respond("", true);
+    } else if (name == "P3") {
+        s.address = arg;
+        respond("", true);
+    } else if (name == "P4") {
+        s.port = atoi(arg.c_str());
+        respond("", true);
+    } else if (name == "P5") {
+        respond("", true);
+    } else if (name == "P6") {
+        if (atoi(arg.c_str()) == 1) {
+            start_client(s);
+        } else {
+            stop_client(s);
+            respond("", true);
+        }
+    } else if (name == "R0") {
+        poll_data();
+    } else if (name == "R1") {
+        int size = atoi(arg.c_str());
+        s.read_size = size > 0 && size <= EMU_MAX_RX_PACKET ? size : EMU_MAX_RX_PACKET;
+        respond("", true);
+    } else if (name == "R2") {
+        s.read_timeout_ms = atoi(arg.c_str());
+        respond("", true);
+    } else {
+        respond("-1", false);
+    }
+}
+
+void ISM43362Emulator::start_client(Socket &s)
+{
+    stop_client(s);
+    if (!_joined || !_link_up) {
+        respond("-1", false);
+        return;
+    }
+
+    std::string addr = s.address;
+    int port = s.port;
+    for (size_t i = 0; i < _redirects.size(); i++) {
+        const Redirect &r = _redirects[i];
+        if ((r.addr == "*" || r.addr == addr) && r.port == port) {
+            addr = r.to_addr;
+            port = r.to_port;
+            break;
+        }
+    }
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, addr.c_str(), &sa.sin_addr) != 1) {
+        respond("-1", false);
+        return;
+    }
+
+    int fd = socket(AF_INET, s.protocol == 1 ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (fd < 0) {
+        respond("-1", false);
+        return;
+    }
+    if (s.protocol != 1) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    // Bounded connect, the way the module gives up on an unreachable server
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int rc = connect(fd, (struct sockaddr *)&sa, sizeof(sa));
+    if (rc < 0 && errno == EINPROGRESS) {
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (poll(&pfd, 1, EMU_CONNECT_TIMEOUT_MS) == 1 &&
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+            rc = 0;
+        }
+    }
+    if (rc < 0) {
+        ::close(fd);
+        respond("-1", false);
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+
+    s.fd = fd;
+    s.closed_by_peer = false;
+    _stats.connects++;
+    respond("", true);
+}
+
+void ISM43362Emulator::stop_client(Socket &s)
+{
+    if (s.fd >= 0) {
+        ::close(s.fd);
+    }
+    s.fd = -1;
+    s.closed_by_peer = false;
+    s.read_size = EMU_MAX_RX_PACKET;
+    s.read_timeout_ms = 1;
+}
+
+void ISM43362Emulator::send_data(const char *data, size_t length)
+{
+    Socket &s = _sockets[_active];
+    _stats.send_commands++;
+    size_t sent = 0;
+    while (s.fd >= 0 && sent < length) {
+        ssize_t n = ::send(s.fd, data + sent, length - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        sent += n;
+    }
+    if (s.fd < 0 || sent < length) {
+        respond("-1", false);
+        return;
+    }
+    _stats.send_bytes += length;
+    respond("", true);
+}
+
+void ISM43362Emulator::poll_data()
+{
+    Socket &s = _sockets[_active];
+    _stats.recv_polls++;
+    if (s.fd < 0) {
+        // Never opened, closed, or lost with the link
+        respond("-1", false);
+        return;
+    }
+
+    char buf[EMU_MAX_RX_PACKET];
+    struct pollfd pfd = {s.fd, POLLIN, 0};
+    ssize_t n = -1;
+    if (poll(&pfd, 1, s.read_timeout_ms) == 1) {
+        n = ::recv(s.fd, buf, s.read_size, MSG_DONTWAIT);
+    }
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && (pfd.revents & (POLLERR | POLLHUP)))) {
+        ::close(s.fd);
+        s.fd = -1;
+        s.closed_by_peer = true;
+        respond("-1", false);
+        return;
+    }
+    if (n < 0) {
+        _stats.empty_polls++;
+        respond("", true);
+        return;
+    }
+    _stats.recv_bytes += n;
+    respond(std::string(buf, n), true);
+}
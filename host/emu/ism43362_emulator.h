@@ -0,0 +1,161 @@
+/* Emulation of the Inventek ISM43362 (eS-WiFi) module as seen over its SPI
+ * AT interface, for running the real wifi-ism43362 driver on the host.
+ *
+ * The emulator follows the module's half-duplex handshake: CMD/DATA_READY
+ * high means "ready for a command", the host clocks the command out while
+ * NSS is low, the module raises CMD/DATA_READY again once the response is
+ * ready and drops it after the last response word has been clocked in.
+ * Responses are framed as "\r\n<data>\r\nOK\r\n> " and padded with 0x15 to
+ * a whole 16-bit word, as the firmware does.
+ *
+ * Joining an access point always succeeds unless an SSID/passphrase was
+ * configured and does not match. Module sockets are bridged to real host
+ * sockets, so P6=1 opens a TCP (or UDP) connection, S3 sends on it and R0
+ * polls it with the R1 size and R2 timeout. redirect() maps a remote
+ * address to another one, so a client configured for a LAN broker can be
+ * pointed at one on loopback.
+ */
+#ifndef ISM43362_EMULATOR_H
+#define ISM43362_EMULATOR_H
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mbed.h"
+
+#define ISM43362_EMU_SOCKETS 4
+
+struct ISM43362Stats {
+    uint32_t transactions;      // NSS low periods
+    uint64_t frames;            // 16-bit SPI frames, either direction
+    uint64_t bus_ns;            // SPI clock time for those frames
+    uint32_t commands;
+    uint32_t send_commands;     // S3
+    uint64_t send_bytes;        // payload bytes accepted by S3
+    uint32_t recv_polls;        // R0
+    uint32_t empty_polls;       // R0 with nothing to return
+    uint64_t recv_bytes;        // payload bytes returned by R0
+    uint32_t connects;          // successful P6=1
+    uint32_t joins;             // C0 commands
+    uint32_t scans;             // F0 commands
+    uint32_t errors;            // commands answered with ERROR
+};
+
+class ISM43362Emulator : public HostSPIBus, public HostGPIOListener {
+public:
+    ISM43362Emulator(PinName nss, PinName reset, PinName dataready);
+    ~ISM43362Emulator();
+
+    /** Route the shim's SPI and GPIO to this module. Safe to call from
+     *  host_board_setup(). */
+    void attach();
+    void detach();
+
+    /** Only accept C0 for this SSID/passphrase (nullptr accepts anything) */
+    void set_access_point(const char *ssid, const char *password);
+
+    /** Connections to @p addr:@p port (addr "*" matches any address) go to
+     *  @p to_addr:@p to_port instead */
+    void redirect(const char *addr, uint16_t port, const char *to_addr, uint16_t to_port);
+
+    /** Extra time the module takes to answer each command */
+    void set_command_latency_us(int us)
+    {
+        _latency_us = us;
+    }
+
+    /** Time C0 (join) takes to answer, on top of the command latency; a
+     *  real module needs several seconds to associate */
+    void set_join_delay_ms(int ms)
+    {
+        _join_delay_ms = ms;
+    }
+
+    /** BSSID and channel the access point shows in scans (F0) */
+    void set_access_point_radio(const char *bssid, int channel);
+
+    /** Take the access point away (or bring it back). While it is down
+     *  joins and connects fail and open sockets read as closed. */
+    void set_link_up(bool up);
+
+    ISM43362Stats stats();
+    void reset_stats();
+
+    void format(int bits, int mode) override;
+    void frequency(int hz) override;
+    int transfer(int value) override;
+    void pin_written(int pin, int value) override;
+
+private:
+    enum State { OFF, READY, RECEIVING, RESPONDING, READING };
+
+    struct Socket {
+        int fd;
+        int protocol;           // P1: 0 TCP, 1 UDP
+        int local_port;         // P2
+        std::string address;    // P3
+        int port;               // P4
+        int read_size;          // R1
+        int read_timeout_ms;    // R2
+        bool closed_by_peer;
+    };
+
+    struct Redirect {
+        std::string addr;
+        uint16_t port;
+        std::string to_addr;
+        uint16_t to_port;
+    };
+
+    void boot();
+    void process(const std::string &command);
+    void respond(const std::string &data, bool ok);
+    void start_client(Socket &s);
+    void stop_client(Socket &s);
+    void send_data(const char *data, size_t length);
+    void poll_data();
+    std::string status_line() const;
+    std::string scan_entry(int index) const;
+
+    std::mutex _mutex;
+    PinName _nss;
+    PinName _reset;
+    PinName _dataready;
+    State _state;
+    int _hz;
+
+    std::string _rx;
+    std::string _tx;
+    size_t _tx_pos;
+
+    std::string _ap_ssid;
+    std::string _ap_password;
+    bool _check_ap;
+    std::string _ap_bssid;
+    int _ap_channel;
+    int _scan_next;
+    bool _link_up;
+    int _latency_us;
+    int _join_delay_ms;
+
+    std::string _ssid;
+    std::string _password;
+    int _security;
+    bool _joined;
+    int _active;
+    Socket _sockets[ISM43362_EMU_SOCKETS];
+    std::vector<Redirect> _redirects;
+
+    ISM43362Stats _stats;
+};
+
+/** The module on the pins the driver is built for (MBED_CONF_ISM43362_WIFI_*).
+ *  The driver's interface is a static in network_manager.cpp and talks to
+ *  the module from its constructor, so ism43362_board.cpp also defines
+ *  host_board_setup() to attach it on first peripheral use. */
+ISM43362Emulator &ism43362_board_module();
+
+#endif // ISM43362_EMULATOR_H
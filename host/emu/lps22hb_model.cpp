@@ -0,0 +1,248 @@
+#include "lps22hb_model.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "LPS22HB_driver.h"
+
+// Not named by the driver header
+#define TEMP_OUT_H_REG      0x2C
+#define CTRL2_BOOT_MASK     0x80
+#define CTRL2_SWRESET_MASK  0x04
+
+// One-shot conversion time, typical figure for low-current mode
+#define ONE_SHOT_CONVERSION_US 10000
+
+LPS22HBModel::LPS22HBModel(const SensorSignal &signal) : _signal(signal), _now_us(0)
+{
+    reset();
+}
+
+void LPS22HBModel::reset()
+{
+    memset(_regs, 0, sizeof(_regs));
+    _regs[LPS22HB_WHO_AM_I_REG] = LPS22HB_WHO_AM_I_VAL;
+    _regs[LPS22HB_CTRL_REG2] = LPS22HB_ADD_INC_MASK;
+
+    _next_conversion_us = 0;
+    _one_shot_pending = false;
+    _one_shot_due_us = 0;
+    _conversions = 0;
+    memset(_latest, 0, sizeof(_latest));
+    _pressure_held = false;
+    _temperature_held = false;
+    flush_fifo();
+}
+
+uint64_t LPS22HBModel::period_us() const
+{
+    switch (_regs[LPS22HB_CTRL_REG1] & LPS22HB_ODR_MASK) {
+        case LPS22HB_ODR_1HZ:
+            return 1000000;
+        case LPS22HB_ODR_10HZ:
+            return 100000;
+        case LPS22HB_ODR_25HZ:
+            return 40000;
+        case LPS22HB_ODR_50HZ:
+            return 20000;
+        case LPS22HB_ODR_75HZ:
+            return 13333;
+        default:
+            return 0;
+    }
+}
+
+bool LPS22HBModel::fifo_enabled() const
+{
+    return (_regs[LPS22HB_CTRL_REG2] & LPS22HB_FIFO_EN_MASK) &&
+           (_regs[LPS22HB_CTRL_FIFO_REG] & LPS22HB_FIFO_MODE_MASK) != LPS22HB_FIFO_BYPASS_MODE;
+}
+
+void LPS22HBModel::flush_fifo()
+{
+    _fifo_head = 0;
+    _fifo_count = 0;
+    _fifo_overrun = false;
+}
+
+void LPS22HBModel::convert(uint64_t t_us)
+{
+    SensorTruth truth = _signal.at(t_us);
+
+    // 4096 LSB/hPa in 24 bits, 100 LSB/degC in 16 bits
+    double p = round((double)truth.pressure * 4096.0);
+    p = p > 8388607.0 ? 8388607.0 : (p < -8388608.0 ? -8388608.0 : p);
+    int32_t p_raw = (int32_t)p;
+    float t = roundf(truth.temperature * 100.0f);
+    t = t > 32767.0f ? 32767.0f : (t < -32768.0f ? -32768.0f : t);
+    int16_t t_raw = (int16_t)t;
+
+    _latest[0] = (uint8_t)(p_raw & 0xFF);
+    _latest[1] = (uint8_t)((p_raw >> 8) & 0xFF);
+    _latest[2] = (uint8_t)((p_raw >> 16) & 0xFF);
+    _latest[3] = (uint8_t)(t_raw & 0xFF);
+    _latest[4] = (uint8_t)((t_raw >> 8) & 0xFF);
+    _conversions++;
+
+    if (fifo_enabled()) {
+        if (_fifo_count == LPS22HB_MODEL_FIFO_DEPTH) {
+            if ((_regs[LPS22HB_CTRL_FIFO_REG] & LPS22HB_FIFO_MODE_MASK) == LPS22HB_FIFO_MODE) {
+                return; // FIFO mode stops collecting once full
+            }
+            _fifo_head = (_fifo_head + 1) % LPS22HB_MODEL_FIFO_DEPTH;
+            _fifo_count--;
+            _fifo_overrun = true;
+        }
+        int slot = (_fifo_head + _fifo_count) % LPS22HB_MODEL_FIFO_DEPTH;
+        memcpy(_fifo[slot], _latest, sizeof(_latest));
+        _fifo_count++;
+    } else {
+        bool bdu = _regs[LPS22HB_CTRL_REG1] & LPS22HB_BDU_MASK;
+        if (!bdu || !_pressure_held) {
+            memcpy(&_regs[LPS22HB_PRESS_OUT_XL_REG], &_latest[0], 3);
+        }
+        if (!bdu || !_temperature_held) {
+            memcpy(&_regs[LPS22HB_TEMP_OUT_L_REG], &_latest[3], 2);
+        }
+    }
+
+    uint8_t status = _regs[LPS22HB_STATUS_REG];
+    if (status & LPS22HB_PDA_MASK) {
+        status |= LPS22HB_POR_MASK;
+    }
+    if (status & LPS22HB_TDA_MASK) {
+        status |= LPS22HB_TOR_MASK;
+    }
+    _regs[LPS22HB_STATUS_REG] = status | LPS22HB_PDA_MASK | LPS22HB_TDA_MASK;
+}
+
+void LPS22HBModel::tick(uint64_t now_us)
+{
+    _now_us = now_us;
+
+    uint64_t period = period_us();
+    if (period) {
+        // More than a FIFO's worth of conversions cannot be told apart from
+        // exactly a FIFO's worth, so skip the rest
+        uint64_t keep = (uint64_t)(LPS22HB_MODEL_FIFO_DEPTH + 1) * period;
+        if (_next_conversion_us + keep < now_us) {
+            _regs[LPS22HB_STATUS_REG] |= LPS22HB_PDA_MASK | LPS22HB_TDA_MASK;
+            _next_conversion_us += (now_us - _next_conversion_us) / period * period - keep + period;
+        }
+        while (_next_conversion_us <= now_us) {
+            convert(_next_conversion_us);
+            _next_conversion_us += period;
+        }
+    }
+
+    if (_one_shot_pending && _one_shot_due_us <= now_us) {
+        convert(_one_shot_due_us);
+        _one_shot_pending = false;
+        _regs[LPS22HB_CTRL_REG2] &= ~LPS22HB_ONE_SHOT_MASK;
+    }
+}
+
+uint8_t LPS22HBModel::select(uint8_t sub_address, bool &increment)
+{
+    increment = _regs[LPS22HB_CTRL_REG2] & LPS22HB_ADD_INC_MASK;
+    return sub_address;
+}
+
+bool LPS22HBModel::responding() const
+{
+    return !(_regs[LPS22HB_CTRL_REG2] & LPS22HB_I2C_MASK);
+}
+
+uint8_t LPS22HBModel::read_register(uint8_t reg)
+{
+    if (reg == LPS22HB_STATUS_FIFO_REG) {
+        uint8_t wtm = _regs[LPS22HB_CTRL_FIFO_REG] & LPS22HB_WTM_POINT_MASK;
+        uint8_t value = (uint8_t)_fifo_count & LPS22HB_LEVEL_FIFO_MASK;
+        if (_fifo_overrun) {
+            value |= LPS22HB_OVR_FIFO_MASK;
+        }
+        if (_fifo_count > wtm) {
+            value |= LPS22HB_FTH_FIFO_MASK;
+        }
+        return value;
+    }
+    if (reg < LPS22HB_PRESS_OUT_XL_REG || reg > TEMP_OUT_H_REG) {
+        return _regs[reg];
+    }
+
+    bool from_fifo = fifo_enabled() && _fifo_count > 0;
+    uint8_t value = from_fifo ? _fifo[_fifo_head][reg - LPS22HB_PRESS_OUT_XL_REG] : _regs[reg];
+    switch (reg) {
+        case LPS22HB_PRESS_OUT_H_REG:
+            _pressure_held = false;
+            memcpy(&_regs[LPS22HB_PRESS_OUT_XL_REG], &_latest[0], 3);
+            _regs[LPS22HB_STATUS_REG] &= ~(LPS22HB_PDA_MASK | LPS22HB_POR_MASK);
+            break;
+        case TEMP_OUT_H_REG:
+            _temperature_held = false;
+            memcpy(&_regs[LPS22HB_TEMP_OUT_L_REG], &_latest[3], 2);
+            _regs[LPS22HB_STATUS_REG] &= ~(LPS22HB_TDA_MASK | LPS22HB_TOR_MASK);
+            if (from_fifo) {
+                _fifo_head = (_fifo_head + 1) % LPS22HB_MODEL_FIFO_DEPTH;
+                _fifo_count--;
+            }
+            break;
+        case LPS22HB_TEMP_OUT_L_REG:
+            _temperature_held = true;
+            break;
+        default:
+            _pressure_held = true;
+            break;
+    }
+    return value;
+}
+
+void LPS22HBModel::write_register(uint8_t reg, uint8_t value)
+{
+    switch (reg) {
+        case LPS22HB_CTRL_REG1: {
+            uint8_t old = _regs[reg];
+            _regs[reg] = value;
+            if ((old ^ value) & LPS22HB_ODR_MASK) {
+                _next_conversion_us = _now_us + period_us();
+            }
+            break;
+        }
+        case LPS22HB_CTRL_REG2:
+            if (value & (CTRL2_BOOT_MASK | CTRL2_SWRESET_MASK)) {
+                reset();
+                break;
+            }
+            if ((_regs[reg] & LPS22HB_FIFO_EN_MASK) && !(value & LPS22HB_FIFO_EN_MASK)) {
+                flush_fifo();
+            }
+            _regs[reg] = value;
+            if ((value & LPS22HB_ONE_SHOT_MASK) && period_us() == 0) {
+                _one_shot_pending = true;
+                _one_shot_due_us = _now_us + ONE_SHOT_CONVERSION_US;
+            }
+            break;
+        case LPS22HB_CTRL_FIFO_REG:
+            // Passing through BYPASS empties the FIFO and clears overrun
+            if ((value & LPS22HB_FIFO_MODE_MASK) == LPS22HB_FIFO_BYPASS_MODE) {
+                flush_fifo();
+            }
+            _regs[reg] = value;
+            break;
+        case LPS22HB_INTERRUPT_CFG_REG:
+        case LPS22HB_THS_P_LOW_REG:
+        case LPS22HB_THS_P_HIGH_REG:
+        case LPS22HB_CTRL_REG3:
+        case LPS22HB_REF_P_XL_REG:
+        case LPS22HB_REF_P_L_REG:
+        case LPS22HB_REF_P_H_REG:
+        case LPS22HB_RPDS_L_REG:
+        case LPS22HB_RPDS_H_REG:
+        case LPS22HB_RES_CONF_REG:
+            _regs[reg] = value;
+            break;
+        default:
+            // Read-only or reserved
+            break;
+    }
+}
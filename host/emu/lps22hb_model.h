@@ -0,0 +1,69 @@
+/* Register-level model of the LPS22HB pressure sensor.
+ *
+ * Covers WHO_AM_I, CTRL_REG1..3, FIFO_CTRL, RES_CONF, FIFO_STATUS, STATUS
+ * and the pressure/temperature output registers. Conversions run at the ODR
+ * in CTRL_REG1 or on ONE_SHOT. Address auto-increment follows IF_ADD_INC in
+ * CTRL_REG2; BDU freezes an output group between its first and last byte.
+ *
+ * The 32-slot FIFO supports BYPASS, FIFO (stop when full) and STREAM
+ * (overwrite oldest) mode; the trigger-driven modes behave as STREAM since
+ * the interrupt inputs are not modelled. While the FIFO holds data the output
+ * registers show its oldest entry, which is popped when TEMP_OUT_H is read.
+ * Setting I2C_DIS makes the device stop answering on the bus, as on the part.
+ */
+#ifndef LPS22HB_MODEL_H
+#define LPS22HB_MODEL_H
+
+#include "register_device.h"
+#include "sensor_signal.h"
+
+#define LPS22HB_MODEL_FIFO_DEPTH 32
+
+class LPS22HBModel : public RegisterDevice {
+public:
+    explicit LPS22HBModel(const SensorSignal &signal);
+
+    void tick(uint64_t now_us) override;
+
+    uint32_t conversions() const
+    {
+        return _conversions;
+    }
+
+    int fifo_level() const
+    {
+        return _fifo_count;
+    }
+
+protected:
+    uint8_t select(uint8_t sub_address, bool &increment) override;
+    bool responding() const override;
+    uint8_t read_register(uint8_t reg) override;
+    void write_register(uint8_t reg, uint8_t value) override;
+
+private:
+    void reset();
+    void convert(uint64_t t_us);
+    void flush_fifo();
+    bool fifo_enabled() const;
+    uint64_t period_us() const;
+
+    const SensorSignal &_signal;
+    uint64_t _now_us;
+    uint64_t _next_conversion_us;
+    uint64_t _one_shot_due_us;
+    bool _one_shot_pending;
+    uint32_t _conversions;
+
+    // Latest conversion in output register order: PRESS_OUT_XL..TEMP_OUT_H
+    uint8_t _latest[5];
+    bool _pressure_held;
+    bool _temperature_held;
+
+    uint8_t _fifo[LPS22HB_MODEL_FIFO_DEPTH][5];
+    int _fifo_head;
+    int _fifo_count;
+    bool _fifo_overrun;
+};
+
+#endif // LPS22HB_MODEL_H
@@ -0,0 +1,359 @@
+/* Runs the firmware's network path end to end against an emulated ISM43362
+ * and reports publish throughput, SPI cost per message and reconnect times.
+ *
+ * network_manager.cpp, mqtt_handler.cpp and the wifi-ism43362 driver are
+ * linked in unchanged; the module underneath the driver's SPI and GPIO is
+ * emulated and bridges its sockets to host TCP. Connections to the broker in
+ * config.h are redirected to an in-process broker on loopback, or to the
+ * broker given with --broker.
+ *
+ * Output is one JSON record each for network_init(), the MQTT connect, the
+ * publish run and every forced reconnect, then a summary.
+ *
+ * By default the bench calls mqtt_yield(--yield-ms) after every publish, as
+ * the main loop used to. With --event-driven a thread runs mqtt_service()
+ * the way the network thread does, woken by the socket's sigio and the keep
+ * alive timer. service_ms is the time spent in either.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "config.h"
+#include "anomaly_detector.h"
+#include "mqtt_handler.h"
+#include "network_manager.h"
+#include "temp_tracker.h"
+
+#include "ism43362_emulator.h"
+#include "mqtt_test_broker.h"
+#include "tool_common.h"
+
+struct BenchOptions {
+    int messages = 200;
+    int interval_ms = 0;
+    int yield_ms = 0;
+    int reconnects = 3;
+    int latency_us = 0;
+    int timeout_ms = 10000;
+    int qos = MQTT_DATA_QOS;
+    int window = MQTT_INFLIGHT_WINDOW;
+    int ack_delay_ms = 0;
+    const char *broker = nullptr;
+    bool event_driven = false;
+    bool summary_only = false;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--messages N] [--interval-ms N] [--yield-ms N] [--reconnects N]\n"
+            "       [--qos 0|1] [--window N] [--ack-delay-ms N] [--latency-us N]\n"
+            "       [--timeout-ms N] [--broker HOST:PORT] [--event-driven] [--summary-only]\n",
+            prog);
+}
+
+static double elapsed_ms(Timer &t)
+{
+    return t.elapsed_time().count() / 1000.0;
+}
+
+// --event-driven: the network thread's service loop (network_task.cpp)
+static EventFlags service_events;
+static Thread service_thread;
+
+static void mqtt_event()
+{
+    service_events.set(1);
+}
+
+static void service_loop()
+{
+    uint32_t wait_ms = 0;
+    while (true) {
+        service_events.wait_any_for(1, std::chrono::milliseconds(wait_ms));
+        wait_ms = mqtt_service();
+    }
+}
+
+// Lets incoming packets be handled for about ms: by polling, or by the
+// service thread while this one sleeps
+static void process_incoming(bool event_driven, int ms)
+{
+    if (event_driven) {
+        ThisThread::sleep_for(std::chrono::milliseconds(ms));
+    } else {
+        mqtt_yield(ms);
+    }
+}
+
+static void print_spi(FILE *out, const ISM43362Stats &s)
+{
+    fprintf(out, "\"spi_transactions\":%u,\"spi_bytes\":%llu,\"spi_bus_us\":%.1f,\"commands\":%u",
+            s.transactions, (unsigned long long)(s.frames * 2), s.bus_ns / 1000.0, s.commands);
+}
+
+static bool publish_sample(int i)
+{
+    float temp = 22.0f + 0.01f * (i % 100);
+    SensorData data = {temp, 45.0f, 1013.25f, true, true, true};
+    temp_tracker_update(temp);
+    AnomalyStatus anomaly = anomaly_detector_process(temp);
+    TempStats1Hour stats = temp_tracker_get_stats();
+    return mqtt_publish_data(data, stats, anomaly);
+}
+
+// Yields until every QoS 1 publish is acknowledged or timeout_ms passes
+static void drain_inflight(bool event_driven, int timeout_ms)
+{
+    Timer t;
+    t.start();
+    while (mqtt_get_stats().inflight > 0 && mqtt_is_connected() && elapsed_ms(t) < timeout_ms) {
+        process_incoming(event_driven, 5);
+    }
+}
+
+// Mirrors the reconnect branch of main(): publish while connected, otherwise
+// reconnect. Returns once the client has noticed the drop and recovered, or
+// after timeout_ms.
+static bool wait_reconnect(const BenchOptions &options, int &sample, double &detect_ms, double &recover_ms,
+                           int &attempts)
+{
+    Timer t;
+    t.start();
+    detect_ms = -1.0;
+    recover_ms = -1.0;
+    attempts = 0;
+    while (elapsed_ms(t) < options.timeout_ms) {
+        if (!mqtt_is_connected()) {
+            if (detect_ms < 0) {
+                detect_ms = elapsed_ms(t);
+            }
+            attempts++;
+            if (mqtt_connect()) {
+                recover_ms = elapsed_ms(t);
+                return true;
+            }
+            ThisThread::sleep_for(100ms);
+        } else {
+            publish_sample(sample++);
+            process_incoming(options.event_driven, options.yield_ms > 0 ? options.yield_ms : 100);
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--messages") && has_value) {
+            options.messages = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval-ms") && has_value) {
+            options.interval_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--yield-ms") && has_value) {
+            options.yield_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--reconnects") && has_value) {
+            options.reconnects = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--qos") && has_value) {
+            options.qos = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--window") && has_value) {
+            options.window = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--ack-delay-ms") && has_value) {
+            options.ack_delay_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--latency-us") && has_value) {
+            options.latency_us = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--timeout-ms") && has_value) {
+            options.timeout_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--broker") && has_value) {
+            options.broker = argv[++i];
+        } else if (!strcmp(argv[i], "--event-driven")) {
+            options.event_driven = true;
+        } else if (!strcmp(argv[i], "--summary-only")) {
+            options.summary_only = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.messages <= 0 || options.interval_ms < 0 || options.yield_ms < 0 ||
+            options.reconnects < 0 || options.latency_us < 0 || options.timeout_ms <= 0 ||
+            options.qos < 0 || options.qos > 1 || options.window < 1 || options.window > MQTT_INFLIGHT_WINDOW ||
+            options.ack_delay_ms < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string broker_host = "127.0.0.1";
+    int broker_port = 0;
+    if (options.broker) {
+        const char *colon = strrchr(options.broker, ':');
+        broker_port = colon ? atoi(colon + 1) : MQTT_BROKER_PORT;
+        broker_host = colon ? std::string(options.broker, colon - options.broker) : std::string(options.broker);
+        if (broker_port <= 0 || broker_port > 65535) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    FILE *out = tool_report_stream("mqtt_net_bench");
+    if (!out) {
+        return 1;
+    }
+
+    MQTTTestBroker local_broker;
+    if (!options.broker) {
+        if (!local_broker.start()) {
+            perror("mqtt_net_bench: broker");
+            return 1;
+        }
+        local_broker.set_ack_delay_ms(options.ack_delay_ms);
+        broker_port = local_broker.port();
+    }
+
+    ISM43362Emulator &emu = ism43362_board_module();
+    emu.redirect(MQTT_BROKER_HOSTNAME, MQTT_BROKER_PORT, broker_host.c_str(), (uint16_t)broker_port);
+    emu.set_command_latency_us(options.latency_us);
+    emu.reset_stats();
+
+    anomaly_detector_init();
+    temp_tracker_init();
+    if (options.event_driven) {
+        mqtt_sigio(callback(mqtt_event));
+    }
+
+    Timer t;
+    t.start();
+    nsapi_error_t rc = network_init();
+    fprintf(out, "{\"phase\":\"init\",\"ok\":%s,\"ms\":%.1f,", rc == NSAPI_ERROR_OK ? "true" : "false", elapsed_ms(t));
+    print_spi(out, emu.stats());
+    fprintf(out, "}\n");
+    if (rc != NSAPI_ERROR_OK || !mqtt_init(network_get_interface())) {
+        fprintf(stderr, "mqtt_net_bench: network init failed (%d)\n", rc);
+        fflush(out);
+        _exit(1);
+    }
+    mqtt_set_data_qos(options.qos, options.window);
+
+    emu.reset_stats();
+    t.reset();
+    bool connected = mqtt_connect();
+    fprintf(out, "{\"phase\":\"connect\",\"ok\":%s,\"ms\":%.1f,", connected ? "true" : "false", elapsed_ms(t));
+    print_spi(out, emu.stats());
+    fprintf(out, "}\n");
+    if (!connected) {
+        fprintf(stderr, "mqtt_net_bench: MQTT connect to %s:%d failed\n", broker_host.c_str(), broker_port);
+        fflush(out);
+        _exit(1);
+    }
+    if (options.event_driven) {
+        service_thread.start(callback(service_loop));
+    }
+
+    // Steady state: the main loop's publish + yield, without the sensor read.
+    // With QoS 1 the run ends when the last PUBACK is in.
+    emu.reset_stats();
+    local_broker.reset_stats();
+    MqttStats before = mqtt_get_stats();
+    int published = 0;
+    int sample = 0;
+    double worst_ms = 0.0;
+    t.reset();
+    for (int i = 0; i < options.messages; i++) {
+        Timer m;
+        m.start();
+        if (publish_sample(sample++)) {
+            published++;
+        }
+        if (options.yield_ms > 0 && !options.event_driven) {
+            mqtt_yield(options.yield_ms);
+        }
+        double ms = elapsed_ms(m);
+        worst_ms = ms > worst_ms ? ms : worst_ms;
+        if (options.interval_ms > 0) {
+            ThisThread::sleep_for(std::chrono::milliseconds(options.interval_ms));
+        }
+    }
+    drain_inflight(options.event_driven, options.timeout_ms);
+    double run_ms = elapsed_ms(t);
+    ISM43362Stats spi = emu.stats();
+    MqttStats mqtt = mqtt_get_stats();
+    uint32_t received = published;
+    if (!options.broker) {
+        local_broker.wait_publishes(published, options.timeout_ms);
+        received = local_broker.stats().publishes;
+    }
+
+    double n = (double)options.messages;
+    double msgs_per_s = run_ms > 0 ? options.messages * 1000.0 / run_ms : 0.0;
+    double acked_per_s = run_ms > 0 ? mqtt.acked * 1000.0 / run_ms : 0.0;
+    fprintf(out, "{\"phase\":\"publish\",\"qos\":%d,\"window\":%d,\"messages\":%d,\"published\":%d,"
+            "\"received\":%u,\"acked\":%u,\"ms\":%.1f,\"msgs_per_s\":%.1f,\"acked_per_s\":%.1f,"
+            "\"worst_ms\":%.2f,\"max_inflight\":%u,\"window_full\":%u,\"spi_transactions_per_msg\":%.2f,"
+            "\"spi_bytes_per_msg\":%.1f,\"spi_bus_us_per_msg\":%.1f,\"send_commands\":%u,"
+            "\"recv_polls\":%u,\"empty_polls\":%u,\"payload_bytes\":%llu,\"service_calls\":%u,"
+            "\"service_ms\":%.1f,\"service_pct\":%.2f}\n",
+            options.qos, options.window, options.messages, published, received, mqtt.acked, run_ms,
+            msgs_per_s, acked_per_s, worst_ms, mqtt.max_inflight, mqtt.window_full,
+            spi.transactions / n, spi.frames * 2 / n, spi.bus_ns / 1000.0 / n,
+            spi.send_commands, spi.recv_polls, spi.empty_polls, (unsigned long long)spi.send_bytes,
+            mqtt.service_calls - before.service_calls, (mqtt.service_us - before.service_us) / 1000.0,
+            run_ms > 0 ? (mqtt.service_us - before.service_us) / 10.0 / run_ms : 0.0);
+
+    // Forced reconnects: fill the window, then the broker drops the session
+    // without a word. Unacknowledged QoS 1 publishes go out again afterwards.
+    int recovered = 0;
+    double total_detect = 0.0, total_recover = 0.0;
+    for (int r = 0; r < options.reconnects && !options.broker; r++) {
+        for (int i = 0; i < options.window; i++) {
+            publish_sample(sample++);
+        }
+        uint32_t retransmits = mqtt_get_stats().retransmits;
+        local_broker.kick_clients();
+        double detect_ms, recover_ms;
+        int attempts;
+        bool ok = wait_reconnect(options, sample, detect_ms, recover_ms, attempts);
+        if (ok) {
+            recovered++;
+            total_detect += detect_ms;
+            total_recover += recover_ms;
+        }
+        if (!options.summary_only) {
+            fprintf(out, "{\"phase\":\"reconnect\",\"index\":%d,\"recovered\":%s,\"detect_ms\":%.1f,"
+                    "\"recover_ms\":%.1f,\"attempts\":%d,\"retransmits\":%u}\n",
+                    r, ok ? "true" : "false", detect_ms, recover_ms, attempts,
+                    mqtt_get_stats().retransmits - retransmits);
+        }
+        if (!ok) {
+            break;
+        }
+    }
+    drain_inflight(options.event_driven, options.timeout_ms);
+
+    // QoS 1 loses nothing that was accepted: everything is acked or still queued
+    MqttStats total = mqtt_get_stats();
+    ISM43362Stats all = emu.stats();
+    int lost = options.qos ? (int)(total.published - total.acked - total.inflight)
+                           : (options.broker ? 0 : published - (int)received);
+    fprintf(out, "{\"phase\":\"summary\",\"broker\":\"%s:%d\",\"latency_us\":%d,\"mode\":\"%s\",\"yield_ms\":%d,"
+            "\"qos\":%d,\"window\":%d,\"ack_delay_ms\":%d,\"msgs_per_s\":%.1f,\"acked_per_s\":%.1f,"
+            "\"published\":%u,\"acked\":%u,\"unacked\":%u,\"retransmits\":%u,\"lost\":%d,"
+            "\"duplicates\":%u,\"reconnects\":%d,\"recovered\":%d,\"mean_detect_ms\":%.1f,"
+            "\"mean_recover_ms\":%.1f,\"connects\":%u,\"errors\":%u,\"service_calls\":%u,\"service_ms\":%.1f}\n",
+            broker_host.c_str(), broker_port, options.latency_us, options.event_driven ? "event" : "yield",
+            options.yield_ms, options.qos, options.window,
+            options.ack_delay_ms, msgs_per_s, acked_per_s, total.published, total.acked, total.inflight,
+            total.retransmits, lost, options.broker ? 0 : local_broker.stats().duplicates,
+            options.broker ? 0 : options.reconnects, recovered,
+            recovered ? total_detect / recovered : 0.0, recovered ? total_recover / recovered : 0.0,
+            all.connects, all.errors, total.service_calls, total.service_us / 1000.0);
+    fflush(out);
+
+    // The driver's socket thread never returns; skip static teardown under it
+    bool failed = lost > 0 || total.inflight > 0 || (!options.broker && recovered < options.reconnects);
+    _exit(failed ? 1 : 0);
+}
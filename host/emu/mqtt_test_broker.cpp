@@ -0,0 +1,350 @@
+#include "mqtt_test_broker.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "MQTTPacket.h"
+
+// '+' matches one level, a trailing '#' the rest
+static bool filter_matches(const std::string &filter, const std::string &topic)
+{
+    size_t f = 0, t = 0;
+    while (f < filter.size()) {
+        if (filter[f] == '#') {
+            return true;
+        }
+        if (filter[f] == '+') {
+            while (t < topic.size() && topic[t] != '/') {
+                t++;
+            }
+            f++;
+            continue;
+        }
+        if (t >= topic.size() || filter[f] != topic[t]) {
+            return false;
+        }
+        f++;
+        t++;
+    }
+    return t == topic.size();
+}
+
+static std::string to_string(const MQTTString &s)
+{
+    return s.cstring ? std::string(s.cstring) : std::string(s.lenstring.data, s.lenstring.len);
+}
+
+MQTTTestBroker::MQTTTestBroker() : _listen_fd(-1), _port(0), _running(false), _kick(false), _ack_delay_ms(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+MQTTTestBroker::~MQTTTestBroker()
+{
+    stop();
+}
+
+bool MQTTTestBroker::start(uint16_t port)
+{
+    _listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_listen_fd < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sa);
+    if (bind(_listen_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(_listen_fd, SOMAXCONN) < 0 ||
+            getsockname(_listen_fd, (struct sockaddr *)&sa, &len) < 0) {
+        close(_listen_fd);
+        _listen_fd = -1;
+        return false;
+    }
+    _port = ntohs(sa.sin_port);
+    _running = true;
+    _thread = std::thread(&MQTTTestBroker::run, this);
+    return true;
+}
+
+void MQTTTestBroker::stop()
+{
+    if (!_running) {
+        return;
+    }
+    _running = false;
+    _thread.join();
+    std::lock_guard<std::mutex> lock(_mutex);
+    while (!_clients.empty()) {
+        drop(_clients.size() - 1);
+    }
+    close(_listen_fd);
+    _listen_fd = -1;
+}
+
+void MQTTTestBroker::on_publish(PublishHook hook)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hook = hook;
+}
+
+void MQTTTestBroker::kick_clients()
+{
+    _kick = true;
+}
+
+bool MQTTTestBroker::wait_publishes(uint32_t count, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, count] {
+        return _stats.publishes >= count;
+    });
+}
+
+MQTTBrokerStats MQTTTestBroker::stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void MQTTTestBroker::reset_stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void MQTTTestBroker::drop(size_t index)
+{
+    // Acknowledgements still held back for this connection are lost with it
+    for (size_t i = _acks.size(); i-- > 0;) {
+        if (_acks[i].fd == _clients[index].fd) {
+            _acks.erase(_acks.begin() + i);
+        }
+    }
+    close(_clients[index].fd);
+    _clients.erase(_clients.begin() + index);
+    _stats.disconnects++;
+}
+
+void MQTTTestBroker::send_to(Client &c, const unsigned char *data, int len)
+{
+    if (len > 0) {
+        (void)::send(c.fd, data, len, MSG_NOSIGNAL);
+    }
+}
+
+void MQTTTestBroker::forward(const std::string &topic, const std::string &payload)
+{
+    std::vector<unsigned char> buf(topic.size() + payload.size() + 16);
+    MQTTString name = MQTTString_initializer;
+    name.lenstring.data = (char *)topic.data();
+    name.lenstring.len = (int)topic.size();
+    int len = MQTTSerialize_publish(buf.data(), (int)buf.size(), 0, 0, 0, 0, name,
+                                    (unsigned char *)payload.data(), (int)payload.size());
+    for (size_t i = 0; i < _clients.size(); i++) {
+        for (size_t f = 0; f < _clients[i].filters.size(); f++) {
+            if (filter_matches(_clients[i].filters[f], topic)) {
+                send_to(_clients[i], buf.data(), len);
+                break;
+            }
+        }
+    }
+}
+
+void MQTTTestBroker::handle_packet(Client &c, unsigned char *packet, int len)
+{
+    unsigned char out[256];
+    MQTTHeader header;
+    header.byte = packet[0];
+
+    switch (header.bits.type) {
+        case CONNECT: {
+            MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+            bool ok = MQTTDeserialize_connect(&data, packet, len) == 1;
+            send_to(c, out, MQTTSerialize_connack(out, sizeof(out), ok ? 0 : 2, 0));
+            c.connected = ok;
+            if (ok) {
+                _stats.connects++;
+            }
+            break;
+        }
+        case PUBLISH: {
+            unsigned char dup, retained;
+            int qos, payloadlen;
+            unsigned short id;
+            MQTTString topic;
+            unsigned char *payload;
+            if (MQTTDeserialize_publish(&dup, &qos, &retained, &id, &topic, &payload, &payloadlen, packet, len) != 1) {
+                break;
+            }
+            _stats.publishes++;
+            _stats.payload_bytes += payloadlen;
+            _stats.duplicates += dup ? 1 : 0;
+            if (qos == 1) {
+                _stats.qos1_publishes++;
+                if (_ack_delay_ms > 0) {
+                    PendingAck ack = {c.fd, id, std::chrono::steady_clock::now() + std::chrono::milliseconds(_ack_delay_ms)};
+                    _acks.push_back(ack);
+                } else {
+                    send_to(c, out, MQTTSerialize_puback(out, sizeof(out), id));
+                }
+            }
+            std::string name = to_string(topic);
+            std::string body((const char *)payload, payloadlen);
+            if (_hook) {
+                _hook(name, body, qos);
+            }
+            forward(name, body);
+            _cv.notify_all();
+            break;
+        }
+        case SUBSCRIBE: {
+            unsigned char dup;
+            unsigned short id;
+            int count = 0;
+            MQTTString filters[8];
+            int qos[8];
+            if (MQTTDeserialize_subscribe(&dup, &id, 8, &count, filters, qos, packet, len) != 1) {
+                break;
+            }
+            int granted[8];
+            for (int i = 0; i < count; i++) {
+                c.filters.push_back(to_string(filters[i]));
+                granted[i] = 0;
+            }
+            _stats.subscribes++;
+            send_to(c, out, MQTTSerialize_suback(out, sizeof(out), id, count, granted));
+            break;
+        }
+        case UNSUBSCRIBE: {
+            unsigned char type, dup;
+            unsigned short id;
+            if (MQTTDeserialize_ack(&type, &dup, &id, packet, len) == 1) {
+                send_to(c, out, MQTTSerialize_ack(out, sizeof(out), UNSUBACK, 0, id));
+            }
+            break;
+        }
+        case PINGREQ: {
+            unsigned char resp[2] = {PINGRESP << 4, 0};
+            _stats.pings++;
+            send_to(c, resp, sizeof(resp));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void MQTTTestBroker::send_due_acks()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    size_t kept = 0;
+    for (size_t i = 0; i < _acks.size(); i++) {
+        if (_acks[i].due > now) {
+            _acks[kept++] = _acks[i];
+            continue;
+        }
+        unsigned char out[4];
+        int len = MQTTSerialize_puback(out, sizeof(out), _acks[i].id);
+        (void)::send(_acks[i].fd, out, len, MSG_NOSIGNAL);
+    }
+    _acks.resize(kept);
+}
+
+void MQTTTestBroker::run()
+{
+    while (_running) {
+        std::vector<struct pollfd> fds;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_kick.exchange(false)) {
+                while (!_clients.empty()) {
+                    drop(_clients.size() - 1);
+                }
+            }
+            send_due_acks();
+            struct pollfd l = {_listen_fd, POLLIN, 0};
+            fds.push_back(l);
+            for (size_t i = 0; i < _clients.size(); i++) {
+                struct pollfd p = {_clients[i].fd, POLLIN, 0};
+                fds.push_back(p);
+            }
+        }
+        if (poll(fds.data(), fds.size(), 1) <= 0) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Take every pending connection, so a burst of them is not admitted one per loop
+        struct pollfd pending = fds[0];
+        while (pending.revents & POLLIN) {
+            int fd = accept(_listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                Client c = {fd, false, std::string(), std::vector<std::string>()};
+                _clients.push_back(c);
+            }
+            if (fd < 0 || poll(&pending, 1, 0) <= 0) {
+                break;
+            }
+        }
+        // Walk backwards so dropping a client keeps the remaining indices valid
+        for (size_t k = fds.size() - 1; k >= 1; k--) {
+            if (!fds[k].revents) {
+                continue;
+            }
+            size_t index = k - 1;
+            Client &c = _clients[index];
+            char buf[2048];
+            ssize_t n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n <= 0) {
+                drop(index);
+                continue;
+            }
+            _stats.wire_bytes += n;
+            c.in.append(buf, n);
+
+            bool closed = false;
+            while (c.in.size() >= 2 && !closed) {
+                int rem_len = 0;
+                int multiplier = 1;
+                size_t pos = 1;
+                bool complete = false;
+                while (pos < c.in.size() && pos <= 4) {
+                    unsigned char b = (unsigned char)c.in[pos++];
+                    rem_len += (b & 127) * multiplier;
+                    multiplier *= 128;
+                    if (!(b & 128)) {
+                        complete = true;
+                        break;
+                    }
+                }
+                if (!complete || c.in.size() < pos + rem_len) {
+                    break;
+                }
+                std::string packet = c.in.substr(0, pos + rem_len);
+                c.in.erase(0, pos + rem_len);
+                MQTTHeader header;
+                header.byte = (unsigned char)packet[0];
+                if (header.bits.type == DISCONNECT) {
+                    drop(index);
+                    closed = true;
+                    break;
+                }
+                handle_packet(c, (unsigned char *)&packet[0], (int)packet.size());
+            }
+        }
+    }
+}
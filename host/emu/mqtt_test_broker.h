@@ -0,0 +1,104 @@
+/* Minimal MQTT 3.1.1 broker on loopback for host tools.
+ *
+ * Accepts any CONNECT, acknowledges QoS 1 publishes, answers PINGREQ and
+ * SUBSCRIBE/UNSUBSCRIBE, and forwards publishes (at QoS 0) to matching
+ * subscriptions. No retained messages, sessions or QoS 2. It runs on its own
+ * thread and counts what it sees, so a tool can check what actually arrived
+ * and drop clients to exercise reconnects.
+ */
+#ifndef MQTT_TEST_BROKER_H
+#define MQTT_TEST_BROKER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct MQTTBrokerStats {
+    uint32_t connects;
+    uint32_t disconnects;       // clean DISCONNECT or connection loss
+    uint32_t publishes;
+    uint32_t qos1_publishes;
+    uint32_t duplicates;        // publishes with DUP set
+    uint32_t subscribes;
+    uint32_t pings;
+    uint64_t payload_bytes;
+    uint64_t wire_bytes;        // everything read from clients
+};
+
+class MQTTTestBroker {
+public:
+    typedef std::function<void(const std::string &topic, const std::string &payload, int qos)> PublishHook;
+
+    MQTTTestBroker();
+    ~MQTTTestBroker();
+
+    /** Listen on 127.0.0.1:@p port (0 picks a free port) */
+    bool start(uint16_t port = 0);
+    void stop();
+    uint16_t port() const
+    {
+        return _port;
+    }
+
+    /** Called on the broker thread for every PUBLISH received */
+    void on_publish(PublishHook hook);
+
+    /** Hold each PUBACK back for @p ms, standing in for the network round trip */
+    void set_ack_delay_ms(int ms)
+    {
+        _ack_delay_ms = ms;
+    }
+
+    /** Close every client connection without a word, as a broker restart would */
+    void kick_clients();
+
+    /** Wait until @p count publishes have arrived in total */
+    bool wait_publishes(uint32_t count, int timeout_ms);
+
+    MQTTBrokerStats stats();
+    void reset_stats();
+
+private:
+    struct Client {
+        int fd;
+        bool connected;
+        std::string in;
+        std::vector<std::string> filters;
+    };
+
+    struct PendingAck {
+        int fd;
+        unsigned short id;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    void run();
+    void send_due_acks();
+    void handle_packet(Client &c, unsigned char *packet, int len);
+    void forward(const std::string &topic, const std::string &payload);
+    void send_to(Client &c, const unsigned char *data, int len);
+    void drop(size_t index);
+
+    int _listen_fd;
+    uint16_t _port;
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::atomic<bool> _kick;
+    std::atomic<int> _ack_delay_ms;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<Client> _clients;
+    std::vector<PendingAck> _acks;
+    PublishHook _hook;
+    MQTTBrokerStats _stats;
+};
+
+#endif // MQTT_TEST_BROKER_H
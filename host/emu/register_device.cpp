@@ -0,0 +1,41 @@
+#include "register_device.h"
+
+#include <string.h>
+
+RegisterDevice::RegisterDevice() : _pointer(0), _increment(false)
+{
+    memset(_regs, 0, sizeof(_regs));
+}
+
+bool RegisterDevice::on_write(const uint8_t *data, int length)
+{
+    if (!responding()) {
+        return false;
+    }
+    if (length == 0) {
+        return true; // address probe
+    }
+
+    _pointer = select(data[0], _increment);
+    for (int i = 1; i < length; i++) {
+        write_register(_pointer, data[i]);
+        if (_increment) {
+            _pointer++;
+        }
+    }
+    return true;
+}
+
+bool RegisterDevice::on_read(uint8_t *data, int length)
+{
+    if (!responding()) {
+        return false;
+    }
+    for (int i = 0; i < length; i++) {
+        data[i] = read_register(_pointer);
+        if (_increment) {
+            _pointer++;
+        }
+    }
+    return true;
+}
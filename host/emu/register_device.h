@@ -0,0 +1,56 @@
+/* Base for I2C slaves laid out as a map of 8-bit registers.
+ *
+ * Handles the common framing: the first byte of a write selects the register
+ * (the "sub-address"), further written bytes and all read bytes go to the
+ * selected register, moving to the next one when the device's
+ * auto-increment rule says so. Subclasses decode the sub-address and hook
+ * register accesses for side effects such as clearing status bits.
+ */
+#ifndef REGISTER_DEVICE_H
+#define REGISTER_DEVICE_H
+
+#include <stdint.h>
+
+#include "i2c_bus_emulator.h"
+
+class RegisterDevice : public I2CDeviceModel {
+public:
+    RegisterDevice();
+
+    bool on_write(const uint8_t *data, int length) override;
+    bool on_read(uint8_t *data, int length) override;
+
+    /** Register contents without side effects */
+    uint8_t peek(uint8_t reg) const
+    {
+        return _regs[reg];
+    }
+
+protected:
+    /** Map a sub-address byte to a register and say whether it auto-increments */
+    virtual uint8_t select(uint8_t sub_address, bool &increment) = 0;
+
+    /** false NACKs the transfer */
+    virtual bool responding() const
+    {
+        return true;
+    }
+
+    virtual uint8_t read_register(uint8_t reg)
+    {
+        return _regs[reg];
+    }
+
+    virtual void write_register(uint8_t reg, uint8_t value)
+    {
+        _regs[reg] = value;
+    }
+
+    uint8_t _regs[256];
+
+private:
+    uint8_t _pointer;
+    bool _increment;
+};
+
+#endif // REGISTER_DEVICE_H
@@ -0,0 +1,304 @@
+/* Replays one input signal through the firmware's processing loop twice, at
+ * the fixed SENSOR_UPDATE_INTERVAL_MS and with the adaptive sampling
+ * controller, and compares what each costs.
+ *
+ * sensors.cpp, the tracker, the anomaly detector, sampling.cpp and the
+ * payload formatter are the firmware's; the loop below mirrors main.cpp
+ * (interval choice, ODR changes, publish rate limit) on the simulated clock
+ * of the emulated I2C bus, so a one-hour replay takes well under a second.
+ *
+ * For each run the summary reports sensor reads, sensor conversions, I2C bus
+ * time, publishes and MQTT bytes, an energy estimate, and how long after the
+ * true temperature crossed TEMP_THRESHOLD_HIGH a reading, and a publish,
+ * showed it. The energy model is deliberately coarse and only meant for
+ * comparing the two runs; its terms are:
+ *
+ *   HTS221 conversion    2 uA for 1 s at 3.3 V    (datasheet: 2 uA at 1 Hz)
+ *   LPS22HB conversion  12 uA for 1 s at 3.3 V    (low-noise mode at 1 Hz)
+ *   I2C traffic          MCU at 10 mA, 3.3 V, for the simulated bus time
+ *   Reading              MCU at 10 mA, 3.3 V, for 1 ms of processing
+ *   Publish              WiFi module: 1 mJ per packet plus 2 uJ per byte
+ *
+ * Sleep current is the same in both runs and left out.
+ *
+ * Output is JSON lines: a record per sampling mode change of the adaptive
+ * run (unless --summary-only), one summary per run and a comparison.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "config.h"
+#include "sensors.h"
+#include "temp_tracker.h"
+#include "anomaly_detector.h"
+#include "sampling.h"
+#include "mqtt_payload.h"
+#include "HTS221_driver.h"
+#include "LPS22HB_driver.h"
+
+#include "hts221_model.h"
+#include "i2c_bus_emulator.h"
+#include "lps22hb_model.h"
+#include "sensor_signal.h"
+#include "tool_common.h"
+
+// Energy model, see the top of the file
+static const double HTS221_UJ_PER_CONVERSION = 2.0 * 3.3;
+static const double LPS22HB_UJ_PER_CONVERSION = 12.0 * 3.3;
+static const double MCU_UJ_PER_US = 10.0e-3 * 3.3;
+static const double READING_UJ = 1000.0 * MCU_UJ_PER_US;
+static const double PUBLISH_UJ = 1000.0;
+static const double PUBLISH_UJ_PER_BYTE = 2.0;
+
+// Resolution used to find when the input signal crossed the threshold, and
+// how far back below it the signal must go before the next crossing counts
+static const uint64_t CROSSING_STEP_US = 10000;
+static const float CROSSING_HYSTERESIS = 0.5f;
+
+struct ReplayOptions {
+    int duration_s = 3600;
+    int i2c_hz = 100000;
+    const char *signal = "temperature=sine:22:4:600~0.05";
+    const char *trace = nullptr;
+    bool summary_only = false;
+};
+
+struct ReplayResult {
+    uint32_t reads = 0;
+    uint32_t publishes = 0;
+    uint32_t anomalies = 0;       // times the anomaly flag was raised
+    uint64_t payload_bytes = 0;
+    uint64_t mqtt_bytes = 0;      // PUBLISH packets including headers
+    uint64_t bus_ns = 0;
+    uint32_t hts221_conversions = 0;
+    uint32_t lps22hb_conversions = 0;
+    uint32_t mode_ms[3] = {0, 0, 0};
+    // Threshold crossings of the true signal and detection delays
+    uint32_t crossings = 0;
+    uint32_t crossings_missed = 0;  // fell back below before a reading saw them
+    double read_latency_sum_ms = 0.0;
+    double read_latency_max_ms = 0.0;
+    double publish_latency_sum_ms = 0.0;
+    double publish_latency_max_ms = 0.0;
+    uint32_t published_crossings = 0;
+
+    double energy_uj() const
+    {
+        return hts221_conversions * HTS221_UJ_PER_CONVERSION +
+               lps22hb_conversions * LPS22HB_UJ_PER_CONVERSION +
+               bus_ns / 1000.0 * MCU_UJ_PER_US +
+               reads * READING_UJ +
+               publishes * PUBLISH_UJ + mqtt_bytes * PUBLISH_UJ_PER_BYTE;
+    }
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--duration-s N] [--i2c-hz N] [--signal SPEC | --trace FILE] [--summary-only]\n",
+            prog);
+}
+
+// Size of an MQTT PUBLISH of @p payload_len bytes to the data topic
+static uint32_t publish_packet_bytes(int payload_len)
+{
+    uint32_t remaining = 2 + (uint32_t)strlen(MQTT_TOPIC_DATA) + (MQTT_DATA_QOS > 0 ? 2 : 0) + payload_len;
+    uint32_t length_bytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    return 1 + length_bytes + remaining;
+}
+
+static ReplayResult replay(const SensorSignal &signal, const ReplayOptions &options, bool adaptive, FILE *out)
+{
+    ReplayResult r;
+    HTS221Model hts221(signal);
+    LPS22HBModel lps22hb(signal);
+    I2CBusEmulator bus(options.i2c_hz);
+    bus.add_device(HTS221_I2C_ADDRESS, &hts221);
+    bus.add_device(LPS22HB_ADDRESS_HIGH, &lps22hb);
+    host_i2c_attach(&bus);
+
+    sensors_init();
+    temp_tracker_init();
+    anomaly_detector_init();
+    sampling_init();
+
+    uint32_t interval_ms = SENSOR_UPDATE_INTERVAL_MS;
+    uint32_t elapsed_ms = 0;
+    SamplingMode mode = SAMPLING_NOMINAL;
+    if (adaptive) {
+        sensors_set_interval_ms(interval_ms);
+    }
+
+    const uint64_t end_us = (uint64_t)options.duration_s * 1000000;
+    uint64_t checked_us = 0;
+    bool truth_above = signal.at(0).temperature > TEMP_THRESHOLD_HIGH;
+    bool was_anomalous = false;
+    bool crossing_pending = false;
+    bool publish_pending = false;
+    uint64_t crossing_us = 0;
+    uint64_t read_seen_us = 0;
+    bus.reset_stats();
+
+    while (bus.now_us() < end_us) {
+        uint64_t now_us = bus.now_us();
+
+        // Walk the true signal up to now to time threshold crossings
+        for (; checked_us <= now_us; checked_us += CROSSING_STEP_US) {
+            float temp = signal.at(checked_us).temperature;
+            bool above = truth_above ? temp > TEMP_THRESHOLD_HIGH - CROSSING_HYSTERESIS
+                                     : temp > TEMP_THRESHOLD_HIGH;
+            if (above && !truth_above) {
+                if (crossing_pending) {
+                    r.crossings_missed++;
+                }
+                r.crossings++;
+                crossing_pending = true;
+                crossing_us = checked_us;
+            }
+            truth_above = above;
+        }
+
+        SensorData data = sensors_read();
+        r.reads++;
+        temp_tracker_update(data.temperature, elapsed_ms);
+        AnomalyStatus anomaly = anomaly_detector_process(data.temperature, elapsed_ms);
+        TempStats1Hour stats = temp_tracker_get_stats();
+        if (anomaly.is_anomalous && !was_anomalous) {
+            r.anomalies++;
+        }
+        was_anomalous = anomaly.is_anomalous;
+
+        if (adaptive) {
+            interval_ms = sampling_update(data.temperature, anomaly.is_anomalous, elapsed_ms);
+            sensors_set_interval_ms(interval_ms);
+            if (sampling_get_mode() != mode) {
+                mode = sampling_get_mode();
+                if (!options.summary_only) {
+                    fprintf(out, "{\"phase\":\"mode\",\"t_ms\":%llu,\"mode\":\"%s\",\"interval_ms\":%u,\"temp\":%.2f}\n",
+                            (unsigned long long)(now_us / 1000), sampling_mode_name(mode), interval_ms,
+                            data.temperature);
+                }
+            }
+        }
+        r.mode_ms[mode] += interval_ms;
+
+        if (crossing_pending && data.temperature > TEMP_THRESHOLD_HIGH) {
+            double latency_ms = (now_us - crossing_us) / 1000.0;
+            r.read_latency_sum_ms += latency_ms;
+            r.read_latency_max_ms = latency_ms > r.read_latency_max_ms ? latency_ms : r.read_latency_max_ms;
+            crossing_pending = false;
+            publish_pending = true;
+            read_seen_us = crossing_us;
+        }
+
+        // The fixed interval publishes every reading, as before adaptive sampling
+        if (!adaptive || sampling_report_due(data.temperature, anomaly.is_anomalous, elapsed_ms)) {
+            char payload[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+            int len = mqtt_format_data_payload(payload, sizeof(payload), data, stats, anomaly);
+            if (len > 0) {
+                r.publishes++;
+                r.payload_bytes += len;
+                r.mqtt_bytes += publish_packet_bytes(len);
+            }
+            if (publish_pending && data.temperature > TEMP_THRESHOLD_HIGH) {
+                double latency_ms = (now_us - read_seen_us) / 1000.0;
+                r.publish_latency_sum_ms += latency_ms;
+                r.publish_latency_max_ms = latency_ms > r.publish_latency_max_ms ? latency_ms : r.publish_latency_max_ms;
+                r.published_crossings++;
+                publish_pending = false;
+            }
+        }
+
+        bus.advance_us((uint64_t)interval_ms * 1000);
+        elapsed_ms = interval_ms;
+    }
+
+    // Count the conversions made after the last read
+    hts221.tick(bus.now_us());
+    lps22hb.tick(bus.now_us());
+    r.bus_ns = bus.stats().bus_ns;
+    r.hts221_conversions = hts221.conversions();
+    r.lps22hb_conversions = lps22hb.conversions();
+    host_i2c_attach(nullptr);
+    return r;
+}
+
+static void print_result(FILE *out, const char *phase, const ReplayResult &r, int duration_s)
+{
+    fprintf(out, "{\"phase\":\"%s\",\"duration_s\":%d,\"reads\":%u,\"publishes\":%u,\"payload_bytes\":%llu,"
+            "\"mqtt_bytes\":%llu,\"bus_us\":%.1f,\"hts221_conversions\":%u,\"lps22hb_conversions\":%u,"
+            "\"anomalies\":%u,\"fast_s\":%.1f,\"nominal_s\":%.1f,\"slow_s\":%.1f,\"energy_mj\":%.3f,"
+            "\"crossings\":%u,\"crossings_missed\":%u,\"read_latency_avg_ms\":%.0f,\"read_latency_max_ms\":%.0f,"
+            "\"publish_latency_avg_ms\":%.0f,\"publish_latency_max_ms\":%.0f}\n",
+            phase, duration_s, r.reads, r.publishes, (unsigned long long)r.payload_bytes,
+            (unsigned long long)r.mqtt_bytes, r.bus_ns / 1000.0, r.hts221_conversions, r.lps22hb_conversions,
+            r.anomalies, r.mode_ms[SAMPLING_FAST] / 1000.0, r.mode_ms[SAMPLING_NOMINAL] / 1000.0,
+            r.mode_ms[SAMPLING_SLOW] / 1000.0, r.energy_uj() / 1000.0,
+            r.crossings, r.crossings_missed,
+            r.crossings > r.crossings_missed ? r.read_latency_sum_ms / (r.crossings - r.crossings_missed) : 0.0,
+            r.read_latency_max_ms,
+            r.published_crossings ? r.publish_latency_sum_ms / r.published_crossings : 0.0,
+            r.publish_latency_max_ms);
+}
+
+static double share(double a, double b)
+{
+    return b > 0.0 ? a / b : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    ReplayOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--duration-s") && has_value) {
+            options.duration_s = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--i2c-hz") && has_value) {
+            options.i2c_hz = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--signal") && has_value) {
+            options.signal = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && has_value) {
+            options.trace = argv[++i];
+        } else if (!strcmp(argv[i], "--summary-only")) {
+            options.summary_only = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.duration_s <= 0 || options.i2c_hz <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string error;
+    SensorSignal *signal = options.trace ? sensor_signal_from_trace(options.trace, error)
+                                         : sensor_signal_from_spec(options.signal, error);
+    if (!signal) {
+        fprintf(stderr, "sampling_replay: %s\n", error.c_str());
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("sampling_replay");
+    if (!out) {
+        return 1;
+    }
+
+    ReplayResult fixed = replay(*signal, options, false, out);
+    ReplayResult adaptive = replay(*signal, options, true, out);
+    print_result(out, "fixed", fixed, options.duration_s);
+    print_result(out, "adaptive", adaptive, options.duration_s);
+    fprintf(out, "{\"phase\":\"comparison\",\"reads_ratio\":%.3f,\"publishes_ratio\":%.3f,"
+            "\"mqtt_bytes_ratio\":%.3f,\"energy_ratio\":%.3f,\"energy_saved_mj\":%.3f}\n",
+            share(adaptive.reads, fixed.reads), share(adaptive.publishes, fixed.publishes),
+            share((double)adaptive.mqtt_bytes, (double)fixed.mqtt_bytes),
+            share(adaptive.energy_uj(), fixed.energy_uj()),
+            (fixed.energy_uj() - adaptive.energy_uj()) / 1000.0);
+    fflush(out);
+
+    delete signal;
+    return 0;
+}
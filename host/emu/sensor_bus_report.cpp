@@ -0,0 +1,190 @@
+/* Runs the firmware's sensors module against the emulated HTS221/LPS22HB and
+ * reports the I2C traffic each sensors_read() generates.
+ *
+ * The real sensors.cpp, HTS221Sensor/LPS22HBSensor, DevI2C and ST drivers are
+ * linked in unchanged; only mbed::I2C underneath DevI2C is emulated. Between
+ * reads the simulated clock moves by the sampling interval, so data-ready
+ * flags and output registers evolve as they would on the board.
+ *
+ * Output is one JSON record for sensors_init(), one per read and a summary.
+ * The --max-* options turn the run into a regression check: the exit status
+ * is 1 if any read exceeds the given budget.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "config.h"
+#include "sensors.h"
+#include "HTS221_driver.h"
+#include "LPS22HB_driver.h"
+
+#include "hts221_model.h"
+#include "i2c_bus_emulator.h"
+#include "lps22hb_model.h"
+#include "sensor_signal.h"
+#include "tool_common.h"
+
+struct ReportOptions {
+    int reads = 100;
+    int interval_ms = SENSOR_UPDATE_INTERVAL_MS;
+    int i2c_hz = 100000;
+    const char *signal = "";
+    const char *trace = nullptr;
+    bool summary_only = false;
+    long max_transfers = -1;
+    long max_bytes = -1;
+    long max_bus_us = -1;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--reads N] [--interval-ms N] [--i2c-hz N] [--signal SPEC | --trace FILE]\n"
+            "       [--summary-only] [--max-transfers-per-read N] [--max-bytes-per-read N]\n"
+            "       [--max-bus-us-per-read N]\n",
+            prog);
+}
+
+static void print_stats(FILE *out, const I2CBusStats &s)
+{
+    fprintf(out, "\"transfers\":%u,\"transactions\":%u,\"bytes\":%u,\"nacks\":%u,\"bus_us\":%.1f",
+            s.transfers, s.transactions, s.bytes, s.nacks, s.bus_ns / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    ReportOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--reads") && has_value) {
+            options.reads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval-ms") && has_value) {
+            options.interval_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--i2c-hz") && has_value) {
+            options.i2c_hz = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--signal") && has_value) {
+            options.signal = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && has_value) {
+            options.trace = argv[++i];
+        } else if (!strcmp(argv[i], "--summary-only")) {
+            options.summary_only = true;
+        } else if (!strcmp(argv[i], "--max-transfers-per-read") && has_value) {
+            options.max_transfers = atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--max-bytes-per-read") && has_value) {
+            options.max_bytes = atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--max-bus-us-per-read") && has_value) {
+            options.max_bus_us = atol(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.reads <= 0 || options.interval_ms < 0 || options.i2c_hz <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string error;
+    SensorSignal *signal = options.trace ? sensor_signal_from_trace(options.trace, error)
+                                         : sensor_signal_from_spec(options.signal, error);
+    if (!signal) {
+        fprintf(stderr, "sensor_bus_report: %s\n", error.c_str());
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("sensor_bus_report");
+    if (!out) {
+        return 1;
+    }
+
+    HTS221Model hts221(*signal);
+    LPS22HBModel lps22hb(*signal);
+    I2CBusEmulator bus(options.i2c_hz);
+    bus.add_device(HTS221_I2C_ADDRESS, &hts221);
+    bus.add_device(LPS22HB_ADDRESS_HIGH, &lps22hb);
+    host_i2c_attach(&bus);
+
+    sensors_init();
+    fprintf(out, "{\"phase\":\"init\",");
+    print_stats(out, bus.stats());
+    fprintf(out, "}\n");
+
+    I2CBusStats total = {0, 0, 0, 0, 0};
+    I2CBusStats worst = {0, 0, 0, 0, 0};
+    double max_err[3] = {0.0, 0.0, 0.0};
+    int invalid = 0;
+    int over_budget = 0;
+
+    for (int i = 0; i < options.reads; i++) {
+        bus.advance_us((uint64_t)options.interval_ms * 1000);
+        bus.reset_stats();
+        SensorTruth truth = signal->at(bus.now_us());
+        SensorData data = sensors_read();
+        const I2CBusStats &s = bus.stats();
+
+        total.transfers += s.transfers;
+        total.transactions += s.transactions;
+        total.bytes += s.bytes;
+        total.nacks += s.nacks;
+        total.bus_ns += s.bus_ns;
+        worst.transfers = s.transfers > worst.transfers ? s.transfers : worst.transfers;
+        worst.transactions = s.transactions > worst.transactions ? s.transactions : worst.transactions;
+        worst.bytes = s.bytes > worst.bytes ? s.bytes : worst.bytes;
+        worst.nacks = s.nacks > worst.nacks ? s.nacks : worst.nacks;
+        worst.bus_ns = s.bus_ns > worst.bus_ns ? s.bus_ns : worst.bus_ns;
+
+        if (!data.temp_valid || !data.humidity_valid || !data.pressure_valid) {
+            invalid++;
+        }
+        double err[3] = {fabs(data.temperature - truth.temperature),
+                         fabs(data.humidity - truth.humidity),
+                         fabs(data.pressure - truth.pressure)};
+        for (int c = 0; c < 3; c++) {
+            max_err[c] = err[c] > max_err[c] ? err[c] : max_err[c];
+        }
+
+        if ((options.max_transfers >= 0 && s.transfers > options.max_transfers) ||
+                (options.max_bytes >= 0 && s.bytes > options.max_bytes) ||
+                (options.max_bus_us >= 0 && s.bus_ns > (uint64_t)options.max_bus_us * 1000)) {
+            over_budget++;
+        }
+
+        if (!options.summary_only) {
+            fprintf(out, "{\"phase\":\"read\",\"read\":%d,\"t_ms\":%llu,", i,
+                    (unsigned long long)(bus.now_us() / 1000));
+            print_stats(out, s);
+            fprintf(out, ",\"temp\":%.2f,\"temp_true\":%.2f,\"humidity\":%.2f,\"humidity_true\":%.2f,"
+                    "\"pressure\":%.2f,\"pressure_true\":%.2f,\"valid\":%s}\n",
+                    data.temperature, truth.temperature, data.humidity, truth.humidity,
+                    data.pressure, truth.pressure,
+                    data.temp_valid && data.humidity_valid && data.pressure_valid ? "true" : "false");
+        }
+    }
+
+    double n = (double)options.reads;
+    fprintf(out, "{\"phase\":\"summary\",\"reads\":%d,\"i2c_hz\":%d,"
+            "\"transfers_per_read\":%.2f,\"transactions_per_read\":%.2f,\"bytes_per_read\":%.2f,"
+            "\"bus_us_per_read\":%.1f,\"max_transfers\":%u,\"max_bytes\":%u,\"max_bus_us\":%.1f,"
+            "\"nacks\":%u,\"invalid_reads\":%d,\"max_err_temp\":%.3f,\"max_err_humidity\":%.3f,"
+            "\"max_err_pressure\":%.3f,\"hts221_conversions\":%u,\"lps22hb_conversions\":%u,"
+            "\"over_budget\":%d}\n",
+            options.reads, bus.hz(),
+            total.transfers / n, total.transactions / n, total.bytes / n,
+            total.bus_ns / 1000.0 / n, worst.transfers, worst.bytes, worst.bus_ns / 1000.0,
+            total.nacks, invalid, max_err[0], max_err[1], max_err[2],
+            hts221.conversions(), lps22hb.conversions(), over_budget);
+    fflush(out);
+
+    host_i2c_attach(nullptr);
+    delete signal;
+
+    if (over_budget) {
+        fprintf(stderr, "sensor_bus_report: %d of %d reads over the I2C budget\n", over_budget, options.reads);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include "sensor_signal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    CHANNEL_TEMPERATURE,
+    CHANNEL_HUMIDITY,
+    CHANNEL_PRESSURE,
+    CHANNEL_COUNT
+};
+
+static const char *const channel_names[CHANNEL_COUNT] = {"temperature", "humidity", "pressure"};
+static const float channel_defaults[CHANNEL_COUNT] = {22.0f, 45.0f, 1013.25f};
+
+// --- Waveforms ---
+
+enum Shape {
+    SHAPE_CONST,
+    SHAPE_SINE,
+    SHAPE_RAMP,
+    SHAPE_STEP
+};
+
+struct Waveform {
+    Shape shape;
+    double a, b, c;
+    double noise_sd;
+};
+
+// Hash of (time, channel) mapped to a standard normal value
+static double noise_at(uint64_t t_us, int channel)
+{
+    uint64_t x = t_us * 0x9E3779B97F4A7C15ull + (uint64_t)(channel + 1) * 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 31;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 29;
+    double u1 = ((x >> 11) + 1) * (1.0 / 9007199254740993.0);
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 32;
+    double u2 = (x >> 11) * (1.0 / 9007199254740992.0);
+    return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+class WaveformSignal : public SensorSignal {
+public:
+    WaveformSignal()
+    {
+        for (int c = 0; c < CHANNEL_COUNT; c++) {
+            Waveform w = {SHAPE_CONST, channel_defaults[c], 0.0, 0.0, 0.0};
+            _channels[c] = w;
+        }
+    }
+
+    void set(int channel, const Waveform &w)
+    {
+        _channels[channel] = w;
+    }
+
+    SensorTruth at(uint64_t t_us) const override
+    {
+        float values[CHANNEL_COUNT];
+        double t = (double)t_us / 1e6;
+        for (int c = 0; c < CHANNEL_COUNT; c++) {
+            const Waveform &w = _channels[c];
+            double v;
+            switch (w.shape) {
+                case SHAPE_SINE:
+                    v = w.a + w.b * sin(6.283185307179586 * t / w.c);
+                    break;
+                case SHAPE_RAMP:
+                    v = w.a + w.b * t;
+                    break;
+                case SHAPE_STEP:
+                    v = t < w.c ? w.a : w.b;
+                    break;
+                default:
+                    v = w.a;
+                    break;
+            }
+            if (w.noise_sd > 0.0) {
+                v += w.noise_sd * noise_at(t_us, c);
+            }
+            values[c] = (float)v;
+        }
+        SensorTruth truth = {values[CHANNEL_TEMPERATURE], values[CHANNEL_HUMIDITY], values[CHANNEL_PRESSURE]};
+        return truth;
+    }
+
+private:
+    Waveform _channels[CHANNEL_COUNT];
+};
+
+static bool parse_waveform(const std::string &text, Waveform &w, std::string &error)
+{
+    std::string body = text;
+    w.noise_sd = 0.0;
+    size_t tilde = body.find('~');
+    if (tilde != std::string::npos) {
+        w.noise_sd = atof(body.c_str() + tilde + 1);
+        body = body.substr(0, tilde);
+    }
+
+    std::vector<double> args;
+    std::string shape;
+    size_t pos = body.find(':');
+    shape = body.substr(0, pos);
+    while (pos != std::string::npos) {
+        size_t next = body.find(':', pos + 1);
+        args.push_back(atof(body.substr(pos + 1, next - pos - 1).c_str()));
+        pos = next;
+    }
+
+    size_t expected;
+    if (shape == "const") {
+        w.shape = SHAPE_CONST;
+        expected = 1;
+    } else if (shape == "sine") {
+        w.shape = SHAPE_SINE;
+        expected = 3;
+    } else if (shape == "ramp") {
+        w.shape = SHAPE_RAMP;
+        expected = 2;
+    } else if (shape == "step") {
+        w.shape = SHAPE_STEP;
+        expected = 3;
+    } else {
+        error = "unknown waveform '" + shape + "'";
+        return false;
+    }
+    if (args.size() != expected) {
+        error = "wrong number of arguments for '" + shape + "'";
+        return false;
+    }
+    if (w.shape == SHAPE_SINE && args[2] <= 0.0) {
+        error = "sine period must be positive";
+        return false;
+    }
+    w.a = args[0];
+    w.b = expected > 1 ? args[1] : 0.0;
+    w.c = expected > 2 ? args[2] : 0.0;
+    return true;
+}
+
+SensorSignal *sensor_signal_from_spec(const char *spec, std::string &error)
+{
+    WaveformSignal *signal = new WaveformSignal();
+    std::string text = spec ? spec : "";
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(';', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string entry = text.substr(start, end - start);
+        start = end + 1;
+        if (entry.empty()) {
+            continue;
+        }
+
+        size_t eq = entry.find('=');
+        int channel = -1;
+        for (int c = 0; c < CHANNEL_COUNT && eq != std::string::npos; c++) {
+            if (entry.compare(0, eq, channel_names[c]) == 0) {
+                channel = c;
+            }
+        }
+        if (channel < 0) {
+            error = "bad signal entry '" + entry + "'";
+            delete signal;
+            return nullptr;
+        }
+        Waveform w;
+        if (!parse_waveform(entry.substr(eq + 1), w, error)) {
+            delete signal;
+            return nullptr;
+        }
+        signal->set(channel, w);
+    }
+    return signal;
+}
+
+// --- Traces ---
+
+struct TracePoint {
+    double t_ms;
+    float values[CHANNEL_COUNT];
+};
+
+class TraceSignal : public SensorSignal {
+public:
+    explicit TraceSignal(std::vector<TracePoint> &points)
+    {
+        _points.swap(points);
+    }
+
+    SensorTruth at(uint64_t t_us) const override
+    {
+        double t_ms = (double)t_us / 1000.0;
+        size_t lo = 0;
+        size_t hi = _points.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (_points[mid].t_ms < t_ms) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        float values[CHANNEL_COUNT];
+        if (hi == 0 || hi == _points.size()) {
+            const TracePoint &p = _points[hi == 0 ? 0 : _points.size() - 1];
+            memcpy(values, p.values, sizeof(values));
+        } else {
+            const TracePoint &a = _points[hi - 1];
+            const TracePoint &b = _points[hi];
+            double f = (t_ms - a.t_ms) / (b.t_ms - a.t_ms);
+            for (int c = 0; c < CHANNEL_COUNT; c++) {
+                values[c] = (float)(a.values[c] + f * (b.values[c] - a.values[c]));
+            }
+        }
+        SensorTruth truth = {values[CHANNEL_TEMPERATURE], values[CHANNEL_HUMIDITY], values[CHANNEL_PRESSURE]};
+        return truth;
+    }
+
+private:
+    std::vector<TracePoint> _points;
+};
+
+SensorSignal *sensor_signal_from_trace(const char *path, std::string &error)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        error = std::string("cannot open ") + path;
+        return nullptr;
+    }
+
+    std::vector<TracePoint> points;
+    char line[256];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        if (strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+
+        TracePoint p;
+        if (sscanf(line, "%lf,%f,%f,%f", &p.t_ms, &p.values[0], &p.values[1], &p.values[2]) != 4) {
+            if (points.empty() && line_no == 1) {
+                continue; // header
+            }
+            error = std::string(path) + ":" + std::to_string(line_no) + ": expected t_ms,temperature,humidity,pressure";
+            fclose(f);
+            return nullptr;
+        }
+        if (!points.empty() && p.t_ms <= points.back().t_ms) {
+            error = std::string(path) + ":" + std::to_string(line_no) + ": timestamps must increase";
+            fclose(f);
+            return nullptr;
+        }
+        points.push_back(p);
+    }
+    fclose(f);
+
+    if (points.empty()) {
+        error = std::string(path) + ": no samples";
+        return nullptr;
+    }
+    return new TraceSignal(points);
+}
@@ -0,0 +1,44 @@
+/* Physical quantities fed to the emulated sensors.
+ *
+ * A signal is either built from a waveform spec or loaded from a CSV trace.
+ *
+ * Waveform spec: semicolon-separated "<channel>=<shape>:<args>[~<noise sd>]"
+ * entries, channel being temperature (degC), humidity (%rH) or pressure (hPa):
+ *
+ *   const:V                   constant V
+ *   sine:MEAN:AMP:PERIOD_S    MEAN + AMP * sin(2 pi t / PERIOD_S)
+ *   ramp:START:PER_S          START + PER_S * t
+ *   step:BEFORE:AFTER:AT_S    BEFORE until AT_S, AFTER from then on
+ *
+ * e.g. "temperature=sine:22:4:600~0.05;pressure=ramp:1013:-0.01". Channels
+ * left out hold 22 degC, 45 %rH and 1013.25 hPa. Noise is a deterministic
+ * function of time, so a run is reproducible.
+ *
+ * Trace: "t_ms,temperature,humidity,pressure" lines, optionally preceded by
+ * a header line; '#' starts a comment. Values are interpolated linearly and
+ * held past either end.
+ */
+#ifndef SENSOR_SIGNAL_H
+#define SENSOR_SIGNAL_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct SensorTruth {
+    float temperature;
+    float humidity;
+    float pressure;
+};
+
+class SensorSignal {
+public:
+    virtual ~SensorSignal() {}
+    virtual SensorTruth at(uint64_t t_us) const = 0;
+};
+
+/** Both return nullptr and set @p error on a malformed spec or file */
+SensorSignal *sensor_signal_from_spec(const char *spec, std::string &error);
+SensorSignal *sensor_signal_from_trace(const char *path, std::string &error);
+
+#endif // SENSOR_SIGNAL_H
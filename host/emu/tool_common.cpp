@@ -0,0 +1,14 @@
+#include "tool_common.h"
+
+#include <unistd.h>
+
+FILE *tool_report_stream(const char *prog)
+{
+    fflush(stdout);
+    FILE *out = fdopen(dup(fileno(stdout)), "w");
+    if (!out || !freopen("/dev/null", "w", stdout)) {
+        perror(prog);
+        return nullptr;
+    }
+    return out;
+}
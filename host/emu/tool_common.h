@@ -0,0 +1,12 @@
+/* Helpers shared by the host tools */
+#ifndef TOOL_COMMON_H
+#define TOOL_COMMON_H
+
+#include <stdio.h>
+
+/** The firmware modules log to stdout: sends stdout to /dev/null and returns
+ *  a stream on the original one for the tool's report. On failure prints
+ *  the error under @p prog and returns nullptr. */
+FILE *tool_report_stream(const char *prog);
+
+#endif // TOOL_COMMON_H
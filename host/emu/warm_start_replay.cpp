@@ -0,0 +1,263 @@
+/* Replays one temperature signal through the tracker and anomaly detector
+ * with resets along the way, once restarting cold after each reset and once
+ * restoring the state saved by persistence.cpp, and compares both with a run
+ * that is never reset.
+ *
+ * The detector, tracker, persistence and record store are the firmware's;
+ * the flash is FlashBlockDevice, laid out like STATE_FLASH_SIZE of the
+ * STM32L475's internal flash. Readings are taken every SAMPLE_INTERVAL_MS
+ * straight from the signal (no sensor emulation) and the RTC keeps running
+ * through a reset unless --rtc-lost is given. With --torn-saves each reset
+ * cuts power halfway through a save, so the boot has to fall back to the
+ * snapshot before it.
+ *
+ * For each run the summary reports:
+ *   untrained_s      time after boots before the detector had a full rate
+ *                    window of its own (a restored model counts as full)
+ *   tracker_blind_s  time the tracker had no valid min/max statistics
+ *   decisions_differ readings whose anomaly decision differs from the
+ *                    uninterrupted run's
+ * and for the warm run the restores, the invalid slots skipped at boot,
+ * the erase counts and the flash lifetime they project to at
+ * --erase-cycles per page.
+ *
+ * Output is JSON lines: a record per boot of the warm run (unless
+ * --summary-only), one summary per run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "temp_tracker.h"
+#include "anomaly_detector.h"
+#include "persistence.h"
+
+#include "flash_block_device.h"
+#include "sensor_signal.h"
+#include "tool_common.h"
+
+enum RunKind {
+    RUN_REFERENCE,  // never reset
+    RUN_COLD,       // state lost at each reset
+    RUN_WARM        // state restored from flash
+};
+
+static const char *const RUN_NAMES[] = {"reference", "cold", "warm"};
+
+struct ReplayOptions {
+    int duration_s = 6 * 3600;
+    int resets = 3;
+    int downtime_s = 30;
+    int erase_cycles = 10000;
+    const char *signal = "temperature=sine:22:4:600~0.05";
+    const char *trace = nullptr;
+    bool torn_saves = false;
+    bool rtc_lost = false;
+    bool summary_only = false;
+};
+
+struct ReplayResult {
+    uint32_t reads = 0;
+    uint32_t boots = 0;
+    uint32_t anomalies = 0;           // times the anomaly flag was raised
+    uint32_t decisions_differ = 0;
+    uint64_t untrained_ms = 0;
+    uint64_t tracker_blind_ms = 0;
+    // Warm run only
+    uint32_t restores = 0;
+    uint32_t invalid_slots = 0;       // summed over boots
+    uint32_t saves = 0;
+    uint32_t torn_saves = 0;
+    uint64_t erases = 0;
+    uint32_t max_page_erases = 0;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--duration-s N] [--resets N] [--downtime-s N] [--signal SPEC | --trace FILE]\n"
+            "          [--torn-saves] [--rtc-lost] [--erase-cycles N] [--summary-only]\n",
+            prog);
+}
+
+// Decisions of the reference run, one per reading slot; others compare
+// against it where they have a reading
+static std::vector<char> reference_decisions;
+
+static ReplayResult replay(const SensorSignal &signal, const ReplayOptions &options, RunKind kind, FILE *out)
+{
+    ReplayResult r;
+    FlashBlockDevice flash(STATE_FLASH_SIZE);
+    const uint64_t end_ms = (uint64_t)options.duration_s * 1000;
+    const uint64_t reset_every_ms = kind == RUN_REFERENCE ? end_ms + 1 : end_ms / (options.resets + 1);
+    if (kind == RUN_REFERENCE) {
+        reference_decisions.assign(end_ms / SAMPLE_INTERVAL_MS + 1, 0);
+    }
+
+    uint64_t now_ms = 0;
+    uint64_t next_reset_ms = reset_every_ms;
+    uint32_t rtc_offset_s = 0;
+    while (now_ms < end_ms) {
+        // Boot
+        r.boots++;
+        temp_tracker_init();
+        anomaly_detector_init();
+        uint32_t rtc_s = (uint32_t)(now_ms / 1000) - rtc_offset_s;
+        bool restored = false;
+        if (kind == RUN_WARM && persistence_init(&flash)) {
+            RecordStoreStats store = record_store_get_stats();
+            RestoreResult restore = persistence_restore(rtc_s);
+            restored = restore.restored;
+            r.restores += restore.restored;
+            r.invalid_slots += store.invalid_slots;
+            if (!options.summary_only) {
+                fprintf(out, "{\"phase\":\"boot\",\"t_s\":%llu,\"restored\":%s,\"age_s\":%ld,\"invalid_slots\":%u,\"seq\":%u}\n",
+                        (unsigned long long)(now_ms / 1000), restore.restored ? "true" : "false", (long)restore.age_s,
+                        store.invalid_slots, store.last_seq);
+            }
+        }
+
+        // Run until the next reset
+        uint32_t rates = 0;
+        uint32_t elapsed_ms = SAMPLE_INTERVAL_MS;
+        bool first = true;
+        bool was_anomalous = false;
+        for (; now_ms < end_ms && now_ms < next_reset_ms; now_ms += SAMPLE_INTERVAL_MS) {
+            float temp = signal.at(now_ms * 1000).temperature;
+            temp_tracker_update(temp, elapsed_ms);
+            AnomalyStatus anomaly = anomaly_detector_process(temp, elapsed_ms);
+            TempStats1Hour stats = temp_tracker_get_stats();
+            rtc_s = (uint32_t)(now_ms / 1000) - rtc_offset_s;
+            if (kind == RUN_WARM) {
+                uint32_t saves_before = record_store_get_stats().saves;
+                persistence_update(first ? 0 : elapsed_ms, rtc_s);
+                r.saves += record_store_get_stats().saves - saves_before;
+            }
+            r.reads++;
+
+            if (!first && rates < RATE_BUFFER_SIZE) {
+                rates++;
+            }
+            if (!restored && rates < RATE_BUFFER_SIZE) {
+                r.untrained_ms += SAMPLE_INTERVAL_MS;
+            }
+            if (!stats.valid) {
+                r.tracker_blind_ms += SAMPLE_INTERVAL_MS;
+            }
+            if (anomaly.is_anomalous && !was_anomalous) {
+                r.anomalies++;
+            }
+            was_anomalous = anomaly.is_anomalous;
+
+            uint64_t slot = now_ms / SAMPLE_INTERVAL_MS;
+            if (kind == RUN_REFERENCE) {
+                reference_decisions[slot] = anomaly.is_anomalous;
+            } else if (reference_decisions[slot] != (char)anomaly.is_anomalous) {
+                r.decisions_differ++;
+            }
+            first = false;
+        }
+        if (now_ms >= end_ms) {
+            break;
+        }
+
+        // Reset, possibly in the middle of a save, then stay off. Readings
+        // resume on the sample grid.
+        if (kind == RUN_WARM && options.torn_saves) {
+            flash.cut_power_after(48);
+            persistence_save(rtc_s);
+            r.torn_saves += flash.power_was_cut();
+        }
+        uint64_t off_ms = (uint64_t)options.downtime_s * 1000;
+        r.tracker_blind_ms += off_ms;
+        now_ms += (off_ms + SAMPLE_INTERVAL_MS - 1) / SAMPLE_INTERVAL_MS * SAMPLE_INTERVAL_MS;
+        next_reset_ms += reset_every_ms;
+        if (options.rtc_lost) {
+            rtc_offset_s = (uint32_t)(now_ms / 1000);
+        }
+    }
+
+    r.erases = flash.total_erases();
+    r.max_page_erases = flash.max_erase_count();
+    return r;
+}
+
+static void print_result(FILE *out, RunKind kind, const ReplayResult &r, const ReplayOptions &options)
+{
+    fprintf(out, "{\"phase\":\"%s\",\"duration_s\":%d,\"boots\":%u,\"reads\":%u,\"anomalies\":%u,"
+            "\"decisions_differ\":%u,\"untrained_s\":%.0f,\"tracker_blind_s\":%.0f",
+            RUN_NAMES[kind], options.duration_s, r.boots, r.reads, r.anomalies,
+            r.decisions_differ, r.untrained_ms / 1000.0, r.tracker_blind_ms / 1000.0);
+    if (kind == RUN_WARM) {
+        // The page erased most often wears out first
+        double erases_per_day = r.max_page_erases * 86400.0 / options.duration_s;
+        fprintf(out, ",\"restores\":%u,\"invalid_slots\":%u,\"saves\":%u,"
+                "\"torn_saves\":%u,\"erases\":%llu,\"max_page_erases\":%u,\"flash_life_years\":%.1f",
+                r.restores, r.invalid_slots, r.saves, r.torn_saves,
+                (unsigned long long)r.erases, r.max_page_erases,
+                erases_per_day > 0.0 ? options.erase_cycles / erases_per_day / 365.0 : -1.0);
+    }
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char **argv)
+{
+    ReplayOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--duration-s") && has_value) {
+            options.duration_s = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--resets") && has_value) {
+            options.resets = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--downtime-s") && has_value) {
+            options.downtime_s = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--erase-cycles") && has_value) {
+            options.erase_cycles = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--signal") && has_value) {
+            options.signal = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && has_value) {
+            options.trace = argv[++i];
+        } else if (!strcmp(argv[i], "--torn-saves")) {
+            options.torn_saves = true;
+        } else if (!strcmp(argv[i], "--rtc-lost")) {
+            options.rtc_lost = true;
+        } else if (!strcmp(argv[i], "--summary-only")) {
+            options.summary_only = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.duration_s <= 0 || options.resets < 0 || options.downtime_s < 0 || options.erase_cycles <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string error;
+    SensorSignal *signal = options.trace ? sensor_signal_from_trace(options.trace, error)
+                                         : sensor_signal_from_spec(options.signal, error);
+    if (!signal) {
+        fprintf(stderr, "warm_start_replay: %s\n", error.c_str());
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("warm_start_replay");
+    if (!out) {
+        return 1;
+    }
+
+    ReplayResult reference = replay(*signal, options, RUN_REFERENCE, out);
+    ReplayResult cold = replay(*signal, options, RUN_COLD, out);
+    ReplayResult warm = replay(*signal, options, RUN_WARM, out);
+    print_result(out, RUN_REFERENCE, reference, options);
+    print_result(out, RUN_COLD, cold, options);
+    print_result(out, RUN_WARM, warm, options);
+    fflush(out);
+
+    delete signal;
+    return 0;
+}
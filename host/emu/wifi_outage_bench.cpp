@@ -0,0 +1,196 @@
+/* Takes the access point away and brings it back, repeatedly, and measures
+ * how long the firmware takes to notice and to get WiFi and MQTT back.
+ *
+ * network_task.cpp runs the link manager and the MQTT reconnects on its own
+ * thread as on the board; this tool's main thread plays main() and
+ * publishes while connected. The WiFi module
+ * is the emulated ISM43362 (joins take --join-ms) and the broker is the
+ * loopback test broker.
+ *
+ * Output is one JSON record per outage and a summary. detect_ms is from the
+ * AP going away to the link manager noticing; wifi_ms and mqtt_ms are from
+ * the AP coming back to the link and the MQTT session being up again.
+ * --no-fast-rejoin turns off looking for the AP between retries, which
+ * leaves the rejoin to the backoff alone.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "anomaly_detector.h"
+#include "link_manager.h"
+#include "mqtt_handler.h"
+#include "network_task.h"
+#include "temp_tracker.h"
+
+#include "ism43362_emulator.h"
+#include "mqtt_test_broker.h"
+#include "tool_common.h"
+
+struct BenchOptions {
+    int outages = 3;
+    int down_ms = 15000;
+    int join_ms = 1000;
+    int timeout_ms = 90000;
+    bool fast_rejoin = true;
+    bool summary_only = false;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--outages N] [--down-ms N] [--join-ms N] [--timeout-ms N]\n"
+            "       [--no-fast-rejoin] [--summary-only]\n",
+            prog);
+}
+
+// One pass of main()'s network step
+static void main_loop_step(int &sample)
+{
+    if (!mqtt_is_connected()) {
+        return;
+    }
+    float temp = 22.0f + 0.01f * (sample++ % 100);
+    SensorData data = {temp, 45.0f, 1013.25f, true, true, true};
+    temp_tracker_update(temp);
+    AnomalyStatus anomaly = anomaly_detector_process(temp);
+    mqtt_publish_data(data, temp_tracker_get_stats(), anomaly);
+}
+
+struct OutageResult {
+    double detect_ms = -1.0;
+    double wifi_ms = -1.0;
+    double mqtt_ms = -1.0;
+    uint32_t joins = 0;
+    uint32_t scans = 0;
+};
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--outages") && has_value) {
+            options.outages = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--down-ms") && has_value) {
+            options.down_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--join-ms") && has_value) {
+            options.join_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--timeout-ms") && has_value) {
+            options.timeout_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--no-fast-rejoin")) {
+            options.fast_rejoin = false;
+        } else if (!strcmp(argv[i], "--summary-only")) {
+            options.summary_only = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.outages < 0 || options.down_ms < 0 || options.join_ms < 0 || options.timeout_ms <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *out = tool_report_stream("wifi_outage_bench");
+    if (!out) {
+        return 1;
+    }
+
+    MQTTTestBroker broker;
+    if (!broker.start()) {
+        perror("wifi_outage_bench: broker");
+        return 1;
+    }
+    ISM43362Emulator &emu = ism43362_board_module();
+    emu.redirect(MQTT_BROKER_HOSTNAME, MQTT_BROKER_PORT, "127.0.0.1", broker.port());
+    emu.set_join_delay_ms(options.join_ms);
+
+    link_manager_set_fast_rejoin(options.fast_rejoin);
+    network_task_start();
+    Timer boot;
+    boot.start();
+    while (network_task_get_state() == NETWORK_TASK_CONNECTING && boot.read_ms() < options.timeout_ms) {
+        ThisThread::sleep_for(10ms);
+    }
+    if (network_task_get_state() != NETWORK_TASK_ONLINE) {
+        fprintf(stderr, "wifi_outage_bench: network did not come up\n");
+        return 1;
+    }
+
+    int sample = 0;
+    int recovered = 0;
+    double wifi_sum = 0.0, wifi_max = 0.0, mqtt_sum = 0.0, mqtt_max = 0.0;
+    for (int o = 0; o < options.outages; o++) {
+        // Start from a settled link: up, session connected, AP remembered
+        Timer settle;
+        settle.start();
+        while (settle.read_ms() < LINK_CHECK_INTERVAL_MS + 500 || !mqtt_is_connected()) {
+            main_loop_step(sample);
+            ThisThread::sleep_for(20ms);
+            if (settle.read_ms() > options.timeout_ms) {
+                break;
+            }
+        }
+
+        OutageResult r;
+        ISM43362Stats before = emu.stats();
+        Timer t;
+        t.start();
+        emu.set_link_up(false);
+        double up_at_ms = -1.0;
+        while (t.read_ms() < options.timeout_ms) {
+            main_loop_step(sample);
+            double now_ms = t.elapsed_time().count() / 1000.0;
+            if (r.detect_ms < 0 && !link_manager_is_up()) {
+                r.detect_ms = now_ms;
+            }
+            if (up_at_ms < 0 && now_ms >= options.down_ms) {
+                emu.set_link_up(true);
+                up_at_ms = now_ms;
+            }
+            if (up_at_ms >= 0 && r.detect_ms >= 0) {
+                if (r.wifi_ms < 0 && link_manager_is_up()) {
+                    r.wifi_ms = now_ms - up_at_ms;
+                }
+                if (r.wifi_ms >= 0 && mqtt_is_connected()) {
+                    r.mqtt_ms = now_ms - up_at_ms;
+                    break;
+                }
+            }
+            ThisThread::sleep_for(10ms);
+        }
+        ISM43362Stats after = emu.stats();
+        r.joins = after.joins - before.joins;
+        r.scans = after.scans - before.scans;
+        if (r.mqtt_ms >= 0) {
+            recovered++;
+            wifi_sum += r.wifi_ms;
+            mqtt_sum += r.mqtt_ms;
+            wifi_max = r.wifi_ms > wifi_max ? r.wifi_ms : wifi_max;
+            mqtt_max = r.mqtt_ms > mqtt_max ? r.mqtt_ms : mqtt_max;
+        }
+        if (!options.summary_only) {
+            LinkStats link = link_manager_get_stats();
+            fprintf(out, "{\"phase\":\"outage\",\"index\":%d,\"down_ms\":%d,\"detect_ms\":%.0f,\"wifi_ms\":%.0f,"
+                    "\"mqtt_ms\":%.0f,\"joins\":%u,\"scans\":%u,\"outage_ms\":%u,\"rejoin_ms\":%ld}\n",
+                    o, options.down_ms, r.detect_ms, r.wifi_ms, r.mqtt_ms, r.joins, r.scans,
+                    link.last_outage_ms, (long)link.last_rejoin_ms);
+            fflush(out);
+        }
+    }
+
+    LinkStats link = link_manager_get_stats();
+    fprintf(out, "{\"phase\":\"summary\",\"fast_rejoin\":%s,\"outages\":%d,\"recovered\":%d,\"join_ms\":%d,"
+            "\"mean_wifi_ms\":%.0f,\"max_wifi_ms\":%.0f,\"mean_mqtt_ms\":%.0f,\"max_mqtt_ms\":%.0f,"
+            "\"join_attempts\":%u,\"channel\":%u,\"bssid_known\":%s}\n",
+            options.fast_rejoin ? "true" : "false", options.outages, recovered, options.join_ms,
+            recovered ? wifi_sum / recovered : 0.0, wifi_max, recovered ? mqtt_sum / recovered : 0.0, mqtt_max,
+            link.join_attempts, link.channel, link.bssid_known ? "true" : "false");
+    fflush(out);
+
+    // The network thread never returns; leave without unwinding it
+    _exit(recovered == options.outages ? 0 : 1);
+}
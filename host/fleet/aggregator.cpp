@@ -0,0 +1,185 @@
+#include "aggregator.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "telemetry_decode.h"
+
+uint64_t fleet_now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// FNV-1a: stable across runs, so a device always lands on the same shard
+static uint32_t device_hash(const char *device, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)device[i]) * 16777619u;
+    }
+    return h;
+}
+
+FleetAggregator::FleetAggregator(int shards, size_t queue_capacity)
+    : _capacity(queue_capacity ? queue_capacity : 1), _running(false), _submitted(0)
+{
+    for (int i = 0; i < (shards > 0 ? shards : 1); i++) {
+        _shards.emplace_back(new Shard());
+    }
+}
+
+FleetAggregator::~FleetAggregator()
+{
+    stop();
+}
+
+void FleetAggregator::start()
+{
+    if (_running.exchange(true)) {
+        return;
+    }
+    for (std::unique_ptr<Shard> &shard : _shards) {
+        Shard *s = shard.get();
+        s->thread = std::thread([this, s]() {
+            run(*s);
+        });
+    }
+}
+
+void FleetAggregator::stop()
+{
+    if (!_running.exchange(false)) {
+        return;
+    }
+    for (std::unique_ptr<Shard> &shard : _shards) {
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+        }
+        shard->ready.notify_all();
+    }
+    for (std::unique_ptr<Shard> &shard : _shards) {
+        shard->thread.join();
+    }
+}
+
+void FleetAggregator::submit(const char *payload, size_t len, uint64_t received_ns)
+{
+    const char *device = "";
+    size_t device_len = 0;
+    telemetry_device(payload, len, &device, &device_len);
+    Shard &shard = *_shards[device_hash(device, device_len) % _shards.size()];
+
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.space.wait(lock, [&]() {
+            return shard.queue.size() < _capacity;
+        });
+        shard.queue.push_back(Message{std::string(payload, len), received_ns});
+        uint32_t depth = (uint32_t)shard.queue.size();
+        shard.max_depth = std::max(shard.max_depth, depth);
+        shard.depth_sum += depth;
+        shard.depth_samples++;
+    }
+    shard.ready.notify_one();
+    _submitted++;
+}
+
+void FleetAggregator::run(Shard &shard)
+{
+    std::deque<Message> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.ready.wait(lock, [&]() {
+                return !shard.queue.empty() || !_running;
+            });
+            if (shard.queue.empty()) {
+                return;
+            }
+            // Take everything queued: one lock round trip per batch, not per reading
+            batch.swap(shard.queue);
+        }
+        shard.space.notify_all();
+        for (const Message &message : batch) {
+            process(shard, message);
+        }
+        batch.clear();
+    }
+}
+
+void FleetAggregator::process(Shard &shard, const Message &message)
+{
+    DataReport report;
+    if (!telemetry_decode_data(message.payload.data(), message.payload.size(), &report)) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.decode_errors++;
+        return;
+    }
+
+    Device *device;
+    {
+        // Inserting may rehash; shard_stats() reads the map size under the lock
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        device = &shard.devices[report.device];
+    }
+    uint64_t seq = device->readings++;
+    device->tracker.update(report.temp);
+    AnomalyStatus status = device->detector.process(report.temp);
+
+    uint64_t done_ns = fleet_now_ns();
+    uint64_t sent_ns = _sent_clock ? _sent_clock(report.device, seq) : 0;
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.anomalies += status.is_anomalous;
+    shard.disagreements += status.is_anomalous != report.anomaly;
+    shard.queue_us.add((uint32_t)((done_ns - message.received_ns) / 1000));
+    if (sent_ns && sent_ns <= done_ns) {
+        shard.end_to_end_us.add((uint32_t)((done_ns - sent_ns) / 1000));
+    }
+    shard.messages++;
+}
+
+uint64_t FleetAggregator::processed() const
+{
+    uint64_t total = 0;
+    for (const std::unique_ptr<Shard> &shard : _shards) {
+        total += shard->messages + shard->decode_errors;
+    }
+    return total;
+}
+
+FleetShardStats FleetAggregator::shard_stats(int index)
+{
+    Shard &shard = *_shards[index];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    FleetShardStats stats;
+    stats.messages = shard.messages;
+    stats.decode_errors = shard.decode_errors;
+    stats.anomalies = shard.anomalies;
+    stats.disagreements = shard.disagreements;
+    stats.devices = (uint32_t)shard.devices.size();
+    stats.depth = (uint32_t)shard.queue.size();
+    stats.max_depth = shard.max_depth;
+    stats.mean_depth = shard.depth_samples ? (double)shard.depth_sum / shard.depth_samples : 0.0;
+    return stats;
+}
+
+FleetLatency FleetAggregator::latency(LatencySamples Shard::*samples)
+{
+    LatencySamples all;
+    for (std::unique_ptr<Shard> &shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        all.merge((*shard).*samples);
+    }
+    return all.summary();
+}
+
+FleetLatency FleetAggregator::queue_latency()
+{
+    return latency(&Shard::queue_us);
+}
+
+FleetLatency FleetAggregator::end_to_end_latency()
+{
+    return latency(&Shard::end_to_end_us);
+}
@@ -0,0 +1,131 @@
+/* Runs the device logic for a whole fleet from its telemetry.
+ *
+ * Data messages (mqtt_format_data_payload() with a "dev" key) are routed by
+ * device ID to one of several shards. Each shard has a worker thread, a
+ * bounded queue and the TempTracker and AnomalyDetector of every device that
+ * hashes to it, so a device's readings are processed in arrival order by one
+ * thread and shards never share state. submit() is called from the thread
+ * that reads the broker connection and blocks while the shard's queue is
+ * full, which pushes back on the broker rather than dropping readings.
+ *
+ * Each reading is scored again here and the decision compared with the one
+ * the device published. They can differ: the payload rounds readings to two
+ * decimals, and a device may not sample at the nominal interval or may have
+ * restored its model after a reset.
+ */
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "anomaly_detector.h"
+#include "latency_samples.h"
+#include "temp_tracker.h"
+
+// steady_clock, in ns: the clock of submit()'s received_ns
+uint64_t fleet_now_ns();
+
+struct FleetShardStats {
+    uint64_t messages;          // readings processed
+    uint64_t decode_errors;
+    uint64_t anomalies;         // flagged by the aggregator's detector
+    uint64_t disagreements;     // the device's decision was different
+    uint32_t devices;
+    uint32_t depth;             // queued now
+    uint32_t max_depth;
+    double mean_depth;          // sampled at every submit()
+};
+
+class FleetAggregator {
+public:
+    // When set, gives the time (fleet_now_ns()) a device's seq-th reading was
+    // published, or 0 if unknown. End-to-end latency is measured from there.
+    typedef std::function<uint64_t(const char *device, uint64_t seq)> SentClock;
+
+    FleetAggregator(int shards, size_t queue_capacity);
+    ~FleetAggregator();
+
+    void set_sent_clock(SentClock clock)
+    {
+        _sent_clock = clock;
+    }
+
+    void start();
+    // Waits for the queues to drain, then stops the workers
+    void stop();
+
+    // A data payload as received at received_ns
+    void submit(const char *payload, size_t len, uint64_t received_ns);
+
+    int shards() const
+    {
+        return (int)_shards.size();
+    }
+    uint64_t submitted() const
+    {
+        return _submitted;
+    }
+    uint64_t processed() const;
+    FleetShardStats shard_stats(int shard);
+    // Across shards: queue (submit to processed) and end-to-end latency
+    FleetLatency queue_latency();
+    FleetLatency end_to_end_latency();
+
+private:
+    struct Device {
+        TempTracker tracker;
+        AnomalyDetector detector;
+        uint64_t readings = 0;
+    };
+
+    struct Message {
+        std::string payload;
+        uint64_t received_ns;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::condition_variable space;
+        std::deque<Message> queue;
+        uint32_t max_depth = 0;
+        uint64_t depth_sum = 0;
+        uint64_t depth_samples = 0;
+
+        // Owned by the worker; read under mutex for the stats, except the
+        // two counts processed() polls without it
+        std::unordered_map<std::string, Device> devices;
+        std::atomic<uint64_t> messages{0};
+        std::atomic<uint64_t> decode_errors{0};
+        uint64_t anomalies = 0;
+        uint64_t disagreements = 0;
+        LatencySamples queue_us;
+        LatencySamples end_to_end_us;
+
+        std::thread thread;
+    };
+
+    void run(Shard &shard);
+    void process(Shard &shard, const Message &message);
+    FleetLatency latency(LatencySamples Shard::*samples);
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    size_t _capacity;
+    std::atomic<bool> _running;
+    std::atomic<uint64_t> _submitted;
+    SentClock _sent_clock;
+};
+
+#endif // AGGREGATOR_H
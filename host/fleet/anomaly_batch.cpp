@@ -0,0 +1,251 @@
+#include "anomaly_batch.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ANOMALY_BATCH_X86 1
+#else
+#define ANOMALY_BATCH_X86 0
+#endif
+
+typedef MonitorConfig Config;
+static const int WINDOW = Config::rate_window;
+static const size_t LANES = 8;  // AVX2 floats per vector; streams are padded to it
+
+// The operations of anomaly_core_process() per stream, for one tick, with the
+// rate interval always Config::sample_interval_ms. Every kernel below does
+// exactly these, lane by lane.
+struct TickArrays {
+    const float *values;
+    float *window;
+    float *slot;        // window + index * padded
+    float *mean;
+    float *m2;
+    float *std_dev;
+    float *last;
+    float *z;
+    uint8_t *anomalous;
+    size_t padded;
+    size_t streams;
+};
+
+static void tick_scalar(const TickArrays &a)
+{
+    const float n = (float)WINDOW;
+    for (size_t s = 0; s < a.streams; s++) {
+        float rate = a.values[s] - a.last[s];
+        a.last[s] = a.values[s];
+
+        float z = (rate - a.mean[s]) / a.std_dev[s];
+        a.z[s] = z;
+        a.anomalous[s] = a.std_dev[s] > Config::min_std_dev && fabsf(z) > Config::z_threshold;
+
+        a.slot[s] = rate;
+        float sum = 0.0f;
+        for (int i = 0; i < WINDOW; i++) {
+            sum += a.window[i * a.padded + s];
+        }
+        float mean = sum / n;
+        float m2 = 0.0f;
+        for (int i = 0; i < WINDOW; i++) {
+            float d = a.window[i * a.padded + s] - mean;
+            m2 += d * d;
+        }
+        a.mean[s] = mean;
+        a.m2[s] = m2;
+        a.std_dev[s] = sqrtf(m2 / n);
+    }
+}
+
+#if ANOMALY_BATCH_X86
+static void tick_sse2(const TickArrays &a)
+{
+    const __m128 n = _mm_set1_ps((float)WINDOW);
+    const __m128 min_std_dev = _mm_set1_ps(Config::min_std_dev);
+    const __m128 threshold = _mm_set1_ps(Config::z_threshold);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (size_t s = 0; s < a.padded; s += 4) {
+        __m128 value = _mm_loadu_ps(a.values + s);
+        __m128 rate = _mm_sub_ps(value, _mm_loadu_ps(a.last + s));
+        _mm_storeu_ps(a.last + s, value);
+
+        __m128 std_dev = _mm_loadu_ps(a.std_dev + s);
+        __m128 z = _mm_div_ps(_mm_sub_ps(rate, _mm_loadu_ps(a.mean + s)), std_dev);
+        _mm_storeu_ps(a.z + s, z);
+        __m128 flagged = _mm_and_ps(_mm_cmpgt_ps(std_dev, min_std_dev),
+                                    _mm_cmpgt_ps(_mm_and_ps(z, abs_mask), threshold));
+        int bits = _mm_movemask_ps(flagged);
+        for (int l = 0; l < 4; l++) {
+            a.anomalous[s + l] = (bits >> l) & 1;
+        }
+
+        _mm_storeu_ps(a.slot + s, rate);
+        __m128 sum = _mm_setzero_ps();
+        for (int i = 0; i < WINDOW; i++) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(a.window + i * a.padded + s));
+        }
+        __m128 mean = _mm_div_ps(sum, n);
+        __m128 m2 = _mm_setzero_ps();
+        for (int i = 0; i < WINDOW; i++) {
+            __m128 d = _mm_sub_ps(_mm_loadu_ps(a.window + i * a.padded + s), mean);
+            m2 = _mm_add_ps(m2, _mm_mul_ps(d, d));
+        }
+        _mm_storeu_ps(a.mean + s, mean);
+        _mm_storeu_ps(a.m2 + s, m2);
+        _mm_storeu_ps(a.std_dev + s, _mm_sqrt_ps(_mm_div_ps(m2, n)));
+    }
+}
+
+// No FMA: a fused multiply-add would round differently from the scalar detector
+__attribute__((target("avx2")))
+static void tick_avx2(const TickArrays &a)
+{
+    const __m256 n = _mm256_set1_ps((float)WINDOW);
+    const __m256 min_std_dev = _mm256_set1_ps(Config::min_std_dev);
+    const __m256 threshold = _mm256_set1_ps(Config::z_threshold);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    for (size_t s = 0; s < a.padded; s += 8) {
+        __m256 value = _mm256_loadu_ps(a.values + s);
+        __m256 rate = _mm256_sub_ps(value, _mm256_loadu_ps(a.last + s));
+        _mm256_storeu_ps(a.last + s, value);
+
+        __m256 std_dev = _mm256_loadu_ps(a.std_dev + s);
+        __m256 z = _mm256_div_ps(_mm256_sub_ps(rate, _mm256_loadu_ps(a.mean + s)), std_dev);
+        _mm256_storeu_ps(a.z + s, z);
+        __m256 flagged = _mm256_and_ps(_mm256_cmp_ps(std_dev, min_std_dev, _CMP_GT_OQ),
+                                       _mm256_cmp_ps(_mm256_and_ps(z, abs_mask), threshold, _CMP_GT_OQ));
+        int bits = _mm256_movemask_ps(flagged);
+        for (int l = 0; l < 8; l++) {
+            a.anomalous[s + l] = (bits >> l) & 1;
+        }
+
+        _mm256_storeu_ps(a.slot + s, rate);
+        __m256 sum = _mm256_setzero_ps();
+        for (int i = 0; i < WINDOW; i++) {
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(a.window + i * a.padded + s));
+        }
+        __m256 mean = _mm256_div_ps(sum, n);
+        __m256 m2 = _mm256_setzero_ps();
+        for (int i = 0; i < WINDOW; i++) {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a.window + i * a.padded + s), mean);
+            m2 = _mm256_add_ps(m2, _mm256_mul_ps(d, d));
+        }
+        _mm256_storeu_ps(a.mean + s, mean);
+        _mm256_storeu_ps(a.m2 + s, m2);
+        _mm256_storeu_ps(a.std_dev + s, _mm256_sqrt_ps(_mm256_div_ps(m2, n)));
+    }
+}
+#endif // ANOMALY_BATCH_X86
+
+bool AnomalyBatch::kernel_supported(Kernel kernel)
+{
+    switch (kernel) {
+    case KERNEL_AUTO:
+    case KERNEL_SCALAR:
+        return true;
+#if ANOMALY_BATCH_X86
+    case KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char *AnomalyBatch::kernel_name(Kernel kernel)
+{
+    switch (kernel) {
+    case KERNEL_AUTO:
+        return "auto";
+    case KERNEL_SCALAR:
+        return "scalar";
+    case KERNEL_SSE2:
+        return "sse2";
+    case KERNEL_AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+AnomalyBatch::AnomalyBatch(size_t streams, Kernel kernel)
+    : _streams(streams),
+      _padded((streams + LANES - 1) / LANES * LANES),
+      _kernel(kernel),
+      _first(true),
+      _index(0),
+      _window((size_t)WINDOW * _padded),
+      _mean(_padded),
+      _m2(_padded),
+      _std_dev(_padded),
+      _last(_padded),
+      _z(_padded),
+      _padded_in(_padded),
+      _padded_out(_padded)
+{
+    if (_kernel == KERNEL_AUTO) {
+        _kernel = kernel_supported(KERNEL_AVX2) ? KERNEL_AVX2 :
+                  kernel_supported(KERNEL_SSE2) ? KERNEL_SSE2 : KERNEL_SCALAR;
+    } else if (!kernel_supported(_kernel)) {
+        _kernel = KERNEL_SCALAR;
+    }
+    reset();
+}
+
+void AnomalyBatch::reset()
+{
+    memset(_window.data(), 0, _window.size() * sizeof(float));
+    memset(_mean.data(), 0, _padded * sizeof(float));
+    memset(_m2.data(), 0, _padded * sizeof(float));
+    memset(_std_dev.data(), 0, _padded * sizeof(float));
+    memset(_last.data(), 0, _padded * sizeof(float));
+    memset(_z.data(), 0, _padded * sizeof(float));
+    _first = true;
+    _index = 0;
+}
+
+void AnomalyBatch::process(const float *values, uint8_t *anomalous)
+{
+    if (_first) {
+        // Can't calculate a rate yet
+        memcpy(_last.data(), values, _streams * sizeof(float));
+        memset(anomalous, 0, _streams);
+        _first = false;
+        return;
+    }
+
+    // The vector kernels run over the padding too; give them whole vectors
+    // of input and output to work on
+    const float *in = values;
+    uint8_t *out = anomalous;
+    if (_kernel != KERNEL_SCALAR && _padded != _streams) {
+        memcpy(_padded_in.data(), values, _streams * sizeof(float));
+        in = _padded_in.data();
+        out = _padded_out.data();
+    }
+
+    TickArrays a = {in, _window.data(), _window.data() + (size_t)_index * _padded, _mean.data(), _m2.data(),
+                    _std_dev.data(), _last.data(), _z.data(), out, _padded, _streams
+                   };
+    switch (_kernel) {
+#if ANOMALY_BATCH_X86
+    case KERNEL_AVX2:
+        tick_avx2(a);
+        break;
+    case KERNEL_SSE2:
+        tick_sse2(a);
+        break;
+#endif
+    default:
+        tick_scalar(a);
+        break;
+    }
+    _index = _index + 1 == WINDOW ? 0 : _index + 1;
+
+    if (out != anomalous) {
+        memcpy(anomalous, out, _streams);
+    }
+}
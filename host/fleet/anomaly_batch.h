@@ -0,0 +1,87 @@
+/* Rate-of-change anomaly detection for many streams at once.
+ *
+ * AnomalyBatch keeps the detector state of every stream in structure-of-
+ * arrays form (the rate window slot by slot, then mean, M2, standard
+ * deviation and last reading, each contiguous across streams) and updates
+ * all of them per process() call with SSE2 or AVX2 kernels, or a scalar
+ * loop elsewhere. Each stream gets the same statistics and decisions as an
+ * AnomalyDetector fed the same readings, bit for bit: the kernels do the
+ * same IEEE operations per lane in the same order, and only the streams
+ * are spread across lanes.
+ *
+ * Every process() call is one tick: one reading per stream, taken a
+ * nominal SAMPLE_INTERVAL_MS after the previous one, so all streams share
+ * the ring position.
+ */
+#ifndef ANOMALY_BATCH_H
+#define ANOMALY_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "config.h"
+
+class AnomalyBatch {
+public:
+    enum Kernel {
+        KERNEL_AUTO,    // the widest one the CPU supports
+        KERNEL_SCALAR,
+        KERNEL_SSE2,
+        KERNEL_AVX2,
+    };
+
+    explicit AnomalyBatch(size_t streams, Kernel kernel = KERNEL_AUTO);
+
+    // Forgets every stream's model
+    void reset();
+
+    // values[s] is stream s's reading; anomalous[s] is set to 1 if it was
+    // flagged, else 0. Both hold streams() entries.
+    void process(const float *values, uint8_t *anomalous);
+
+    size_t streams() const
+    {
+        return _streams;
+    }
+    Kernel kernel() const
+    {
+        return _kernel;
+    }
+
+    // Per stream, after the last process(): the model (as in AnomalyStatus)
+    // and the z-score of the last rate, meaningful where it was flagged
+    const float *means() const
+    {
+        return _mean.data();
+    }
+    const float *std_devs() const
+    {
+        return _std_dev.data();
+    }
+    const float *z_scores() const
+    {
+        return _z.data();
+    }
+
+    static const char *kernel_name(Kernel kernel);
+    static bool kernel_supported(Kernel kernel);
+
+private:
+    size_t _streams;
+    size_t _padded;          // streams rounded up to a whole AVX2 vector
+    Kernel _kernel;
+    bool _first;             // no reading yet: the next one only sets _last
+    int _index;              // next ring slot, shared by all streams
+
+    std::vector<float> _window;   // RATE_BUFFER_SIZE slots of _padded rates
+    std::vector<float> _mean;
+    std::vector<float> _m2;       // sum of squared deviations from the mean
+    std::vector<float> _std_dev;
+    std::vector<float> _last;
+    std::vector<float> _z;
+    std::vector<float> _padded_in;      // process() input and output when
+    std::vector<uint8_t> _padded_out;   // streams is not a whole vector
+};
+
+#endif // ANOMALY_BATCH_H
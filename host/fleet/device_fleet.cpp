@@ -0,0 +1,574 @@
+/* Virtual device fleet: many simulated devices publishing to one broker,
+ * for sizing the broker and the aggregator (fleet_aggregator).
+ *
+ * Each device has its own client ID (--id-prefix and its number) and its own
+ * broker connection, and runs the firmware's reporting path every
+ * --interval-ms: a reading from the input signal, TempTracker,
+ * AnomalyDetector, then mqtt_format_data_payload() and a publish on
+ * MQTT_TOPIC_DATA at --qos. The signal is a waveform spec (--signal) or a
+ * CSV trace (--trace), as for sensor_bus_report; each device reads it at its
+ * own time offset so the fleet is not in lockstep.
+ *
+ * Devices are spread over --threads threads. Each thread runs an event loop
+ * over its devices' connections with poll(), so thousands of connections
+ * need only a few threads. Connections open spread over --ramp-ms (0 opens
+ * them all at once, a connect storm). Faults:
+ *   --storm-every-s S --storm-fraction F  every S seconds, a fraction F of
+ *                                         the connected devices drop their
+ *                                         connection at the same moment
+ *   --fault-disconnect P                  each publish, drop the connection
+ *                                         with probability P
+ *   --fault-corrupt P                     each publish, send a truncated
+ *                                         payload with probability P
+ * A device that lost its connection reconnects after a random delay of up
+ * to --backoff-ms. Readings taken while it is offline are not published.
+ * At QoS 1 at most MQTT_INFLIGHT_WINDOW publishes per device await their
+ * PUBACK; a reading that finds the window full is skipped.
+ *
+ * Without --broker the loopback test broker is started in-process, on
+ * --listen PORT if given so that fleet_aggregator --broker can attach.
+ *
+ * Output is a progress record every --report-ms and a summary: publish rate,
+ * publish lag (reading due to written), PUBACK latency at QoS 1, connect
+ * time and reconnect time (connection lost to CONNACK, backoff included).
+ *
+ * Usage: device_fleet [--broker HOST:PORT | --listen PORT] [--devices N] [--threads N]
+ *                     [--interval-ms MS] [--qos 0|1] [--duration-s S] [--ramp-ms MS]
+ *                     [--signal SPEC | --trace FILE] [--id-prefix STR]
+ *                     [--storm-every-s S] [--storm-fraction F] [--backoff-ms MS]
+ *                     [--fault-disconnect P] [--fault-corrupt P] [--report-ms MS]
+ */
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "anomaly_detector.h"
+#include "mqtt_payload.h"
+#include "temp_tracker.h"
+
+#include "aggregator.h"
+#include "latency_samples.h"
+#include "mqtt_test_broker.h"
+#include "mqtt_wire.h"
+#include "sensor_signal.h"
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;          // 0: in-process test broker
+    uint16_t listen = 0;
+    int devices = 1000;
+    int threads = 1;
+    int interval_ms = 1000;
+    int qos = MQTT_DATA_QOS;
+    double duration_s = 10.0;
+    int ramp_ms = 1000;
+    const char *signal = "temperature=sine:22:3:600~0.05";
+    const char *trace = nullptr;
+    const char *id_prefix = "vdev-";
+    double storm_every_s = 0.0;
+    double storm_fraction = 0.5;
+    int backoff_ms = 500;
+    double fault_disconnect = 0.0;
+    double fault_corrupt = 0.0;
+    int report_ms = 1000;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--broker HOST:PORT | --listen PORT] [--devices N] [--threads N] [--interval-ms MS]\n"
+            "       [--qos 0|1] [--duration-s S] [--ramp-ms MS] [--signal SPEC | --trace FILE] [--id-prefix STR]\n"
+            "       [--storm-every-s S] [--storm-fraction F] [--backoff-ms MS] [--fault-disconnect P]\n"
+            "       [--fault-corrupt P] [--report-ms MS]\n", prog);
+}
+
+// Fleet-wide counters, updated by every thread
+struct Counters {
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> acked{0};
+    std::atomic<uint64_t> offline{0};       // readings taken while disconnected
+    std::atomic<uint64_t> window_full{0};
+    std::atomic<uint64_t> backpressure{0};  // the socket's queue was over its limit
+    std::atomic<uint64_t> corrupted{0};
+    std::atomic<uint64_t> fault_disconnects{0};
+    std::atomic<uint64_t> storm_disconnects{0};
+    std::atomic<uint64_t> lost{0};          // connections closed by the broker or the network
+    std::atomic<uint64_t> connects{0};
+    std::atomic<uint64_t> reconnects{0};
+    std::atomic<uint64_t> connect_failures{0};
+    std::atomic<int> connected{0};
+};
+
+struct Inflight {
+    unsigned short id;
+    uint64_t sent_ns;
+};
+
+struct VirtualDevice {
+    char client_id[32];
+    MqttWire wire;
+    TempTracker tracker;
+    AnomalyDetector detector;
+    uint64_t signal_offset_us;
+    uint64_t next_sample_ns;
+    uint64_t reconnect_ns;      // when to open the connection next
+    uint64_t down_ns;           // when it was lost; 0 for the first connect
+    uint64_t connect_start_ns;
+    bool was_connected = false;
+    Inflight inflight[MQTT_INFLIGHT_WINDOW];
+    int inflight_count = 0;
+};
+
+struct ThreadResult {
+    LatencySamples lag_us;
+    LatencySamples ack_us;
+    LatencySamples connect_us;
+    LatencySamples reconnect_us;
+};
+
+class FleetThread {
+public:
+    FleetThread(const Options &options, const SensorSignal &signal, const struct sockaddr_in &broker,
+                Counters &counters, int first, int count, int stride, uint32_t seed);
+
+    void run(const std::atomic<bool> &running, const std::atomic<int> &storm);
+    // After run(): waits up to timeout_ms for outstanding PUBACKs, then disconnects
+    void finish(int timeout_ms);
+
+    ThreadResult result;
+
+private:
+    uint32_t random();
+    bool chance(double p);
+    void connection_lost(VirtualDevice &device, uint64_t now, bool counted);
+    void sample(VirtualDevice &device, uint64_t now);
+    void poll_once(int timeout_ms);
+
+    const Options &_options;
+    const SensorSignal &_signal;
+    struct sockaddr_in _broker;
+    Counters &_counters;
+    std::vector<std::unique_ptr<VirtualDevice>> _devices;
+    std::vector<struct pollfd> _fds;
+    std::vector<VirtualDevice *> _polled;
+    uint32_t _rng;
+};
+
+FleetThread::FleetThread(const Options &options, const SensorSignal &signal, const struct sockaddr_in &broker,
+                         Counters &counters, int first, int count, int stride, uint32_t seed)
+    : _options(options), _signal(signal), _broker(broker), _counters(counters), _rng(seed ? seed : 1)
+{
+    uint64_t start = fleet_now_ns();
+    for (int d = first; d < count; d += stride) {
+        _devices.emplace_back(new VirtualDevice());
+        VirtualDevice &device = *_devices.back();
+        snprintf(device.client_id, sizeof(device.client_id), "%s%05d", options.id_prefix, d);
+        // Offsets spread over a day of signal time
+        device.signal_offset_us = (uint64_t)(d * 7919ull % 86400) * 1000000ull;
+        device.reconnect_ns = start + (options.ramp_ms > 0 ? (uint64_t)random() % options.ramp_ms * 1000000ull : 0);
+        device.down_ns = 0;
+        device.next_sample_ns = device.reconnect_ns + (uint64_t)options.interval_ms * 1000000ull;
+        MqttWire *wire = &device.wire;
+        VirtualDevice *owner = &device;
+        wire->set_ack_handler([this, owner](unsigned short id) {
+            for (int i = 0; i < owner->inflight_count; i++) {
+                if (owner->inflight[i].id == id) {
+                    result.ack_us.add((uint32_t)((fleet_now_ns() - owner->inflight[i].sent_ns) / 1000));
+                    owner->inflight[i] = owner->inflight[--owner->inflight_count];
+                    _counters.acked++;
+                    return;
+                }
+            }
+        });
+    }
+}
+
+uint32_t FleetThread::random()
+{
+    // xorshift32
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    return _rng;
+}
+
+bool FleetThread::chance(double p)
+{
+    return p > 0.0 && random() < p * 4294967296.0;
+}
+
+void FleetThread::connection_lost(VirtualDevice &device, uint64_t now, bool counted)
+{
+    if (device.wire.is_open()) {
+        device.wire.close(false);
+    }
+    if (device.was_connected) {
+        _counters.connected--;
+        device.was_connected = false;
+        device.down_ns = now;
+        if (!counted) {
+            _counters.lost++;
+        }
+    } else {
+        _counters.connect_failures++;
+    }
+    // Unacknowledged publishes are given up, as with a clean session
+    device.inflight_count = 0;
+    device.reconnect_ns = now + (_options.backoff_ms > 0 ? (uint64_t)(random() % _options.backoff_ms) * 1000000ull : 0);
+}
+
+void FleetThread::sample(VirtualDevice &device, uint64_t now)
+{
+    uint64_t due = device.next_sample_ns;
+    device.next_sample_ns += (uint64_t)_options.interval_ms * 1000000ull;
+    if (device.next_sample_ns < now) {
+        // Fell behind by more than an interval: skip ahead rather than burst
+        device.next_sample_ns = now + (uint64_t)_options.interval_ms * 1000000ull;
+    }
+
+    SensorTruth truth = _signal.at(device.signal_offset_us + (due / 1000));
+    SensorData data = {};
+    data.temperature = truth.temperature;
+    data.humidity = truth.humidity;
+    data.pressure = truth.pressure;
+    data.temp_valid = data.humidity_valid = data.pressure_valid = true;
+    device.tracker.update(data.temperature, _options.interval_ms);
+    AnomalyStatus anomaly = device.detector.process(data.temperature, _options.interval_ms);
+
+    if (device.wire.state() != MqttWire::CONNECTED) {
+        _counters.offline++;
+        return;
+    }
+    if (_options.qos > 0 && device.inflight_count == MQTT_INFLIGHT_WINDOW) {
+        _counters.window_full++;
+        return;
+    }
+    char payload[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+    int len = mqtt_format_data_payload(payload, sizeof(payload), data, device.tracker.get_stats(), anomaly, 0,
+                                       device.client_id);
+    if (len <= 0) {
+        return;
+    }
+    if (chance(_options.fault_corrupt)) {
+        len /= 2;
+        _counters.corrupted++;
+    }
+    unsigned short id = 0;
+    if (!device.wire.publish(MQTT_TOPIC_DATA, payload, len, _options.qos, &id)) {
+        if (device.wire.is_open()) {
+            _counters.backpressure++;
+        } else {
+            connection_lost(device, now, false);
+        }
+        return;
+    }
+    uint64_t sent = fleet_now_ns();
+    result.lag_us.add((uint32_t)((sent - due) / 1000));
+    _counters.published++;
+    if (_options.qos > 0) {
+        device.inflight[device.inflight_count++] = Inflight{id, sent};
+    }
+    if (chance(_options.fault_disconnect)) {
+        _counters.fault_disconnects++;
+        connection_lost(device, now, true);
+    }
+}
+
+void FleetThread::poll_once(int timeout_ms)
+{
+    _fds.clear();
+    _polled.clear();
+    for (std::unique_ptr<VirtualDevice> &device : _devices) {
+        if (device->wire.is_open()) {
+            struct pollfd p = {device->wire.fd(), device->wire.events(), 0};
+            _fds.push_back(p);
+            _polled.push_back(device.get());
+        }
+    }
+    if (_fds.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        return;
+    }
+    if (poll(_fds.data(), _fds.size(), timeout_ms) <= 0) {
+        return;
+    }
+    uint64_t now = fleet_now_ns();
+    for (size_t i = 0; i < _fds.size(); i++) {
+        if (!_fds[i].revents) {
+            continue;
+        }
+        VirtualDevice &device = *_polled[i];
+        MqttWire::State before = device.wire.state();
+        if (!device.wire.service(_fds[i].revents, MqttWire::PublishHandler())) {
+            connection_lost(device, now, false);
+            continue;
+        }
+        if (before != MqttWire::CONNECTED && device.wire.state() == MqttWire::CONNECTED) {
+            result.connect_us.add((uint32_t)((now - device.connect_start_ns) / 1000));
+            if (device.down_ns) {
+                result.reconnect_us.add((uint32_t)((now - device.down_ns) / 1000));
+                _counters.reconnects++;
+            }
+            device.was_connected = true;
+            _counters.connected++;
+            _counters.connects++;
+        }
+    }
+}
+
+void FleetThread::run(const std::atomic<bool> &running, const std::atomic<int> &storm)
+{
+    int storms_seen = 0;
+    while (running) {
+        uint64_t now = fleet_now_ns();
+        bool storming = storm != storms_seen;
+        storms_seen = storm;
+        uint64_t next_due = now + 10000000ull;
+        for (std::unique_ptr<VirtualDevice> &d : _devices) {
+            VirtualDevice &device = *d;
+            if (storming && device.wire.state() == MqttWire::CONNECTED && chance(_options.storm_fraction)) {
+                _counters.storm_disconnects++;
+                connection_lost(device, now, true);
+            }
+            if (!device.wire.is_open() && now >= device.reconnect_ns) {
+                device.connect_start_ns = now;
+                if (!device.wire.start(_broker, device.client_id)) {
+                    connection_lost(device, now, false);
+                }
+            }
+            if (now >= device.next_sample_ns) {
+                sample(device, now);
+            }
+            next_due = std::min(next_due, device.next_sample_ns);
+            if (!device.wire.is_open()) {
+                next_due = std::min(next_due, device.reconnect_ns);
+            }
+        }
+        int timeout_ms = next_due > now ? (int)((next_due - now) / 1000000) : 0;
+        poll_once(timeout_ms);
+    }
+}
+
+void FleetThread::finish(int timeout_ms)
+{
+    uint64_t deadline = fleet_now_ns() + (uint64_t)timeout_ms * 1000000ull;
+    for (;;) {
+        bool waiting = false;
+        for (std::unique_ptr<VirtualDevice> &device : _devices) {
+            waiting |= device->wire.is_open() && (device->inflight_count > 0 || device->wire.pending() > 0);
+        }
+        if (!waiting || fleet_now_ns() >= deadline) {
+            break;
+        }
+        poll_once(10);
+    }
+    for (std::unique_ptr<VirtualDevice> &device : _devices) {
+        device->wire.close(true);
+    }
+}
+
+static void print_latency(const char *name, const FleetLatency &latency)
+{
+    printf(",\"%s\":{\"samples\":%llu,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u}", name,
+            (unsigned long long)latency.samples, latency.p50_us, latency.p90_us, latency.p99_us, latency.max_us);
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--broker") && has_value) {
+            const char *arg = argv[++i];
+            const char *colon = strrchr(arg, ':');
+            if (!colon || colon == arg) {
+                usage(argv[0]);
+                return 2;
+            }
+            options.host.assign(arg, colon - arg);
+            options.port = (uint16_t)atoi(colon + 1);
+        } else if (!strcmp(argv[i], "--listen") && has_value) {
+            options.listen = (uint16_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--devices") && has_value) {
+            options.devices = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && has_value) {
+            options.threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval-ms") && has_value) {
+            options.interval_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--qos") && has_value) {
+            options.qos = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--duration-s") && has_value) {
+            options.duration_s = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--ramp-ms") && has_value) {
+            options.ramp_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--signal") && has_value) {
+            options.signal = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && has_value) {
+            options.trace = argv[++i];
+        } else if (!strcmp(argv[i], "--id-prefix") && has_value) {
+            options.id_prefix = argv[++i];
+        } else if (!strcmp(argv[i], "--storm-every-s") && has_value) {
+            options.storm_every_s = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--storm-fraction") && has_value) {
+            options.storm_fraction = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--backoff-ms") && has_value) {
+            options.backoff_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--fault-disconnect") && has_value) {
+            options.fault_disconnect = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--fault-corrupt") && has_value) {
+            options.fault_corrupt = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--report-ms") && has_value) {
+            options.report_ms = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.devices <= 0 || options.threads <= 0 || options.interval_ms <= 0 || options.qos < 0 ||
+            options.qos > 1 || options.duration_s <= 0 || options.ramp_ms < 0 || options.backoff_ms < 0 ||
+            options.report_ms <= 0 || strlen(options.id_prefix) > 20) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string error;
+    std::unique_ptr<SensorSignal> signal(options.trace ? sensor_signal_from_trace(options.trace, error)
+                                                       : sensor_signal_from_spec(options.signal, error));
+    if (!signal) {
+        fprintf(stderr, "device_fleet: %s\n", error.c_str());
+        return 2;
+    }
+
+    // Each device is a socket, twice over with the in-process broker
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    MQTTTestBroker broker;
+    if (options.port == 0) {
+        if (!broker.start(options.listen)) {
+            fprintf(stderr, "device_fleet: cannot start the test broker\n");
+            return 1;
+        }
+        options.port = broker.port();
+        printf("{\"broker\":\"127.0.0.1:%u\"}\n", options.port);
+        fflush(stdout);
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *resolved = nullptr;
+    if (getaddrinfo(options.host.c_str(), nullptr, &hints, &resolved) != 0 || !resolved) {
+        fprintf(stderr, "device_fleet: cannot resolve %s\n", options.host.c_str());
+        return 1;
+    }
+    memcpy(&address, resolved->ai_addr, sizeof(address));
+    address.sin_port = htons(options.port);
+    freeaddrinfo(resolved);
+
+    Counters counters;
+    std::vector<std::unique_ptr<FleetThread>> fleet;
+    for (int t = 0; t < options.threads; t++) {
+        fleet.emplace_back(new FleetThread(options, *signal, address, counters, t, options.devices, options.threads,
+                                           0x9e3779b9u * (t + 1)));
+    }
+    std::atomic<bool> running(true);
+    std::atomic<int> storm(0);
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<FleetThread> &thread : fleet) {
+        FleetThread *t = thread.get();
+        threads.emplace_back([t, &running, &storm]() {
+            t->run(running, storm);
+        });
+    }
+
+    uint64_t start = fleet_now_ns();
+    uint64_t end = start + (uint64_t)(options.duration_s * 1e9);
+    uint64_t next_storm = options.storm_every_s > 0 ? start + (uint64_t)(options.storm_every_s * 1e9) : UINT64_MAX;
+    uint64_t next_report = start + (uint64_t)options.report_ms * 1000000ull;
+    uint64_t last_report = start, last_published = 0;
+    for (;;) {
+        uint64_t now = fleet_now_ns();
+        if (now >= end) {
+            break;
+        }
+        if (now >= next_storm) {
+            storm++;
+            next_storm += (uint64_t)(options.storm_every_s * 1e9);
+        }
+        if (now >= next_report) {
+            uint64_t published = counters.published;
+            printf("{\"t_s\":%.1f,\"connected\":%d,\"published\":%llu,\"acked\":%llu,\"msgs_per_s\":%.0f,"
+                   "\"storms\":%d,\"reconnects\":%llu}\n",
+                   (now - start) / 1e9, counters.connected.load(), (unsigned long long)published,
+                   (unsigned long long)counters.acked.load(), (published - last_published) * 1e9 / (now - last_report),
+                   storm.load(), (unsigned long long)counters.reconnects.load());
+            fflush(stdout);
+            last_report = now;
+            last_published = published;
+            next_report += (uint64_t)options.report_ms * 1000000ull;
+        }
+        uint64_t next = std::min(std::min(next_storm, next_report), end);
+        std::this_thread::sleep_for(std::chrono::nanoseconds(next > now ? next - now : 0));
+    }
+    running = false;
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    uint64_t run_ns = fleet_now_ns() - start;
+    for (std::unique_ptr<FleetThread> &thread : fleet) {
+        thread->finish(1000);
+    }
+
+    ThreadResult total;
+    for (std::unique_ptr<FleetThread> &thread : fleet) {
+        total.lag_us.merge(thread->result.lag_us);
+        total.ack_us.merge(thread->result.ack_us);
+        total.connect_us.merge(thread->result.connect_us);
+        total.reconnect_us.merge(thread->result.reconnect_us);
+    }
+    printf("{\"summary\":true,\"devices\":%d,\"threads\":%d,\"qos\":%d,\"interval_ms\":%d,\"published\":%llu,"
+           "\"acked\":%llu,\"msgs_per_s\":%.0f,\"offered_per_s\":%.0f,\"offline\":%llu,\"window_full\":%llu,"
+           "\"backpressure\":%llu,\"corrupted\":%llu,\"storms\":%d,\"storm_disconnects\":%llu,"
+           "\"fault_disconnects\":%llu,\"lost\":%llu,\"connects\":%llu,\"reconnects\":%llu,"
+           "\"connect_failures\":%llu",
+           options.devices, options.threads, options.qos, options.interval_ms,
+           (unsigned long long)counters.published.load(), (unsigned long long)counters.acked.load(),
+           counters.published * 1e9 / run_ns, options.devices * 1000.0 / options.interval_ms,
+           (unsigned long long)counters.offline.load(), (unsigned long long)counters.window_full.load(),
+           (unsigned long long)counters.backpressure.load(), (unsigned long long)counters.corrupted.load(),
+           storm.load(), (unsigned long long)counters.storm_disconnects.load(),
+           (unsigned long long)counters.fault_disconnects.load(), (unsigned long long)counters.lost.load(),
+           (unsigned long long)counters.connects.load(), (unsigned long long)counters.reconnects.load(),
+           (unsigned long long)counters.connect_failures.load());
+    if (broker.port()) {
+        MQTTBrokerStats stats = broker.stats();
+        printf(",\"broker_publishes\":%u", stats.publishes);
+    }
+    print_latency("lag", total.lag_us.summary());
+    print_latency("ack", total.ack_us.summary());
+    print_latency("connect", total.connect_us.summary());
+    print_latency("reconnect", total.reconnect_us.summary());
+    printf("}\n");
+    broker.stop();
+    return 0;
+}
@@ -0,0 +1,332 @@
+/* Fleet aggregator: subscribes to the devices' topics on a broker and runs
+ * every device's tracker and detector on the server (aggregator.h).
+ *
+ * One thread reads the subscription and hands each data message to the
+ * shard that owns its device; --shards worker threads process them. Without
+ * --broker the loopback test broker is started in-process.
+ *
+ * --devices virtual devices publish data messages at --rate messages per
+ * second in total, over --connections broker connections, one thread each.
+ * Each runs the firmware's TempTracker and AnomalyDetector on its own
+ * synthetic signal (a daily swing, noise and the odd step) and formats the
+ * report with mqtt_format_data_payload(), "dev" included. --devices 0
+ * generates nothing and only aggregates what the broker delivers.
+ *
+ * Output is a progress record every --report-ms, one record per shard
+ * (readings, devices, queue depth) and a summary: ingest rate, queue latency
+ * (received to processed) and, for the virtual devices, end-to-end latency
+ * (published to processed), and how often the server's anomaly decision
+ * differed from the device's.
+ *
+ * Usage: fleet_aggregator [--broker HOST:PORT] [--shards N] [--duration-s S]
+ *                         [--devices N] [--rate MSG/S] [--connections N]
+ *                         [--queue N] [--report-ms MS]
+ */
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "anomaly_detector.h"
+#include "mqtt_payload.h"
+#include "temp_tracker.h"
+
+#include "aggregator.h"
+#include "mqtt_wire.h"
+#include "mqtt_test_broker.h"
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;          // 0: in-process test broker
+    int shards = 0;             // 0: one per core
+    double duration_s = 5.0;
+    int devices = 1000;
+    double rate = 10000.0;
+    int connections = 4;
+    size_t queue = 4096;
+    int report_ms = 1000;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--broker HOST:PORT] [--shards N] [--duration-s S] [--devices N] [--rate MSG/S]\n"
+            "       [--connections N] [--queue N] [--report-ms MS]\n", prog);
+}
+
+static const char DEVICE_PREFIX[] = "vdev-";
+
+// Publish times of the virtual devices' recent readings, by device and seq
+static const uint64_t SENT_SLOTS = 256;
+static std::unique_ptr<std::atomic<uint64_t>[]> sent_ns;
+static int virtual_devices;
+
+static uint64_t sent_clock(const char *device, uint64_t seq)
+{
+    if (strncmp(device, DEVICE_PREFIX, sizeof(DEVICE_PREFIX) - 1) != 0) {
+        return 0;
+    }
+    int index = atoi(device + sizeof(DEVICE_PREFIX) - 1);
+    if (index < 0 || index >= virtual_devices) {
+        return 0;
+    }
+    return sent_ns[(uint64_t)index * SENT_SLOTS + seq % SENT_SLOTS].load(std::memory_order_relaxed);
+}
+
+struct VirtualDevice {
+    char name[sizeof(DEVICE_PREFIX) + 11];  // prefix and any int
+    TempTracker tracker;
+    AnomalyDetector detector;
+    uint64_t seq = 0;
+    uint32_t rng;
+    float offset = 0.0f;
+};
+
+static float next_reading(VirtualDevice &device, int index)
+{
+    // xorshift32
+    device.rng ^= device.rng << 13;
+    device.rng ^= device.rng >> 17;
+    device.rng ^= device.rng << 5;
+    float noise = ((device.rng & 0xffff) / 65535.0f - 0.5f) * 0.1f;
+    if ((device.rng >> 16) % 2000 == 0) {
+        device.offset += ((device.rng >> 8) & 1) ? 2.5f : -2.5f;
+    }
+    float day = sinf((float)(device.seq + index * 97) * 0.002f);
+    return 21.0f + 3.0f * day + noise + device.offset;
+}
+
+// Publishes for the devices index % connections == connection, paced so all
+// connections together send options.rate messages per second
+static void run_publisher(const Options &options, int connection, std::atomic<bool> &running,
+                          std::atomic<uint64_t> &published, std::atomic<uint64_t> &failed)
+{
+    MqttWire wire;
+    char client_id[32];
+    snprintf(client_id, sizeof(client_id), "fleet-load-%d", connection);
+    if (!wire.open(options.host.c_str(), options.port, client_id)) {
+        fprintf(stderr, "fleet_aggregator: publisher %d cannot connect\n", connection);
+        return;
+    }
+
+    std::vector<std::unique_ptr<VirtualDevice>> devices;
+    for (int d = connection; d < options.devices; d += options.connections) {
+        devices.emplace_back(new VirtualDevice());
+        VirtualDevice &device = *devices.back();
+        snprintf(device.name, sizeof(device.name), "%s%05d", DEVICE_PREFIX, d);
+        device.rng = 0x9e3779b9u ^ (uint32_t)(d * 2654435761u);
+    }
+    if (devices.empty()) {
+        return;
+    }
+    double interval_ns = 1e9 * options.connections / options.rate;
+    uint64_t start = fleet_now_ns();
+    char payload[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+    for (uint64_t n = 0; running; n++) {
+        uint64_t due = start + (uint64_t)(n * interval_ns);
+        uint64_t now = fleet_now_ns();
+        if (due > now) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+        }
+        size_t slot = n % devices.size();
+        VirtualDevice &device = *devices[slot];
+        int index = (int)(slot * options.connections + connection);
+
+        SensorData data = {};
+        data.temperature = next_reading(device, index);
+        data.humidity = 45.0f;
+        data.pressure = 1013.0f;
+        data.temp_valid = data.humidity_valid = data.pressure_valid = true;
+        device.tracker.update(data.temperature);
+        AnomalyStatus anomaly = device.detector.process(data.temperature);
+        int len = mqtt_format_data_payload(payload, sizeof(payload), data, device.tracker.get_stats(), anomaly, 0,
+                                           device.name);
+        sent_ns[(uint64_t)index * SENT_SLOTS + device.seq % SENT_SLOTS].store(fleet_now_ns(),
+                                                                              std::memory_order_relaxed);
+        device.seq++;
+        if (len > 0 && wire.publish(MQTT_TOPIC_DATA, payload, len)) {
+            published++;
+        } else {
+            failed++;
+            if (!wire.is_open()) {
+                return;
+            }
+        }
+    }
+    wire.close();
+}
+
+static void print_latency(const char *name, const FleetLatency &latency)
+{
+    printf("\"%s\":{\"samples\":%llu,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u}", name,
+           (unsigned long long)latency.samples, latency.p50_us, latency.p90_us, latency.p99_us, latency.max_us);
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--broker") && has_value) {
+            const char *arg = argv[++i];
+            const char *colon = strrchr(arg, ':');
+            if (!colon || colon == arg) {
+                usage(argv[0]);
+                return 2;
+            }
+            options.host.assign(arg, colon - arg);
+            options.port = (uint16_t)atoi(colon + 1);
+        } else if (!strcmp(argv[i], "--shards") && has_value) {
+            options.shards = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--duration-s") && has_value) {
+            options.duration_s = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--devices") && has_value) {
+            options.devices = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--rate") && has_value) {
+            options.rate = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--connections") && has_value) {
+            options.connections = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--queue") && has_value) {
+            options.queue = (size_t)atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--report-ms") && has_value) {
+            options.report_ms = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.shards <= 0) {
+        options.shards = (int)std::thread::hardware_concurrency();
+        if (options.shards <= 0) {
+            options.shards = 1;
+        }
+    }
+    if (options.duration_s <= 0 || options.devices < 0 || options.connections <= 0 || options.queue == 0 ||
+            options.report_ms <= 0 || (options.devices > 0 && options.rate <= 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    MQTTTestBroker broker;
+    if (options.port == 0) {
+        if (!broker.start()) {
+            fprintf(stderr, "fleet_aggregator: cannot start the test broker\n");
+            return 1;
+        }
+        options.port = broker.port();
+    }
+
+    virtual_devices = options.devices;
+    sent_ns.reset(new std::atomic<uint64_t>[(size_t)options.devices * SENT_SLOTS + 1]());
+
+    FleetAggregator aggregator(options.shards, options.queue);
+    aggregator.set_sent_clock(sent_clock);
+    aggregator.start();
+
+    MqttWire subscriber;
+    if (!subscriber.open(options.host.c_str(), options.port, "fleet-aggregator") ||
+            !subscriber.subscribe("iot-temp-monitor/#")) {
+        fprintf(stderr, "fleet_aggregator: cannot subscribe on %s:%u\n", options.host.c_str(), options.port);
+        return 1;
+    }
+    std::atomic<bool> reading(true);
+    std::atomic<uint64_t> other_messages(0);
+    std::atomic<uint64_t> last_arrival_ns(fleet_now_ns());
+    std::thread reader([&]() {
+        const size_t data_topic_len = strlen(MQTT_TOPIC_DATA);
+        while (reading && subscriber.is_open()) {
+            struct pollfd p = {subscriber.fd(), POLLIN, 0};
+            if (poll(&p, 1, 10) <= 0) {
+                continue;
+            }
+            subscriber.receive([&](const char *topic, size_t topic_len, const char *payload, size_t len) {
+                uint64_t now = fleet_now_ns();
+                last_arrival_ns = now;
+                if (topic_len == data_topic_len && !memcmp(topic, MQTT_TOPIC_DATA, topic_len)) {
+                    aggregator.submit(payload, len, now);
+                } else {
+                    other_messages++;
+                }
+            });
+        }
+    });
+
+    std::atomic<bool> publishing(true);
+    std::atomic<uint64_t> published(0), failed(0);
+    std::vector<std::thread> publishers;
+    for (int c = 0; c < options.connections && c < options.devices; c++) {
+        publishers.emplace_back(run_publisher, std::cref(options), c, std::ref(publishing), std::ref(published),
+                                std::ref(failed));
+    }
+
+    uint64_t start = fleet_now_ns();
+    uint64_t end = start + (uint64_t)(options.duration_s * 1e9);
+    uint64_t last_report = start;
+    uint64_t last_processed = 0;
+    while (fleet_now_ns() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.report_ms));
+        uint64_t now = fleet_now_ns();
+        uint64_t processed = aggregator.processed();
+        uint32_t depth = 0;
+        for (int s = 0; s < aggregator.shards(); s++) {
+            depth += aggregator.shard_stats(s).depth;
+        }
+        printf("{\"t_s\":%.1f,\"published\":%llu,\"processed\":%llu,\"msgs_per_s\":%.0f,\"queued\":%u}\n",
+               (now - start) / 1e9, (unsigned long long)published.load(), (unsigned long long)processed,
+               (processed - last_processed) * 1e9 / (now - last_report), depth);
+        fflush(stdout);
+        last_report = now;
+        last_processed = processed;
+    }
+
+    publishing = false;
+    for (std::thread &t : publishers) {
+        t.join();
+    }
+    uint64_t run_ns = fleet_now_ns() - start;
+    // Let what the broker still holds arrive: done once nothing has for 200 ms
+    while (fleet_now_ns() - last_arrival_ns < 200000000ull) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    reading = false;
+    reader.join();
+    aggregator.stop();
+    subscriber.close();
+
+    uint64_t messages = 0, errors = 0, anomalies = 0, disagreements = 0, devices = 0;
+    for (int s = 0; s < aggregator.shards(); s++) {
+        FleetShardStats stats = aggregator.shard_stats(s);
+        printf("{\"shard\":%d,\"messages\":%llu,\"devices\":%u,\"anomalies\":%llu,\"max_depth\":%u,"
+               "\"mean_depth\":%.1f}\n", s, (unsigned long long)stats.messages, stats.devices,
+               (unsigned long long)stats.anomalies, stats.max_depth, stats.mean_depth);
+        messages += stats.messages;
+        errors += stats.decode_errors;
+        anomalies += stats.anomalies;
+        disagreements += stats.disagreements;
+        devices += stats.devices;
+    }
+    printf("{\"summary\":true,\"shards\":%d,\"devices\":%llu,\"published\":%llu,\"publish_failures\":%llu,"
+           "\"messages\":%llu,\"decode_errors\":%llu,\"other_messages\":%llu,\"msgs_per_s\":%.0f,"
+           "\"anomalies\":%llu,\"disagreements\":%llu,",
+           aggregator.shards(), (unsigned long long)devices, (unsigned long long)published.load(),
+           (unsigned long long)failed.load(), (unsigned long long)messages, (unsigned long long)errors,
+           (unsigned long long)other_messages.load(), messages * 1e9 / run_ns, (unsigned long long)anomalies,
+           (unsigned long long)disagreements);
+    print_latency("queue", aggregator.queue_latency());
+    printf(",");
+    print_latency("end_to_end", aggregator.end_to_end_latency());
+    printf("}\n");
+
+    broker.stop();
+    bool lost = options.devices > 0 && messages + errors < published;
+    return errors == 0 && !lost ? 0 : 1;
+}
@@ -0,0 +1,443 @@
+/* Re-scores recorded sensor history with the device's detector and tracker,
+ * e.g. after retuning the z-score threshold or the rate window.
+ *
+ * Each input is the history of one device, or a directory of them: a
+ * binary trace (.trace, trace_file.h), read in place from a mapping, or a
+ * CSV trace ("t_ms,temperature,humidity,pressure", the sensor_bus_report
+ * trace format; the file name without its extension is the device ID),
+ * which has to be parsed. Every reading goes
+ * through TempTracker's kernel and the detector's, with the time since the
+ * previous reading as the elapsed time, as on the device. The detector is
+ * the runtime-tuned instantiation (MonitorConfigRuntimeThreshold over a
+ * runtime window of up to 64), so --z-threshold and --window need no
+ * rebuild; --reference uses the firmware's own AnomalyDetector instead.
+ *
+ * Devices are independent, so each is one task for a work-stealing pool of
+ * --threads threads (work_pool.h), largest file first.
+ *
+ * Output is one record per device (readings, anomalies, span, min/max, the
+ * longest gap between readings), then a summary with the throughput in
+ * samples/s and how the work was spread over the threads. --timeline FILE
+ * writes every anomaly event, device by device in input order:
+ * {"dev":...,"t_ms":...,"temp":...,"z":...,"rate":...,"mean":...,"std_dev":...}
+ *
+ * Usage: history_reprocess [--threads N] [--z-threshold Z] [--window N] [--reference]
+ *                          [--timeline FILE] [--summary-only] PATH...
+ */
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "anomaly_detector.h"
+#include "anomaly_detector_core.h"
+#include "temp_tracker_core.h"
+
+#include "aggregator.h"
+#include "trace_file.h"
+#include "work_pool.h"
+
+// Up to 64 readings in the rate window, and the threshold, chosen per run
+typedef MonitorConfigRuntimeThreshold<MonitorConfigRuntimeWindow<64>> RetuneConfig;
+
+struct Options {
+    int threads = 0;            // 0: one per core
+    float z_threshold = ANOMALY_Z_SCORE_THRESHOLD;
+    int window = RATE_BUFFER_SIZE;
+    bool reference = false;
+    const char *timeline = nullptr;
+    bool summary_only = false;
+    std::vector<std::string> paths;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--threads N] [--z-threshold Z] [--window N] [--reference] [--timeline FILE]\n"
+            "       [--summary-only] PATH...\n", prog);
+}
+
+struct DeviceHistory {
+    std::string path;
+    std::string device;
+    uint64_t bytes;
+    bool trace;                 // binary trace (trace_file.h), else CSV
+
+    // Results
+    bool ok;
+    uint64_t readings;
+    uint64_t anomalies;         // events: flagged rate evaluations
+    uint64_t periods;           // statistics periods completed
+    double first_ms;
+    double last_ms;
+    double max_gap_ms;
+    float min_temp;
+    float max_temp;
+    std::string timeline;
+};
+
+static bool ends_with(const std::string &s, const char *suffix)
+{
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static void add_history(std::vector<DeviceHistory> &histories, const std::string &path, uint64_t bytes)
+{
+    DeviceHistory history = DeviceHistory();
+    history.path = path;
+    size_t slash = path.find_last_of('/');
+    history.device = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    size_t dot = history.device.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        history.device.resize(dot);
+    }
+    history.bytes = bytes;
+    history.trace = ends_with(path, ".trace");
+    if (history.trace) {
+        // The device ID is in the header
+        TraceReader reader;
+        std::string error;
+        if (reader.open(path.c_str(), error)) {
+            history.device = reader.device();
+        }
+    }
+    histories.push_back(history);
+}
+
+// Files as given; directories contribute their *.csv and *.trace files, sorted by name
+static bool collect(const std::string &path, std::vector<DeviceHistory> &histories)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        fprintf(stderr, "history_reprocess: cannot open %s\n", path.c_str());
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        add_history(histories, path, (uint64_t)st.st_size);
+        return true;
+    }
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        fprintf(stderr, "history_reprocess: cannot read %s\n", path.c_str());
+        return false;
+    }
+    std::vector<std::string> names;
+    while (struct dirent *entry = readdir(dir)) {
+        if (ends_with(entry->d_name, ".csv") || ends_with(entry->d_name, ".trace")) {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    for (const std::string &name : names) {
+        std::string file = path + "/" + name;
+        if (stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            add_history(histories, file, (uint64_t)st.st_size);
+        }
+    }
+    return true;
+}
+
+static bool read_file(const std::string &path, std::string &data)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    data.clear();
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.append(buf, n);
+    }
+    fclose(f);
+    return true;
+}
+
+// The detector behind a common interface: the retunable instantiation or the firmware's
+class RetunedDetector {
+public:
+    RetunedDetector(const Options &options)
+    {
+        anomaly_core_reset(_core, options.window, options.z_threshold);
+    }
+    AnomalyStatus process(float value, uint32_t elapsed_ms)
+    {
+        return anomaly_core_process(_core, value, elapsed_ms);
+    }
+    bool take_event(AnomalyEvent *event)
+    {
+        return anomaly_core_take_event(_core, event);
+    }
+
+private:
+    AnomalyDetectorCore<RetuneConfig> _core;
+};
+
+class ReferenceDetector {
+public:
+    ReferenceDetector(const Options &)
+    {
+    }
+    AnomalyStatus process(float value, uint32_t elapsed_ms)
+    {
+        return _detector.process(value, elapsed_ms);
+    }
+    bool take_event(AnomalyEvent *event)
+    {
+        return _detector.take_event(event);
+    }
+
+private:
+    AnomalyDetector _detector;
+};
+
+// Feeds one device's readings, in time order, through the tracker and detector
+template <typename Detector>
+class HistoryScorer {
+public:
+    HistoryScorer(const Options &options, DeviceHistory &history)
+        : _options(options), _history(history), _detector(options), _previous_ms(0.0)
+    {
+        temp_core_reset(_tracker);
+        history.min_temp = 1e30f;
+        history.max_temp = -1e30f;
+    }
+
+    void add(double t_ms, float temp)
+    {
+        DeviceHistory &history = _history;
+        uint32_t elapsed_ms = MonitorConfig::sample_interval_ms;
+        if (history.readings == 0) {
+            history.first_ms = t_ms;
+        } else {
+            double gap = t_ms - _previous_ms;
+            history.max_gap_ms = std::max(history.max_gap_ms, gap);
+            elapsed_ms = gap > 0 ? (uint32_t)(gap + 0.5) : 0;
+        }
+        _previous_ms = t_ms;
+        history.readings++;
+        history.min_temp = std::min(history.min_temp, temp);
+        history.max_temp = std::max(history.max_temp, temp);
+
+        history.periods += temp_core_update(_tracker, temp, elapsed_ms);
+        _detector.process(temp, elapsed_ms);
+        AnomalyEvent event;
+        if (_detector.take_event(&event)) {
+            history.anomalies++;
+            if (_options.timeline) {
+                char record[256];
+                int len = snprintf(record, sizeof(record),
+                                   "{\"dev\":\"%s\",\"t_ms\":%.0f,\"temp\":%.2f,\"z\":%.2f,\"rate\":%.4f,"
+                                   "\"mean\":%.4f,\"std_dev\":%.4f}\n",
+                                   history.device.c_str(), t_ms, temp, event.z_score, event.rate, event.mean,
+                                   event.std_dev);
+                if (len > 0) {
+                    history.timeline.append(record, std::min(len, (int)sizeof(record) - 1));
+                }
+            }
+        }
+    }
+
+    void finish()
+    {
+        _history.last_ms = _previous_ms;
+        _history.ok = true;
+    }
+
+private:
+    const Options &_options;
+    DeviceHistory &_history;
+    Detector _detector;
+    TempTrackerCore<MonitorConfig> _tracker;
+    double _previous_ms;
+};
+
+template <typename Detector>
+static void reprocess_csv(const Options &options, DeviceHistory &history)
+{
+    std::string data;
+    if (!read_file(history.path, data)) {
+        return;
+    }
+    HistoryScorer<Detector> scorer(options, history);
+    const char *p = data.c_str();
+    const char *end = p + data.size();
+    while (p < end) {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol) {
+            eol = end;
+        }
+        const char *line = p;
+        p = eol + 1;
+        // Header, comments and blank lines do not start with a number
+        if (line == eol || !(*line == '-' || *line == '.' || (*line >= '0' && *line <= '9'))) {
+            continue;
+        }
+        char *next;
+        double t_ms = strtod(line, &next);
+        if (*next != ',') {
+            continue;
+        }
+        const char *field = next + 1;
+        float temp = strtof(field, &next);
+        if (next == field) {
+            continue;
+        }
+        scorer.add(t_ms, temp);
+    }
+    scorer.finish();
+}
+
+// Straight from the mapped file: no parsing, no copy
+template <typename Detector>
+static void reprocess_trace(const Options &options, DeviceHistory &history)
+{
+    TraceReader reader;
+    std::string error;
+    if (!reader.open(history.path.c_str(), error)) {
+        return;
+    }
+    HistoryScorer<Detector> scorer(options, history);
+    for (size_t b = 0; b < reader.block_count(); b++) {
+        TraceBlock block = reader.block(b);
+        for (size_t i = 0; i < block.count; i++) {
+            scorer.add((double)block.t_ms[i], block.temperature[i]);
+        }
+    }
+    scorer.finish();
+}
+
+template <typename Detector>
+static void reprocess(const Options &options, DeviceHistory &history)
+{
+    if (history.trace) {
+        reprocess_trace<Detector>(options, history);
+    } else {
+        reprocess_csv<Detector>(options, history);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    bool tuned = false;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--threads") && has_value) {
+            options.threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--z-threshold") && has_value) {
+            options.z_threshold = (float)atof(argv[++i]);
+            tuned = true;
+        } else if (!strcmp(argv[i], "--window") && has_value) {
+            options.window = atoi(argv[++i]);
+            tuned = true;
+        } else if (!strcmp(argv[i], "--reference")) {
+            options.reference = true;
+        } else if (!strcmp(argv[i], "--timeline") && has_value) {
+            options.timeline = argv[++i];
+        } else if (!strcmp(argv[i], "--summary-only")) {
+            options.summary_only = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            options.paths.push_back(argv[i]);
+        }
+    }
+    if (options.threads <= 0) {
+        options.threads = (int)std::thread::hardware_concurrency();
+        if (options.threads <= 0) {
+            options.threads = 1;
+        }
+    }
+    if (options.paths.empty() || options.window < 1 || options.window > RetuneConfig::rate_window ||
+            options.z_threshold <= 0 || (options.reference && tuned)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<DeviceHistory> histories;
+    for (const std::string &path : options.paths) {
+        if (!collect(path, histories)) {
+            return 1;
+        }
+    }
+    FILE *timeline = nullptr;
+    if (options.timeline && !(timeline = fopen(options.timeline, "w"))) {
+        fprintf(stderr, "history_reprocess: cannot write %s\n", options.timeline);
+        return 1;
+    }
+
+    // Largest first, so the long histories do not start last
+    std::vector<size_t> order(histories.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return histories[a].bytes > histories[b].bytes;
+    });
+
+    WorkPool pool(options.threads);
+    uint64_t start = fleet_now_ns();
+    pool.run(order.size(), [&](size_t task, int) {
+        DeviceHistory &history = histories[order[task]];
+        if (options.reference) {
+            reprocess<ReferenceDetector>(options, history);
+        } else {
+            reprocess<RetunedDetector>(options, history);
+        }
+    });
+    uint64_t elapsed = fleet_now_ns() - start;
+
+    uint64_t readings = 0, anomalies = 0, bytes = 0;
+    int failed = 0;
+    for (DeviceHistory &history : histories) {
+        if (!history.ok) {
+            fprintf(stderr, "history_reprocess: cannot read %s\n", history.path.c_str());
+            failed++;
+            continue;
+        }
+        readings += history.readings;
+        anomalies += history.anomalies;
+        bytes += history.bytes;
+        if (!options.summary_only) {
+            printf("{\"dev\":\"%s\",\"readings\":%llu,\"anomalies\":%llu,\"periods\":%llu,\"first_ms\":%.0f,"
+                   "\"last_ms\":%.0f,\"max_gap_ms\":%.0f,\"min\":%.2f,\"max\":%.2f}\n",
+                   history.device.c_str(), (unsigned long long)history.readings,
+                   (unsigned long long)history.anomalies, (unsigned long long)history.periods, history.first_ms,
+                   history.last_ms, history.max_gap_ms, history.readings ? history.min_temp : 0.0f,
+                   history.readings ? history.max_temp : 0.0f);
+        }
+        if (timeline) {
+            fwrite(history.timeline.data(), 1, history.timeline.size(), timeline);
+        }
+    }
+    if (timeline) {
+        fclose(timeline);
+    }
+
+    uint64_t stolen = 0, max_busy = 0, total_busy = 0;
+    for (const WorkPoolStats &stats : pool.stats()) {
+        stolen += stats.stolen;
+        max_busy = std::max(max_busy, stats.busy_ns);
+        total_busy += stats.busy_ns;
+    }
+    printf("{\"summary\":true,\"detector\":\"%s\",\"window\":%d,\"z_threshold\":%.2f,\"devices\":%zu,"
+           "\"failed\":%d,\"readings\":%llu,\"anomalies\":%llu,\"mb\":%.1f,\"threads\":%d,\"seconds\":%.3f,"
+           "\"samples_per_s\":%.0f,\"stolen\":%llu,\"balance\":%.2f}\n",
+           options.reference ? "reference" : "retuned", options.reference ? RATE_BUFFER_SIZE : options.window,
+           options.reference ? ANOMALY_Z_SCORE_THRESHOLD : options.z_threshold, histories.size(), failed,
+           (unsigned long long)readings, (unsigned long long)anomalies, bytes / 1e6, pool.threads(), elapsed / 1e9,
+           readings * 1e9 / elapsed, (unsigned long long)stolen,
+           max_busy ? (double)total_busy / pool.threads() / max_busy : 1.0);
+    return failed ? 1 : 0;
+}
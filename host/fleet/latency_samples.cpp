@@ -0,0 +1,47 @@
+#include "latency_samples.h"
+
+#include <algorithm>
+
+LatencySamples::LatencySamples(size_t capacity, uint32_t seed)
+    : _capacity(capacity ? capacity : 1), _seen(0), _max(0), _rng(seed ? seed : 1)
+{
+}
+
+void LatencySamples::add(uint32_t us)
+{
+    _seen++;
+    _max = std::max(_max, us);
+    if (_samples.size() < _capacity) {
+        _samples.push_back(us);
+        return;
+    }
+    // xorshift32
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    uint64_t slot = _rng % _seen;
+    if (slot < _capacity) {
+        _samples[slot] = us;
+    }
+}
+
+void LatencySamples::merge(const LatencySamples &other)
+{
+    _samples.insert(_samples.end(), other._samples.begin(), other._samples.end());
+    _seen += other._seen;
+    _max = std::max(_max, other._max);
+}
+
+FleetLatency LatencySamples::summary() const
+{
+    FleetLatency result = {_seen, 0, 0, 0, _max};
+    if (_samples.empty()) {
+        return result;
+    }
+    std::vector<uint32_t> sorted(_samples);
+    std::sort(sorted.begin(), sorted.end());
+    result.p50_us = sorted[sorted.size() * 50 / 100];
+    result.p90_us = sorted[sorted.size() * 90 / 100];
+    result.p99_us = sorted[sorted.size() * 99 / 100];
+    return result;
+}
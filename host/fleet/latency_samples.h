@@ -0,0 +1,45 @@
+/* Latency percentiles for the fleet tools.
+ *
+ * Keeps up to a fixed number of samples; past that, a uniform random subset
+ * of everything added (reservoir sampling), so memory stays bounded however
+ * long a run is. Not thread-safe: keep one per thread and merge() them.
+ */
+#ifndef LATENCY_SAMPLES_H
+#define LATENCY_SAMPLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+struct FleetLatency {
+    uint64_t samples;       // added, not kept
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+};
+
+class LatencySamples {
+public:
+    explicit LatencySamples(size_t capacity = 1 << 16, uint32_t seed = 2463534242u);
+
+    void add(uint32_t us);
+    // Pools other's kept samples into this one
+    void merge(const LatencySamples &other);
+    FleetLatency summary() const;
+
+    uint64_t count() const
+    {
+        return _seen;
+    }
+
+private:
+    std::vector<uint32_t> _samples;
+    size_t _capacity;
+    uint64_t _seen;
+    uint32_t _max;
+    uint32_t _rng;
+};
+
+#endif // LATENCY_SAMPLES_H
@@ -0,0 +1,381 @@
+#include "mqtt_wire.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "MQTTPacket.h"
+
+MqttWire::MqttWire()
+    : _fd(-1), _state(CLOSED), _queued(false), _pending_start(0), _max_pending(64 * 1024), _next_id(1),
+      _bytes_out(0)
+{
+}
+
+MqttWire::~MqttWire()
+{
+    close(false);
+}
+
+bool MqttWire::send_all(const unsigned char *data, size_t len)
+{
+    if (_queued) {
+        _pending.append((const char *)data, len);
+        return flush();
+    }
+    while (len > 0) {
+        ssize_t n = ::send(_fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd p = {_fd, POLLOUT, 0};
+            poll(&p, 1, 100);
+            continue;
+        }
+        if (n <= 0) {
+            close(false);
+            return false;
+        }
+        _bytes_out += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool MqttWire::flush()
+{
+    if (_fd < 0) {
+        return false;
+    }
+    // Until the TCP connection is up, send() fails with EAGAIN or ENOTCONN
+    while (pending() > 0) {
+        ssize_t n = ::send(_fd, _pending.data() + _pending_start, pending(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN)) {
+            break;
+        }
+        if (n <= 0) {
+            close(false);
+            return false;
+        }
+        _bytes_out += n;
+        _pending_start += n;
+    }
+    // Compact once the written part dominates, not on every partial write
+    if (_pending_start == _pending.size()) {
+        _pending.clear();
+        _pending_start = 0;
+    } else if (_pending_start > 4096 && _pending_start * 2 > _pending.size()) {
+        _pending.erase(0, _pending_start);
+        _pending_start = 0;
+    }
+    return true;
+}
+
+void MqttWire::take_packets(const std::function<void(unsigned char *packet, int len)> &handler)
+{
+    size_t start = 0;
+    while (_in.size() - start >= 2) {
+        int rem_len = 0;
+        int multiplier = 1;
+        size_t pos = start + 1;
+        bool complete = false;
+        while (pos < _in.size() && pos <= start + 4) {
+            unsigned char b = (unsigned char)_in[pos++];
+            rem_len += (b & 127) * multiplier;
+            multiplier *= 128;
+            if (!(b & 128)) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || _in.size() < pos + rem_len) {
+            break;
+        }
+        handler((unsigned char *)&_in[start], (int)(pos + rem_len - start));
+        start = pos + rem_len;
+    }
+    _in.erase(0, start);
+}
+
+static void dispatch_publish(unsigned char *packet, int len, const MqttWire::PublishHandler &handler)
+{
+    unsigned char dup, retained;
+    int qos, payload_len;
+    unsigned short id;
+    MQTTString topic = MQTTString_initializer;
+    unsigned char *payload;
+    if (handler && MQTTDeserialize_publish(&dup, &qos, &retained, &id, &topic, &payload, &payload_len, packet, len) == 1) {
+        if (topic.cstring) {
+            handler(topic.cstring, strlen(topic.cstring), (const char *)payload, payload_len);
+        } else {
+            handler(topic.lenstring.data, topic.lenstring.len, (const char *)payload, payload_len);
+        }
+    }
+}
+
+void MqttWire::handle_packet(unsigned char *packet, int len, const PublishHandler &handler)
+{
+    MQTTHeader header;
+    header.byte = packet[0];
+    switch (header.bits.type) {
+        case PUBLISH:
+            dispatch_publish(packet, len, handler);
+            break;
+        case CONNACK: {
+            unsigned char session_present, rc;
+            if (MQTTDeserialize_connack(&session_present, &rc, packet, len) == 1 && rc == 0) {
+                _state = CONNECTED;
+            } else {
+                close(false);
+            }
+            break;
+        }
+        case PUBACK: {
+            unsigned char type, dup;
+            unsigned short id;
+            if (_ack_handler && MQTTDeserialize_ack(&type, &dup, &id, packet, len) == 1) {
+                _ack_handler(id);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool MqttWire::read_available()
+{
+    char buf[16384];
+    for (;;) {
+        ssize_t n = recv(_fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0) {
+            _in.append(buf, n);
+            if ((size_t)n == sizeof(buf)) {
+                continue;
+            }
+            return true;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return true;
+        }
+        close(false);
+        return false;
+    }
+}
+
+bool MqttWire::receive(const PublishHandler &handler)
+{
+    if (_fd < 0) {
+        return false;
+    }
+    read_available();
+    take_packets([&](unsigned char *packet, int len) {
+        if (_fd >= 0) {
+            handle_packet(packet, len, handler);
+        }
+    });
+    return _fd >= 0;
+}
+
+short MqttWire::events() const
+{
+    if (_fd < 0) {
+        return 0;
+    }
+    return POLLIN | (pending() > 0 ? POLLOUT : 0);
+}
+
+bool MqttWire::service(short revents, const PublishHandler &handler)
+{
+    if (_fd < 0) {
+        return false;
+    }
+    if (revents & (POLLERR | POLLHUP | POLLNVAL) && !(revents & POLLIN)) {
+        close(false);
+        return false;
+    }
+    if (revents & POLLOUT && !flush()) {
+        return false;
+    }
+    if (revents & POLLIN) {
+        return receive(handler);
+    }
+    return true;
+}
+
+bool MqttWire::wait_for(int type, int timeout_ms, const PublishHandler &handler)
+{
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    bool seen = false;
+    while (!seen && _fd >= 0) {
+        int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                       deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) {
+            return false;
+        }
+        struct pollfd p = {_fd, POLLIN, 0};
+        if (poll(&p, 1, left) <= 0) {
+            continue;
+        }
+        char buf[4096];
+        ssize_t n = recv(_fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            close(false);
+            return false;
+        }
+        _in.append(buf, n);
+        take_packets([&](unsigned char *packet, int len) {
+            MQTTHeader header;
+            header.byte = packet[0];
+            if (_fd >= 0) {
+                handle_packet(packet, len, handler);
+            }
+            if (header.bits.type == type) {
+                seen = true;
+            }
+        });
+    }
+    return seen && _fd >= 0;
+}
+
+static int serialize_connect(unsigned char *buf, int size, const char *client_id, int keepalive_s)
+{
+    MQTTPacket_connectData options = MQTTPacket_connectData_initializer;
+    options.clientID.cstring = (char *)client_id;
+    options.keepAliveInterval = (unsigned short)keepalive_s;
+    options.cleansession = 1;
+    return MQTTSerialize_connect(buf, size, &options);
+}
+
+bool MqttWire::open(const char *host, uint16_t port, const char *client_id, int keepalive_s, int timeout_ms)
+{
+    close(false);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addr = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    if (getaddrinfo(host, service, &hints, &addr) != 0 || !addr) {
+        return false;
+    }
+    _fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    bool connected = _fd >= 0 && connect(_fd, addr->ai_addr, addr->ai_addrlen) == 0;
+    freeaddrinfo(addr);
+    if (!connected) {
+        close(false);
+        return false;
+    }
+    int one = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    _in.clear();
+    _state = CONNECTING;
+
+    unsigned char buf[256];
+    int len = serialize_connect(buf, sizeof(buf), client_id, keepalive_s);
+    if (len <= 0 || !send_all(buf, len) || !wait_for(CONNACK, timeout_ms, PublishHandler())) {
+        close(false);
+        return false;
+    }
+    return true;
+}
+
+bool MqttWire::start(const struct sockaddr_in &broker, const char *client_id, int keepalive_s)
+{
+    close(false);
+    _fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (_fd < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(_fd, (const struct sockaddr *)&broker, sizeof(broker)) < 0 && errno != EINPROGRESS) {
+        close(false);
+        return false;
+    }
+    _in.clear();
+    _state = CONNECTING;
+    _queued = true;
+
+    // Goes out once the socket is writable, i.e. connected
+    unsigned char buf[256];
+    int len = serialize_connect(buf, sizeof(buf), client_id, keepalive_s);
+    _pending.assign((const char *)buf, len);
+    return true;
+}
+
+bool MqttWire::subscribe(const char *filter, int timeout_ms)
+{
+    if (_fd < 0) {
+        return false;
+    }
+    MQTTString topic = MQTTString_initializer;
+    topic.cstring = (char *)filter;
+    int qos = 0;
+    unsigned char buf[256];
+    int len = MQTTSerialize_subscribe(buf, sizeof(buf), 0, _next_id++, 1, &topic, &qos);
+    return len > 0 && send_all(buf, len) && wait_for(SUBACK, timeout_ms, PublishHandler());
+}
+
+bool MqttWire::publish(const char *topic, const char *payload, size_t len, int qos, unsigned short *id)
+{
+    if (_fd < 0 || _state != CONNECTED || (_queued && pending() > _max_pending)) {
+        return false;
+    }
+    unsigned short packet_id = 0;
+    if (qos > 0) {
+        packet_id = _next_id++;
+        if (_next_id == 0) {
+            _next_id = 1;
+        }
+        if (id) {
+            *id = packet_id;
+        }
+    }
+    MQTTString name = MQTTString_initializer;
+    name.cstring = (char *)topic;
+    _out.resize(strlen(topic) + len + 8);
+    int n = MQTTSerialize_publish((unsigned char *)&_out[0], (int)_out.size(), 0, qos, 0, packet_id, name,
+                                  (unsigned char *)payload, (int)len);
+    return n > 0 && send_all((const unsigned char *)_out.data(), n);
+}
+
+bool MqttWire::ping()
+{
+    unsigned char buf[2];
+    int len = MQTTSerialize_pingreq(buf, sizeof(buf));
+    return _fd >= 0 && send_all(buf, len);
+}
+
+void MqttWire::close(bool clean)
+{
+    if (_fd < 0) {
+        return;
+    }
+    if (clean) {
+        unsigned char buf[2];
+        int len = MQTTSerialize_disconnect(buf, sizeof(buf));
+        (void)::send(_fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    ::close(_fd);
+    _fd = -1;
+    _state = CLOSED;
+    _queued = false;
+    _pending.clear();
+    _pending_start = 0;
+}
@@ -0,0 +1,121 @@
+/* MQTT 3.1.1 client connection over a plain POSIX socket, for the fleet tools.
+ *
+ * The firmware's client (the shim's MQTTClient over the WiFi driver) keeps
+ * one session per process; the fleet tools need hundreds, on the server
+ * side. MqttWire is just the wire protocol: CONNECT, SUBSCRIBE, PUBLISH at
+ * QoS 0 or 1 and PINGREQ out, PUBLISH and PUBACK in, using the MQTTPacket
+ * serializers.
+ *
+ * It is used in one of two ways. open() and subscribe() block until the
+ * broker answers, and publish() blocks while the socket's send buffer is
+ * full. Or, for many connections on one thread, start() connects without
+ * blocking: the owner polls fd() for events() and passes what poll()
+ * returned to service(), which completes the connection, writes what is
+ * queued and reads. receive() never blocks in either mode.
+ */
+#ifndef MQTT_WIRE_H
+#define MQTT_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <netinet/in.h>
+
+#include <functional>
+#include <string>
+
+class MqttWire {
+public:
+    typedef std::function<void(const char *topic, size_t topic_len, const char *payload, size_t len)> PublishHandler;
+    // A QoS 1 publish was acknowledged
+    typedef std::function<void(unsigned short id)> AckHandler;
+
+    enum State {
+        CLOSED,
+        CONNECTING,     // TCP connect or CONNACK outstanding
+        CONNECTED,
+    };
+
+    MqttWire();
+    ~MqttWire();
+
+    // Connects and waits up to timeout_ms for the CONNACK
+    bool open(const char *host, uint16_t port, const char *client_id, int keepalive_s = 60,
+              int timeout_ms = 2000);
+    // Starts connecting and returns: the session is up once state() is
+    // CONNECTED. False if the socket could not even be created.
+    bool start(const struct sockaddr_in &broker, const char *client_id, int keepalive_s = 60);
+    bool subscribe(const char *filter, int timeout_ms = 2000);
+    // QoS 0 or 1; for QoS 1 the packet ID is stored in *id. Without start()
+    // this blocks while the socket's send buffer is full; with it, the
+    // packet is queued, and false is returned if over max_pending bytes are
+    // already waiting to be written.
+    bool publish(const char *topic, const char *payload, size_t len, int qos = 0, unsigned short *id = nullptr);
+    bool ping();
+    // Handles what has arrived without waiting: handler is called for each
+    // PUBLISH. False once the connection is gone.
+    bool receive(const PublishHandler &handler);
+    // For a start()ed connection: the poll() events to wait for, and the
+    // handling of the revents poll() returned. False once the connection is gone.
+    short events() const;
+    bool service(short revents, const PublishHandler &handler);
+    // Sends DISCONNECT if clean, then closes
+    void close(bool clean = true);
+
+    void set_ack_handler(const AckHandler &handler)
+    {
+        _ack_handler = handler;
+    }
+    void set_max_pending(size_t bytes)
+    {
+        _max_pending = bytes;
+    }
+
+    State state() const
+    {
+        return _state;
+    }
+    bool is_open() const
+    {
+        return _fd >= 0;
+    }
+    int fd() const
+    {
+        return _fd;
+    }
+    uint64_t bytes_out() const
+    {
+        return _bytes_out;
+    }
+    // Bytes queued by a start()ed connection and not yet written
+    size_t pending() const
+    {
+        return _pending.size() - _pending_start;
+    }
+
+private:
+    bool send_all(const unsigned char *data, size_t len);
+    // Writes what is queued until the socket would block
+    bool flush();
+    // Waits for a packet of the given type, handing PUBLISHes to handler meanwhile
+    bool wait_for(int type, int timeout_ms, const PublishHandler &handler);
+    // Calls handler for each complete packet in _in and drops them from it
+    void take_packets(const std::function<void(unsigned char *packet, int len)> &handler);
+    // Reads what the socket holds without blocking
+    bool read_available();
+    void handle_packet(unsigned char *packet, int len, const PublishHandler &handler);
+
+    int _fd;
+    State _state;
+    bool _queued;           // start()ed: writes go through _pending
+    std::string _in;
+    std::string _out;
+    std::string _pending;
+    size_t _pending_start;
+    size_t _max_pending;
+    unsigned short _next_id;
+    uint64_t _bytes_out;
+    AckHandler _ack_handler;
+};
+
+#endif // MQTT_WIRE_H
@@ -0,0 +1,89 @@
+#include "telemetry_decode.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Start of the value of "key" in payload, or nullptr
+static const char *find_value(const char *payload, size_t len, const char *key)
+{
+    size_t key_len = strlen(key);
+    const char *end = payload + len;
+    for (const char *p = payload; p + key_len + 3 <= end; p++) {
+        if (p[0] != '"' || memcmp(p + 1, key, key_len) != 0 || p[key_len + 1] != '"') {
+            continue;
+        }
+        p += key_len + 2;
+        while (p < end && (*p == ' ' || *p == ':')) {
+            p++;
+        }
+        return p < end ? p : nullptr;
+    }
+    return nullptr;
+}
+
+static bool read_float(const char *payload, size_t len, const char *key, float *value)
+{
+    const char *p = find_value(payload, len, key);
+    if (!p) {
+        return false;
+    }
+    // The payload is not NUL-terminated; numbers are short, copy one out
+    char number[32];
+    size_t n = 0;
+    while (p + n < payload + len && n < sizeof(number) - 1 && strchr("+-.0123456789eE", p[n])) {
+        number[n] = p[n];
+        n++;
+    }
+    number[n] = '\0';
+    char *parsed;
+    *value = strtof(number, &parsed);
+    return n > 0 && parsed == number + n;
+}
+
+bool telemetry_device(const char *payload, size_t len, const char **device, size_t *device_len)
+{
+    const char *p = find_value(payload, len, "dev");
+    if (!p || *p != '"') {
+        return false;
+    }
+    p++;
+    const char *close = (const char *)memchr(p, '"', payload + len - p);
+    if (!close) {
+        return false;
+    }
+    *device = p;
+    *device_len = close - p;
+    return true;
+}
+
+bool telemetry_decode_data(const char *payload, size_t len, DataReport *report)
+{
+    const char *device;
+    size_t device_len = 0;
+    if (!telemetry_device(payload, len, &device, &device_len)) {
+        device_len = 0;
+    }
+    if (device_len >= sizeof(report->device)) {
+        return false;
+    }
+    memcpy(report->device, device_len ? device : "", device_len);
+    report->device[device_len] = '\0';
+
+    if (!read_float(payload, len, "temp", &report->temp) ||
+            !read_float(payload, len, "humidity", &report->humidity) ||
+            !read_float(payload, len, "pressure", &report->pressure) ||
+            !read_float(payload, len, "min_1h", &report->min_1h) ||
+            !read_float(payload, len, "max_1h", &report->max_1h)) {
+        return false;
+    }
+
+    const char *anomaly = find_value(payload, len, "anomaly");
+    if (!anomaly || payload + len - anomaly < 6) {
+        return false;
+    }
+    report->anomaly = memcmp(anomaly, "\"true\"", 6) == 0;
+
+    const char *age = find_value(payload, len, "age_ms");
+    report->age_ms = age ? (uint32_t)strtoul(age, nullptr, 10) : 0;
+    return true;
+}
@@ -0,0 +1,33 @@
+/* Decoding of the devices' MQTT payloads (mqtt_payload.h) on the server side.
+ *
+ * These parse what mqtt_format_data_payload() writes and nothing more
+ * general: keys are looked up by name, so their order does not matter, but
+ * the values must be plain numbers or the quoted strings it produces.
+ */
+#ifndef TELEMETRY_DECODE_H
+#define TELEMETRY_DECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_DEVICE_MAX 48
+
+struct DataReport {
+    char device[TELEMETRY_DEVICE_MAX];  // "dev", empty if the payload has none
+    float temp;
+    float humidity;
+    float pressure;
+    float min_1h;
+    float max_1h;
+    bool anomaly;
+    uint32_t age_ms;                    // 0 for a live reading
+};
+
+// The "dev" value without copying it: false if there is none. Cheap enough
+// to route a message before it is decoded.
+bool telemetry_device(const char *payload, size_t len, const char **device, size_t *device_len);
+
+// False if a reading is missing or malformed
+bool telemetry_decode_data(const char *payload, size_t len, DataReport *report);
+
+#endif // TELEMETRY_DECODE_H
@@ -0,0 +1,241 @@
+/* Converts recorded sensor history to the binary trace format (trace_file.h),
+ * and describes trace files.
+ *
+ * Inputs ending in .csv are traces of one device in the
+ * "t_ms,temperature,humidity,pressure" format; the file name is the device
+ * ID. Any other input is a log of data messages as a subscriber records
+ * them, one per line: the payload mqtt_publish_data() sends, optionally
+ * preceded by the time it was received in ms and a space. A reading's time
+ * is the received time less its "age_ms"; lines without a received time are
+ * taken to be --interval-ms apart per device. Each device in a log ("dev",
+ * or --device for payloads without one) gets its own trace. A log's readings
+ * are sorted by time per device before writing, since backlogged reports
+ * arrive after newer ones.
+ *
+ * Traces are written to --out DIR as <device>.trace. With --info, the given
+ * trace files are checked and described instead.
+ *
+ * Output is one JSON record per trace written (or described) and a summary.
+ *
+ * Usage: trace_convert --out DIR [--block N] [--interval-ms MS] [--device ID] INPUT...
+ *        trace_convert --info TRACE...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+#include "aggregator.h"
+#include "telemetry_decode.h"
+#include "trace_file.h"
+
+struct Options {
+    const char *out = nullptr;
+    uint32_t block = TRACE_BLOCK_RECORDS;
+    int interval_ms = SAMPLE_INTERVAL_MS;
+    const char *device = "device";
+    bool info = false;
+    std::vector<const char *> inputs;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s --out DIR [--block N] [--interval-ms MS] [--device ID] INPUT...\n"
+            "       %s --info TRACE...\n", prog, prog);
+}
+
+struct Reading {
+    int64_t t_ms;
+    float temperature;
+    float humidity;
+    float pressure;
+};
+
+static uint64_t total_records;
+static uint64_t total_bytes;
+
+static bool ends_with(const char *s, const char *suffix)
+{
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static std::string base_name(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    std::string name(slash ? slash + 1 : path);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        name.resize(dot);
+    }
+    return name;
+}
+
+static bool write_trace(const Options &options, const std::string &device, const std::vector<Reading> &readings)
+{
+    std::string path = std::string(options.out) + "/" + device + ".trace";
+    TraceWriter writer;
+    bool ok = writer.open(path.c_str(), device.c_str(), options.block);
+    for (size_t i = 0; ok && i < readings.size(); i++) {
+        ok = writer.append(readings[i].t_ms, readings[i].temperature, readings[i].humidity, readings[i].pressure);
+    }
+    ok = writer.close() && ok;
+    if (!ok) {
+        fprintf(stderr, "trace_convert: cannot write %s\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    uint64_t bytes = stat(path.c_str(), &st) == 0 ? (uint64_t)st.st_size : 0;
+    printf("{\"trace\":\"%s\",\"dev\":\"%s\",\"records\":%zu,\"bytes\":%llu,\"bytes_per_record\":%.1f}\n",
+           path.c_str(), device.c_str(), readings.size(), (unsigned long long)bytes,
+           readings.empty() ? 0.0 : (double)bytes / readings.size());
+    total_records += readings.size();
+    total_bytes += bytes;
+    return true;
+}
+
+static bool convert_csv(const Options &options, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "trace_convert: cannot open %s\n", path);
+        return false;
+    }
+    std::vector<Reading> readings;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        Reading r = {0, 22.0f, 45.0f, 1013.25f};
+        double t_ms;
+        // Header, comments and blank lines do not parse
+        if (sscanf(line, "%lf,%f,%f,%f", &t_ms, &r.temperature, &r.humidity, &r.pressure) >= 2) {
+            r.t_ms = (int64_t)(t_ms + 0.5);
+            readings.push_back(r);
+        }
+    }
+    fclose(f);
+    std::stable_sort(readings.begin(), readings.end(), [](const Reading &a, const Reading &b) {
+        return a.t_ms < b.t_ms;
+    });
+    return write_trace(options, base_name(path), readings);
+}
+
+static bool convert_log(const Options &options, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "trace_convert: cannot open %s\n", path);
+        return false;
+    }
+    std::map<std::string, std::vector<Reading>> devices;
+    uint64_t skipped = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        char *payload = strchr(line, '{');
+        if (!payload) {
+            continue;
+        }
+        DataReport report;
+        if (!telemetry_decode_data(payload, strlen(payload), &report)) {
+            skipped++;
+            continue;
+        }
+        std::vector<Reading> &readings = devices[report.device[0] ? report.device : options.device];
+        int64_t t_ms;
+        char *end;
+        long long received = strtoll(line, &end, 10);
+        if (end != line && end <= payload) {
+            t_ms = (int64_t)received - report.age_ms;
+        } else {
+            t_ms = (int64_t)readings.size() * options.interval_ms;
+        }
+        readings.push_back(Reading{t_ms, report.temp, report.humidity, report.pressure});
+    }
+    fclose(f);
+    if (skipped) {
+        fprintf(stderr, "trace_convert: %s: %llu lines are not data messages\n", path, (unsigned long long)skipped);
+    }
+    bool ok = true;
+    for (auto &device : devices) {
+        std::stable_sort(device.second.begin(), device.second.end(), [](const Reading &a, const Reading &b) {
+            return a.t_ms < b.t_ms;
+        });
+        ok = write_trace(options, device.first, device.second) && ok;
+    }
+    return ok;
+}
+
+static bool describe(const char *path)
+{
+    TraceReader reader;
+    std::string error;
+    if (!reader.open(path, error)) {
+        fprintf(stderr, "trace_convert: %s\n", error.c_str());
+        return false;
+    }
+    int64_t first = 0, last = 0;
+    if (reader.block_count() > 0) {
+        first = reader.block(0).first_ms;
+        last = reader.block(reader.block_count() - 1).last_ms;
+    }
+    printf("{\"trace\":\"%s\",\"dev\":\"%s\",\"records\":%llu,\"blocks\":%zu,\"bytes\":%zu,\"first_ms\":%lld,"
+           "\"last_ms\":%lld}\n", path, reader.device(), (unsigned long long)reader.record_count(),
+           reader.block_count(), reader.file_size(), (long long)first, (long long)last);
+    total_records += reader.record_count();
+    total_bytes += reader.file_size();
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--out") && has_value) {
+            options.out = argv[++i];
+        } else if (!strcmp(argv[i], "--block") && has_value) {
+            options.block = (uint32_t)atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval-ms") && has_value) {
+            options.interval_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--device") && has_value) {
+            options.device = argv[++i];
+        } else if (!strcmp(argv[i], "--info")) {
+            options.info = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            options.inputs.push_back(argv[i]);
+        }
+    }
+    if (options.inputs.empty() || (!options.info && !options.out) || options.block == 0 ||
+            options.interval_ms <= 0 || strlen(options.device) >= TRACE_DEVICE_MAX) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.out) {
+        mkdir(options.out, 0777);
+    }
+
+    uint64_t start = fleet_now_ns();
+    bool ok = true;
+    for (const char *input : options.inputs) {
+        if (options.info) {
+            ok = describe(input) && ok;
+        } else if (ends_with(input, ".csv")) {
+            ok = convert_csv(options, input) && ok;
+        } else {
+            ok = convert_log(options, input) && ok;
+        }
+    }
+    printf("{\"summary\":true,\"records\":%llu,\"bytes\":%llu,\"seconds\":%.3f}\n", (unsigned long long)total_records,
+           (unsigned long long)total_bytes, (fleet_now_ns() - start) / 1e9);
+    return ok ? 0 : 1;
+}
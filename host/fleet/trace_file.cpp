@@ -0,0 +1,266 @@
+#include "trace_file.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "trace files are read in place: little-endian hosts only"
+#endif
+
+static_assert(sizeof(TraceHeader) == 80, "TraceHeader is part of the file format");
+static_assert(sizeof(TraceBlockHeader) == 16, "TraceBlockHeader is part of the file format");
+static_assert(sizeof(TraceIndexEntry) == 32, "TraceIndexEntry is part of the file format");
+
+// Column bytes for count readings, padded so the next block stays aligned
+static uint64_t block_payload_size(uint64_t count)
+{
+    uint64_t size = count * (sizeof(int64_t) + 3 * sizeof(float));
+    return (size + 7) & ~(uint64_t)7;
+}
+
+// --- Reader ---
+
+TraceReader::TraceReader() : _data(nullptr), _size(0), _header(nullptr), _index(nullptr)
+{
+    _device[0] = '\0';
+}
+
+TraceReader::~TraceReader()
+{
+    close();
+}
+
+void TraceReader::close()
+{
+    if (_data) {
+        munmap((void *)_data, _size);
+    }
+    _data = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _index = nullptr;
+    _device[0] = '\0';
+}
+
+bool TraceReader::open(const char *path, std::string &error)
+{
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceHeader)) {
+        ::close(fd);
+        error = std::string(path) + " is not a trace";
+        return false;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error = std::string("cannot map ") + path;
+        return false;
+    }
+    // Replay reads front to back
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    _data = (const uint8_t *)data;
+    _size = st.st_size;
+
+    const TraceHeader *header = (const TraceHeader *)_data;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0) {
+        error = std::string(path) + " is not a trace";
+    } else if (header->version == 0 || header->version > TRACE_VERSION || header->header_size < sizeof(TraceHeader)) {
+        error = std::string(path) + ": unsupported trace version";
+    } else if (header->index_offset % 8 || header->index_offset > _size ||
+               (uint64_t)header->block_count * sizeof(TraceIndexEntry) > _size - header->index_offset) {
+        error = std::string(path) + ": block index out of bounds (incomplete file?)";
+    } else {
+        _header = header;
+        _index = (const TraceIndexEntry *)(_data + header->index_offset);
+    }
+    uint64_t records = 0;
+    for (size_t i = 0; _header && i < _header->block_count; i++) {
+        const TraceIndexEntry &entry = _index[i];
+        if (entry.offset % 8 || entry.offset < sizeof(TraceHeader) ||
+                entry.offset + sizeof(TraceBlockHeader) > _header->index_offset) {
+            error = std::string(path) + ": block out of bounds";
+            _header = nullptr;
+            break;
+        }
+        const TraceBlockHeader *block = (const TraceBlockHeader *)(_data + entry.offset);
+        if (block->count != entry.count || block->encoding != TRACE_ENCODING_RAW ||
+                block->size < block_payload_size(block->count) ||
+                block->size > _header->index_offset - entry.offset - sizeof(TraceBlockHeader)) {
+            error = std::string(path) + ": block out of bounds";
+            _header = nullptr;
+            break;
+        }
+        records += entry.count;
+    }
+    if (_header && records != _header->record_count) {
+        error = std::string(path) + ": record count does not match the blocks";
+        _header = nullptr;
+    }
+    if (!_header) {
+        close();
+        return false;
+    }
+    memcpy(_device, _header->device, TRACE_DEVICE_MAX);
+    _device[TRACE_DEVICE_MAX] = '\0';
+    return true;
+}
+
+TraceBlock TraceReader::block(size_t i) const
+{
+    const TraceIndexEntry &entry = _index[i];
+    const uint8_t *columns = _data + entry.offset + sizeof(TraceBlockHeader);
+    TraceBlock block;
+    block.count = entry.count;
+    block.first_ms = entry.first_ms;
+    block.last_ms = entry.last_ms;
+    block.t_ms = (const int64_t *)columns;
+    block.temperature = (const float *)(columns + entry.count * sizeof(int64_t));
+    block.humidity = block.temperature + entry.count;
+    block.pressure = block.humidity + entry.count;
+    return block;
+}
+
+size_t TraceReader::find_block(int64_t t_ms) const
+{
+    // Blocks are in time order: the first whose last reading is not before t_ms
+    size_t lo = 0, hi = block_count();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (_index[mid].last_ms < t_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// --- Writer ---
+
+TraceWriter::TraceWriter() : _file(nullptr), _ok(false), _block_records(0), _offset(0), _records(0)
+{
+    memset(_device, 0, sizeof(_device));
+}
+
+TraceWriter::~TraceWriter()
+{
+    if (_file) {
+        fclose(_file);
+    }
+}
+
+bool TraceWriter::open(const char *path, const char *device, uint32_t block_records)
+{
+    if (_file) {
+        fclose(_file);
+    }
+    _file = fopen(path, "wb");
+    _ok = _file != nullptr;
+    _block_records = block_records ? block_records : TRACE_BLOCK_RECORDS;
+    _records = 0;
+    memset(_device, 0, sizeof(_device));
+    strncpy(_device, device, sizeof(_device) - 1);
+    _device[sizeof(_device) - 1] = '\0';
+    _t_ms.clear();
+    _temperature.clear();
+    _humidity.clear();
+    _pressure.clear();
+    _t_ms.reserve(_block_records);
+    _temperature.reserve(_block_records);
+    _humidity.reserve(_block_records);
+    _pressure.reserve(_block_records);
+    _index.clear();
+
+    // Placeholder; close() writes the real header
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    _ok = _ok && fwrite(&header, sizeof(header), 1, _file) == 1;
+    _offset = sizeof(header);
+    return _ok;
+}
+
+bool TraceWriter::append(int64_t t_ms, float temperature, float humidity, float pressure)
+{
+    if (!_ok || (!_t_ms.empty() && t_ms < _t_ms.back()) ||
+            (_t_ms.empty() && !_index.empty() && t_ms < _index.back().last_ms)) {
+        _ok = false;
+        return false;
+    }
+    _t_ms.push_back(t_ms);
+    _temperature.push_back(temperature);
+    _humidity.push_back(humidity);
+    _pressure.push_back(pressure);
+    _records++;
+    if (_t_ms.size() == _block_records) {
+        return flush_block();
+    }
+    return true;
+}
+
+bool TraceWriter::flush_block()
+{
+    size_t count = _t_ms.size();
+    if (count == 0) {
+        return _ok;
+    }
+    TraceBlockHeader block;
+    memset(&block, 0, sizeof(block));
+    block.count = (uint32_t)count;
+    block.encoding = TRACE_ENCODING_RAW;
+    block.size = (uint32_t)block_payload_size(count);
+
+    TraceIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = _offset;
+    entry.first_ms = _t_ms.front();
+    entry.last_ms = _t_ms.back();
+    entry.count = (uint32_t)count;
+    _index.push_back(entry);
+
+    static const uint8_t padding[8] = {0};
+    size_t written = count * (sizeof(int64_t) + 3 * sizeof(float));
+    _ok = _ok && fwrite(&block, sizeof(block), 1, _file) == 1 &&
+          fwrite(_t_ms.data(), sizeof(int64_t), count, _file) == count &&
+          fwrite(_temperature.data(), sizeof(float), count, _file) == count &&
+          fwrite(_humidity.data(), sizeof(float), count, _file) == count &&
+          fwrite(_pressure.data(), sizeof(float), count, _file) == count &&
+          fwrite(padding, 1, block.size - written, _file) == block.size - written;
+    _offset += sizeof(block) + block.size;
+    _t_ms.clear();
+    _temperature.clear();
+    _humidity.clear();
+    _pressure.clear();
+    return _ok;
+}
+
+bool TraceWriter::close()
+{
+    if (!_file) {
+        return false;
+    }
+    flush_block();
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.header_size = sizeof(header);
+    header.block_records = _block_records;
+    memcpy(header.device, _device, sizeof(header.device));
+    header.record_count = _records;
+    header.block_count = (uint32_t)_index.size();
+    header.index_offset = _offset;
+    _ok = _ok && fwrite(_index.data(), sizeof(TraceIndexEntry), _index.size(), _file) == _index.size() &&
+          fseek(_file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, _file) == 1;
+    _ok = fclose(_file) == 0 && _ok;
+    _file = nullptr;
+    return _ok;
+}
@@ -0,0 +1,160 @@
+/* Binary trace format for recorded sensor history, one device per file.
+ *
+ * Parsing CSV or JSON dominates replay; this format is read in place. All
+ * values are little-endian and every section starts 8-byte aligned:
+ *
+ *   TraceHeader        80 bytes: magic, version, device ID, counts, and
+ *                      the offset of the block index
+ *   blocks             up to block_records readings each, in columns:
+ *                        TraceBlockHeader (16 bytes)
+ *                        int64 t_ms[count]
+ *                        float temperature[count]
+ *                        float humidity[count]
+ *                        float pressure[count]
+ *                      padded to a multiple of 8 bytes
+ *   TraceIndexEntry[block_count]
+ *                      offset, time span and count of every block, so a
+ *                      reader can seek by time without touching the blocks
+ *
+ * Readings are in time order within a file. TraceReader maps the file and
+ * hands out TraceBlock views whose column pointers point into the mapping:
+ * iterating gigabytes allocates nothing per reading or per block.
+ * TraceWriter buffers one block and writes the header last, so a file is
+ * complete only once close() has succeeded.
+ *
+ * A reader accepts the versions it knows and rejects newer ones;
+ * TraceBlockHeader::encoding leaves room for compressed blocks.
+ */
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#define TRACE_MAGIC "ITMTRACE"
+#define TRACE_VERSION 1
+#define TRACE_DEVICE_MAX 32
+// Readings per block unless the writer is told otherwise
+#define TRACE_BLOCK_RECORDS 4096
+
+struct TraceHeader {
+    char magic[8];                      // TRACE_MAGIC, no terminator
+    uint16_t version;
+    uint16_t header_size;               // sizeof(TraceHeader)
+    uint32_t block_records;             // most readings in one block
+    char device[TRACE_DEVICE_MAX];      // NUL-terminated and padded
+    uint64_t record_count;
+    uint32_t block_count;
+    uint32_t reserved;
+    uint64_t index_offset;
+    uint64_t reserved2;
+};
+
+enum TraceEncoding {
+    TRACE_ENCODING_RAW = 0,             // the columns as above
+};
+
+struct TraceBlockHeader {
+    uint32_t count;
+    uint16_t encoding;                  // TraceEncoding
+    uint16_t reserved;
+    uint32_t size;                      // bytes after this header, padding included
+    uint32_t reserved2;
+};
+
+struct TraceIndexEntry {
+    uint64_t offset;                    // of the TraceBlockHeader
+    int64_t first_ms;
+    int64_t last_ms;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+// One block's readings, pointing into the mapped file
+struct TraceBlock {
+    size_t count;
+    int64_t first_ms;
+    int64_t last_ms;
+    const int64_t *t_ms;
+    const float *temperature;
+    const float *humidity;
+    const float *pressure;
+};
+
+class TraceReader {
+public:
+    TraceReader();
+    ~TraceReader();
+
+    // Maps the file and checks the header, the index and every block's
+    // bounds; on failure error says why
+    bool open(const char *path, std::string &error);
+    void close();
+
+    const char *device() const
+    {
+        return _device;
+    }
+    uint64_t record_count() const
+    {
+        return _header ? _header->record_count : 0;
+    }
+    size_t block_count() const
+    {
+        return _header ? _header->block_count : 0;
+    }
+    size_t file_size() const
+    {
+        return _size;
+    }
+    // The i-th block's readings, without copying them
+    TraceBlock block(size_t i) const;
+    // The first block that may hold readings at or after t_ms
+    size_t find_block(int64_t t_ms) const;
+
+private:
+    const uint8_t *_data;
+    size_t _size;
+    const TraceHeader *_header;
+    const TraceIndexEntry *_index;
+    char _device[TRACE_DEVICE_MAX + 1];
+};
+
+class TraceWriter {
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    bool open(const char *path, const char *device, uint32_t block_records = TRACE_BLOCK_RECORDS);
+    // Readings must come in time order; false once a write has failed or
+    // t_ms goes backwards
+    bool append(int64_t t_ms, float temperature, float humidity, float pressure);
+    // Writes the last block, the index and the header
+    bool close();
+
+    uint64_t record_count() const
+    {
+        return _records;
+    }
+
+private:
+    bool flush_block();
+
+    FILE *_file;
+    bool _ok;
+    uint32_t _block_records;
+    uint64_t _offset;
+    uint64_t _records;
+    char _device[TRACE_DEVICE_MAX];
+    std::vector<int64_t> _t_ms;
+    std::vector<float> _temperature;
+    std::vector<float> _humidity;
+    std::vector<float> _pressure;
+    std::vector<TraceIndexEntry> _index;
+};
+
+#endif // TRACE_FILE_H
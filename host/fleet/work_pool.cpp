@@ -0,0 +1,71 @@
+#include "work_pool.h"
+
+#include <thread>
+
+#include "aggregator.h"
+
+WorkPool::WorkPool(int threads)
+{
+    for (int i = 0; i < (threads > 0 ? threads : 1); i++) {
+        _queues.emplace_back(new Queue());
+    }
+}
+
+bool WorkPool::take(int thread, size_t *task, bool *stolen)
+{
+    {
+        Queue &own = *_queues[thread];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            *task = own.tasks.front();
+            own.tasks.pop_front();
+            *stolen = false;
+            return true;
+        }
+    }
+    // Victims in turn from the next thread on, so thieves spread out
+    int n = threads();
+    for (int i = 1; i < n; i++) {
+        Queue &victim = *_queues[(thread + i) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            *task = victim.tasks.back();
+            victim.tasks.pop_back();
+            *stolen = true;
+            return true;
+        }
+    }
+    // Tasks never add tasks, so every deque being empty means there is no more work
+    return false;
+}
+
+void WorkPool::work(int thread, const Task &task)
+{
+    WorkPoolStats &stats = _stats[thread];
+    size_t index;
+    bool stolen;
+    while (take(thread, &index, &stolen)) {
+        uint64_t start = fleet_now_ns();
+        task(index, thread);
+        stats.busy_ns += fleet_now_ns() - start;
+        stats.tasks++;
+        stats.stolen += stolen;
+    }
+}
+
+void WorkPool::run(size_t count, const Task &task)
+{
+    int n = threads();
+    _stats.assign(n, WorkPoolStats());
+    for (size_t i = 0; i < count; i++) {
+        _queues[i % n]->tasks.push_back(i);
+    }
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < n; t++) {
+        helpers.emplace_back(&WorkPool::work, this, t, std::cref(task));
+    }
+    work(0, task);
+    for (std::thread &helper : helpers) {
+        helper.join();
+    }
+}
@@ -0,0 +1,64 @@
+/* Work-stealing thread pool for the fleet's batch jobs.
+ *
+ * run() executes tasks 0..count-1 on the pool's threads (the calling thread
+ * is one of them) and returns when all are done. Tasks are dealt out up
+ * front, round robin, to one deque per thread. A thread takes from the
+ * front of its own deque; once that is empty it steals from the back of
+ * another's. Give the tasks in decreasing order of cost when that is known:
+ * the long ones then start first, and what is left to steal at the end is
+ * short, so the threads finish close together.
+ *
+ * The deques are guarded by a mutex each. Tasks here are whole device
+ * histories, milliseconds or more apiece, so the lock is never contended
+ * enough to matter and a lock-free deque would buy nothing.
+ */
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct WorkPoolStats {
+    uint64_t tasks;     // run by this thread
+    uint64_t stolen;    // of which taken from another thread's deque
+    uint64_t busy_ns;   // spent in tasks
+};
+
+class WorkPool {
+public:
+    typedef std::function<void(size_t task, int thread)> Task;
+
+    explicit WorkPool(int threads);
+
+    int threads() const
+    {
+        return (int)_queues.size();
+    }
+
+    void run(size_t count, const Task &task);
+    // Per thread, for the last run()
+    const std::vector<WorkPoolStats> &stats() const
+    {
+        return _stats;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool take(int thread, size_t *task, bool *stolen);
+    void work(int thread, const Task &task);
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<WorkPoolStats> _stats;
+};
+
+#endif // WORK_POOL_H
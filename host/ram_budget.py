@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Static RAM budget per module: .data and .bss bytes of each object file.
+
+Reads either the linker map of a firmware build (exact figures for the
+target, e.g. BUILD/DISCO_L475VG_IOT01A/GCC_ARM/<app>.map) or object files and
+static libraries through binutils' `size -A` (the host build's objects, or
+the firmware's with --size arm-none-eabi-size).
+
+    ram_budget.py --map BUILD/DISCO_L475VG_IOT01A/GCC_ARM/app.map
+    ram_budget.py build-host/libapp-core.a build-host/libapp-network.a
+
+Output is one JSON record per module, largest first, then a total. .data
+also occupies flash for its initial values; only RAM is counted here.
+"""
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+DATA_SECTIONS = (".data", ".tdata")
+BSS_SECTIONS = (".bss", ".tbss", "COMMON")
+
+
+def section_kind(name):
+    # Relocated constants (vtables) are writable only on hosted targets; the
+    # firmware places them in flash
+    if name.startswith(".data.rel.ro"):
+        return None
+    for prefix in DATA_SECTIONS:
+        if name == prefix or name.startswith(prefix + "."):
+            return "data"
+    for prefix in BSS_SECTIONS:
+        if name == prefix or name.startswith(prefix + "."):
+            return "bss"
+    return None
+
+
+def module_name(path):
+    # "libfoo.a(bar.cpp.o)" -> "bar", "dir/bar.o" -> "bar"
+    member = re.search(r"\(([^)]+)\)$", path)
+    name = os.path.basename(member.group(1) if member else path)
+    for ext in (".o", ".obj", ".c", ".cpp"):
+        if name.endswith(ext):
+            name = name[: -len(ext)]
+    return name
+
+
+def from_map(path):
+    """Input sections of a GNU ld map: ' .bss.name  0xaddr  0xsize  file.o',
+    with the address and size on the next line when the name is long."""
+    budget = defaultdict(lambda: {"data": 0, "bss": 0})
+    pending = None
+    in_memory_map = False
+    with open(path, errors="replace") as f:
+        for line in f:
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+            full = re.match(r"^ (\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$", line)
+            if full:
+                name, size, obj = full.group(1), int(full.group(3), 16), full.group(4).strip()
+                pending = None
+            elif pending and re.match(r"^\s+0x[0-9a-f]+\s+0x[0-9a-f]+\s+\S", line):
+                fields = line.split(None, 2)
+                name, size, obj = pending, int(fields[1], 16), fields[2].strip()
+                pending = None
+            else:
+                lone = re.match(r"^ (\.\S+|COMMON)\s*$", line)
+                pending = lone.group(1) if lone else None
+                continue
+            kind = section_kind(name)
+            if kind and size:
+                budget[module_name(obj)][kind] += size
+    return budget
+
+
+def from_objects(paths, size_tool):
+    """`size -A` prints a table per object (per member for archives)."""
+    budget = defaultdict(lambda: {"data": 0, "bss": 0})
+    out = subprocess.run([size_tool, "-A", "-d"] + paths, check=True,
+                         stdout=subprocess.PIPE, universal_newlines=True).stdout
+    module = None
+    for line in out.splitlines():
+        header = re.match(r"^(\S+)\s+(\(ex (\S+)\))?\s*:$", line)
+        if header:
+            module = module_name(header.group(1))
+            continue
+        fields = line.split()
+        if module and len(fields) == 3 and fields[1].isdigit():
+            kind = section_kind(fields[0])
+            if kind:
+                budget[module][kind] += int(fields[1])
+    return budget
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("objects", nargs="*", help="object files or static libraries")
+    parser.add_argument("--map", help="linker map file of a firmware build")
+    parser.add_argument("--size", default="size", help="binutils size program")
+    parser.add_argument("--filter", help="only modules whose name contains this")
+    args = parser.parse_args()
+    if bool(args.map) == bool(args.objects):
+        parser.error("give either --map or object files")
+
+    budget = from_map(args.map) if args.map else from_objects(args.objects, args.size)
+    rows = sorted(budget.items(), key=lambda kv: -(kv[1]["data"] + kv[1]["bss"]))
+    total = {"data": 0, "bss": 0}
+    for module, r in rows:
+        if args.filter and args.filter not in module:
+            continue
+        if r["data"] + r["bss"] == 0:
+            continue
+        total["data"] += r["data"]
+        total["bss"] += r["bss"]
+        print(json.dumps({"module": module, "data": r["data"], "bss": r["bss"],
+                          "ram": r["data"] + r["bss"]}))
+    print(json.dumps({"module": "total", "data": total["data"], "bss": total["bss"],
+                      "ram": total["data"] + total["bss"]}))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
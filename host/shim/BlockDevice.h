@@ -0,0 +1,71 @@
+/* Host stand-in for mbed's BlockDevice interface (storage/blockdevice).
+ *
+ * Same virtuals and error codes as mbed OS 6, so storage code written
+ * against it builds unchanged for the board (FlashIAPBlockDevice, QSPIF...)
+ * and for host tools that supply their own device.
+ */
+#ifndef HOST_BLOCK_DEVICE_H
+#define HOST_BLOCK_DEVICE_H
+
+#include <stdint.h>
+
+namespace mbed {
+
+typedef uint64_t bd_addr_t;
+typedef uint64_t bd_size_t;
+
+enum {
+    BD_ERROR_OK                 = 0,     // no error
+    BD_ERROR_DEVICE_ERROR       = -4001, // device specific error
+};
+
+class BlockDevice {
+public:
+    virtual ~BlockDevice() {}
+
+    virtual int init() = 0;
+    virtual int deinit() = 0;
+    virtual int sync()
+    {
+        return 0;
+    }
+
+    virtual int read(void *buffer, bd_addr_t addr, bd_size_t size) = 0;
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size) = 0;
+    virtual int erase(bd_addr_t addr, bd_size_t size)
+    {
+        return 0;
+    }
+    virtual int trim(bd_addr_t addr, bd_size_t size)
+    {
+        return 0;
+    }
+
+    virtual bd_size_t get_read_size() const = 0;
+    virtual bd_size_t get_program_size() const = 0;
+    virtual bd_size_t get_erase_size() const
+    {
+        return get_program_size();
+    }
+    virtual bd_size_t get_erase_size(bd_addr_t addr) const
+    {
+        return get_erase_size();
+    }
+    /** Value of erased bytes, or -1 if it is not defined */
+    virtual int get_erase_value() const
+    {
+        return -1;
+    }
+    virtual bd_size_t size() const = 0;
+    virtual const char *get_type() const = 0;
+};
+
+} // namespace mbed
+
+using mbed::BlockDevice;
+using mbed::bd_addr_t;
+using mbed::bd_size_t;
+using mbed::BD_ERROR_OK;
+using mbed::BD_ERROR_DEVICE_ERROR;
+
+#endif // HOST_BLOCK_DEVICE_H
@@ -0,0 +1,74 @@
+/* Host stand-in for mbed::Callback.
+ *
+ * Only the constructors the in-tree drivers use are provided: plain
+ * functions, functors/lambdas, (object, member function) pairs and null.
+ */
+#ifndef HOST_CALLBACK_H
+#define HOST_CALLBACK_H
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace mbed {
+
+template <typename Signature>
+class Callback;
+
+template <typename R, typename... Args>
+class Callback<R(Args...)> {
+public:
+    Callback() {}
+
+    // Also takes NULL/nullptr, which leaves the callback empty
+    Callback(R (*func)(Args...))
+    {
+        if (func) {
+            _func = func;
+        }
+    }
+
+    template <typename F, typename = typename std::enable_if<
+                  !std::is_pointer<F>::value &&
+                  !std::is_integral<F>::value &&
+                  !std::is_same<typename std::decay<F>::type, Callback>::value>::type>
+    Callback(F f) : _func(std::move(f)) {}
+
+    template <typename T, typename U>
+    Callback(U *obj, R (T::*method)(Args...))
+        : _func([obj, method](Args... args) -> R { return (obj->*method)(std::forward<Args>(args)...); }) {}
+
+    template <typename T, typename U>
+    Callback(const U *obj, R (T::*method)(Args...) const)
+        : _func([obj, method](Args... args) -> R { return (obj->*method)(std::forward<Args>(args)...); }) {}
+
+    R operator()(Args... args) const
+    {
+        return _func(std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const
+    {
+        return static_cast<bool>(_func);
+    }
+
+private:
+    std::function<R(Args...)> _func;
+};
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(U *obj, R (T::*method)(Args...))
+{
+    return Callback<R(Args...)>(obj, method);
+}
+
+template <typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(Args...))
+{
+    return Callback<R(Args...)>(func);
+}
+
+} // namespace mbed
+
+#endif // HOST_CALLBACK_H
@@ -0,0 +1,128 @@
+/* Host stand-in for mbed OS's MQTTClientMbedOs (the Paho MQTT::Client
+ * wrapped around a TCPSocket).
+ *
+ * Return codes and connection-state handling follow Paho: 0 on success,
+ * MQTT::FAILURE (-1) otherwise, and a failed read, send or keep-alive marks
+ * the session disconnected. Packets are limited to
+ * MBED_CONF_MQTT_MAX_PACKET_SIZE as in the library. Unlike the library's
+ * network wrapper, a packet that arrives in several socket reads is
+ * reassembled rather than dropped.
+ */
+#ifndef HOST_MQTT_CLIENT_MBED_OS_H
+#define HOST_MQTT_CLIENT_MBED_OS_H
+
+#include <stddef.h>
+
+#include <chrono>
+
+#include "MQTTPacket.h"
+#include "TCPSocket.h"
+
+#ifndef MBED_CONF_MQTT_MAX_PACKET_SIZE
+#define MBED_CONF_MQTT_MAX_PACKET_SIZE 100
+#endif
+#ifndef MBED_CONF_MQTT_MAX_CONNECTIONS
+#define MBED_CONF_MQTT_MAX_CONNECTIONS 5
+#endif
+
+namespace MQTT {
+
+enum QoS { QOS0, QOS1, QOS2 };
+
+enum returnCode { BUFFER_OVERFLOW = -2, FAILURE = -1, SUCCESS = 0 };
+
+struct Message {
+    enum QoS qos;
+    bool retained;
+    bool dup;
+    unsigned short id;
+    void *payload;
+    size_t payloadlen;
+};
+
+struct MessageData {
+    MessageData(MQTTString &aTopicName, struct Message &aMessage) : message(aMessage), topicName(aTopicName) {}
+
+    struct Message &message;
+    MQTTString &topicName;
+};
+
+} // namespace MQTT
+
+class MQTTClient {
+public:
+    typedef void (*messageHandler)(MQTT::MessageData &);
+
+    MQTTClient(TCPSocket *socket, unsigned int command_timeout_ms = 30000);
+
+    nsapi_error_t connect(MQTTPacket_connectData &options);
+    nsapi_error_t publish(const char *topicName, MQTT::Message &message);
+    nsapi_error_t subscribe(const char *topicFilter, enum MQTT::QoS qos, messageHandler mh);
+    nsapi_error_t unsubscribe(const char *topicFilter);
+    nsapi_error_t yield(unsigned long timeout_ms = 1000L);
+    nsapi_error_t disconnect();
+    bool isConnected();
+    void setDefaultMessageHandler(messageHandler mh);
+
+private:
+    class Countdown {
+    public:
+        Countdown() : _end(std::chrono::steady_clock::now()) {}
+        explicit Countdown(unsigned long ms)
+        {
+            countdown_ms(ms);
+        }
+        void countdown_ms(unsigned long ms)
+        {
+            _end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        }
+        void countdown(unsigned int seconds)
+        {
+            countdown_ms(seconds * 1000UL);
+        }
+        bool expired() const
+        {
+            return left_ms() == 0;
+        }
+        int left_ms() const
+        {
+            long long left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 _end - std::chrono::steady_clock::now()).count();
+            return left > 0 ? (int)left : 0;
+        }
+
+    private:
+        std::chrono::steady_clock::time_point _end;
+    };
+
+    int net_read(unsigned char *buffer, int len, Countdown &timer);
+    int send_packet(int length, Countdown &timer);
+    int read_packet(Countdown &timer);
+    int cycle(Countdown &timer);
+    int waitfor(int packet_type, Countdown &timer);
+    int keepalive();
+    void deliver_message(MQTTString &topicName, MQTT::Message &message);
+    void close_session();
+    unsigned short next_packet_id();
+
+    TCPSocket *_socket;
+    unsigned int _command_timeout_ms;
+    unsigned char _sendbuf[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+    unsigned char _readbuf[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+
+    Countdown _last_sent;
+    Countdown _last_received;
+    unsigned int _keep_alive_interval;
+    bool _ping_outstanding;
+    bool _is_connected;
+    bool _clean_session;
+    unsigned short _packet_id;
+
+    struct {
+        const char *topicFilter;
+        messageHandler fp;
+    } _handlers[MBED_CONF_MQTT_MAX_CONNECTIONS];
+    messageHandler _default_handler;
+};
+
+#endif // HOST_MQTT_CLIENT_MBED_OS_H
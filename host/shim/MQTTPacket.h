@@ -0,0 +1,119 @@
+/* Host stand-in for the Paho embedded-C MQTTPacket library that mbed OS
+ * ships with its MQTT client. The functions here keep Paho's names,
+ * signatures and return conventions (serializers return the packet length or
+ * MQTTPACKET_BUFFER_TOO_SHORT, deserializers return 1 on success), so code
+ * written against them builds unchanged for the board.
+ *
+ * Only MQTT 3.1/3.1.1 packets without QoS 2 flows are covered.
+ */
+#ifndef HOST_MQTT_PACKET_H
+#define HOST_MQTT_PACKET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum errors {
+    MQTTPACKET_BUFFER_TOO_SHORT = -2,
+    MQTTPACKET_READ_ERROR = -1,
+    MQTTPACKET_READ_COMPLETE
+};
+
+enum msgTypes {
+    CONNECT = 1, CONNACK, PUBLISH, PUBACK, PUBREC, PUBREL,
+    PUBCOMP, SUBSCRIBE, SUBACK, UNSUBSCRIBE, UNSUBACK,
+    PINGREQ, PINGRESP, DISCONNECT
+};
+
+typedef union {
+    unsigned char byte;
+    struct {
+        unsigned int retain : 1;
+        unsigned int qos : 2;
+        unsigned int dup : 1;
+        unsigned int type : 4;
+    } bits;
+} MQTTHeader;
+
+typedef struct {
+    int len;
+    char *data;
+} MQTTLenString;
+
+typedef struct {
+    char *cstring;
+    MQTTLenString lenstring;
+} MQTTString;
+
+#define MQTTString_initializer {NULL, {0, NULL}}
+
+typedef struct {
+    char struct_id[4];
+    int struct_version;
+    MQTTString topicName;
+    MQTTString message;
+    unsigned char retained;
+    char qos;
+} MQTTPacket_willOptions;
+
+#define MQTTPacket_willOptions_initializer { {'M', 'Q', 'T', 'W'}, 0, {NULL, {0, NULL}}, {NULL, {0, NULL}}, 0, 0 }
+
+typedef struct {
+    char struct_id[4];
+    int struct_version;
+    unsigned char MQTTVersion;   // 3 = 3.1, 4 = 3.1.1
+    MQTTString clientID;
+    unsigned short keepAliveInterval;
+    unsigned char cleansession;
+    unsigned char willFlag;
+    MQTTPacket_willOptions will;
+    MQTTString username;
+    MQTTString password;
+} MQTTPacket_connectData;
+
+#define MQTTPacket_connectData_initializer { {'M', 'Q', 'T', 'C'}, 0, 4, {NULL, {0, NULL}}, 60, 1, 0, \
+        MQTTPacket_willOptions_initializer, {NULL, {0, NULL}}, {NULL, {0, NULL}} }
+
+int MQTTstrlen(MQTTString mqttstring);
+int MQTTPacket_equals(MQTTString *a, char *b);
+
+/** Remaining-length field helpers */
+int MQTTPacket_encode(unsigned char *buf, int length);
+int MQTTPacket_decodeBuf(unsigned char *buf, int *value);
+int MQTTPacket_len(int rem_len);
+
+int MQTTSerialize_connect(unsigned char *buf, int buflen, MQTTPacket_connectData *options);
+int MQTTDeserialize_connect(MQTTPacket_connectData *data, unsigned char *buf, int len);
+int MQTTSerialize_connack(unsigned char *buf, int buflen, unsigned char connack_rc, unsigned char sessionPresent);
+int MQTTDeserialize_connack(unsigned char *sessionPresent, unsigned char *connack_rc, unsigned char *buf, int buflen);
+
+int MQTTSerialize_disconnect(unsigned char *buf, int buflen);
+int MQTTSerialize_pingreq(unsigned char *buf, int buflen);
+
+int MQTTSerialize_publish(unsigned char *buf, int buflen, unsigned char dup, int qos, unsigned char retained,
+                          unsigned short packetid, MQTTString topicName, unsigned char *payload, int payloadlen);
+int MQTTDeserialize_publish(unsigned char *dup, int *qos, unsigned char *retained, unsigned short *packetid,
+                            MQTTString *topicName, unsigned char **payload, int *payloadlen,
+                            unsigned char *buf, int len);
+
+int MQTTSerialize_ack(unsigned char *buf, int buflen, unsigned char type, unsigned char dup, unsigned short packetid);
+int MQTTSerialize_puback(unsigned char *buf, int buflen, unsigned short packetid);
+int MQTTDeserialize_ack(unsigned char *packettype, unsigned char *dup, unsigned short *packetid,
+                        unsigned char *buf, int buflen);
+
+int MQTTSerialize_subscribe(unsigned char *buf, int buflen, unsigned char dup, unsigned short packetid,
+                            int count, MQTTString topicFilters[], int requestedQoSs[]);
+int MQTTDeserialize_subscribe(unsigned char *dup, unsigned short *packetid, int maxcount, int *count,
+                              MQTTString topicFilters[], int requestedQoSs[], unsigned char *buf, int len);
+int MQTTSerialize_suback(unsigned char *buf, int buflen, unsigned short packetid, int count, int *grantedQoSs);
+int MQTTDeserialize_suback(unsigned short *packetid, int maxcount, int *count, int grantedQoSs[],
+                           unsigned char *buf, int len);
+
+int MQTTSerialize_unsubscribe(unsigned char *buf, int buflen, unsigned char dup, unsigned short packetid,
+                              int count, MQTTString topicFilters[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MQTT_PACKET_H
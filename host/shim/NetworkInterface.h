@@ -0,0 +1,79 @@
+/* Host stand-in for netsocket NetworkInterface */
+#ifndef HOST_NETWORK_INTERFACE_H
+#define HOST_NETWORK_INTERFACE_H
+
+#include <stdint.h>
+
+#include "Callback.h"
+#include "NetworkStack.h"
+#include "SocketAddress.h"
+#include "nsapi_types.h"
+
+class WiFiInterface;
+
+class NetworkInterface {
+public:
+    virtual ~NetworkInterface() {}
+
+    virtual nsapi_error_t connect() = 0;
+    virtual nsapi_error_t disconnect() = 0;
+
+    virtual const char *get_mac_address()
+    {
+        return nullptr;
+    }
+    virtual const char *get_ip_address()
+    {
+        return nullptr;
+    }
+    virtual nsapi_error_t get_ip_address(SocketAddress *address)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+    virtual const char *get_netmask()
+    {
+        return nullptr;
+    }
+    virtual nsapi_error_t get_netmask(SocketAddress *address)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+    virtual const char *get_gateway()
+    {
+        return nullptr;
+    }
+    virtual nsapi_error_t get_gateway(SocketAddress *address)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+    virtual char *get_interface_name(char *interface_name)
+    {
+        return nullptr;
+    }
+
+    virtual nsapi_error_t gethostbyname(const char *host, SocketAddress *address,
+                                        nsapi_version_t version = NSAPI_UNSPEC,
+                                        const char *interface_name = nullptr)
+    {
+        return get_stack()->gethostbyname(host, address, version, interface_name);
+    }
+
+    virtual void attach(mbed::Callback<void(nsapi_event_t, intptr_t)> status_cb) {}
+    virtual nsapi_connection_status_t get_connection_status() const
+    {
+        return NSAPI_STATUS_ERROR_UNSUPPORTED;
+    }
+
+    virtual WiFiInterface *wifiInterface()
+    {
+        return nullptr;
+    }
+
+protected:
+    friend class TCPSocket;
+    friend class UDPSocket;
+
+    virtual NetworkStack *get_stack() = 0;
+};
+
+#endif // HOST_NETWORK_INTERFACE_H
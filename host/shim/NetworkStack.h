@@ -0,0 +1,49 @@
+/* Host stand-in for netsocket NetworkStack, the socket API a network driver
+ * implements. Only the calls the sockets and the in-tree drivers use exist.
+ */
+#ifndef HOST_NETWORK_STACK_H
+#define HOST_NETWORK_STACK_H
+
+#include "SocketAddress.h"
+#include "nsapi_types.h"
+
+class NetworkStack {
+public:
+    virtual ~NetworkStack() {}
+
+    virtual const char *get_ip_address()
+    {
+        return nullptr;
+    }
+    virtual nsapi_error_t get_ip_address(SocketAddress *address)
+    {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+
+    /** IP literals are taken as they are; names go to the host's resolver,
+     *  standing in for the DNS client the firmware's stack would run */
+    virtual nsapi_error_t gethostbyname(const char *host, SocketAddress *address,
+                                        nsapi_version_t version = NSAPI_UNSPEC,
+                                        const char *interface_name = nullptr);
+
+protected:
+    friend class TCPSocket;
+    friend class UDPSocket;
+
+    virtual nsapi_error_t socket_open(nsapi_socket_t *handle, nsapi_protocol_t proto) = 0;
+    virtual nsapi_error_t socket_close(nsapi_socket_t handle) = 0;
+    virtual nsapi_error_t socket_bind(nsapi_socket_t handle, const SocketAddress &address) = 0;
+    virtual nsapi_error_t socket_listen(nsapi_socket_t handle, int backlog) = 0;
+    virtual nsapi_error_t socket_connect(nsapi_socket_t handle, const SocketAddress &address) = 0;
+    virtual nsapi_error_t socket_accept(nsapi_socket_t server, nsapi_socket_t *handle,
+                                        SocketAddress *address) = 0;
+    virtual nsapi_size_or_error_t socket_send(nsapi_socket_t handle, const void *data, nsapi_size_t size) = 0;
+    virtual nsapi_size_or_error_t socket_recv(nsapi_socket_t handle, void *data, nsapi_size_t size) = 0;
+    virtual nsapi_size_or_error_t socket_sendto(nsapi_socket_t handle, const SocketAddress &address,
+                                                const void *data, nsapi_size_t size) = 0;
+    virtual nsapi_size_or_error_t socket_recvfrom(nsapi_socket_t handle, SocketAddress *address,
+                                                  void *data, nsapi_size_t size) = 0;
+    virtual void socket_attach(nsapi_socket_t handle, void (*callback)(void *), void *data) = 0;
+};
+
+#endif // HOST_NETWORK_STACK_H
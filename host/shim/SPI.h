@@ -0,0 +1,2 @@
+/* The shim keeps all of its peripheral classes in mbed.h */
+#include "mbed.h"
@@ -0,0 +1,47 @@
+/* Host stand-in for netsocket SocketAddress: an IP literal and a port */
+#ifndef HOST_SOCKET_ADDRESS_H
+#define HOST_SOCKET_ADDRESS_H
+
+#include <stdint.h>
+
+#include "nsapi_types.h"
+
+#define NSAPI_IP_SIZE 40
+
+class SocketAddress {
+public:
+    SocketAddress(const char *addr = nullptr, uint16_t port = 0);
+
+    /** Accepts IPv4 and IPv6 literals; anything else leaves the address empty */
+    bool set_ip_address(const char *addr);
+    void set_port(uint16_t port)
+    {
+        _port = port;
+    }
+
+    /** nullptr when no address is set */
+    const char *get_ip_address() const;
+    uint16_t get_port() const
+    {
+        return _port;
+    }
+    nsapi_version_t get_ip_version() const
+    {
+        return _version;
+    }
+
+    explicit operator bool() const
+    {
+        return _version != NSAPI_UNSPEC;
+    }
+
+    friend bool operator==(const SocketAddress &a, const SocketAddress &b);
+    friend bool operator!=(const SocketAddress &a, const SocketAddress &b);
+
+private:
+    char _ip[NSAPI_IP_SIZE];
+    nsapi_version_t _version;
+    uint16_t _port;
+};
+
+#endif // HOST_SOCKET_ADDRESS_H
@@ -0,0 +1,59 @@
+/* Host stand-in for netsocket TCPSocket.
+ *
+ * Blocking behaviour follows mbed OS: a call that would block waits for the
+ * stack's socket event (or the timeout) and retries. sigio() handlers run in
+ * the thread that raised the event.
+ */
+#ifndef HOST_TCP_SOCKET_H
+#define HOST_TCP_SOCKET_H
+
+#include <condition_variable>
+#include <mutex>
+
+#include "Callback.h"
+#include "NetworkInterface.h"
+#include "NetworkStack.h"
+#include "SocketAddress.h"
+#include "nsapi_types.h"
+
+class TCPSocket {
+public:
+    TCPSocket();
+    virtual ~TCPSocket();
+
+    nsapi_error_t open(NetworkStack *stack);
+    nsapi_error_t open(NetworkInterface *iface)
+    {
+        return open(iface ? iface->get_stack() : nullptr);
+    }
+    nsapi_error_t close();
+
+    nsapi_error_t connect(const SocketAddress &address);
+    nsapi_size_or_error_t send(const void *data, nsapi_size_t size);
+    nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
+
+    /** -1 blocks indefinitely, 0 never blocks */
+    void set_timeout(int timeout);
+    void set_blocking(bool blocking)
+    {
+        set_timeout(blocking ? -1 : 0);
+    }
+
+    void sigio(mbed::Callback<void()> func);
+
+private:
+    static void event_thunk(void *data);
+    void event();
+    bool wait_event();
+
+    NetworkStack *_stack;
+    nsapi_socket_t _socket;
+    int _timeout;
+
+    std::mutex _event_mutex;
+    std::condition_variable _event_cv;
+    bool _event_pending;
+    mbed::Callback<void()> _callback;
+};
+
+#endif // HOST_TCP_SOCKET_H
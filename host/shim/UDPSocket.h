@@ -0,0 +1,47 @@
+/* Host stand-in for netsocket UDPSocket: datagrams through the network
+ * stack, blocking up to the timeout as TCPSocket does.
+ */
+#ifndef HOST_UDP_SOCKET_H
+#define HOST_UDP_SOCKET_H
+
+#include <condition_variable>
+#include <mutex>
+
+#include "NetworkInterface.h"
+#include "NetworkStack.h"
+#include "SocketAddress.h"
+#include "nsapi_types.h"
+
+class UDPSocket {
+public:
+    UDPSocket();
+    virtual ~UDPSocket();
+
+    nsapi_error_t open(NetworkStack *stack);
+    nsapi_error_t open(NetworkInterface *iface)
+    {
+        return open(iface ? iface->get_stack() : nullptr);
+    }
+    nsapi_error_t close();
+
+    nsapi_size_or_error_t sendto(const SocketAddress &address, const void *data, nsapi_size_t size);
+    nsapi_size_or_error_t recvfrom(SocketAddress *address, void *data, nsapi_size_t size);
+
+    /** -1 blocks indefinitely, 0 never blocks */
+    void set_timeout(int timeout);
+
+private:
+    static void event_thunk(void *data);
+    void event();
+    bool wait_event();
+
+    NetworkStack *_stack;
+    nsapi_socket_t _socket;
+    int _timeout;
+
+    std::mutex _event_mutex;
+    std::condition_variable _event_cv;
+    bool _event_pending;
+};
+
+#endif // HOST_UDP_SOCKET_H
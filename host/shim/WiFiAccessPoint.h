@@ -0,0 +1,42 @@
+/* Host stand-in for netsocket WiFiAccessPoint */
+#ifndef HOST_WIFI_ACCESS_POINT_H
+#define HOST_WIFI_ACCESS_POINT_H
+
+#include <string.h>
+
+#include "nsapi_types.h"
+
+class WiFiAccessPoint {
+public:
+    WiFiAccessPoint()
+    {
+        memset(&_ap, 0, sizeof(_ap));
+    }
+    WiFiAccessPoint(nsapi_wifi_ap_t ap) : _ap(ap) {}
+
+    const char *get_ssid() const
+    {
+        return _ap.ssid;
+    }
+    const uint8_t *get_bssid() const
+    {
+        return _ap.bssid;
+    }
+    nsapi_security_t get_security() const
+    {
+        return _ap.security;
+    }
+    int8_t get_rssi() const
+    {
+        return _ap.rssi;
+    }
+    uint8_t get_channel() const
+    {
+        return _ap.channel;
+    }
+
+private:
+    nsapi_wifi_ap_t _ap;
+};
+
+#endif // HOST_WIFI_ACCESS_POINT_H
@@ -0,0 +1,30 @@
+/* Host stand-in for netsocket WiFiInterface */
+#ifndef HOST_WIFI_INTERFACE_H
+#define HOST_WIFI_INTERFACE_H
+
+#include "NetworkInterface.h"
+#include "WiFiAccessPoint.h"
+
+class WiFiInterface : public virtual NetworkInterface {
+public:
+    virtual nsapi_error_t set_credentials(const char *ssid, const char *pass,
+                                          nsapi_security_t security = NSAPI_SECURITY_NONE) = 0;
+    virtual nsapi_error_t set_channel(uint8_t channel) = 0;
+    virtual int8_t get_rssi() = 0;
+
+    virtual nsapi_error_t connect(const char *ssid, const char *pass,
+                                  nsapi_security_t security = NSAPI_SECURITY_NONE, uint8_t channel = 0) = 0;
+    virtual nsapi_error_t connect() = 0;
+    virtual nsapi_error_t disconnect() = 0;
+
+    virtual nsapi_size_or_error_t scan(WiFiAccessPoint *res, nsapi_size_t count) = 0;
+
+    virtual WiFiInterface *wifiInterface()
+    {
+        return this;
+    }
+
+    static WiFiInterface *get_default_instance();
+};
+
+#endif // HOST_WIFI_INTERFACE_H
@@ -0,0 +1,76 @@
+/* Hooks that let host tools put emulated peripherals behind the shim's bus
+ * and GPIO classes. Nothing is attached by default, in which case I2C
+ * transfers are NACKed as on an empty bus, SPI reads return zeros and input
+ * pins read low.
+ */
+#ifndef HOST_BUS_H
+#define HOST_BUS_H
+
+#include "Callback.h"
+
+class HostI2CBus {
+public:
+    virtual ~HostI2CBus() {}
+
+    /** Bus clock requested by the master */
+    virtual void frequency(int hz) {}
+
+    /** Same contract as mbed::I2C::read/write: 0 on ACK, non-zero on NACK.
+     *  @p address is the 8-bit (left-aligned) slave address. */
+    virtual int read(int address, char *data, int length, bool repeated) = 0;
+    virtual int write(int address, const char *data, int length, bool repeated) = 0;
+};
+
+/** Route every mbed::I2C instance to @p bus (nullptr detaches) */
+void host_i2c_attach(HostI2CBus *bus);
+HostI2CBus *host_i2c_bus();
+
+class HostSPIBus {
+public:
+    virtual ~HostSPIBus() {}
+
+    virtual void format(int bits, int mode) {}
+    virtual void frequency(int hz) {}
+
+    /** One full-duplex frame, as mbed::SPI::write(int) */
+    virtual int transfer(int value) = 0;
+};
+
+/** Route every mbed::SPI instance to @p bus (nullptr detaches) */
+void host_spi_attach(HostSPIBus *bus);
+HostSPIBus *host_spi_bus();
+
+/** Sees every DigitalOut write, so an emulator can follow chip selects and
+ *  reset lines driven by the application */
+class HostGPIOListener {
+public:
+    virtual ~HostGPIOListener() {}
+    virtual void pin_written(int pin, int value) = 0;
+};
+
+void host_gpio_listen(HostGPIOListener *listener);
+
+/** Drive an input pin. DigitalIn reads the level; InterruptIn handlers on the
+ *  pin run synchronously, in the caller's thread, on a change. */
+void host_gpio_set(int pin, int value);
+int host_gpio_get(int pin);
+
+/** Used by the shim's DigitalOut to report writes to the listener */
+void host_gpio_write(int pin, int value);
+
+/** Interrupt registration used by the shim's InterruptIn */
+struct HostPinIrq {
+    int pin;
+    mbed::Callback<void()> rise;
+    mbed::Callback<void()> fall;
+};
+
+void host_gpio_irq_add(HostPinIrq *irq);
+void host_gpio_irq_remove(HostPinIrq *irq);
+
+/** Called once, before the first use of any hook above. Tools that need an
+ *  emulator in place before the application's static constructors touch the
+ *  hardware define this; the default does nothing. */
+void host_board_setup();
+
+#endif // HOST_BUS_H
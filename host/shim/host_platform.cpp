@@ -0,0 +1,195 @@
+/* Host implementations of the mbed platform calls declared in the shim */
+#include "mbed.h"
+#include "mbed_stats.h"
+#include <stdarg.h>
+
+#include <atomic>
+#include <map>
+#include <thread>
+#include <vector>
+
+static std::recursive_mutex critical_section;
+static HostI2CBus *i2c_bus = nullptr;
+static HostSPIBus *spi_bus = nullptr;
+
+// GPIO state: input levels driven by emulators, InterruptIn registrations and
+// the listener that sees DigitalOut writes. Pins are set up by static
+// constructors in the application, so this is built on first use and never
+// torn down.
+struct GpioState {
+    std::recursive_mutex mutex;
+    std::map<int, int> levels;
+    std::vector<HostPinIrq *> irqs;
+    HostGPIOListener *listener = nullptr;
+};
+
+static GpioState &gpio()
+{
+    static GpioState *state = new GpioState;
+    return *state;
+}
+
+extern "C" void core_util_critical_section_enter(void)
+{
+    critical_section.lock();
+}
+
+extern "C" void core_util_critical_section_exit(void)
+{
+    critical_section.unlock();
+}
+
+extern "C" void error(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    abort();
+}
+
+static std::atomic<mbed_mem_trace_cb_t> mem_trace_callback(nullptr);
+static thread_local int mem_trace_suspended = 0;
+
+void mbed_mem_trace_set_callback(mbed_mem_trace_cb_t cb)
+{
+    mem_trace_callback = cb;
+}
+
+HostMemTraceSuspend::HostMemTraceSuspend()
+{
+    mem_trace_suspended++;
+}
+
+HostMemTraceSuspend::~HostMemTraceSuspend()
+{
+    mem_trace_suspended--;
+}
+
+mbed_mem_trace_cb_t host_mem_trace_callback()
+{
+    return mem_trace_suspended ? nullptr : mem_trace_callback.load();
+}
+
+// heap_trap.cpp has the real figures
+__attribute__((weak)) void mbed_stats_heap_get(mbed_stats_heap_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void wait_us(int us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+__attribute__((weak)) void host_board_setup()
+{
+}
+
+// Runs host_board_setup() the first time the application side touches a
+// peripheral. Calls made by the setup itself fall through.
+static void board_setup_once()
+{
+    static std::once_flag once;
+    static thread_local bool in_setup = false;
+    if (in_setup) {
+        return;
+    }
+    std::call_once(once, [] {
+        in_setup = true;
+        host_board_setup();
+        in_setup = false;
+    });
+}
+
+void host_i2c_attach(HostI2CBus *bus)
+{
+    i2c_bus = bus;
+}
+
+HostI2CBus *host_i2c_bus()
+{
+    board_setup_once();
+    return i2c_bus;
+}
+
+void host_spi_attach(HostSPIBus *bus)
+{
+    spi_bus = bus;
+}
+
+HostSPIBus *host_spi_bus()
+{
+    board_setup_once();
+    return spi_bus;
+}
+
+void host_gpio_listen(HostGPIOListener *listener)
+{
+    GpioState &g = gpio();
+    std::lock_guard<std::recursive_mutex> lock(g.mutex);
+    g.listener = listener;
+}
+
+void host_gpio_write(int pin, int value)
+{
+    board_setup_once();
+    GpioState &g = gpio();
+    std::lock_guard<std::recursive_mutex> lock(g.mutex);
+    if (g.listener) {
+        HostMemTraceSuspend emulator;
+        g.listener->pin_written(pin, value);
+    }
+}
+
+void host_gpio_set(int pin, int value)
+{
+    GpioState &g = gpio();
+    std::lock_guard<std::recursive_mutex> lock(g.mutex);
+    value = value ? 1 : 0;
+    int &level = g.levels[pin];
+    if (level == value) {
+        return;
+    }
+    level = value;
+    for (size_t i = 0; i < g.irqs.size(); i++) {
+        HostPinIrq *irq = g.irqs[i];
+        if (irq->pin != pin) {
+            continue;
+        }
+        if (value && irq->rise) {
+            irq->rise();
+        } else if (!value && irq->fall) {
+            irq->fall();
+        }
+    }
+}
+
+int host_gpio_get(int pin)
+{
+    board_setup_once();
+    GpioState &g = gpio();
+    std::lock_guard<std::recursive_mutex> lock(g.mutex);
+    std::map<int, int>::const_iterator it = g.levels.find(pin);
+    return it == g.levels.end() ? 0 : it->second;
+}
+
+void host_gpio_irq_add(HostPinIrq *irq)
+{
+    board_setup_once();
+    GpioState &g = gpio();
+    std::lock_guard<std::recursive_mutex> lock(g.mutex);
+    g.irqs.push_back(irq);
+}
+
+void host_gpio_irq_remove(HostPinIrq *irq)
+{
+    GpioState &g = gpio();
+    std::lock_guard<std::recursive_mutex> lock(g.mutex);
+    for (size_t i = 0; i < g.irqs.size(); i++) {
+        if (g.irqs[i] == irq) {
+            g.irqs.erase(g.irqs.begin() + i);
+            break;
+        }
+    }
+}
@@ -0,0 +1,442 @@
+/* Host stand-in for the subset of mbed.h used by the application modules
+ * and the in-tree sensor/WiFi drivers.
+ *
+ * This is not an mbed OS port: peripherals are inert unless a host tool
+ * attaches an emulator to them, and only the calls the code in this
+ * repository makes are provided.
+ */
+#ifndef HOST_MBED_H
+#define HOST_MBED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "Callback.h"
+#include "host_bus.h"
+#include "mbed_error.h"
+#include "mbed_debug.h"
+#include "mbed_mem_trace.h"
+
+// Pins referenced by config.h and mbed_app.json. The values are arbitrary.
+typedef enum {
+    PB_10, PB_11, PB_13,
+    PC_10, PC_11, PC_12,
+    PE_0, PE_1, PE_8,
+    LED1,
+    NC = -1
+} PinName;
+
+extern "C" void core_util_critical_section_enter(void);
+extern "C" void core_util_critical_section_exit(void);
+
+// mbed_critical.h atomics
+inline uint8_t core_util_atomic_load_u8(const volatile uint8_t *valuePtr)
+{
+    return __atomic_load_n(valuePtr, __ATOMIC_SEQ_CST);
+}
+
+inline void core_util_atomic_store_u8(volatile uint8_t *valuePtr, uint8_t desiredValue)
+{
+    __atomic_store_n(valuePtr, desiredValue, __ATOMIC_SEQ_CST);
+}
+
+void wait_us(int us);
+
+namespace mbed {
+
+class Timer {
+public:
+    Timer() : _running(false), _elapsed(0) {}
+
+    void start()
+    {
+        if (!_running) {
+            _start = std::chrono::steady_clock::now();
+            _running = true;
+        }
+    }
+
+    void stop()
+    {
+        if (_running) {
+            _elapsed += now_elapsed();
+            _running = false;
+        }
+    }
+
+    void reset()
+    {
+        _elapsed = std::chrono::microseconds(0);
+        _start = std::chrono::steady_clock::now();
+    }
+
+    std::chrono::microseconds elapsed_time() const
+    {
+        return _running ? _elapsed + now_elapsed() : _elapsed;
+    }
+
+    int read_ms() const
+    {
+        return (int)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed_time()).count();
+    }
+
+    int read_us() const
+    {
+        return (int)elapsed_time().count();
+    }
+
+private:
+    std::chrono::microseconds now_elapsed() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start);
+    }
+
+    bool _running;
+    std::chrono::steady_clock::time_point _start;
+    std::chrono::microseconds _elapsed;
+};
+
+class DigitalOut {
+public:
+    DigitalOut(PinName pin, int value = 0) : _pin(pin), _value(value)
+    {
+        host_gpio_write(pin, value);
+    }
+    void write(int value)
+    {
+        _value = value;
+        host_gpio_write(_pin, value);
+    }
+    int read() const
+    {
+        return _value;
+    }
+    DigitalOut &operator=(int value)
+    {
+        write(value);
+        return *this;
+    }
+    operator int() const
+    {
+        return read();
+    }
+
+private:
+    PinName _pin;
+    int _value;
+};
+
+class DigitalIn {
+public:
+    DigitalIn(PinName pin) : _pin(pin) {}
+    int read() const
+    {
+        return host_gpio_get(_pin);
+    }
+    operator int() const
+    {
+        return read();
+    }
+
+private:
+    PinName _pin;
+};
+
+class InterruptIn {
+public:
+    InterruptIn(PinName pin)
+    {
+        _irq.pin = pin;
+        host_gpio_irq_add(&_irq);
+    }
+    ~InterruptIn()
+    {
+        host_gpio_irq_remove(&_irq);
+    }
+    void rise(Callback<void()> func)
+    {
+        _irq.rise = func;
+    }
+    void fall(Callback<void()> func)
+    {
+        _irq.fall = func;
+    }
+    int read() const
+    {
+        return host_gpio_get(_irq.pin);
+    }
+
+private:
+    HostPinIrq _irq;
+};
+
+class SPI {
+public:
+    SPI(PinName mosi, PinName miso, PinName sclk, PinName ssel = NC) {}
+    virtual ~SPI() {}
+    void frequency(int hz)
+    {
+        if (HostSPIBus *bus = host_spi_bus()) {
+            bus->frequency(hz);
+        }
+    }
+    void format(int bits, int mode = 0)
+    {
+        if (HostSPIBus *bus = host_spi_bus()) {
+            bus->format(bits, mode);
+        }
+    }
+    virtual int write(int value)
+    {
+        HostSPIBus *bus = host_spi_bus();
+        HostMemTraceSuspend emulator;
+        return bus ? bus->transfer(value) : 0;
+    }
+    virtual int write(const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length)
+    {
+        int length = std::max(tx_length, rx_length);
+        for (int i = 0; i < length; i++) {
+            int rx = SPI::write(i < tx_length ? (uint8_t)tx_buffer[i] : 0xFF);
+            if (i < rx_length) {
+                rx_buffer[i] = (char)rx;
+            }
+        }
+        return length;
+    }
+    void lock()
+    {
+        _mutex.lock();
+    }
+    void unlock()
+    {
+        _mutex.unlock();
+    }
+
+private:
+    std::recursive_mutex _mutex;
+};
+
+class I2C {
+public:
+    I2C(PinName sda, PinName scl) : _sda(sda), _scl(scl) {}
+    virtual ~I2C() {}
+    void frequency(int hz)
+    {
+        if (HostI2CBus *bus = host_i2c_bus()) {
+            bus->frequency(hz);
+        }
+    }
+    int read(int address, char *data, int length, bool repeated = false)
+    {
+        HostI2CBus *bus = host_i2c_bus();
+        HostMemTraceSuspend emulator;
+        return bus ? bus->read(address, data, length, repeated) : -1;
+    }
+    int write(int address, const char *data, int length, bool repeated = false)
+    {
+        HostI2CBus *bus = host_i2c_bus();
+        HostMemTraceSuspend emulator;
+        return bus ? bus->write(address, data, length, repeated) : -1;
+    }
+    void lock()
+    {
+        _mutex.lock();
+    }
+    void unlock()
+    {
+        _mutex.unlock();
+    }
+
+private:
+    PinName _sda;
+    PinName _scl;
+    std::recursive_mutex _mutex;
+};
+
+} // namespace mbed
+
+typedef enum {
+    osPriorityIdle = 1,
+    osPriorityLow = 8,
+    osPriorityBelowNormal = 16,
+    osPriorityNormal = 24,
+    osPriorityAboveNormal = 32,
+    osPriorityHigh = 40,
+    osPriorityRealtime = 48
+} osPriority;
+
+typedef int32_t osStatus;
+#define osOK 0
+#define osErrorResource -3
+
+#define OS_STACK_SIZE 4096
+#define osWaitForever 0xFFFFFFFFU
+#define osFlagsErrorTimeout 0xFFFFFFFEU
+
+#include <condition_variable>
+
+namespace rtos {
+
+class Mutex {
+public:
+    void lock()
+    {
+        _mutex.lock();
+    }
+    bool trylock()
+    {
+        return _mutex.try_lock();
+    }
+    void unlock()
+    {
+        _mutex.unlock();
+    }
+
+private:
+    std::recursive_mutex _mutex;
+};
+
+class EventFlags {
+public:
+    EventFlags(const char *name = nullptr) : _flags(0) {}
+
+    uint32_t set(uint32_t flags)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _flags |= flags;
+        _cond.notify_all();
+        return _flags;
+    }
+
+    uint32_t clear(uint32_t flags = 0x7fffffff)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint32_t previous = _flags;
+        _flags &= ~flags;
+        return previous;
+    }
+
+    uint32_t get() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _flags;
+    }
+
+    /** Flags set when the wait ended (before clearing), or
+     *  osFlagsErrorTimeout */
+    template <typename Rep, typename Period>
+    uint32_t wait_any_for(uint32_t flags, std::chrono::duration<Rep, Period> rel_time, bool clear = true)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_cond.wait_for(lock, rel_time, [&] { return (_flags & flags) != 0; })) {
+            return osFlagsErrorTimeout;
+        }
+        uint32_t result = _flags;
+        if (clear) {
+            _flags &= ~flags;
+        }
+        return result;
+    }
+
+    uint32_t wait_any(uint32_t flags, uint32_t millisec = osWaitForever, bool clear = true)
+    {
+        return wait_any_for(flags, std::chrono::milliseconds(millisec == osWaitForever ? 24 * 3600 * 1000 : millisec),
+                            clear);
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::condition_variable _cond;
+    uint32_t _flags;
+};
+
+/** Runs on a std::thread. Priority and stack arguments are accepted and
+ *  ignored; a thread still running at exit is detached. */
+class Thread {
+public:
+    Thread(osPriority priority = osPriorityNormal, uint32_t stack_size = OS_STACK_SIZE,
+           unsigned char *stack_mem = nullptr, const char *name = nullptr) : _name(name) {}
+
+    ~Thread()
+    {
+        if (_thread.joinable()) {
+            _thread.detach();
+        }
+    }
+
+    osStatus start(mbed::Callback<void()> task)
+    {
+        if (_thread.joinable()) {
+            return osErrorResource;
+        }
+        _thread = std::thread([task]() {
+            task();
+        });
+        return osOK;
+    }
+
+    osStatus join()
+    {
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        return osOK;
+    }
+
+    const char *get_name() const
+    {
+        return _name;
+    }
+
+private:
+    std::thread _thread;
+    const char *_name;
+};
+
+namespace ThisThread {
+
+inline void sleep_for(uint32_t millisec)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(millisec));
+}
+
+template <typename Rep, typename Period>
+void sleep_for(std::chrono::duration<Rep, Period> rel_time)
+{
+    std::this_thread::sleep_for(rel_time);
+}
+
+inline void yield()
+{
+    std::this_thread::yield();
+}
+
+} // namespace ThisThread
+
+} // namespace rtos
+
+// The RTC: on the host the OS keeps the clock that time() reads, so setting
+// it is left to the OS
+inline void set_time(time_t t)
+{
+    (void)t;
+}
+
+// Network API (netsocket) stand-ins, which mbed.h pulls in as well
+#include "nsapi.h"
+
+using namespace std::chrono_literals;
+using namespace mbed;
+using namespace rtos;
+using namespace std;
+
+#endif // HOST_MBED_H
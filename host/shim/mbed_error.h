@@ -0,0 +1,16 @@
+/* Host stand-in for mbed_error.h */
+#ifndef HOST_MBED_ERROR_H
+#define HOST_MBED_ERROR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Print the message and abort, like mbed's fatal error() */
+void error(const char *format, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MBED_ERROR_H
@@ -0,0 +1,36 @@
+/* Host stand-in for mbed_mem_trace.h. The callback sees allocations only in
+ * tools that link host/emu/heap_trap.cpp, which wraps malloc; elsewhere it
+ * is never called.
+ */
+#ifndef HOST_MBED_MEM_TRACE_H
+#define HOST_MBED_MEM_TRACE_H
+
+#include <stdint.h>
+
+enum {
+    MBED_MEM_TRACE_MALLOC,
+    MBED_MEM_TRACE_REALLOC,
+    MBED_MEM_TRACE_CALLOC,
+    MBED_MEM_TRACE_FREE
+};
+
+/** As on the board: after res and caller come the call's own arguments */
+typedef void (*mbed_mem_trace_cb_t)(uint8_t op, void *res, void *caller, ...);
+
+void mbed_mem_trace_set_callback(mbed_mem_trace_cb_t cb);
+
+// Host only. The emulators behind the bus classes stand in for hardware, so
+// what they allocate is not the firmware's: the bus calls suspend tracing on
+// their thread while an emulator runs, and so does the malloc wrapper while
+// the callback runs.
+class HostMemTraceSuspend {
+public:
+    HostMemTraceSuspend();
+    ~HostMemTraceSuspend();
+};
+
+/** The callback for an allocation on this thread; nullptr if none is set
+ *  or tracing is suspended */
+mbed_mem_trace_cb_t host_mem_trace_callback();
+
+#endif // HOST_MBED_MEM_TRACE_H
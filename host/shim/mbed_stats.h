@@ -0,0 +1,21 @@
+/* Host stand-in for the heap part of mbed_stats.h. The figures are zero
+ * unless the tool links host/emu/heap_trap.cpp, which keeps them.
+ */
+#ifndef HOST_MBED_STATS_H
+#define HOST_MBED_STATS_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t current_size;      // bytes in use
+    uint32_t max_size;          // peak bytes in use
+    uint32_t total_size;        // bytes ever allocated
+    uint32_t reserved_size;
+    uint32_t alloc_cnt;         // blocks in use
+    uint32_t alloc_fail_cnt;
+    uint32_t overhead_size;
+} mbed_stats_heap_t;
+
+void mbed_stats_heap_get(mbed_stats_heap_t *stats);
+
+#endif // HOST_MBED_STATS_H
@@ -0,0 +1,406 @@
+/* MQTT client with the MQTTClientMbedOs interface, following the control
+ * flow of Paho's MQTT::Client so connection-state changes happen at the same
+ * points as on the board.
+ */
+#include "MQTTClientMbedOs.h"
+
+#include <string.h>
+
+// Paho's MQTT topic filter match, '+' and '#' wildcards included
+static bool topic_matched(const char *filter, MQTTString &topic_name)
+{
+    const char *curf = filter;
+    const char *curn = topic_name.lenstring.data;
+    const char *curn_end = curn + topic_name.lenstring.len;
+
+    while (*curf && curn < curn_end) {
+        if (*curn == '/' && *curf != '/') {
+            break;
+        }
+        if (*curf != '+' && *curf != '#' && *curf != *curn) {
+            break;
+        }
+        if (*curf == '+') {
+            // skip until the next separator, or the end
+            const char *nextpos = curn + 1;
+            while (nextpos < curn_end && *nextpos != '/') {
+                nextpos = ++curn + 1;
+            }
+        } else if (*curf == '#') {
+            curn = curn_end - 1; // skip until the end of the string
+        }
+        curf++;
+        curn++;
+    }
+    return curn == curn_end && *curf == '\0';
+}
+
+MQTTClient::MQTTClient(TCPSocket *socket, unsigned int command_timeout_ms)
+    : _socket(socket), _command_timeout_ms(command_timeout_ms), _keep_alive_interval(0),
+      _ping_outstanding(false), _is_connected(false), _clean_session(true), _packet_id(0),
+      _default_handler(nullptr)
+{
+    memset(_handlers, 0, sizeof(_handlers));
+}
+
+unsigned short MQTTClient::next_packet_id()
+{
+    _packet_id = (_packet_id == 65535) ? 1 : _packet_id + 1;
+    return _packet_id;
+}
+
+// MQTTNetworkMbedOs::read: bytes read, 0 on timeout, -1 once the peer has
+// closed the connection
+int MQTTClient::net_read(unsigned char *buffer, int len, Countdown &timer)
+{
+    int got = 0;
+    while (got < len) {
+        _socket->set_timeout(timer.left_ms());
+        nsapi_size_or_error_t rc = _socket->recv(buffer + got, len - got);
+        if (rc == NSAPI_ERROR_WOULD_BLOCK) {
+            break;
+        }
+        if (rc <= 0) {
+            return -1;
+        }
+        got += rc;
+    }
+    return got;
+}
+
+int MQTTClient::send_packet(int length, Countdown &timer)
+{
+    int sent = 0;
+    while (sent < length && !timer.expired()) {
+        _socket->set_timeout(timer.left_ms());
+        nsapi_size_or_error_t rc = _socket->send(&_sendbuf[sent], length - sent);
+        if (rc == NSAPI_ERROR_WOULD_BLOCK) {
+            continue;
+        }
+        if (rc < 0) {
+            break;
+        }
+        sent += rc;
+    }
+    if (sent != length) {
+        return MQTT::FAILURE;
+    }
+    if (_keep_alive_interval > 0) {
+        _last_sent.countdown(_keep_alive_interval);
+    }
+    return MQTT::SUCCESS;
+}
+
+// Packet type of the packet now in _readbuf, 0 if nothing arrived before the
+// timer ran out, negative on error
+int MQTTClient::read_packet(Countdown &timer)
+{
+    int rc = net_read(_readbuf, 1, timer);
+    if (rc != 1) {
+        return rc;
+    }
+
+    // Once a packet has started, give the rest of it the command timeout
+    Countdown rest(_command_timeout_ms);
+    int rem_len = 0;
+    int multiplier = 1;
+    unsigned char c;
+    int len_bytes = 0;
+    do {
+        if (++len_bytes > 4 || net_read(&c, 1, rest) != 1) {
+            return MQTT::FAILURE;
+        }
+        rem_len += (c & 127) * multiplier;
+        multiplier *= 128;
+    } while (c & 128);
+
+    int len = 1 + MQTTPacket_encode(_readbuf + 1, rem_len);
+    if (rem_len > MBED_CONF_MQTT_MAX_PACKET_SIZE - len) {
+        return MQTT::BUFFER_OVERFLOW;
+    }
+    if (rem_len > 0 && net_read(_readbuf + len, rem_len, rest) != rem_len) {
+        return MQTT::FAILURE;
+    }
+    if (_keep_alive_interval > 0) {
+        _last_received.countdown(_keep_alive_interval);
+    }
+    MQTTHeader header;
+    header.byte = _readbuf[0];
+    return header.bits.type;
+}
+
+void MQTTClient::deliver_message(MQTTString &topicName, MQTT::Message &message)
+{
+    for (int i = 0; i < MBED_CONF_MQTT_MAX_CONNECTIONS; i++) {
+        if (_handlers[i].topicFilter &&
+                (MQTTPacket_equals(&topicName, (char *)_handlers[i].topicFilter) ||
+                 topic_matched(_handlers[i].topicFilter, topicName))) {
+            if (_handlers[i].fp) {
+                MQTT::MessageData md(topicName, message);
+                _handlers[i].fp(md);
+                return;
+            }
+        }
+    }
+    if (_default_handler) {
+        MQTT::MessageData md(topicName, message);
+        _default_handler(md);
+    }
+}
+
+int MQTTClient::keepalive()
+{
+    if (_keep_alive_interval == 0) {
+        return MQTT::SUCCESS;
+    }
+    if (_last_sent.expired() || _last_received.expired()) {
+        if (_ping_outstanding) {
+            return MQTT::FAILURE; // no PINGRESP within the keep-alive interval
+        }
+        Countdown timer(1000);
+        int len = MQTTSerialize_pingreq(_sendbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE);
+        if (len > 0 && send_packet(len, timer) == MQTT::SUCCESS) {
+            _ping_outstanding = true;
+        }
+    }
+    return MQTT::SUCCESS;
+}
+
+int MQTTClient::cycle(Countdown &timer)
+{
+    int packet_type = read_packet(timer);
+    int rc = MQTT::SUCCESS;
+
+    switch (packet_type) {
+        case 0:
+        case CONNACK:
+        case PUBACK:
+        case SUBACK:
+        case UNSUBACK:
+            break;
+        case PUBLISH: {
+            MQTTString topicName = MQTTString_initializer;
+            MQTT::Message msg;
+            int intQoS;
+            unsigned char dup, retained;
+            msg.payloadlen = 0;
+            int payloadlen = 0;
+            if (MQTTDeserialize_publish(&dup, &intQoS, &retained, &msg.id, &topicName,
+                                        (unsigned char **)&msg.payload, &payloadlen,
+                                        _readbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE) != 1) {
+                rc = MQTT::FAILURE;
+                break;
+            }
+            msg.qos = (enum MQTT::QoS)intQoS;
+            msg.dup = dup;
+            msg.retained = retained;
+            msg.payloadlen = payloadlen;
+            deliver_message(topicName, msg);
+            if (msg.qos != MQTT::QOS0) {
+                Countdown ack_timer(_command_timeout_ms);
+                int len = MQTTSerialize_ack(_sendbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE,
+                                            msg.qos == MQTT::QOS1 ? PUBACK : PUBREC, 0, msg.id);
+                rc = len <= 0 ? MQTT::FAILURE : send_packet(len, ack_timer);
+            }
+            break;
+        }
+        case PINGRESP:
+            _ping_outstanding = false;
+            break;
+        default:
+            // error, or a packet type this client does not handle
+            rc = packet_type;
+            break;
+    }
+
+    if (rc == MQTT::SUCCESS && keepalive() != MQTT::SUCCESS) {
+        rc = MQTT::FAILURE;
+    }
+    if (rc == MQTT::SUCCESS) {
+        return packet_type;
+    }
+    if (_is_connected) {
+        close_session();
+    }
+    return rc < 0 ? rc : MQTT::FAILURE;
+}
+
+int MQTTClient::waitfor(int packet_type, Countdown &timer)
+{
+    int rc;
+    do {
+        if (timer.expired()) {
+            return MQTT::FAILURE;
+        }
+        rc = cycle(timer);
+    } while (rc != packet_type && rc >= 0);
+    return rc;
+}
+
+void MQTTClient::close_session()
+{
+    _ping_outstanding = false;
+    _is_connected = false;
+    if (_clean_session) {
+        memset(_handlers, 0, sizeof(_handlers));
+    }
+}
+
+nsapi_error_t MQTTClient::connect(MQTTPacket_connectData &options)
+{
+    if (_is_connected) {
+        return MQTT::FAILURE;
+    }
+    Countdown connect_timer(_command_timeout_ms);
+    _keep_alive_interval = options.keepAliveInterval;
+    _clean_session = options.cleansession;
+
+    int len = MQTTSerialize_connect(_sendbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE, &options);
+    if (len <= 0) {
+        return MQTT::FAILURE;
+    }
+    int rc = send_packet(len, connect_timer);
+    if (rc != MQTT::SUCCESS) {
+        return rc;
+    }
+    if (_keep_alive_interval > 0) {
+        _last_received.countdown(_keep_alive_interval);
+    }
+
+    rc = MQTT::FAILURE;
+    if (waitfor(CONNACK, connect_timer) == CONNACK) {
+        unsigned char connack_rc = 255;
+        unsigned char session_present = 0;
+        if (MQTTDeserialize_connack(&session_present, &connack_rc, _readbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE) == 1) {
+            rc = connack_rc;
+        }
+    }
+    if (rc == MQTT::SUCCESS) {
+        _is_connected = true;
+        _ping_outstanding = false;
+    }
+    return rc;
+}
+
+nsapi_error_t MQTTClient::publish(const char *topicName, MQTT::Message &message)
+{
+    if (!_is_connected) {
+        return MQTT::FAILURE;
+    }
+    Countdown timer(_command_timeout_ms);
+    MQTTString topic = MQTTString_initializer;
+    topic.cstring = (char *)topicName;
+
+    if (message.qos == MQTT::QOS1 || message.qos == MQTT::QOS2) {
+        message.id = next_packet_id();
+    }
+    int len = MQTTSerialize_publish(_sendbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE, 0, message.qos, message.retained,
+                                    message.id, topic, (unsigned char *)message.payload, (int)message.payloadlen);
+    if (len <= 0) {
+        return MQTT::FAILURE;
+    }
+    int rc = send_packet(len, timer);
+    if (rc == MQTT::SUCCESS && message.qos == MQTT::QOS1) {
+        rc = MQTT::FAILURE;
+        if (waitfor(PUBACK, timer) == PUBACK) {
+            unsigned short packet_id;
+            unsigned char dup, type;
+            if (MQTTDeserialize_ack(&type, &dup, &packet_id, _readbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE) == 1) {
+                rc = MQTT::SUCCESS;
+            }
+        }
+    } else if (rc == MQTT::SUCCESS && message.qos == MQTT::QOS2) {
+        rc = MQTT::FAILURE; // not supported by this stand-in
+    }
+    if (rc != MQTT::SUCCESS && _is_connected) {
+        close_session();
+    }
+    return rc;
+}
+
+nsapi_error_t MQTTClient::subscribe(const char *topicFilter, enum MQTT::QoS qos, messageHandler mh)
+{
+    if (!_is_connected) {
+        return MQTT::FAILURE;
+    }
+    Countdown timer(_command_timeout_ms);
+    MQTTString topic = MQTTString_initializer;
+    topic.cstring = (char *)topicFilter;
+    int requested = qos;
+
+    int len = MQTTSerialize_subscribe(_sendbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE, 0, next_packet_id(), 1,
+                                      &topic, &requested);
+    if (len <= 0 || send_packet(len, timer) != MQTT::SUCCESS) {
+        return MQTT::FAILURE;
+    }
+    if (waitfor(SUBACK, timer) != SUBACK) {
+        return MQTT::FAILURE;
+    }
+    int count = 0;
+    int granted = -1;
+    unsigned short packet_id;
+    if (MQTTDeserialize_suback(&packet_id, 1, &count, &granted, _readbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE) != 1 ||
+            granted == 0x80) {
+        return MQTT::FAILURE;
+    }
+    for (int i = 0; i < MBED_CONF_MQTT_MAX_CONNECTIONS; i++) {
+        if (!_handlers[i].topicFilter || strcmp(_handlers[i].topicFilter, topicFilter) == 0) {
+            _handlers[i].topicFilter = topicFilter;
+            _handlers[i].fp = mh;
+            return MQTT::SUCCESS;
+        }
+    }
+    return MQTT::FAILURE;
+}
+
+nsapi_error_t MQTTClient::unsubscribe(const char *topicFilter)
+{
+    if (!_is_connected) {
+        return MQTT::FAILURE;
+    }
+    Countdown timer(_command_timeout_ms);
+    MQTTString topic = MQTTString_initializer;
+    topic.cstring = (char *)topicFilter;
+
+    int len = MQTTSerialize_unsubscribe(_sendbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE, 0, next_packet_id(), 1, &topic);
+    if (len <= 0 || send_packet(len, timer) != MQTT::SUCCESS || waitfor(UNSUBACK, timer) != UNSUBACK) {
+        return MQTT::FAILURE;
+    }
+    for (int i = 0; i < MBED_CONF_MQTT_MAX_CONNECTIONS; i++) {
+        if (_handlers[i].topicFilter && strcmp(_handlers[i].topicFilter, topicFilter) == 0) {
+            _handlers[i].topicFilter = nullptr;
+            _handlers[i].fp = nullptr;
+        }
+    }
+    return MQTT::SUCCESS;
+}
+
+nsapi_error_t MQTTClient::yield(unsigned long timeout_ms)
+{
+    Countdown timer(timeout_ms);
+    do {
+        if (cycle(timer) < 0) {
+            return MQTT::FAILURE;
+        }
+    } while (!timer.expired());
+    return MQTT::SUCCESS;
+}
+
+nsapi_error_t MQTTClient::disconnect()
+{
+    Countdown timer(_command_timeout_ms);
+    int len = MQTTSerialize_disconnect(_sendbuf, MBED_CONF_MQTT_MAX_PACKET_SIZE);
+    int rc = len > 0 ? send_packet(len, timer) : MQTT::FAILURE;
+    close_session();
+    return rc;
+}
+
+bool MQTTClient::isConnected()
+{
+    return _is_connected;
+}
+
+void MQTTClient::setDefaultMessageHandler(messageHandler mh)
+{
+    _default_handler = mh;
+}
@@ -0,0 +1,433 @@
+/* MQTT 3.1/3.1.1 packet codec with the Paho MQTTPacket interface */
+#include "MQTTPacket.h"
+
+#include <string.h>
+
+static void write_char(unsigned char **p, unsigned char c)
+{
+    **p = c;
+    (*p)++;
+}
+
+static void write_int(unsigned char **p, int value)
+{
+    write_char(p, (unsigned char)((value >> 8) & 0xFF));
+    write_char(p, (unsigned char)(value & 0xFF));
+}
+
+static void write_string(unsigned char **p, MQTTString s)
+{
+    const char *data = s.cstring ? s.cstring : s.lenstring.data;
+    int len = MQTTstrlen(s);
+    write_int(p, len);
+    if (len > 0) {
+        memcpy(*p, data, len);
+        *p += len;
+    }
+}
+
+static int read_int(unsigned char **p)
+{
+    int value = ((*p)[0] << 8) | (*p)[1];
+    *p += 2;
+    return value;
+}
+
+// Points @p s into the buffer; false if the string runs past @p end
+static bool read_string(MQTTString *s, unsigned char **p, unsigned char *end)
+{
+    if (end - *p < 2) {
+        return false;
+    }
+    int len = read_int(p);
+    if (end - *p < len) {
+        return false;
+    }
+    s->cstring = NULL;
+    s->lenstring.len = len;
+    s->lenstring.data = (char *)*p;
+    *p += len;
+    return true;
+}
+
+// Parses the fixed header; returns the byte after it, or NULL
+static unsigned char *read_header(MQTTHeader *header, int *rem_len, unsigned char *buf, int buflen)
+{
+    if (buflen < 2) {
+        return NULL;
+    }
+    header->byte = buf[0];
+    int used = MQTTPacket_decodeBuf(buf + 1, rem_len);
+    if (used <= 0 || 1 + used + *rem_len > buflen) {
+        return NULL;
+    }
+    return buf + 1 + used;
+}
+
+int MQTTstrlen(MQTTString mqttstring)
+{
+    return mqttstring.cstring ? (int)strlen(mqttstring.cstring) : mqttstring.lenstring.len;
+}
+
+int MQTTPacket_equals(MQTTString *a, char *b)
+{
+    const char *data = a->cstring ? a->cstring : a->lenstring.data;
+    int len = MQTTstrlen(*a);
+    return (int)strlen(b) == len && memcmp(data, b, len) == 0;
+}
+
+int MQTTPacket_encode(unsigned char *buf, int length)
+{
+    int rc = 0;
+    do {
+        unsigned char d = length % 128;
+        length /= 128;
+        if (length > 0) {
+            d |= 0x80;
+        }
+        buf[rc++] = d;
+    } while (length > 0);
+    return rc;
+}
+
+int MQTTPacket_decodeBuf(unsigned char *buf, int *value)
+{
+    int multiplier = 1;
+    int len = 0;
+    unsigned char c;
+    *value = 0;
+    do {
+        if (len == 4) {
+            return MQTTPACKET_READ_ERROR;
+        }
+        c = buf[len++];
+        *value += (c & 127) * multiplier;
+        multiplier *= 128;
+    } while (c & 128);
+    return len;
+}
+
+int MQTTPacket_len(int rem_len)
+{
+    rem_len += 1;
+    if (rem_len < 128) {
+        rem_len += 1;
+    } else if (rem_len < 16384) {
+        rem_len += 2;
+    } else if (rem_len < 2097151) {
+        rem_len += 3;
+    } else {
+        rem_len += 4;
+    }
+    return rem_len;
+}
+
+static unsigned char *start_packet(unsigned char *buf, int buflen, unsigned char first, int rem_len)
+{
+    if (MQTTPacket_len(rem_len) > buflen) {
+        return NULL;
+    }
+    unsigned char *p = buf;
+    write_char(&p, first);
+    p += MQTTPacket_encode(p, rem_len);
+    return p;
+}
+
+int MQTTSerialize_connect(unsigned char *buf, int buflen, MQTTPacket_connectData *options)
+{
+    int len = options->MQTTVersion == 4 ? 10 : 12;
+    len += MQTTstrlen(options->clientID) + 2;
+    if (options->willFlag) {
+        len += MQTTstrlen(options->will.topicName) + 2 + MQTTstrlen(options->will.message) + 2;
+    }
+    bool username = options->username.cstring || options->username.lenstring.data;
+    bool password = options->password.cstring || options->password.lenstring.data;
+    if (username) {
+        len += MQTTstrlen(options->username) + 2;
+    }
+    if (password) {
+        len += MQTTstrlen(options->password) + 2;
+    }
+
+    unsigned char *p = start_packet(buf, buflen, CONNECT << 4, len);
+    if (!p) {
+        return MQTTPACKET_BUFFER_TOO_SHORT;
+    }
+    MQTTString protocol = MQTTString_initializer;
+    protocol.cstring = (char *)(options->MQTTVersion == 4 ? "MQTT" : "MQIsdp");
+    write_string(&p, protocol);
+    write_char(&p, options->MQTTVersion == 4 ? 4 : 3);
+
+    unsigned char flags = 0;
+    flags |= options->cleansession ? 0x02 : 0;
+    if (options->willFlag) {
+        flags |= 0x04 | ((options->will.qos & 0x03) << 3) | (options->will.retained ? 0x20 : 0);
+    }
+    flags |= password ? 0x40 : 0;
+    flags |= username ? 0x80 : 0;
+    write_char(&p, flags);
+    write_int(&p, options->keepAliveInterval);
+    write_string(&p, options->clientID);
+    if (options->willFlag) {
+        write_string(&p, options->will.topicName);
+        write_string(&p, options->will.message);
+    }
+    if (username) {
+        write_string(&p, options->username);
+    }
+    if (password) {
+        write_string(&p, options->password);
+    }
+    return (int)(p - buf);
+}
+
+int MQTTDeserialize_connect(MQTTPacket_connectData *data, unsigned char *buf, int len)
+{
+    MQTTHeader header;
+    int rem_len;
+    unsigned char *p = read_header(&header, &rem_len, buf, len);
+    if (!p || header.bits.type != CONNECT) {
+        return 0;
+    }
+    unsigned char *end = p + rem_len;
+    MQTTString protocol;
+    if (!read_string(&protocol, &p, end) || end - p < 4) {
+        return 0;
+    }
+    data->MQTTVersion = *p++;
+    unsigned char flags = *p++;
+    data->keepAliveInterval = (unsigned short)read_int(&p);
+    data->cleansession = (flags & 0x02) ? 1 : 0;
+    data->willFlag = (flags & 0x04) ? 1 : 0;
+    if (!read_string(&data->clientID, &p, end)) {
+        return 0;
+    }
+    if (data->willFlag) {
+        data->will.qos = (flags >> 3) & 0x03;
+        data->will.retained = (flags & 0x20) ? 1 : 0;
+        if (!read_string(&data->will.topicName, &p, end) || !read_string(&data->will.message, &p, end)) {
+            return 0;
+        }
+    }
+    if ((flags & 0x80) && !read_string(&data->username, &p, end)) {
+        return 0;
+    }
+    if ((flags & 0x40) && !read_string(&data->password, &p, end)) {
+        return 0;
+    }
+    return 1;
+}
+
+int MQTTSerialize_connack(unsigned char *buf, int buflen, unsigned char connack_rc, unsigned char sessionPresent)
+{
+    unsigned char *p = start_packet(buf, buflen, CONNACK << 4, 2);
+    if (!p) {
+        return MQTTPACKET_BUFFER_TOO_SHORT;
+    }
+    write_char(&p, sessionPresent ? 1 : 0);
+    write_char(&p, connack_rc);
+    return (int)(p - buf);
+}
+
+int MQTTDeserialize_connack(unsigned char *sessionPresent, unsigned char *connack_rc, unsigned char *buf, int buflen)
+{
+    MQTTHeader header;
+    int rem_len;
+    unsigned char *p = read_header(&header, &rem_len, buf, buflen);
+    if (!p || header.bits.type != CONNACK || rem_len < 2) {
+        return 0;
+    }
+    *sessionPresent = p[0] & 0x01;
+    *connack_rc = p[1];
+    return 1;
+}
+
+static int serialize_zero(unsigned char *buf, int buflen, unsigned char type)
+{
+    unsigned char *p = start_packet(buf, buflen, type << 4, 0);
+    return p ? (int)(p - buf) : MQTTPACKET_BUFFER_TOO_SHORT;
+}
+
+int MQTTSerialize_disconnect(unsigned char *buf, int buflen)
+{
+    return serialize_zero(buf, buflen, DISCONNECT);
+}
+
+int MQTTSerialize_pingreq(unsigned char *buf, int buflen)
+{
+    return serialize_zero(buf, buflen, PINGREQ);
+}
+
+int MQTTSerialize_publish(unsigned char *buf, int buflen, unsigned char dup, int qos, unsigned char retained,
+                          unsigned short packetid, MQTTString topicName, unsigned char *payload, int payloadlen)
+{
+    int rem_len = 2 + MQTTstrlen(topicName) + payloadlen + (qos > 0 ? 2 : 0);
+    unsigned char first = (PUBLISH << 4) | (dup ? 0x08 : 0) | ((qos & 0x03) << 1) | (retained ? 0x01 : 0);
+    unsigned char *p = start_packet(buf, buflen, first, rem_len);
+    if (!p) {
+        return MQTTPACKET_BUFFER_TOO_SHORT;
+    }
+    write_string(&p, topicName);
+    if (qos > 0) {
+        write_int(&p, packetid);
+    }
+    if (payloadlen > 0) {
+        memcpy(p, payload, payloadlen);
+        p += payloadlen;
+    }
+    return (int)(p - buf);
+}
+
+int MQTTDeserialize_publish(unsigned char *dup, int *qos, unsigned char *retained, unsigned short *packetid,
+                            MQTTString *topicName, unsigned char **payload, int *payloadlen,
+                            unsigned char *buf, int len)
+{
+    MQTTHeader header;
+    int rem_len;
+    unsigned char *p = read_header(&header, &rem_len, buf, len);
+    if (!p || header.bits.type != PUBLISH) {
+        return 0;
+    }
+    unsigned char *end = p + rem_len;
+    *dup = header.bits.dup;
+    *qos = header.bits.qos;
+    *retained = header.bits.retain;
+    if (!read_string(topicName, &p, end)) {
+        return 0;
+    }
+    *packetid = 0;
+    if (*qos > 0) {
+        if (end - p < 2) {
+            return 0;
+        }
+        *packetid = (unsigned short)read_int(&p);
+    }
+    *payloadlen = (int)(end - p);
+    *payload = p;
+    return 1;
+}
+
+int MQTTSerialize_ack(unsigned char *buf, int buflen, unsigned char type, unsigned char dup, unsigned short packetid)
+{
+    unsigned char first = (type << 4) | (dup ? 0x08 : 0) | (type == PUBREL ? 0x02 : 0);
+    unsigned char *p = start_packet(buf, buflen, first, 2);
+    if (!p) {
+        return MQTTPACKET_BUFFER_TOO_SHORT;
+    }
+    write_int(&p, packetid);
+    return (int)(p - buf);
+}
+
+int MQTTSerialize_puback(unsigned char *buf, int buflen, unsigned short packetid)
+{
+    return MQTTSerialize_ack(buf, buflen, PUBACK, 0, packetid);
+}
+
+int MQTTDeserialize_ack(unsigned char *packettype, unsigned char *dup, unsigned short *packetid,
+                        unsigned char *buf, int buflen)
+{
+    MQTTHeader header;
+    int rem_len;
+    unsigned char *p = read_header(&header, &rem_len, buf, buflen);
+    if (!p || rem_len < 2) {
+        return 0;
+    }
+    *packettype = header.bits.type;
+    *dup = header.bits.dup;
+    *packetid = (unsigned short)read_int(&p);
+    return 1;
+}
+
+int MQTTSerialize_subscribe(unsigned char *buf, int buflen, unsigned char dup, unsigned short packetid,
+                            int count, MQTTString topicFilters[], int requestedQoSs[])
+{
+    int rem_len = 2;
+    for (int i = 0; i < count; i++) {
+        rem_len += 2 + MQTTstrlen(topicFilters[i]) + 1;
+    }
+    unsigned char *p = start_packet(buf, buflen, (SUBSCRIBE << 4) | (dup ? 0x08 : 0) | 0x02, rem_len);
+    if (!p) {
+        return MQTTPACKET_BUFFER_TOO_SHORT;
+    }
+    write_int(&p, packetid);
+    for (int i = 0; i < count; i++) {
+        write_string(&p, topicFilters[i]);
+        write_char(&p, (unsigned char)requestedQoSs[i]);
+    }
+    return (int)(p - buf);
+}
+
+int MQTTDeserialize_subscribe(unsigned char *dup, unsigned short *packetid, int maxcount, int *count,
+                              MQTTString topicFilters[], int requestedQoSs[], unsigned char *buf, int len)
+{
+    MQTTHeader header;
+    int rem_len;
+    unsigned char *p = read_header(&header, &rem_len, buf, len);
+    if (!p || header.bits.type != SUBSCRIBE || rem_len < 2) {
+        return 0;
+    }
+    unsigned char *end = p + rem_len;
+    *dup = header.bits.dup;
+    *packetid = (unsigned short)read_int(&p);
+    *count = 0;
+    while (p < end) {
+        if (*count == maxcount || !read_string(&topicFilters[*count], &p, end) || p >= end) {
+            return 0;
+        }
+        requestedQoSs[*count] = *p++;
+        (*count)++;
+    }
+    return 1;
+}
+
+int MQTTSerialize_suback(unsigned char *buf, int buflen, unsigned short packetid, int count, int *grantedQoSs)
+{
+    unsigned char *p = start_packet(buf, buflen, SUBACK << 4, 2 + count);
+    if (!p) {
+        return MQTTPACKET_BUFFER_TOO_SHORT;
+    }
+    write_int(&p, packetid);
+    for (int i = 0; i < count; i++) {
+        write_char(&p, (unsigned char)grantedQoSs[i]);
+    }
+    return (int)(p - buf);
+}
+
+int MQTTDeserialize_suback(unsigned short *packetid, int maxcount, int *count, int grantedQoSs[],
+                           unsigned char *buf, int len)
+{
+    MQTTHeader header;
+    int rem_len;
+    unsigned char *p = read_header(&header, &rem_len, buf, len);
+    if (!p || header.bits.type != SUBACK || rem_len < 2) {
+        return 0;
+    }
+    unsigned char *end = p + rem_len;
+    *packetid = (unsigned short)read_int(&p);
+    *count = 0;
+    while (p < end) {
+        if (*count == maxcount) {
+            return 0;
+        }
+        grantedQoSs[(*count)++] = *p++;
+    }
+    return 1;
+}
+
+int MQTTSerialize_unsubscribe(unsigned char *buf, int buflen, unsigned char dup, unsigned short packetid,
+                              int count, MQTTString topicFilters[])
+{
+    int rem_len = 2;
+    for (int i = 0; i < count; i++) {
+        rem_len += 2 + MQTTstrlen(topicFilters[i]);
+    }
+    unsigned char *p = start_packet(buf, buflen, (UNSUBSCRIBE << 4) | (dup ? 0x08 : 0) | 0x02, rem_len);
+    if (!p) {
+        return MQTTPACKET_BUFFER_TOO_SHORT;
+    }
+    write_int(&p, packetid);
+    for (int i = 0; i < count; i++) {
+        write_string(&p, topicFilters[i]);
+    }
+    return (int)(p - buf);
+}
@@ -0,0 +1,312 @@
+/* Host implementations of the netsocket stand-ins */
+#include "nsapi.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <chrono>
+
+SocketAddress::SocketAddress(const char *addr, uint16_t port) : _version(NSAPI_UNSPEC), _port(port)
+{
+    _ip[0] = '\0';
+    if (addr) {
+        set_ip_address(addr);
+    }
+}
+
+bool SocketAddress::set_ip_address(const char *addr)
+{
+    unsigned char buf[sizeof(struct in6_addr)];
+    _ip[0] = '\0';
+    _version = NSAPI_UNSPEC;
+    if (!addr) {
+        return false;
+    }
+    if (inet_pton(AF_INET, addr, buf) == 1) {
+        _version = NSAPI_IPv4;
+        inet_ntop(AF_INET, buf, _ip, sizeof(_ip));
+    } else if (inet_pton(AF_INET6, addr, buf) == 1) {
+        _version = NSAPI_IPv6;
+        inet_ntop(AF_INET6, buf, _ip, sizeof(_ip));
+    }
+    return _version != NSAPI_UNSPEC;
+}
+
+const char *SocketAddress::get_ip_address() const
+{
+    return _version == NSAPI_UNSPEC ? nullptr : _ip;
+}
+
+bool operator==(const SocketAddress &a, const SocketAddress &b)
+{
+    if (a._version != b._version || a._port != b._port) {
+        return false;
+    }
+    return a._version == NSAPI_UNSPEC || strcmp(a._ip, b._ip) == 0;
+}
+
+bool operator!=(const SocketAddress &a, const SocketAddress &b)
+{
+    return !(a == b);
+}
+
+nsapi_error_t NetworkStack::gethostbyname(const char *host, SocketAddress *address,
+                                          nsapi_version_t version, const char *interface_name)
+{
+    if (!host || !address) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    uint16_t port = address->get_port();
+    if (address->set_ip_address(host)) {
+        address->set_port(port);
+        return NSAPI_ERROR_OK;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = version == NSAPI_IPv6 ? AF_INET6 : (version == NSAPI_IPv4 ? AF_INET : AF_UNSPEC);
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+        return NSAPI_ERROR_DNS_FAILURE;
+    }
+    char ip[NSAPI_IP_SIZE];
+    const void *raw = result->ai_family == AF_INET
+                      ? (const void *) & ((struct sockaddr_in *)result->ai_addr)->sin_addr
+                      : (const void *) & ((struct sockaddr_in6 *)result->ai_addr)->sin6_addr;
+    bool ok = inet_ntop(result->ai_family, raw, ip, sizeof(ip)) && address->set_ip_address(ip);
+    freeaddrinfo(result);
+    address->set_port(port);
+    return ok ? NSAPI_ERROR_OK : NSAPI_ERROR_DNS_FAILURE;
+}
+
+TCPSocket::TCPSocket() : _stack(nullptr), _socket(nullptr), _timeout(-1), _event_pending(false) {}
+
+TCPSocket::~TCPSocket()
+{
+    close();
+}
+
+nsapi_error_t TCPSocket::open(NetworkStack *stack)
+{
+    if (!stack) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    if (_socket) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    nsapi_socket_t socket;
+    nsapi_error_t err = stack->socket_open(&socket, NSAPI_TCP);
+    if (err) {
+        return err;
+    }
+    _stack = stack;
+    _socket = socket;
+    _stack->socket_attach(_socket, &TCPSocket::event_thunk, this);
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t TCPSocket::close()
+{
+    if (!_socket) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    _stack->socket_attach(_socket, nullptr, nullptr);
+    nsapi_error_t err = _stack->socket_close(_socket);
+    _socket = nullptr;
+    _stack = nullptr;
+    event();
+    return err;
+}
+
+nsapi_error_t TCPSocket::connect(const SocketAddress &address)
+{
+    if (!_socket) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    nsapi_error_t err;
+    do {
+        err = _stack->socket_connect(_socket, address);
+    } while ((err == NSAPI_ERROR_IN_PROGRESS || err == NSAPI_ERROR_ALREADY) && wait_event());
+    return err == NSAPI_ERROR_IS_CONNECTED ? NSAPI_ERROR_OK : err;
+}
+
+nsapi_size_or_error_t TCPSocket::send(const void *data, nsapi_size_t size)
+{
+    const char *ptr = (const char *)data;
+    nsapi_size_t written = 0;
+    nsapi_size_or_error_t ret = NSAPI_ERROR_OK;
+    while (written < size || size == 0) {
+        if (!_socket) {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        ret = _stack->socket_send(_socket, ptr + written, size - written);
+        if (ret >= 0) {
+            written += ret;
+            if (size == 0) {
+                break;
+            }
+        } else if (ret != NSAPI_ERROR_WOULD_BLOCK || !wait_event()) {
+            break;
+        }
+    }
+    return written > 0 ? (nsapi_size_or_error_t)written : ret;
+}
+
+nsapi_size_or_error_t TCPSocket::recv(void *data, nsapi_size_t size)
+{
+    for (;;) {
+        if (!_socket) {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        nsapi_size_or_error_t ret = _stack->socket_recv(_socket, data, size);
+        if (ret != NSAPI_ERROR_WOULD_BLOCK || !wait_event()) {
+            return ret;
+        }
+    }
+}
+
+void TCPSocket::set_timeout(int timeout)
+{
+    _timeout = timeout < 0 ? -1 : timeout;
+}
+
+void TCPSocket::sigio(mbed::Callback<void()> func)
+{
+    std::lock_guard<std::mutex> lock(_event_mutex);
+    _callback = func;
+}
+
+void TCPSocket::event_thunk(void *data)
+{
+    static_cast<TCPSocket *>(data)->event();
+}
+
+void TCPSocket::event()
+{
+    mbed::Callback<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(_event_mutex);
+        _event_pending = true;
+        callback = _callback;
+    }
+    _event_cv.notify_all();
+    if (callback) {
+        callback();
+    }
+}
+
+// Waits for the next socket event; false once the timeout has passed
+bool TCPSocket::wait_event()
+{
+    if (_timeout == 0) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(_event_mutex);
+    if (_timeout < 0) {
+        _event_cv.wait(lock, [this] { return _event_pending; });
+    } else if (!_event_cv.wait_for(lock, std::chrono::milliseconds(_timeout), [this] { return _event_pending; })) {
+        return false;
+    }
+    _event_pending = false;
+    return true;
+}
+
+UDPSocket::UDPSocket() : _stack(nullptr), _socket(nullptr), _timeout(-1), _event_pending(false) {}
+
+UDPSocket::~UDPSocket()
+{
+    close();
+}
+
+nsapi_error_t UDPSocket::open(NetworkStack *stack)
+{
+    if (!stack || _socket) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    nsapi_socket_t socket;
+    nsapi_error_t err = stack->socket_open(&socket, NSAPI_UDP);
+    if (err) {
+        return err;
+    }
+    _stack = stack;
+    _socket = socket;
+    _stack->socket_attach(_socket, &UDPSocket::event_thunk, this);
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t UDPSocket::close()
+{
+    if (!_socket) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    _stack->socket_attach(_socket, nullptr, nullptr);
+    nsapi_error_t err = _stack->socket_close(_socket);
+    _socket = nullptr;
+    _stack = nullptr;
+    event();
+    return err;
+}
+
+nsapi_size_or_error_t UDPSocket::sendto(const SocketAddress &address, const void *data, nsapi_size_t size)
+{
+    for (;;) {
+        if (!_socket) {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        nsapi_size_or_error_t ret = _stack->socket_sendto(_socket, address, data, size);
+        if (ret != NSAPI_ERROR_WOULD_BLOCK || !wait_event()) {
+            return ret;
+        }
+    }
+}
+
+nsapi_size_or_error_t UDPSocket::recvfrom(SocketAddress *address, void *data, nsapi_size_t size)
+{
+    for (;;) {
+        if (!_socket) {
+            return NSAPI_ERROR_NO_SOCKET;
+        }
+        nsapi_size_or_error_t ret = _stack->socket_recvfrom(_socket, address, data, size);
+        if (ret != NSAPI_ERROR_WOULD_BLOCK || !wait_event()) {
+            return ret;
+        }
+    }
+}
+
+void UDPSocket::set_timeout(int timeout)
+{
+    _timeout = timeout < 0 ? -1 : timeout;
+}
+
+void UDPSocket::event_thunk(void *data)
+{
+    static_cast<UDPSocket *>(data)->event();
+}
+
+void UDPSocket::event()
+{
+    {
+        std::lock_guard<std::mutex> lock(_event_mutex);
+        _event_pending = true;
+    }
+    _event_cv.notify_all();
+}
+
+// Waits for the next socket event; false once the timeout has passed
+bool UDPSocket::wait_event()
+{
+    if (_timeout == 0) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(_event_mutex);
+    if (_timeout < 0) {
+        _event_cv.wait(lock, [this] { return _event_pending; });
+    } else if (!_event_cv.wait_for(lock, std::chrono::milliseconds(_timeout), [this] { return _event_pending; })) {
+        return false;
+    }
+    _event_pending = false;
+    return true;
+}
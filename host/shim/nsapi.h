@@ -0,0 +1,14 @@
+/* Host stand-in for the netsocket umbrella header */
+#ifndef HOST_NSAPI_H
+#define HOST_NSAPI_H
+
+#include "nsapi_types.h"
+#include "SocketAddress.h"
+#include "NetworkStack.h"
+#include "NetworkInterface.h"
+#include "WiFiAccessPoint.h"
+#include "WiFiInterface.h"
+#include "TCPSocket.h"
+#include "UDPSocket.h"
+
+#endif // HOST_NSAPI_H
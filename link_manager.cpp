@@ -0,0 +1,222 @@
+#include "link_manager.h"
+#include "config.h"
+#include "network_manager.h"
+
+static WiFiInterface* wifi = nullptr;
+static mbed::Callback<void()> wake;
+static Timer since_check;
+static volatile uint8_t check_requested = false;
+static volatile uint8_t link_state = LINK_DOWN;
+static volatile uint8_t reported_status = NSAPI_STATUS_DISCONNECTED;
+static volatile uint8_t fast_rejoin = LINK_FAST_REJOIN;
+static bool remember_pending = false;
+static Mutex stats_mutex;
+static LinkStats stats;
+
+// Scan results, static so a scan does not allocate
+static WiFiAccessPoint scan_results[LINK_SCAN_MAX_APS];
+
+// --- Helper Functions ---
+// Called by the driver, possibly from another thread and with its lock held:
+// only note the status and wake the network thread
+static void status_changed(nsapi_event_t event, intptr_t status) {
+    if (event == NSAPI_EVENT_CONNECTION_STATUS_CHANGE) {
+        core_util_atomic_store_u8(&reported_status, (uint8_t)status);
+        if (wake) {
+            wake();
+        }
+    }
+}
+
+static void set_state(LinkState state) {
+    core_util_atomic_store_u8(&link_state, state);
+}
+
+// Strongest AP with our SSID in a scan, or nullptr
+static const WiFiAccessPoint* find_access_point() {
+    int count = wifi->scan(scan_results, LINK_SCAN_MAX_APS);
+    const WiFiAccessPoint* best = nullptr;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(scan_results[i].get_ssid(), WIFI_SSID) == 0 &&
+                (!best || scan_results[i].get_rssi() > best->get_rssi())) {
+            best = &scan_results[i];
+        }
+    }
+    return best;
+}
+
+// Is the last good AP (or, before the first join, any AP with our SSID) there?
+static bool access_point_visible() {
+    const WiFiAccessPoint* ap = find_access_point();
+    if (!ap) {
+        return false;
+    }
+    stats_mutex.lock();
+    bool match = !stats.bssid_known || memcmp(ap->get_bssid(), stats.bssid, sizeof(stats.bssid)) == 0;
+    stats_mutex.unlock();
+    return match;
+}
+
+// Keeps the BSSID and channel of the AP just joined for the next rejoin
+static void remember_access_point() {
+    const WiFiAccessPoint* ap = find_access_point();
+    if (!ap) {
+        return;
+    }
+    stats_mutex.lock();
+    memcpy(stats.bssid, ap->get_bssid(), sizeof(stats.bssid));
+    stats.bssid_known = true;
+    stats.channel = ap->get_channel();
+    stats_mutex.unlock();
+
+    // Interfaces that cannot pin the channel (the ISM43362 scans on every
+    // join) rely on the scans between retries instead
+    if (wifi->set_channel(ap->get_channel()) == NSAPI_ERROR_OK) {
+        printf("Link: Rejoins will use channel %u\n", ap->get_channel());
+    }
+}
+
+static bool try_join() {
+    stats_mutex.lock();
+    stats.join_attempts++;
+    stats_mutex.unlock();
+
+    nsapi_error_t result = wifi->connect();
+    if (result != NSAPI_ERROR_OK) {
+        printf("Link: Join failed (%d)\n", result);
+        return false;
+    }
+    core_util_atomic_store_u8(&reported_status, NSAPI_STATUS_GLOBAL_UP);
+
+    stats_mutex.lock();
+    stats.joins++;
+    stats_mutex.unlock();
+    // Scanning holds the module for a few seconds: not while MQTT reconnects
+    remember_pending = true;
+    return true;
+}
+
+// Joins with backoff. Returns the time from the AP showing up in a scan to
+// the link being up, or -1 if no scan saw it first.
+static int32_t join_with_backoff() {
+    uint32_t backoff_ms = LINK_RETRY_MIN_MS;
+    Timer since_seen;
+    bool seen = false;
+
+    while (!try_join()) {
+        // Wait for the next attempt. With fast rejoin the AP is looked for
+        // meanwhile, and a sighting cuts the wait short.
+        uint32_t waited_ms = 0;
+        while (waited_ms < backoff_ms) {
+            uint32_t step_ms = core_util_atomic_load_u8(&fast_rejoin) ? LINK_SCAN_INTERVAL_MS : backoff_ms;
+            step_ms = min(step_ms, backoff_ms - waited_ms);
+            ThisThread::sleep_for(chrono::milliseconds(step_ms));
+            waited_ms += step_ms;
+            if (core_util_atomic_load_u8(&fast_rejoin) && access_point_visible()) {
+                if (!seen) {
+                    since_seen.start();
+                    seen = true;
+                }
+                break;
+            }
+        }
+        // A sighting that did not lead to a join does not reset the backoff
+        backoff_ms = min(backoff_ms * 2, (uint32_t)LINK_RETRY_MAX_MS);
+    }
+    return seen ? since_seen.read_ms() : -1;
+}
+
+// The link is lost: rejoin and account for the outage
+static void recover_link() {
+    printf("Link: WiFi lost, rejoining...\n");
+    set_state(LINK_LOST);
+    stats_mutex.lock();
+    stats.outages++;
+    stats_mutex.unlock();
+
+    Timer outage;
+    outage.start();
+    int32_t rejoin_ms = join_with_backoff();
+    uint32_t outage_ms = outage.read_ms();
+
+    stats_mutex.lock();
+    stats.last_outage_ms = outage_ms;
+    stats.total_outage_ms += outage_ms;
+    if (outage_ms > stats.max_outage_ms) {
+        stats.max_outage_ms = outage_ms;
+    }
+    stats.last_rejoin_ms = rejoin_ms;
+    stats_mutex.unlock();
+
+    set_state(LINK_UP);
+    printf("Link: WiFi back after %lu ms (rejoin %ld ms)\n", (unsigned long)outage_ms, (long)rejoin_ms);
+}
+// -----------------------
+
+void link_manager_init(WiFiInterface* interface) {
+    wifi = interface;
+    memset(&stats, 0, sizeof(stats));
+    stats.last_rejoin_ms = -1;
+    set_state(LINK_DOWN);
+    since_check.start();
+    wifi->attach(callback(status_changed));
+}
+
+void link_manager_sigio(mbed::Callback<void()> func) {
+    wake = func;
+}
+
+void link_manager_connect() {
+    printf("Attempting to connect to WiFi (timeout ~10-15 seconds)...\n");
+    join_with_backoff();
+    set_state(LINK_UP);
+    network_print_connected();
+}
+
+uint32_t link_manager_poll() {
+    // The ISM43362 only notices a lost AP when asked: poll the link when
+    // requested and every LINK_CHECK_INTERVAL_MS
+    bool lost = core_util_atomic_load_u8(&reported_status) == NSAPI_STATUS_DISCONNECTED;
+    bool check = core_util_atomic_load_u8(&check_requested) || since_check.read_ms() >= LINK_CHECK_INTERVAL_MS;
+    if (!lost && check) {
+        core_util_atomic_store_u8(&check_requested, false);
+        since_check.reset();
+        lost = wifi->get_rssi() == 0;
+        if (!lost && remember_pending) {
+            remember_access_point();
+            remember_pending = false;
+        }
+    }
+    if (lost) {
+        recover_link();
+        since_check.reset();
+    }
+    int elapsed_ms = since_check.read_ms();
+    return elapsed_ms < LINK_CHECK_INTERVAL_MS ? LINK_CHECK_INTERVAL_MS - elapsed_ms : 0;
+}
+
+void link_manager_request_check() {
+    core_util_atomic_store_u8(&check_requested, true);
+    if (wake) {
+        wake();
+    }
+}
+
+LinkState link_manager_get_state() {
+    return (LinkState)core_util_atomic_load_u8(&link_state);
+}
+
+bool link_manager_is_up() {
+    return link_manager_get_state() == LINK_UP;
+}
+
+LinkStats link_manager_get_stats() {
+    stats_mutex.lock();
+    LinkStats copy = stats;
+    stats_mutex.unlock();
+    return copy;
+}
+
+void link_manager_set_fast_rejoin(bool enabled) {
+    core_util_atomic_store_u8(&fast_rejoin, enabled);
+}
@@ -0,0 +1,53 @@
+#ifndef LINK_MANAGER_H
+#define LINK_MANAGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "WiFiInterface.h"
+
+// Keeps the WiFi association up. Runs on the network thread: it is woken by
+// the interface's connection status callbacks, polls the link every
+// LINK_CHECK_INTERVAL_MS, and rejoins with exponential backoff when the AP
+// is lost. The BSSID and channel of the last good association are kept;
+// the channel is handed to set_channel() where the interface supports it,
+// and between retries the AP is looked for in scans so the rejoin starts as
+// soon as it is back rather than when the backoff runs out.
+typedef enum {
+    LINK_DOWN,      // not joined yet
+    LINK_UP,
+    LINK_LOST       // was up, rejoining
+} LinkState;
+
+typedef struct {
+    uint32_t joins;             // successful joins, the first one included
+    uint32_t join_attempts;
+    uint32_t outages;           // times an established link was lost
+    uint32_t last_outage_ms;    // loss noticed -> link up again
+    uint32_t max_outage_ms;
+    uint32_t total_outage_ms;
+    int32_t last_rejoin_ms;     // AP seen again -> link up, -1 if not seen in a scan first
+    uint8_t channel;            // of the last good association, 0 if unknown
+    uint8_t bssid[6];
+    bool bssid_known;
+} LinkStats;
+
+void link_manager_init(WiFiInterface* wifi);
+// Joins, retrying with backoff until the link is up. Blocks.
+void link_manager_connect();
+// func is called, possibly from the driver's context, when
+// link_manager_poll() has work: a status change or a check request
+void link_manager_sigio(mbed::Callback<void()> func);
+// One supervision step: checks the link if asked to or if the interval has
+// passed, and rejoins if it is lost (blocking until it is back). Returns the
+// ms until the next periodic check.
+uint32_t link_manager_poll();
+// Polls the link now rather than at the next interval, e.g. when the MQTT
+// connection failed
+void link_manager_request_check();
+LinkState link_manager_get_state();
+bool link_manager_is_up();
+LinkStats link_manager_get_stats();
+// Scan for the AP between retries (default LINK_FAST_REJOIN)
+void link_manager_set_fast_rejoin(bool enabled);
+
+#endif // LINK_MANAGER_H
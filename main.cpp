@@ -3,77 +3,216 @@
 #include "sensors.h"
 #include "anomaly_detector.h"
 #include "temp_tracker.h"
+#include "sampling.h"
 #include "warnings.h"
 #include "display.h"
-#include "network_manager.h"
+#include "network_task.h"
 #include "mqtt_handler.h"
+#include "sample_backlog.h"
+#include "window_stats.h"
+#include "anomaly_alert.h"
+#include "boot_trace.h"
+#include "heap_guard.h"
+#include "system_stats.h"
+#include "persistence.h"
+#include "history_store.h"
+#include "history_query.h"
+#include "time_sync.h"
+#if STATE_PERSISTENCE
+#include "FlashIAPBlockDevice.h"
+
+// Saved detector and tracker state at the end of internal flash
+static FlashIAPBlockDevice state_flash(MBED_ROM_START + MBED_ROM_SIZE - STATE_FLASH_SIZE, STATE_FLASH_SIZE);
+#endif
+#if HISTORY_STORE
+#include "QSPIFBlockDevice.h"
+#include "SlicingBlockDevice.h"
+
+// Reading history at the start of the external QSPI flash
+static QSPIFBlockDevice qspi_flash;
+static SlicingBlockDevice history_flash(&qspi_flash, 0, HISTORY_STORE_SIZE);
+#endif
 
 int main()
 {
     printf("\n--- IoT Temperature Warning System Starting ---\n");
+    boot_trace_start();
 
     // Initialize modules
     sensors_init();
     anomaly_detector_init();
     temp_tracker_init();
+    window_stats_init();
+    sampling_init();
     warnings_init();
-
-    // Initialize Network and MQTT
-    NetworkInterface* net = nullptr;
-    if (network_init() == NSAPI_ERROR_OK) {
-        net = network_get_interface();
-        if (!mqtt_init(net)) {
-            printf("Error: Failed to initialize MQTT handler.\n");
-            // Decide how to proceed - maybe run offline?
-        } else {
-            // Attempt initial MQTT connection (will retry in loop if fails)
-            mqtt_connect();
-            mqtt_publish_status("System Booted");
-        }
-    } else {
-        printf("Error: Failed to initialize network. Running in offline mode.\n");
+    display_init();
+    system_stats_init();
+#if STATE_PERSISTENCE
+    if (persistence_init(&state_flash)) {
+        persistence_restore((uint32_t)time(NULL));
     }
+#endif
+#if HISTORY_STORE
+    history_store_init(&history_flash);
+    history_query_init();
+    // The RTC starts again near 0 after a power loss and is only set once
+    // SNTP answers (time_sync.h). Until then the history's clock carries on
+    // from the newest reading stored, so new readings are never older than
+    // it and are not dropped.
+    uint64_t history_clock_ms = (uint64_t)time(NULL) * 1000U;
+    if (history_clock_ms <= history_store_get_stats().newest_ms) {
+        history_clock_ms = history_store_get_stats().newest_ms + 1;
+    }
+#endif
+
+    sample_backlog_init();
+    anomaly_alert_init();
+    boot_trace_mark(BOOT_SENSORS_READY);
+
+    // WiFi association and the MQTT connect take 10-15 s; they run on the
+    // network thread while the loop below samples. Reports taken before the
+    // session is up are backlogged and published once it is.
+    network_task_start();
 
     printf("\n--- Starting Main Loop ---\n");
 
+    uint32_t sample_interval_ms = SENSOR_UPDATE_INTERVAL_MS;
+    sensors_set_interval_ms(sample_interval_ms);
+
+    Timer sample_clock;
+    sample_clock.start();
+    bool heap_locked = false;
+    uint32_t uptime_ms = 0;
+    uint32_t since_system_stats_ms = 0;
+    SystemStats system_stats = system_stats_sample();
+
     while (true) {
+        // Time since the previous reading, whatever the interval was
+        uint32_t elapsed_ms = chrono::duration_cast<chrono::milliseconds>(sample_clock.elapsed_time()).count();
+        sample_clock.reset();
+        uptime_ms += elapsed_ms;
+
         // 1. Read Sensor Data
         SensorData current_sensor_data = sensors_read();
+        boot_trace_mark(BOOT_FIRST_SAMPLE);
+#if HISTORY_STORE
+        history_clock_ms += elapsed_ms;
+        if (time_sync_is_synced()) {
+            // Catch up with the RTC once it is set; it is never followed back
+            uint64_t rtc_ms = (uint64_t)time(NULL) * 1000U;
+            if (rtc_ms > history_clock_ms + 1000U) {
+                history_clock_ms = rtc_ms;
+            }
+        }
+        history_store_add(history_clock_ms, current_sensor_data);
+#endif
 
         // 2. Process Data
-        temp_tracker_update(current_sensor_data.temperature);
-        AnomalyStatus current_anomaly_status = anomaly_detector_process(current_sensor_data.temperature);
+        temp_tracker_update(current_sensor_data.temperature, elapsed_ms);
+        AnomalyStatus current_anomaly_status = anomaly_detector_process(current_sensor_data.temperature, elapsed_ms);
         TempStats1Hour current_stats = temp_tracker_get_stats();
+        if (current_sensor_data.temp_valid) {
+            window_stats_add(uptime_ms, current_sensor_data.temperature);
+        }
+
+        // An anomaly is alerted on straight away, ahead of everything else
+        AnomalyEvent anomaly_event;
+        if (anomaly_detector_take_event(&anomaly_event)) {
+            anomaly_alert_push(anomaly_event);
+            if (network_task_get_state() == NETWORK_TASK_ONLINE && mqtt_is_connected()) {
+                anomaly_alert_publish();
+            }
+        }
+#if STATE_PERSISTENCE
+        persistence_update(elapsed_ms, (uint32_t)time(NULL));
+#endif
+
+        // 3. Pick the next sample interval from the signal dynamics
+        sample_interval_ms = sampling_update(current_sensor_data.temperature, current_anomaly_status.is_anomalous, elapsed_ms);
+        sensors_set_interval_ms(sample_interval_ms);
 
-        // 3. Update Local Outputs
+        // Readings faster than the nominal rate drive the LED only, unless
+        // they cross a threshold or change the anomaly flag
+        bool report_due = sampling_report_due(current_sensor_data.temperature, current_anomaly_status.is_anomalous, elapsed_ms);
+
+        // 4. Update Local Outputs
         warnings_update(current_sensor_data.temperature, current_anomaly_status.is_anomalous);
-        display_update(current_sensor_data, current_stats, current_anomaly_status);
-
-        // 4. Handle Network & MQTT Tasks
-        if (net) { // Only if network was initialized successfully
-            if (!mqtt_is_connected()) {
-                printf("MQTT disconnected. Attempting reconnect...\n");
-                // Optional: Check WiFi status before attempting MQTT reconnect
-                // if(net->get_connection_status() != NSAPI_STATUS_GLOBAL_UP) { ... }
-                mqtt_connect(); // Attempt to reconnect
-                if(mqtt_is_connected()) {
-                    mqtt_publish_status("System Reconnected");
-                }
+        since_system_stats_ms += elapsed_ms;
+        bool system_stats_due = since_system_stats_ms >= SYSTEM_STATS_INTERVAL_MS;
+        if (system_stats_due) {
+            system_stats = system_stats_sample();
+            since_system_stats_ms = 0;
+        }
+        if (report_due) {
+            if (display_system_page_active()) {
+                display_system_stats(system_stats);
             } else {
-                // Publish data if connected
-                mqtt_publish_data(current_sensor_data, current_stats, current_anomaly_status);
+                WindowStats windows[WINDOW_STATS_COUNT];
+                window_stats_get_all(windows);
+                display_update(current_sensor_data, current_stats, windows, current_anomaly_status);
+            }
+        }
+
+        // 5. Handle Network & MQTT Tasks
+        // The network thread rejoins WiFi and reconnects the session
+        NetworkTaskState net_state = network_task_get_state();
+        if (net_state == NETWORK_TASK_ONLINE && mqtt_is_connected()) {
+            // Alerts that waited for the session go first
+            anomaly_alert_publish();
 
-                // Allow MQTT client to process keep-alives, etc.
-                mqtt_yield(100); // Allow 100ms for MQTT background tasks
+            // Catch up on reports taken while the session was down, oldest
+            // first. They are queued as backfill, which gives way to live data.
+            BacklogSample backlogged;
+            for (int i = 0; i < SAMPLE_BACKLOG_DRAIN_PER_PASS && sample_backlog_peek(&backlogged); i++) {
+                if (!mqtt_publish_data(backlogged.data, backlogged.stats, backlogged.anomaly,
+                                       uptime_ms - backlogged.taken_ms)) {
+                    break;
+                }
+                sample_backlog_pop();
+                boot_trace_mark(BOOT_FIRST_PUBLISH);
+            }
+
+            // Publish data if connected; kept in the backlog if it cannot be queued
+            if (report_due) {
+                if (mqtt_publish_data(current_sensor_data, current_stats, current_anomaly_status)) {
+                    boot_trace_mark(BOOT_FIRST_PUBLISH);
+                } else {
+                    sample_backlog_push(uptime_ms, current_sensor_data, current_stats, current_anomaly_status);
+                }
             }
+            if (system_stats_due) {
+                mqtt_publish_metrics(system_stats, anomaly_alert_get_stats());
+                WindowStats windows[WINDOW_STATS_COUNT];
+                window_stats_get_all(windows);
+                mqtt_publish_window_stats(windows);
+            }
+#if HISTORY_STORE
+            // History queries get what the queue has left, a few chunks a pass
+            history_query_service(uptime_ms);
+#endif
+            // Acknowledgements and keep alive are handled on the network thread
+        } else if (report_due && net_state != NETWORK_TASK_OFFLINE) {
+            // Still connecting, or the session dropped
+            sample_backlog_push(uptime_ms, current_sensor_data, current_stats, current_anomaly_status);
+        }
+
+        // 6. Lock the heap once the network thread is past its set-up: the
+        // join, the SNTP server lookup and the first broker connect attempt,
+        // whether it got a session or not. Reconnects and publishes run from
+        // static storage, and the first pass's dashboard has already made
+        // stdio's one-time allocations, so a broker that never answers does
+        // not hold the lock off. Until WiFi first joins the set-up has not
+        // run, so the lock waits for it. From here on any allocation is
+        // fatal (NO_HEAP_AFTER_INIT).
+        if (!heap_locked && (net_state == NETWORK_TASK_ONLINE || net_state == NETWORK_TASK_OFFLINE)) {
+            heap_guard_lock();
+            heap_locked = true;
         }
 
-        // 5. Wait for next sample interval
-        // Adjust sleep time to account for MQTT yield time if necessary
-        int sleep_time = SAMPLE_INTERVAL_MS;
-        if (net && mqtt_is_connected()) {
-           sleep_time = max(100, SAMPLE_INTERVAL_MS - 100); // Ensure at least 100ms sleep
+        // 7. Wait for the rest of the sample interval
+        uint32_t busy_ms = chrono::duration_cast<chrono::milliseconds>(sample_clock.elapsed_time()).count();
+        if (busy_ms < sample_interval_ms) {
+            ThisThread::sleep_for(chrono::milliseconds(sample_interval_ms - busy_ms));
         }
-         ThisThread::sleep_for(chrono::milliseconds(sleep_time));
     }
-}
\ No newline at end of file
+}
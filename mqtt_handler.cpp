@@ -1,56 +1,585 @@
 #include "mqtt_handler.h"
+#include "mqtt_payload.h"
 #include "config.h"
-#include "MQTTClientMbedOs.h" // Include the MQTT library header
+#include "MQTTPacket.h" // Packet serializers from the MQTT library
 #include "TCPSocket.h"
 #include "SocketAddress.h"
+#include <new> // For placement new
+
+// The MQTT session is run here on top of the library's packet serializers
+// rather than through MQTTClient: its publish() blocks on every PUBACK and
+// its yield() drops acknowledgements without reporting the packet id, so it
+// cannot keep more than one QoS 1 message in flight.
+//
+// Publishes are formatted into a slot of their class's pool in the
+// outbound queue and sent from there, highest class first (see
+// drain_queue()). With a network thread (mqtt_sigio() called) the thread
+// sends them, along with receiving and keep alive (mqtt_service());
+// otherwise the publishing caller does. _session_mutex serializes use of
+// the session, _queue_mutex the queue.
 
 static NetworkInterface* _network_interface = nullptr;
-static MQTTClient* _mqtt_client = nullptr;
+
+// The socket lives in static storage and is constructed once by mqtt_init(),
+// so reconnects never touch the heap and its constructor does not run
+// during static initialization, before the RTOS is up.
+alignas(TCPSocket) static unsigned char _mqtt_socket_storage[sizeof(TCPSocket)];
 static TCPSocket* _mqtt_socket = nullptr;
-static bool _is_connected = false;
+static bool _socket_open = false;
+static volatile uint8_t _is_connected = false;
+static Mutex _session_mutex;
+static mbed::Callback<void()> _sigio_callback;
+
+// Session timing, in ms since mqtt_init()
+static Timer _clock;
+static uint32_t _last_sent_ms = 0;
+static bool _ping_outstanding = false;
+static uint32_t _ping_sent_ms = 0;
+static int _connack_rc = -1;
+
+// Unacknowledged QoS 1 publishes, kept serialized so they can be resent
+// as-is. 'seq' preserves publish order for retransmission.
+typedef struct {
+    unsigned short packet_id; // 0 = free slot
+    uint16_t len;
+    uint32_t seq;
+    unsigned char packet[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+} InflightSlot;
+
+static InflightSlot _inflight[MQTT_INFLIGHT_WINDOW];
+static int _inflight_count = 0;
+static uint32_t _inflight_seq = 0;
+static unsigned short _next_packet_id = 0;
+static int _data_qos = MQTT_DATA_QOS;
+static int _window = MQTT_INFLIGHT_WINDOW;
+
+static unsigned char _send_buffer[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+static unsigned char _read_buffer[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+static int _read_length = 0;
+
+static MqttStats _stats;
+
+// Outbound queue: a ring of pre-allocated slots per class
+typedef struct {
+    const char* topic;
+    uint8_t qos;
+    bool retained;
+    uint16_t len;
+    uint64_t queued_us;
+    uint32_t alert_sequence;    // MQTT_CLASS_ALERT: the event's, for anomaly_alert_sent()
+    char payload[MBED_CONF_MQTT_MAX_PACKET_SIZE];
+} OutboundSlot;
+
+typedef struct {
+    OutboundSlot* slots;
+    uint8_t size;
+    uint8_t weight;     // messages per drain round
+    uint8_t head;       // oldest queued message
+    uint8_t credit;     // left in this round
+    uint64_t total_latency_us;
+    MqttClassStats stats;
+} OutboundClass;
+
+static OutboundSlot _alert_slots[MQTT_QUEUE_ALERT_SLOTS];
+static OutboundSlot _status_slots[MQTT_QUEUE_STATUS_SLOTS];
+static OutboundSlot _telemetry_slots[MQTT_QUEUE_TELEMETRY_SLOTS];
+static OutboundSlot _backfill_slots[MQTT_QUEUE_BACKFILL_SLOTS];
+static OutboundSlot _history_slots[MQTT_QUEUE_HISTORY_SLOTS];
+
+static OutboundClass _classes[MQTT_CLASS_COUNT] = {
+    {_alert_slots, MQTT_QUEUE_ALERT_SLOTS, MQTT_QUEUE_ALERT_WEIGHT, 0, 0, 0, {}},
+    {_status_slots, MQTT_QUEUE_STATUS_SLOTS, MQTT_QUEUE_STATUS_WEIGHT, 0, 0, 0, {}},
+    {_telemetry_slots, MQTT_QUEUE_TELEMETRY_SLOTS, MQTT_QUEUE_TELEMETRY_WEIGHT, 0, 0, 0, {}},
+    {_backfill_slots, MQTT_QUEUE_BACKFILL_SLOTS, MQTT_QUEUE_BACKFILL_WEIGHT, 0, 0, 0, {}},
+    {_history_slots, MQTT_QUEUE_HISTORY_SLOTS, MQTT_QUEUE_HISTORY_WEIGHT, 0, 0, 0, {}},
+};
+static Mutex _queue_mutex;
+
+// Messages received on MQTT_TOPIC_HISTORY_REQUEST, oldest first; filled by
+// whoever reads the socket, emptied by mqtt_take_request() (_queue_mutex)
+typedef struct {
+    uint16_t len;
+    char payload[MQTT_REQUEST_MAX_LEN];
+} RequestSlot;
+
+static RequestSlot _requests[MQTT_REQUEST_SLOTS];
+static uint8_t _request_head = 0;
+static uint8_t _request_count = 0;
+
+// The last status message, published again with the window statistics
+static char _last_status[32] = "Online";
+
+static uint32_t now_ms() {
+    return (uint32_t)chrono::duration_cast<chrono::milliseconds>(_clock.elapsed_time()).count();
+}
+
+static uint64_t now_us() {
+    return (uint64_t)_clock.elapsed_time().count();
+}
+
+static void set_connected(bool connected) {
+    core_util_atomic_store_u8(&_is_connected, connected);
+}
+
+// Drops the connection. In-flight publishes stay queued for the next connect.
+static void close_session() {
+    set_connected(false);
+    _ping_outstanding = false;
+    _read_length = 0;
+    if (_socket_open) {
+        _mqtt_socket->close();
+        _socket_open = false;
+    }
+}
+
+static bool send_packet(const unsigned char* packet, int len) {
+    _mqtt_socket->set_timeout(MQTT_COMMAND_TIMEOUT_MS);
+    int sent = 0;
+    while (sent < len) {
+        nsapi_size_or_error_t rc = _mqtt_socket->send(packet + sent, len - sent);
+        if (rc <= 0) {
+            printf("MQTT Error: Socket send failed (%d), connection lost.\n", rc);
+            close_session();
+            return false;
+        }
+        sent += rc;
+    }
+    _last_sent_ms = now_ms();
+    return true;
+}
+
+static void release_inflight(unsigned short packet_id) {
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        if (_inflight[i].packet_id == packet_id) {
+            _inflight[i].packet_id = 0;
+            _inflight_count--;
+            _stats.acked++;
+            return;
+        }
+    }
+}
+
+static bool packet_id_in_use(unsigned short packet_id) {
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        if (_inflight[i].packet_id == packet_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static unsigned short next_packet_id() {
+    do {
+        _next_packet_id = (_next_packet_id == 65535) ? 1 : _next_packet_id + 1;
+    } while (packet_id_in_use(_next_packet_id));
+    return _next_packet_id;
+}
+
+static void handle_packet(unsigned char* packet, int len) {
+    switch (packet[0] >> 4) {
+        case CONNACK: {
+            unsigned char session_present, rc;
+            if (MQTTDeserialize_connack(&session_present, &rc, packet, len) == 1) {
+                _connack_rc = rc;
+            }
+            break;
+        }
+        case PUBACK: {
+            unsigned char type, dup;
+            unsigned short packet_id;
+            if (MQTTDeserialize_ack(&type, &dup, &packet_id, packet, len) == 1) {
+                release_inflight(packet_id);
+            }
+            break;
+        }
+        case PINGRESP:
+            _ping_outstanding = false;
+            break;
+        case PUBLISH: {
+            // Requests are kept for the main loop; anything else is ignored,
+            // but a QoS 1 delivery still has to be acknowledged
+            unsigned char dup, retained;
+            int qos, payload_len;
+            unsigned short packet_id;
+            MQTTString topic;
+            unsigned char* payload;
+            if (MQTTDeserialize_publish(&dup, &qos, &retained, &packet_id, &topic, &payload, &payload_len, packet, len) != 1) {
+                break;
+            }
+            if (MQTTPacket_equals(&topic, (char*)MQTT_TOPIC_HISTORY_REQUEST)) {
+                _queue_mutex.lock();
+                _stats.requests++;
+                if (_request_count == MQTT_REQUEST_SLOTS) {
+                    _stats.requests_dropped++;
+                } else {
+                    RequestSlot* slot = &_requests[(_request_head + _request_count) % MQTT_REQUEST_SLOTS];
+                    slot->len = (uint16_t)(payload_len < MQTT_REQUEST_MAX_LEN ? payload_len : MQTT_REQUEST_MAX_LEN);
+                    memcpy(slot->payload, payload, slot->len);
+                    _request_count++;
+                }
+                _queue_mutex.unlock();
+            }
+            if (qos == 1) {
+                int ack_len = MQTTSerialize_puback(_send_buffer, sizeof(_send_buffer), packet_id);
+                send_packet(_send_buffer, ack_len);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Waits up to timeout_ms for data and handles every complete packet received.
+// Returns the number of bytes received, 0 if nothing arrived in time, or -1
+// if the connection was lost.
+static int read_packets(int timeout_ms) {
+    _mqtt_socket->set_timeout(timeout_ms);
+    nsapi_size_or_error_t rc = _mqtt_socket->recv(_read_buffer + _read_length, sizeof(_read_buffer) - _read_length);
+    if (rc == NSAPI_ERROR_WOULD_BLOCK) {
+        return 0; // Nothing arrived in time
+    }
+    if (rc <= 0) {
+        printf("MQTT: Connection closed by broker (%d).\n", rc);
+        close_session();
+        return -1;
+    }
+    _read_length += rc;
+
+    // Fixed header: type byte, then 1-4 bytes of remaining length
+    while (_read_length >= 2) {
+        int remaining = 0;
+        int multiplier = 1;
+        int header_len = 1;
+        bool complete = false;
+        while (header_len < _read_length && header_len <= 4) {
+            unsigned char c = _read_buffer[header_len++];
+            remaining += (c & 127) * multiplier;
+            multiplier *= 128;
+            if (!(c & 128)) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete) {
+            break;
+        }
+        int packet_len = header_len + remaining;
+        if (packet_len > (int)sizeof(_read_buffer)) {
+            printf("MQTT Error: Incoming packet of %d bytes exceeds buffer!\n", packet_len);
+            close_session();
+            return -1;
+        }
+        if (_read_length < packet_len) {
+            break;
+        }
+        handle_packet(_read_buffer, packet_len);
+        if (!_socket_open) {
+            return -1; // Lost while answering
+        }
+        _read_length -= packet_len;
+        memmove(_read_buffer, _read_buffer + packet_len, _read_length);
+    }
+    return rc;
+}
+
+// Sends PINGREQ when nothing has been sent for a keep alive interval and
+// gives up on the connection if PINGRESP does not arrive in time
+static bool keepalive() {
+    uint32_t now = now_ms();
+    if (_ping_outstanding) {
+        if (now - _ping_sent_ms >= MQTT_COMMAND_TIMEOUT_MS) {
+            printf("MQTT: No PINGRESP from broker, connection lost.\n");
+            close_session();
+            return false;
+        }
+        return true;
+    }
+    if (now - _last_sent_ms >= MQTT_KEEPALIVE_INTERVAL_S * 1000) {
+        int len = MQTTSerialize_pingreq(_send_buffer, sizeof(_send_buffer));
+        if (!send_packet(_send_buffer, len)) {
+            return false;
+        }
+        _ping_outstanding = true;
+        _ping_sent_ms = now;
+    }
+    return true;
+}
+
+// ms until keepalive() has something to do: send PINGREQ, or give up
+// waiting for PINGRESP
+static uint32_t keepalive_due_ms() {
+    uint32_t elapsed = now_ms() - (_ping_outstanding ? _ping_sent_ms : _last_sent_ms);
+    uint32_t limit = _ping_outstanding ? MQTT_COMMAND_TIMEOUT_MS : MQTT_KEEPALIVE_INTERVAL_S * 1000;
+    return elapsed < limit ? limit - elapsed : 0;
+}
 
-// Buffer for MQTT messages
-static char mqtt_payload_buffer[256];
+// Resends unacknowledged publishes, oldest first, with the DUP flag set
+static void resend_inflight() {
+    uint32_t last_seq = 0;
+    bool first = true;
+    for (int n = 0; n < _inflight_count; n++) {
+        InflightSlot* next = nullptr;
+        for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+            InflightSlot* slot = &_inflight[i];
+            if (slot->packet_id && (first || slot->seq > last_seq) && (!next || slot->seq < next->seq)) {
+                next = slot;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        first = false;
+        last_seq = next->seq;
+        next->packet[0] |= 0x08;
+        if (!send_packet(next->packet, next->len)) {
+            return;
+        }
+        _stats.retransmits++;
+    }
+    if (_stats.retransmits) {
+        printf("MQTT: Resent unacknowledged publishes (%lu total).\n", (unsigned long)_stats.retransmits);
+    }
+}
+
+// Waits for a free in-flight slot, processing incoming acknowledgements
+static InflightSlot* reserve_inflight() {
+    uint32_t start = now_ms();
+    while (_inflight_count >= _window) {
+        if (!_is_connected || now_ms() - start >= MQTT_COMMAND_TIMEOUT_MS) {
+            return nullptr;
+        }
+        read_packets(10);
+    }
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        if (_inflight[i].packet_id == 0) {
+            return &_inflight[i];
+        }
+    }
+    return nullptr;
+}
+
+static bool publish_locked(const char* topic_name, const char* payload, int len, int qos, bool retained) {
+    MQTTString topic = MQTTString_initializer;
+    topic.cstring = (char*)topic_name;
+
+    if (qos == 0) {
+        int packet_len = MQTTSerialize_publish(_send_buffer, sizeof(_send_buffer), 0, 0, retained, 0, topic,
+                                               (unsigned char*)payload, len);
+        if (packet_len <= 0) {
+            printf("MQTT Error: Message does not fit in mqtt.max-packet-size!\n");
+            return false;
+        }
+        if (!send_packet(_send_buffer, packet_len)) {
+            return false;
+        }
+        _stats.published++;
+        return true;
+    }
+
+    InflightSlot* slot = reserve_inflight();
+    if (!slot) {
+        _stats.window_full++;
+        return false;
+    }
+    unsigned short packet_id = next_packet_id();
+    int packet_len = MQTTSerialize_publish(slot->packet, sizeof(slot->packet), 0, 1, retained, packet_id, topic,
+                                           (unsigned char*)payload, len);
+    if (packet_len <= 0) {
+        printf("MQTT Error: Message does not fit in mqtt.max-packet-size!\n");
+        return false;
+    }
+    slot->packet_id = packet_id;
+    slot->len = (uint16_t)packet_len;
+    slot->seq = _inflight_seq++;
+    _inflight_count++;
+    if (_inflight_count > _stats.max_inflight) {
+        _stats.max_inflight = (uint16_t)_inflight_count;
+    }
+    _stats.published++;
+
+    // If the send fails the message stays in flight and goes out again on reconnect
+    send_packet(slot->packet, packet_len);
+    return true;
+}
+
+// --- Outbound queue ---
+// Locks the queue and returns the free slot at the tail of cls. If the
+// class's pool is full, counts a drop, unlocks and returns nullptr.
+static OutboundSlot* queue_begin(MqttClass cls) {
+    _queue_mutex.lock();
+    OutboundClass& c = _classes[cls];
+    if (c.stats.depth == c.size) {
+        c.stats.dropped++;
+        _queue_mutex.unlock();
+        return nullptr;
+    }
+    return &c.slots[(c.head + c.stats.depth) % c.size];
+}
+
+// Queues the slot from queue_begin() once its payload is in (len < 0: it
+// did not fit, and the slot stays free) and unlocks
+// Serialized size of a PUBLISH carrying len payload bytes
+static int publish_packet_size(const char* topic, int qos, int len) {
+    return MQTTPacket_len(2 + (int)strlen(topic) + (qos ? 2 : 0) + len);
+}
+
+// Buffer size to format a payload for topic into so the PUBLISH fits in
+// mqtt.max-packet-size: a byte less for the remaining length field, which
+// may grow once the payload is added, and a byte more for the NUL
+static size_t payload_format_size(const char* topic, int qos) {
+    return MBED_CONF_MQTT_MAX_PACKET_SIZE - publish_packet_size(topic, qos, 0);
+}
+
+static bool queue_end(MqttClass cls, OutboundSlot* slot, int len, const char* topic, int qos, bool retained) {
+    OutboundClass& c = _classes[cls];
+    // Refused here rather than dropped when the drain cannot serialize it
+    if (len < 0 || publish_packet_size(topic, qos, len) > MBED_CONF_MQTT_MAX_PACKET_SIZE) {
+        _queue_mutex.unlock();
+        return false;
+    }
+    slot->topic = topic;
+    slot->qos = (uint8_t)qos;
+    slot->retained = retained;
+    slot->len = (uint16_t)len;
+    slot->queued_us = now_us();
+    c.stats.depth++;
+    c.stats.queued++;
+    if (c.stats.depth > c.stats.max_depth) {
+        c.stats.max_depth = c.stats.depth;
+    }
+    _queue_mutex.unlock();
+    return true;
+}
+
+// Can the message go out without waiting for the in-flight window?
+static bool sendable(const OutboundSlot* slot, bool may_wait) {
+    return slot->qos == 0 || may_wait || _inflight_count < _window;
+}
+
+// Weighted round robin in priority order: in each round a class may send
+// up to its weight, higher classes first. A class without credit waits
+// for the next round, so backfill gets a share of every round but cannot
+// hold up live telemetry, and even a steady stream of alerts leaves room
+// for the rest. Returns -1 if nothing can be sent now.
+static int next_class(bool may_wait) {
+    for (int round = 0; round < 2; round++) {
+        for (int cls = 0; cls < MQTT_CLASS_COUNT; cls++) {
+            OutboundClass& c = _classes[cls];
+            if (c.stats.depth > 0 && c.credit > 0 && sendable(&c.slots[c.head], may_wait)) {
+                c.credit--;
+                return cls;
+            }
+        }
+        // Nothing sendable has credit left: start a new round
+        for (int cls = 0; cls < MQTT_CLASS_COUNT; cls++) {
+            _classes[cls].credit = _classes[cls].weight;
+        }
+    }
+    return -1;
+}
+
+// Sends queued messages while the session is up. With may_wait a QoS 1
+// message waits for room in the in-flight window (MQTT_COMMAND_TIMEOUT_MS
+// at most); otherwise it is left for when a PUBACK frees a slot.
+// Called with _session_mutex held.
+static void drain_queue(bool may_wait) {
+    while (_is_connected) {
+        _queue_mutex.lock();
+        int cls = next_class(may_wait);
+        _queue_mutex.unlock();
+        if (cls < 0) {
+            return;
+        }
+
+        // Only the drain removes messages, so the head stays put meanwhile
+        OutboundClass& c = _classes[cls];
+        OutboundSlot* slot = &c.slots[c.head];
+        bool sent = publish_locked(slot->topic, slot->payload, slot->len, slot->qos, slot->retained);
+        if (!sent && !_is_connected) {
+            return; // Kept for the next connection
+        }
+        uint32_t alert_sequence = slot->alert_sequence;
+
+        _queue_mutex.lock();
+        c.head = (c.head + 1) % c.size;
+        c.stats.depth--;
+        if (sent) {
+            uint64_t elapsed_us = now_us() - slot->queued_us;
+            uint32_t latency_us = elapsed_us > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed_us;
+            c.stats.sent++;
+            c.stats.last_latency_us = latency_us;
+            if (latency_us > c.stats.max_latency_us) {
+                c.stats.max_latency_us = latency_us;
+            }
+            c.total_latency_us += latency_us;
+            c.stats.mean_latency_us = (uint32_t)(c.total_latency_us / c.stats.sent);
+        } else {
+            c.stats.dropped++;
+        }
+        _queue_mutex.unlock();
+
+        // An alert's latency runs to here, the packet on the wire
+        if (sent && cls == MQTT_CLASS_ALERT) {
+            anomaly_alert_sent(alert_sequence);
+        }
+    }
+}
+
+// A message was queued: wake the network thread, or send it now
+static void queue_kick() {
+    if (_sigio_callback) {
+        _sigio_callback();
+        return;
+    }
+    _session_mutex.lock();
+    drain_queue(true);
+    _session_mutex.unlock();
+}
+// -----------------------
 
 bool mqtt_init(NetworkInterface* network_interface) {
     if (!network_interface) {
         printf("MQTT Error: Network interface is null!\n");
         return false;
     }
+    _session_mutex.lock();
     _network_interface = network_interface;
 
-    // Allocate TCPSocket
-    _mqtt_socket = new TCPSocket();
+    // Construct the TCPSocket on first init; it is opened on every connect
     if (!_mqtt_socket) {
-        printf("MQTT Error: Failed to allocate TCPSocket!\n");
-        return false;
-    }
-
-    // Open socket with network interface
-    nsapi_error_t sock_result = _mqtt_socket->open(_network_interface);
-    if (sock_result != NSAPI_ERROR_OK) {
-        printf("MQTT Error: Failed to open socket! (%d)\n", sock_result);
-        delete _mqtt_socket;
-        _mqtt_socket = nullptr;
-        return false;
+        _mqtt_socket = new (_mqtt_socket_storage) TCPSocket();
+        if (_sigio_callback) {
+            _mqtt_socket->sigio(_sigio_callback);
+        }
+    } else {
+        close_session();
     }
 
-    // Allocate MQTT client with the socket
-    _mqtt_client = new MQTTClient(_mqtt_socket);
-    if (!_mqtt_client) {
-        printf("MQTT Error: Failed to allocate MQTTClient!\n");
-        _mqtt_socket->close();
-        delete _mqtt_socket;
-        _mqtt_socket = nullptr;
-        return false;
+    memset(_inflight, 0, sizeof(_inflight));
+    memset(&_stats, 0, sizeof(_stats));
+    _inflight_count = 0;
+
+    _queue_mutex.lock();
+    _request_head = 0;
+    _request_count = 0;
+    for (int cls = 0; cls < MQTT_CLASS_COUNT; cls++) {
+        OutboundClass& c = _classes[cls];
+        c.head = 0;
+        c.credit = c.weight;
+        c.total_latency_us = 0;
+        memset(&c.stats, 0, sizeof(c.stats));
     }
+    _queue_mutex.unlock();
+    _clock.start();
+    _session_mutex.unlock();
 
     printf("MQTT Handler Initialized.\n");
     return true;
 }
 
-bool mqtt_connect() {
-    if (!_mqtt_client || !_mqtt_socket) {
+static bool connect_session() {
+    if (!_mqtt_socket) {
         printf("MQTT Error: Not initialized!\n");
         return false;
     }
@@ -61,12 +590,21 @@ bool mqtt_connect() {
 
     printf("Connecting to MQTT broker: %s:%d\n", MQTT_BROKER_HOSTNAME, MQTT_BROKER_PORT);
 
+    // Start from a fresh socket; a socket the broker dropped cannot be reconnected
+    close_session();
+    nsapi_error_t sock_result = _mqtt_socket->open(_network_interface);
+    if (sock_result != NSAPI_ERROR_OK) {
+        printf("MQTT Error: Failed to open socket! (%d)\n", sock_result);
+        return false;
+    }
+    _socket_open = true;
+
     // Resolve hostname and create socket address
     SocketAddress broker_addr;
     nsapi_error_t dns_result = _network_interface->gethostbyname(MQTT_BROKER_HOSTNAME, &broker_addr);
     if (dns_result != NSAPI_ERROR_OK) {
         printf("MQTT Error: DNS lookup failed for broker (%d)\n", dns_result);
-        _is_connected = false;
+        close_session();
         return false;
     }
     broker_addr.set_port(MQTT_BROKER_PORT);
@@ -75,7 +613,7 @@ bool mqtt_connect() {
     nsapi_error_t socket_result = _mqtt_socket->connect(broker_addr);
     if (socket_result != NSAPI_ERROR_OK) {
         printf("MQTT Error: Socket connection failed! (%d)\n", socket_result);
-        _is_connected = false;
+        close_session();
         return false;
     }
 
@@ -91,156 +629,323 @@ bool mqtt_connect() {
     if (strlen(MQTT_PASSWORD) > 0) {
         options.password.cstring = (char*)MQTT_PASSWORD;
     }
-    options.keepAliveInterval = 60; // Keep alive interval in seconds
+    options.keepAliveInterval = MQTT_KEEPALIVE_INTERVAL_S;
     options.cleansession = 1;
 
-    // Attempt MQTT connection (this returns nsapi_error_t)
-    nsapi_error_t mqtt_result = _mqtt_client->connect(options);
-    if (mqtt_result != NSAPI_ERROR_OK) {
-        printf("MQTT Error: MQTT Connection failed! (%d)\n", mqtt_result);
-        _is_connected = false;
-        _mqtt_socket->close();
+    int len = MQTTSerialize_connect(_send_buffer, sizeof(_send_buffer), &options);
+    if (len <= 0 || !send_packet(_send_buffer, len)) {
+        printf("MQTT Error: Failed to send CONNECT!\n");
+        close_session();
+        return false;
+    }
+
+    // Wait for CONNACK
+    _connack_rc = -1;
+    uint32_t start = now_ms();
+    while (_connack_rc < 0 && now_ms() - start < MQTT_COMMAND_TIMEOUT_MS) {
+        if (read_packets(100) < 0) {
+            break;
+        }
+    }
+    if (_connack_rc != 0) {
+        printf("MQTT Error: MQTT Connection failed! (%d)\n", _connack_rc);
+        close_session();
         return false;
     }
 
     printf("MQTT Connected Successfully!\n");
-    _is_connected = true;
-    return true;
+    set_connected(true);
+    _ping_outstanding = false;
+
+    // A clean session starts with no subscriptions. The SUBACK is not
+    // waited for; requests published before it arrives are lost.
+    MQTTString filter = MQTTString_initializer;
+    filter.cstring = (char*)MQTT_TOPIC_HISTORY_REQUEST;
+    int requested_qos = 1;
+    len = MQTTSerialize_subscribe(_send_buffer, sizeof(_send_buffer), 0, next_packet_id(), 1, &filter, &requested_qos);
+    if (len <= 0 || !send_packet(_send_buffer, len)) {
+        printf("MQTT Error: Failed to subscribe to %s!\n", MQTT_TOPIC_HISTORY_REQUEST);
+        return false;
+    }
+    resend_inflight();
+    return _is_connected;
+}
+
+bool mqtt_connect() {
+    _session_mutex.lock();
+    bool connected = connect_session();
+    if (connected) {
+        queue_kick(); // Messages queued before the connection dropped
+    }
+    _session_mutex.unlock();
+    return connected;
 }
 
-bool mqtt_publish_data(const SensorData& data, const TempStats1Hour& stats, const AnomalyStatus& anomaly) {
-    if (!_is_connected || !_mqtt_client) {
+bool mqtt_publish_data(const SensorData& data, const TempStats1Hour& stats, const AnomalyStatus& anomaly, uint32_t age_ms) {
+    if (!_is_connected) {
         printf("MQTT Error: Not connected, cannot publish data.\n");
         return false;
     }
 
-    // Format data into JSON payload
-    // Note: Using snprintf for safety against buffer overflows
-    int len = snprintf(mqtt_payload_buffer, sizeof(mqtt_payload_buffer),
-                       "{\"temp\":%.2f, \"humidity\":%.2f, \"pressure\":%.2f, "
-                       "\"min_1h\":%.2f, \"max_1h\":%.2f, \"anomaly\":\"%s\"}",
-                       data.temperature, data.humidity, data.pressure,
-                       stats.min_temp, stats.max_temp,
-                       anomaly.is_anomalous ? "true" : "false");
-
-    if (len < 0 || len >= (int)sizeof(mqtt_payload_buffer)) {
-        printf("MQTT Error: Payload buffer too small or snprintf error!\n");
+    // Backlogged readings give way to live ones; a full pool is left to the caller
+    MqttClass cls = age_ms > 0 ? MQTT_CLASS_BACKFILL : MQTT_CLASS_TELEMETRY;
+    OutboundSlot* slot = queue_begin(cls);
+    if (!slot) {
         return false;
     }
 
-    // Create MQTT message
-    MQTT::Message message;
-    message.qos = MQTT::QOS0; // Quality of Service 0 (at most once)
-    message.retained = false;
-    message.dup = false;
-    message.payload = (void*)mqtt_payload_buffer;
-    message.payloadlen = len;
-
-    // Publish the message (returns nsapi_error_t)
-    nsapi_error_t rc = _mqtt_client->publish(MQTT_TOPIC_DATA, message);
-    if (rc != NSAPI_ERROR_OK) {
-        printf("MQTT Error: Failed to publish data! (Code %d)\n", rc);
-        // If socket error, mark as disconnected
-        if (rc == NSAPI_ERROR_DEVICE_ERROR || rc == NSAPI_ERROR_CONNECTION_LOST) {
-            _is_connected = false;
-        }
+    // Format data into JSON payload
+    int len = mqtt_format_data_payload(slot->payload, sizeof(slot->payload), data, stats, anomaly, age_ms,
+                                       MQTT_CLIENT_ID);
+    if (!queue_end(cls, slot, len, MQTT_TOPIC_DATA, _data_qos, false)) {
+        printf("MQTT Error: Payload buffer too small or snprintf error!\n");
         return false;
     }
+    queue_kick();
 
-    // printf("MQTT: Published data to %s\n", MQTT_TOPIC_DATA); // Optional debug print
+    // printf("MQTT: Queued data for %s\n", MQTT_TOPIC_DATA); // Optional debug print
     return true;
 }
 
-bool mqtt_publish_status(const char* status_message) {
-    if (!_is_connected || !_mqtt_client) {
+bool mqtt_publish_status(const char* status_message, const WindowStats* windows) {
+    if (!_is_connected) {
         printf("MQTT Error: Not connected, cannot publish status.\n");
         return false;
     }
 
+    OutboundSlot* slot = queue_begin(MQTT_CLASS_STATUS);
+    if (!slot) {
+        printf("MQTT Error: Status queue full, dropping '%s'!\n", status_message);
+        return false;
+    }
+
     // Format data into simple JSON payload
-    int len = snprintf(mqtt_payload_buffer, sizeof(mqtt_payload_buffer),
-                       "{\"status\":\"%s\"}", status_message);
+    int len = mqtt_format_status_payload(slot->payload, sizeof(slot->payload), status_message, windows);
 
-    if (len < 0 || len >= (int)sizeof(mqtt_payload_buffer)) {
+    // Retain the last status message on the broker (QoS 0)
+    if (!queue_end(MQTT_CLASS_STATUS, slot, len, MQTT_TOPIC_STATUS, 0, true)) {
         printf("MQTT Error: Payload buffer too small or snprintf error for status!\n");
         return false;
     }
+    queue_kick();
+
+    if (status_message != _last_status) {
+        snprintf(_last_status, sizeof(_last_status), "%s", status_message);
+        printf("MQTT: Queued status '%s' for %s\n", status_message, MQTT_TOPIC_STATUS);
+    }
+    return true;
+}
 
-    // Create MQTT message
-    MQTT::Message message;
-    message.qos = MQTT::QOS0;
-    message.retained = true; // Retain the last status message on the broker
-    message.dup = false;
-    message.payload = (void*)mqtt_payload_buffer;
-    message.payloadlen = len;
+bool mqtt_publish_window_stats(const WindowStats* windows) {
+    return mqtt_publish_status(_last_status, windows);
+}
 
-    // Publish the message (returns nsapi_error_t)
-    nsapi_error_t rc = _mqtt_client->publish(MQTT_TOPIC_STATUS, message);
-    if (rc != NSAPI_ERROR_OK) {
-        printf("MQTT Error: Failed to publish status! (Code %d)\n", rc);
-        if (rc == NSAPI_ERROR_DEVICE_ERROR || rc == NSAPI_ERROR_CONNECTION_LOST) {
-            _is_connected = false;
-        }
+bool mqtt_publish_anomaly(const AnomalyEvent& event, uint32_t age_ms) {
+    if (!_is_connected) {
+        printf("MQTT Error: Not connected, cannot publish anomaly.\n");
         return false;
     }
 
-    printf("MQTT: Published status '%s' to %s\n", status_message, MQTT_TOPIC_STATUS);
+    // When full the caller keeps the event and tries again
+    OutboundSlot* slot = queue_begin(MQTT_CLASS_ALERT);
+    if (!slot) {
+        return false;
+    }
+
+    int len = mqtt_format_anomaly_payload(slot->payload, sizeof(slot->payload), event, age_ms);
+    slot->alert_sequence = event.sequence;
+    if (!queue_end(MQTT_CLASS_ALERT, slot, len, MQTT_TOPIC_ANOMALY, MQTT_ANOMALY_QOS, false)) {
+        printf("MQTT Error: Payload buffer too small or snprintf error for anomaly!\n");
+        return false;
+    }
+    queue_kick();
+
+    printf("MQTT: Queued anomaly #%lu for %s\n", (unsigned long)event.sequence, MQTT_TOPIC_ANOMALY);
+    return true;
+}
+
+bool mqtt_publish_metrics(const SystemStats& stats, const AnomalyAlertStats& alerts) {
+    if (!_is_connected) {
+        printf("MQTT Error: Not connected, cannot publish metrics.\n");
+        return false;
+    }
+
+    // Periodic and superseded by the next sample: telemetry, QoS 0, not retained
+    OutboundSlot* slot = queue_begin(MQTT_CLASS_TELEMETRY);
+    if (!slot) {
+        return false;
+    }
+
+    // Threads that would push the packet past mqtt.max-packet-size are left out
+    int len = mqtt_format_metrics_payload(slot->payload, payload_format_size(MQTT_TOPIC_METRICS, 0), stats, alerts);
+    if (!queue_end(MQTT_CLASS_TELEMETRY, slot, len, MQTT_TOPIC_METRICS, 0, false)) {
+        printf("MQTT Error: Payload buffer too small or snprintf error for metrics!\n");
+        return false;
+    }
+
+    // The queue's own figures, taken with the slot just filled
+    MqttClassStats classes[MQTT_CLASS_COUNT];
+    for (int cls = 0; cls < MQTT_CLASS_COUNT; cls++) {
+        classes[cls] = mqtt_get_class_stats((MqttClass)cls);
+    }
+    slot = queue_begin(MQTT_CLASS_TELEMETRY);
+    if (!slot) {
+        queue_kick();
+        return false;
+    }
+    len = mqtt_format_queue_payload(slot->payload, sizeof(slot->payload), classes);
+    if (!queue_end(MQTT_CLASS_TELEMETRY, slot, len, MQTT_TOPIC_QUEUE_METRICS, 0, false)) {
+        printf("MQTT Error: Payload buffer too small or snprintf error for queue metrics!\n");
+        queue_kick();
+        return false;
+    }
+    queue_kick();
     return true;
 }
 
+bool mqtt_publish_history(const uint8_t* payload, int len) {
+    if (!_is_connected) {
+        return false;
+    }
+
+    // Lowest class: a full pool tells the caller to hold back (history_query.cpp)
+    OutboundSlot* slot = queue_begin(MQTT_CLASS_HISTORY);
+    if (!slot) {
+        return false;
+    }
+    if (len > (int)sizeof(slot->payload)) {
+        len = -1;
+    } else {
+        memcpy(slot->payload, payload, len);
+    }
+    if (!queue_end(MQTT_CLASS_HISTORY, slot, len, MQTT_TOPIC_HISTORY_DATA, 0, false)) {
+        printf("MQTT Error: History chunk of %d bytes too big!\n", len);
+        return false;
+    }
+    queue_kick();
+    return true;
+}
+
+int mqtt_take_request(char* buffer, int size) {
+    _queue_mutex.lock();
+    if (_request_count == 0 || size <= 0) {
+        _queue_mutex.unlock();
+        return -1;
+    }
+    RequestSlot* slot = &_requests[_request_head];
+    int len = slot->len < size - 1 ? slot->len : size - 1;
+    memcpy(buffer, slot->payload, len);
+    buffer[len] = '\0';
+    _request_head = (_request_head + 1) % MQTT_REQUEST_SLOTS;
+    _request_count--;
+    _queue_mutex.unlock();
+    return len;
+}
 
 bool mqtt_is_connected() {
-    // Check internal flag first
-    if (!_is_connected || !_mqtt_client) return false;
+    // Updated by every socket operation and by the keep alive check in
+    // mqtt_service()/mqtt_yield()
+    return core_util_atomic_load_u8(&_is_connected);
+}
 
-    // Optionally add a check using the client's isConnected method,
-    // but be mindful this might involve network I/O.
-    // The yield function updates the internal state more reliably.
-    return _mqtt_client->isConnected();
+static void account_service(uint64_t start_us) {
+    _stats.service_calls++;
+    _stats.service_us += now_us() - start_us;
 }
 
 void mqtt_yield(int timeout_ms) {
-    if (_mqtt_client && _network_interface) {
-        // Yield allows the MQTT client to process incoming messages (like PINGRESP)
-        // and manage keep-alive packets.
-        nsapi_error_t rc = _mqtt_client->yield(timeout_ms);
-        if (rc != NSAPI_ERROR_OK && rc != NSAPI_ERROR_WOULD_BLOCK) {
-            printf("MQTT Warning: Yield returned error %d\n", rc);
-            // If yield indicates disconnection, update our state
-            if (!_mqtt_client->isConnected()) {
-                printf("MQTT Disconnected during yield.\n");
-                _is_connected = false;
-            }
+    _session_mutex.lock();
+    if (!_is_connected) {
+        _session_mutex.unlock();
+        return;
+    }
+    // Process PUBACKs and PINGRESPs for the whole period, then keep alive
+    uint64_t start_us = now_us();
+    uint32_t start = now_ms();
+    bool lost = false;
+    do {
+        int remaining = timeout_ms - (int)(now_ms() - start);
+        if (read_packets(remaining > 0 ? remaining : 0) < 0) {
+            printf("MQTT Disconnected during yield.\n");
+            lost = true;
+            break;
         }
+    } while ((int)(now_ms() - start) < timeout_ms);
+    if (!lost) {
+        drain_queue(false);
+        keepalive();
     }
+    account_service(start_us);
+    _session_mutex.unlock();
+}
+
+uint32_t mqtt_service() {
+    _session_mutex.lock();
+    if (!_is_connected) {
+        _session_mutex.unlock();
+        // Woken again by the socket once a connect opens it
+        return MQTT_KEEPALIVE_INTERVAL_S * 1000;
+    }
+    // Send what is queued first, then take whatever the socket has buffered
+    // without waiting for more; acknowledgements may free window for the rest
+    uint64_t start_us = now_us();
+    drain_queue(false);
+    int rc = _is_connected ? 1 : -1;
+    while (rc > 0) {
+        rc = read_packets(0);
+    }
+    if (rc == 0) {
+        drain_queue(false);
+    }
+    uint32_t due_ms = MQTT_KEEPALIVE_INTERVAL_S * 1000;
+    if (_is_connected && keepalive()) {
+        due_ms = keepalive_due_ms();
+    } else {
+        printf("MQTT Disconnected while servicing the session.\n");
+    }
+    account_service(start_us);
+    _session_mutex.unlock();
+    return due_ms;
+}
+
+void mqtt_sigio(mbed::Callback<void()> func) {
+    _session_mutex.lock();
+    _sigio_callback = func;
+    if (_mqtt_socket) {
+        _mqtt_socket->sigio(func);
+    }
+    _session_mutex.unlock();
 }
 
 void mqtt_disconnect() {
-    if (_is_connected && _mqtt_client) {
+    _session_mutex.lock();
+    if (_is_connected) {
         printf("Disconnecting MQTT...\n");
-        nsapi_error_t rc = _mqtt_client->disconnect();
-        if (rc != NSAPI_ERROR_OK) {
-            printf("MQTT Warning: Disconnect failed! (Code %d)\n", rc);
-        } else {
+        int len = MQTTSerialize_disconnect(_send_buffer, sizeof(_send_buffer));
+        if (send_packet(_send_buffer, len)) {
             printf("MQTT Disconnected.\n");
         }
     }
-    _is_connected = false;
+    close_session();
+    _session_mutex.unlock();
+}
 
-    // Close the socket if open
-    if (_mqtt_socket) {
-        _mqtt_socket->close();
-    }
+void mqtt_set_data_qos(int qos, int window) {
+    _data_qos = qos > 0 ? 1 : 0;
+    _window = window < 1 ? 1 : (window > MQTT_INFLIGHT_WINDOW ? MQTT_INFLIGHT_WINDOW : window);
+}
 
-    // Cleanup resources - consider if you want to reuse the client/socket later
-    // If not reusing, uncomment the delete lines:
-    // if (_mqtt_client) {
-    //    delete _mqtt_client;
-    //    _mqtt_client = nullptr;
-    // }
-    // if (_mqtt_socket) {
-    //    delete _mqtt_socket;
-    //    _mqtt_socket = nullptr;
-    // }
-    // _network_interface = nullptr; // Clear the network interface pointer
-}
\ No newline at end of file
+MqttClassStats mqtt_get_class_stats(MqttClass cls) {
+    _queue_mutex.lock();
+    MqttClassStats stats = _classes[cls].stats;
+    _queue_mutex.unlock();
+    return stats;
+}
+
+MqttStats mqtt_get_stats() {
+    _session_mutex.lock();
+    MqttStats stats = _stats;
+    stats.inflight = (uint16_t)_inflight_count;
+    _session_mutex.unlock();
+    return stats;
+}
@@ -5,15 +5,73 @@
 #include "sensors.h"
 #include "temp_tracker.h"
 #include "anomaly_detector.h"
+#include "system_stats.h"
+#include "anomaly_alert.h"
+#include "window_stats.h"
+#include "mqtt_payload.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+// Delivery counters since mqtt_init()
+typedef struct {
+    uint32_t published;     // publishes sent (QoS 0) or accepted into the window (QoS 1)
+    uint32_t acked;         // PUBACKs received
+    uint32_t retransmits;   // QoS 1 publishes resent after a reconnect
+    uint32_t window_full;   // publishes refused because no slot freed up in time
+    uint16_t inflight;      // QoS 1 publishes currently awaiting PUBACK
+    uint16_t max_inflight;  // high-water mark of inflight
+    uint32_t requests;      // messages received on MQTT_TOPIC_HISTORY_REQUEST
+    uint32_t requests_dropped; // received with MQTT_REQUEST_SLOTS already waiting
+    uint32_t service_calls; // runs of mqtt_service() and mqtt_yield()
+    uint64_t service_us;    // time spent in them, waiting for data included
+} MqttStats;
 
 // Function prototypes
 bool mqtt_init(NetworkInterface* network_interface);
 bool mqtt_connect();
-bool mqtt_publish_data(const SensorData& data, const TempStats1Hour& stats, const AnomalyStatus& anomaly);
-bool mqtt_publish_status(const char* status_message);
+// The publish functions queue the message in its class and return false if
+// not connected or the class's pool is full. The network thread sends it,
+// or the caller before returning if there is none (no mqtt_sigio()).
+// age_ms: how long ago a backlogged reading was taken (0 for a live one)
+bool mqtt_publish_data(const SensorData& data, const TempStats1Hour& stats, const AnomalyStatus& anomaly, uint32_t age_ms = 0);
+// windows: WINDOW_STATS_COUNT trailing-window statistics to add, if any
+bool mqtt_publish_status(const char* status_message, const WindowStats* windows = nullptr);
+// On MQTT_TOPIC_ANOMALY at MQTT_ANOMALY_QOS; age_ms as for data
+bool mqtt_publish_anomaly(const AnomalyEvent& event, uint32_t age_ms = 0);
+// The metrics record on MQTT_TOPIC_METRICS, then the outbound queue's
+// figures (mqtt_get_class_stats()) on MQTT_TOPIC_QUEUE_METRICS
+bool mqtt_publish_metrics(const SystemStats& stats, const AnomalyAlertStats& alerts);
+// The last status message again, with the trailing-window statistics
+// (window_stats.h), so the retained status carries them
+bool mqtt_publish_window_stats(const WindowStats* windows);
+// On MQTT_TOPIC_HISTORY_DATA at QoS 0; a binary payload of len bytes
+bool mqtt_publish_history(const uint8_t* payload, int len);
+// The session subscribes to MQTT_TOPIC_HISTORY_REQUEST on every connect and
+// keeps what arrives there, up to MQTT_REQUEST_SLOTS messages. Copies the
+// oldest into buffer, null-terminated and cut to size - 1 bytes, and
+// returns its length; -1 if none is waiting.
+int mqtt_take_request(char* buffer, int size);
 bool mqtt_is_connected();
-void mqtt_yield(int timeout_ms = 100); // Process MQTT messages
+// Waits up to timeout_ms for incoming packets, handling them, then keeps
+// the session alive. For callers without a thread to run mqtt_service().
+void mqtt_yield(int timeout_ms = 100);
 void mqtt_disconnect();
 
-#endif // MQTT_HANDLER_H
\ No newline at end of file
+// Event-driven alternative to mqtt_yield(): the network thread calls
+// mqtt_service() when the socket signals or a message is queued (func
+// passed to mqtt_sigio(), called from the driver's context or the
+// publisher's) and when the returned number of ms has passed. It handles
+// what has arrived without waiting, sends what the in-flight window allows
+// from the outbound queue, and sends PINGREQ when due.
+void mqtt_sigio(mbed::Callback<void()> func);
+uint32_t mqtt_service();
+
+// QoS and in-flight window for data publishes (defaults MQTT_DATA_QOS and
+// MQTT_INFLIGHT_WINDOW; the window is clamped to 1..MQTT_INFLIGHT_WINDOW).
+// A QoS 1 publish accepted into the window is kept until acknowledged,
+// including across reconnects.
+void mqtt_set_data_qos(int qos, int window);
+MqttStats mqtt_get_stats();
+MqttClassStats mqtt_get_class_stats(MqttClass cls);
+
+#endif // MQTT_HANDLER_H
@@ -0,0 +1,123 @@
+#include "mqtt_payload.h"
+#include <stdio.h>
+
+int mqtt_format_data_payload(char* buffer, size_t size, const SensorData& data, const TempStats1Hour& stats, const AnomalyStatus& anomaly, uint32_t age_ms, const char* device) {
+    // Note: Using snprintf for safety against buffer overflows
+    int len = 0;
+    if (device) {
+        len = snprintf(buffer, size, "{\"dev\":\"%s\", ", device);
+        if (len < 0 || len >= (int)size) {
+            return -1;
+        }
+    }
+    len += snprintf(buffer + len, size - len,
+                    "%s\"temp\":%.2f, \"humidity\":%.2f, \"pressure\":%.2f, "
+                    "\"min_1h\":%.2f, \"max_1h\":%.2f, \"anomaly\":\"%s\"}",
+                    device ? "" : "{",
+                    data.temperature, data.humidity, data.pressure,
+                    stats.min_temp, stats.max_temp,
+                    anomaly.is_anomalous ? "true" : "false");
+
+    // Backlogged reading: insert its age before the closing brace
+    if (age_ms > 0 && len > 0 && len < (int)size) {
+        len += snprintf(buffer + len - 1, size - len + 1, ", \"age_ms\":%lu}", (unsigned long)age_ms) - 1;
+    }
+
+    if (len < 0 || len >= (int)size) {
+        return -1;
+    }
+    return len;
+}
+
+int mqtt_format_status_payload(char* buffer, size_t size, const char* status_message, const WindowStats* windows) {
+    int len = snprintf(buffer, size, "{\"status\":\"%s\"", status_message);
+
+    for (int i = 0; windows && i < WINDOW_STATS_COUNT && len >= 0 && len < (int)size; i++) {
+        const WindowStats& w = windows[i];
+        len += snprintf(buffer + len, size - len, "%s\"%lum\":", i ? "," : ",\"windows\":{",
+                        (unsigned long)(window_stats_span_ms(i) / 60000));
+        if (len >= 0 && len < (int)size) {
+            len += w.valid ? snprintf(buffer + len, size - len, "[%.2f,%.2f,%.2f,%lu]", w.min_temp, w.max_temp,
+                                      w.mean_temp, (unsigned long)w.readings)
+                           : snprintf(buffer + len, size - len, "null");
+        }
+    }
+    if (len >= 0 && len < (int)size) {
+        len += snprintf(buffer + len, size - len, windows ? "}}" : "}");
+    }
+
+    if (len < 0 || len >= (int)size) {
+        return -1;
+    }
+    return len;
+}
+
+int mqtt_format_anomaly_payload(char* buffer, size_t size, const AnomalyEvent& event, uint32_t age_ms) {
+    int len = snprintf(buffer, size,
+                       "{\"z\":%.2f, \"mean\":%.4f, \"std_dev\":%.4f, \"rate\":%.4f, "
+                       "\"readings\":[%.2f,%.2f], \"seq\":%lu}",
+                       event.z_score, event.mean, event.std_dev, event.rate,
+                       event.previous_temp, event.current_temp, (unsigned long)event.sequence);
+
+    // Queued while offline: insert its age before the closing brace
+    if (age_ms > 0 && len > 0 && len < (int)size) {
+        len += snprintf(buffer + len - 1, size - len + 1, ", \"age_ms\":%lu}", (unsigned long)age_ms) - 1;
+    }
+
+    if (len < 0 || len >= (int)size) {
+        return -1;
+    }
+    return len;
+}
+
+int mqtt_format_metrics_payload(char* buffer, size_t size, const SystemStats& stats, const AnomalyAlertStats& alerts) {
+    char tail[96];
+    int tail_len = snprintf(tail, sizeof(tail), "},\"alerts\":[%lu,%lu,%lu,%lu,%lu,%lu]}",
+                            (unsigned long)alerts.raised, (unsigned long)alerts.published,
+                            (unsigned long)alerts.dropped, (unsigned long)alerts.last_latency_us,
+                            (unsigned long)alerts.max_latency_us, (unsigned long)alerts.mean_latency_us);
+    int len = snprintf(buffer, size, "{\"up\":%lu,\"idle\":%u,\"heap\":[%lu,%lu,%lu,%lu],\"stack\":{",
+                       (unsigned long)stats.uptime_s, (unsigned)stats.cpu_idle_pct,
+                       (unsigned long)stats.heap_current, (unsigned long)stats.heap_max,
+                       (unsigned long)stats.heap_reserved, (unsigned long)stats.heap_alloc_fail);
+
+    // Threads are listed while they leave room for the alerts; the rest are
+    // left out rather than the record
+    for (int i = 0; i < stats.thread_count && len >= 0 && len < (int)size; i++) {
+        const ThreadStackStats& t = stats.threads[i];
+        int entry_len = snprintf(buffer + len, size - len, "%s\"%s\":[%lu,%lu]", i ? "," : "",
+                                 t.name, (unsigned long)t.stack_used, (unsigned long)t.stack_size);
+        if (entry_len < 0 || len + entry_len + tail_len >= (int)size) {
+            break;
+        }
+        len += entry_len;
+    }
+    if (len >= 0 && len < (int)size) {
+        len += snprintf(buffer + len, size - len, "%s", tail);
+    }
+
+    if (len < 0 || len >= (int)size) {
+        return -1;
+    }
+    return len;
+}
+
+int mqtt_format_queue_payload(char* buffer, size_t size, const MqttClassStats* classes) {
+    int len = snprintf(buffer, size, "{\"queue\":[");
+
+    for (int i = 0; i < MQTT_CLASS_COUNT && len >= 0 && len < (int)size; i++) {
+        const MqttClassStats& c = classes[i];
+        len += snprintf(buffer + len, size - len, "%s[%u,%u,%lu,%lu,%lu,%lu]", i ? "," : "",
+                        (unsigned)c.depth, (unsigned)c.max_depth, (unsigned long)c.sent,
+                        (unsigned long)c.dropped, (unsigned long)c.mean_latency_us,
+                        (unsigned long)c.max_latency_us);
+    }
+    if (len >= 0 && len < (int)size) {
+        len += snprintf(buffer + len, size - len, "]}");
+    }
+
+    if (len < 0 || len >= (int)size) {
+        return -1;
+    }
+    return len;
+}
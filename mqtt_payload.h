@@ -0,0 +1,56 @@
+#ifndef MQTT_PAYLOAD_H
+#define MQTT_PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sensors.h"
+#include "temp_tracker.h"
+#include "anomaly_detector.h"
+#include "system_stats.h"
+#include "anomaly_alert.h"
+#include "window_stats.h"
+
+// Outbound priority classes, highest first. Each has its own pool of
+// pre-allocated message slots (MQTT_QUEUE_*_SLOTS in config.h); a publish
+// whose class's pool is full is refused and counted as dropped.
+typedef enum {
+    MQTT_CLASS_ALERT,       // anomaly events
+    MQTT_CLASS_STATUS,      // status messages
+    MQTT_CLASS_TELEMETRY,   // live readings and metrics
+    MQTT_CLASS_BACKFILL,    // backlogged readings (age_ms > 0)
+    MQTT_CLASS_HISTORY,     // answers to history queries (history_query.h)
+    MQTT_CLASS_COUNT
+} MqttClass;
+
+typedef struct {
+    uint16_t depth;             // messages queued now
+    uint16_t max_depth;
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t dropped;           // refused with the pool full, or lost to a failed send
+    uint32_t last_latency_us;   // queued -> handed to the socket
+    uint32_t max_latency_us;
+    uint32_t mean_latency_us;
+} MqttClassStats;
+
+// JSON payload formatters used by the MQTT handler.
+// Kept free of any network dependency so the host tools can reuse them.
+// Each returns the payload length, or -1 if it does not fit in the buffer.
+// age_ms > 0 adds "age_ms", how long ago the reading was taken (backlogged reports);
+// device leads the payload as "dev", so a subscriber to many devices can tell them apart
+int mqtt_format_data_payload(char* buffer, size_t size, const SensorData& data, const TempStats1Hour& stats, const AnomalyStatus& anomaly, uint32_t age_ms = 0, const char* device = nullptr);
+// {"status":"..."}; with windows (WINDOW_STATS_COUNT of them) also
+// "windows":{"5m":[min,max,mean,readings],...}, null for a window without readings
+int mqtt_format_status_payload(char* buffer, size_t size, const char* status_message, const WindowStats* windows = nullptr);
+// {"z":..., "mean":..., "std_dev":..., "rate":..., "readings":[previous,current], "seq":N},
+// with "age_ms" as above for an event that waited for the session
+int mqtt_format_anomaly_payload(char* buffer, size_t size, const AnomalyEvent& event, uint32_t age_ms = 0);
+// {"up":s,"idle":%,"heap":[current,max,reserved,failures],"stack":{"name":[used,size],...},
+//  "alerts":[raised,published,dropped,last_us,max_us,mean_us]}; threads
+// that would not fit in size are left out
+int mqtt_format_metrics_payload(char* buffer, size_t size, const SystemStats& stats, const AnomalyAlertStats& alerts);
+// {"queue":[[depth,max_depth,sent,dropped,mean_us,max_us],...]}, one array
+// per class of the MQTT_CLASS_COUNT in classes, in MqttClass order
+int mqtt_format_queue_payload(char* buffer, size_t size, const MqttClassStats* classes);
+
+#endif // MQTT_PAYLOAD_H
@@ -5,7 +5,7 @@
 // WiFi Interface object
 static ISM43362Interface wifi_interface(false);
 
-nsapi_error_t network_init() {
+nsapi_error_t network_set_credentials() {
     printf("\n=== WiFi Network Initialization ===\n");
     printf("SSID: %s\n", WIFI_SSID);
     const char* security_type = "Unknown";
@@ -30,34 +30,32 @@ nsapi_error_t network_init() {
         return result;
     }
     printf("Credentials set successfully.\n");
+    return NSAPI_ERROR_OK;
+}
 
-    // Attempt to connect with retry
-    printf("Attempting to connect to WiFi (timeout ~10-15 seconds)...\n");
-    result = wifi_interface.connect();
-    if (result != NSAPI_ERROR_OK) {
-        printf("\nERROR: WiFi connection failed with code: %d\n", result);
-        switch(result) {
-            case NSAPI_ERROR_AUTH_FAILURE:
-                printf("  Code: Authentication failure - check password\n");
-                printf("  Possible causes:\n");
-                printf("    1. Password is incorrect\n");
-                printf("    2. WiFi network security type mismatch (expected WPA2)\n");
-                break;
-            case NSAPI_ERROR_NO_SSID:
-                printf("  Code: SSID not found - check network name\n");
-                printf("  Possible causes:\n");
-                printf("    1. WiFi SSID '%s' not found in range\n", WIFI_SSID);
-                break;
-            case NSAPI_ERROR_TIMEOUT:
-                printf("  Code: Connection timeout - network may be busy\n");
-                break;
-            default:
-                printf("  See Mbed OS documentation for error code %d\n", result);
-        }
-        wait_us(100000);
-        return result;
+void network_print_connect_error(nsapi_error_t result) {
+    printf("\nERROR: WiFi connection failed with code: %d\n", result);
+    switch(result) {
+        case NSAPI_ERROR_AUTH_FAILURE:
+            printf("  Code: Authentication failure - check password\n");
+            printf("  Possible causes:\n");
+            printf("    1. Password is incorrect\n");
+            printf("    2. WiFi network security type mismatch (expected WPA2)\n");
+            break;
+        case NSAPI_ERROR_NO_SSID:
+            printf("  Code: SSID not found - check network name\n");
+            printf("  Possible causes:\n");
+            printf("    1. WiFi SSID '%s' not found in range\n", WIFI_SSID);
+            break;
+        case NSAPI_ERROR_TIMEOUT:
+            printf("  Code: Connection timeout - network may be busy\n");
+            break;
+        default:
+            printf("  See Mbed OS documentation for error code %d\n", result);
     }
+}
 
+void network_print_connected() {
     // Print connection details
     printf("WiFi connection successful!\n");
     const char *ip = wifi_interface.get_ip_address();
@@ -67,6 +65,24 @@ nsapi_error_t network_init() {
         printf("IP Address: (DHCP in progress)\n");
     }
     printf("=== WiFi Ready ===\n\n");
+}
+
+nsapi_error_t network_init() {
+    nsapi_error_t result = network_set_credentials();
+    if (result != NSAPI_ERROR_OK) {
+        return result;
+    }
+
+    // Attempt to connect with retry
+    printf("Attempting to connect to WiFi (timeout ~10-15 seconds)...\n");
+    result = wifi_interface.connect();
+    if (result != NSAPI_ERROR_OK) {
+        network_print_connect_error(result);
+        wait_us(100000);
+        return result;
+    }
+
+    network_print_connected();
     wait_us(100000);
     return NSAPI_ERROR_OK;
 }
@@ -75,6 +91,10 @@ NetworkInterface* network_get_interface() {
     return &wifi_interface;
 }
 
+WiFiInterface* network_get_wifi_interface() {
+    return &wifi_interface;
+}
+
 void network_disconnect() {
     printf("Disconnecting WiFi...\n");
     wifi_interface.disconnect();
@@ -2,10 +2,17 @@
 #define NETWORK_MANAGER_H
 
 #include "NetworkInterface.h"
+#include "WiFiInterface.h"
 
 // Function prototypes
 nsapi_error_t network_init(); // Initializes and connects WiFi
 NetworkInterface* network_get_interface(); // Returns the network interface pointer
+WiFiInterface* network_get_wifi_interface();
 void network_disconnect();
 
-#endif // NETWORK_MANAGER_H
\ No newline at end of file
+// The steps of network_init(), for the link manager's joins
+nsapi_error_t network_set_credentials();
+void network_print_connect_error(nsapi_error_t result);
+void network_print_connected();
+
+#endif // NETWORK_MANAGER_H
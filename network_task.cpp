@@ -0,0 +1,121 @@
+#include "network_task.h"
+#include "config.h"
+#include "network_manager.h"
+#include "mqtt_handler.h"
+#include "boot_trace.h"
+#include "link_manager.h"
+#include "time_sync.h"
+
+// Statically allocated like the WiFi driver's read thread (no heap)
+alignas(8) static unsigned char network_task_stack[NETWORK_TASK_STACK_SIZE];
+static Thread network_thread(NETWORK_TASK_PRIORITY, NETWORK_TASK_STACK_SIZE, network_task_stack, "network");
+static volatile uint8_t task_state = NETWORK_TASK_IDLE;
+
+#define NETWORK_FLAG_LINK 0x1
+#define NETWORK_FLAG_MQTT 0x2
+static EventFlags network_events;
+
+// Called from the WiFi driver's context: only wake the thread
+static void link_event() {
+    network_events.set(NETWORK_FLAG_LINK);
+}
+
+static void mqtt_event() {
+    network_events.set(NETWORK_FLAG_MQTT);
+}
+
+// MQTT reconnects run here, so the TCP connect and the wait for CONNACK
+// (up to MQTT_COMMAND_TIMEOUT_MS) never hold up sampling
+static Timer since_reconnect;
+static uint32_t reconnect_backoff_ms = 0;  // 0: try on the next pass
+
+// Reconnects a dropped session once the link is up, backing off while the
+// broker does not answer. Returns the ms until the next attempt is due.
+static uint32_t mqtt_reconnect_poll() {
+    if (mqtt_is_connected()) {
+        reconnect_backoff_ms = 0;
+        return MQTT_KEEPALIVE_INTERVAL_S * 1000;
+    }
+    if (!link_manager_is_up()) {
+        // The link manager rejoins first, and wakes this thread once it has
+        reconnect_backoff_ms = 0;
+        return LINK_CHECK_INTERVAL_MS;
+    }
+    uint32_t elapsed_ms = chrono::duration_cast<chrono::milliseconds>(since_reconnect.elapsed_time()).count();
+    if (elapsed_ms < reconnect_backoff_ms) {
+        return reconnect_backoff_ms - elapsed_ms;
+    }
+    printf("MQTT disconnected. Attempting reconnect...\n");
+    since_reconnect.reset();
+    if (mqtt_connect()) {
+        mqtt_publish_status("System Reconnected");
+        reconnect_backoff_ms = 0;
+        return MQTT_KEEPALIVE_INTERVAL_S * 1000;
+    }
+    // Maybe the AP is gone: have the link manager look now
+    link_manager_request_check();
+    reconnect_backoff_ms = reconnect_backoff_ms ? min(reconnect_backoff_ms * 2, (uint32_t)MQTT_RETRY_MAX_MS)
+                                                : (uint32_t)MQTT_RETRY_MIN_MS;
+    return reconnect_backoff_ms;
+}
+
+static void network_task_main() {
+    if (network_set_credentials() != NSAPI_ERROR_OK) {
+        printf("Error: Failed to initialize network. Running in offline mode.\n");
+        core_util_atomic_store_u8(&task_state, NETWORK_TASK_OFFLINE);
+        return;
+    }
+
+    // Retries until the AP is reachable; sampling goes on meanwhile
+    link_manager_sigio(callback(link_event));
+    link_manager_init(network_get_wifi_interface());
+    link_manager_connect();
+    boot_trace_mark(BOOT_WIFI_UP);
+
+    // The RTC first, so the history is stamped with the time of day as
+    // soon as possible; a failed sync is retried from the loop below
+    time_sync_init(network_get_interface());
+    time_sync_poll();
+
+    mqtt_sigio(callback(mqtt_event));
+    if (!mqtt_init(network_get_interface())) {
+        printf("Error: Failed to initialize MQTT handler.\n");
+        core_util_atomic_store_u8(&task_state, NETWORK_TASK_OFFLINE);
+        return;
+    }
+    // Retried with backoff from the loop below if this attempt fails
+    since_reconnect.start();
+    if (mqtt_connect()) {
+        boot_trace_mark(BOOT_MQTT_UP);
+        mqtt_publish_status("System Booted");
+    } else {
+        reconnect_backoff_ms = MQTT_RETRY_MIN_MS;
+    }
+    core_util_atomic_store_u8(&task_state, NETWORK_TASK_ONLINE);
+
+    // From here on the thread only runs when there is work: a link status
+    // change or check request, data on the MQTT socket, or a timer
+    uint32_t wait_ms = 0;
+    while (true) {
+        network_events.wait_any_for(NETWORK_FLAG_LINK | NETWORK_FLAG_MQTT, chrono::milliseconds(wait_ms));
+        uint32_t link_ms = link_manager_poll();
+        uint32_t mqtt_ms = min(mqtt_service(), mqtt_reconnect_poll());
+        uint32_t time_ms = time_sync_poll();
+        wait_ms = min(min(link_ms, mqtt_ms), time_ms);
+    }
+}
+
+void network_task_start() {
+    if (core_util_atomic_load_u8(&task_state) != NETWORK_TASK_IDLE) {
+        return;
+    }
+    core_util_atomic_store_u8(&task_state, NETWORK_TASK_CONNECTING);
+    if (network_thread.start(callback(network_task_main)) != osOK) {
+        printf("Error: Failed to start the network thread. Running in offline mode.\n");
+        core_util_atomic_store_u8(&task_state, NETWORK_TASK_OFFLINE);
+    }
+}
+
+NetworkTaskState network_task_get_state() {
+    return (NetworkTaskState)core_util_atomic_load_u8(&task_state);
+}
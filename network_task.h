@@ -0,0 +1,23 @@
+#ifndef NETWORK_TASK_H
+#define NETWORK_TASK_H
+
+#include <stdint.h>
+
+// Brings WiFi and the MQTT session up on a thread of its own, so the main
+// loop can sample while the module associates (10-15 s) and connects. The
+// thread then stays on to keep the link up (link_manager.h), to run the
+// MQTT session's receive side and keep alive (mqtt_service()), and to
+// reconnect the session with backoff when it drops. It sleeps
+// until the link manager or the MQTT socket signals, or the next link check
+// or keep alive falls due.
+typedef enum {
+    NETWORK_TASK_IDLE,        // not started
+    NETWORK_TASK_CONNECTING,  // joining WiFi (until it succeeds) and connecting to the broker
+    NETWORK_TASK_ONLINE,      // WiFi up and MQTT initialised; the main loop publishes while mqtt_is_connected()
+    NETWORK_TASK_OFFLINE      // invalid WiFi credentials or MQTT set-up failed: running offline
+} NetworkTaskState;
+
+void network_task_start();
+NetworkTaskState network_task_get_state();
+
+#endif // NETWORK_TASK_H
@@ -0,0 +1,74 @@
+#include "persistence.h"
+#include "config.h"
+
+static bool persistence_ready = false;
+static uint32_t since_save_ms = 0;
+static MonitorSnapshot snapshot;
+
+bool persistence_init(BlockDevice* bd) {
+    since_save_ms = 0;
+    persistence_ready = record_store_init(bd, sizeof(MonitorSnapshot));
+    if (!persistence_ready) {
+        printf("Persistence Error: State will not survive a reset.\n");
+    }
+    return persistence_ready;
+}
+
+RestoreResult persistence_restore(uint32_t rtc_s) {
+    RestoreResult result = {false, -1};
+    if (!persistence_ready || !record_store_load(&snapshot)) {
+        printf("Persistence: No saved state, starting cold.\n");
+        return result;
+    }
+    if (snapshot.version != STATE_SNAPSHOT_VERSION || snapshot.rate_buffer_size != RATE_BUFFER_SIZE) {
+        printf("Persistence: Saved state has another layout, starting cold.\n");
+        return result;
+    }
+
+    // An RTC that went backwards (lost on power down) gives no age; the
+    // gap is then counted as zero
+    uint64_t off_ms = 0;
+    if (rtc_s >= snapshot.saved_at_s) {
+        result.age_s = (int32_t)(rtc_s - snapshot.saved_at_s);
+        off_ms = (uint64_t)result.age_s * 1000U;
+    }
+
+    anomaly_detector_set_state(&snapshot.detector);
+
+    // The time off counts towards the statistics period. If the period ended
+    // meanwhile, carry on as the tracker would have: a full period has
+    // passed and the next one seeds its min/max with the next reading.
+    TempTrackerState tracker = snapshot.tracker;
+    uint64_t period_ms = (uint64_t)tracker.elapsed_ms + off_ms;
+    if (period_ms >= TEMP_STATS_PERIOD_MS) {
+        period_ms %= TEMP_STATS_PERIOD_MS;
+        tracker.valid = true;
+        tracker.first_reading = true;
+    }
+    tracker.elapsed_ms = (uint32_t)period_ms;
+    temp_tracker_set_state(&tracker);
+    result.restored = true;
+
+    printf("Persistence: Restored detector and tracker (saved %ld s ago).\n", (long)result.age_s);
+    return result;
+}
+
+bool persistence_save(uint32_t rtc_s) {
+    if (!persistence_ready) {
+        return false;
+    }
+    snapshot.version = STATE_SNAPSHOT_VERSION;
+    snapshot.rate_buffer_size = RATE_BUFFER_SIZE;
+    snapshot.saved_at_s = rtc_s;
+    anomaly_detector_get_state(&snapshot.detector);
+    temp_tracker_get_state(&snapshot.tracker);
+    since_save_ms = 0;
+    return record_store_save(&snapshot);
+}
+
+void persistence_update(uint32_t elapsed_ms, uint32_t rtc_s) {
+    since_save_ms += elapsed_ms;
+    if (since_save_ms >= STATE_SAVE_INTERVAL_MS) {
+        persistence_save(rtc_s);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "BlockDevice.h"
+#include "anomaly_detector.h"
+#include "temp_tracker.h"
+#include "record_store.h"
+
+// Snapshot of the learned state, saved to flash every STATE_SAVE_INTERVAL_MS
+// so a reset does not restart the detector's training and the tracker's
+// statistics period from scratch
+typedef struct {
+    uint16_t version;           // STATE_SNAPSHOT_VERSION
+    uint16_t rate_buffer_size;  // RATE_BUFFER_SIZE when saved
+    uint32_t saved_at_s;        // RTC time of the save
+    AnomalyDetectorState detector;
+    TempTrackerState tracker;
+} MonitorSnapshot;
+
+typedef struct {
+    bool restored;              // a snapshot was loaded
+    int32_t age_s;              // time since the snapshot, -1 if unknown
+} RestoreResult;
+
+// Opens the record log on bd; false leaves persistence disabled
+bool persistence_init(BlockDevice* bd);
+// Loads the newest snapshot into the detector and tracker (after their
+// _init()). rtc_s is the current RTC time: the time since the save counts
+// towards the tracker's statistics period, unless the RTC went backwards.
+RestoreResult persistence_restore(uint32_t rtc_s);
+// Called once per reading; saves when STATE_SAVE_INTERVAL_MS has passed
+void persistence_update(uint32_t elapsed_ms, uint32_t rtc_s);
+bool persistence_save(uint32_t rtc_s);
+
+#endif // PERSISTENCE_H
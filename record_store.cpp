@@ -0,0 +1,191 @@
+#include "record_store.h"
+#include "config.h"
+
+#define RECORD_MAGIC 0x52435244u // "RCRD"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;    // 1 for the first record, then incrementing
+    uint32_t length; // payload bytes
+    uint32_t crc;    // CRC-32 of seq, length and the payload
+} RecordHeader;
+
+typedef enum {
+    SLOT_BLANK,   // erased, can be programmed
+    SLOT_VALID,
+    SLOT_INVALID  // written but not a complete record, e.g. a torn save
+} SlotState;
+
+static BlockDevice* store_bd = nullptr;
+static uint32_t record_size = 0;
+static uint32_t slot_size = 0;
+static uint32_t erase_size = 0;
+static uint32_t slots_per_block = 0;
+static int erase_value = -1;
+static bool has_record = false;
+static uint32_t newest_slot = 0;
+static RecordStoreStats stats;
+
+// One slot, assembled or read back in place (no heap)
+static uint8_t slot_buffer[RECORD_STORE_MAX_SLOT_SIZE];
+
+// --- Helper Functions ---
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t record_crc(const RecordHeader* header, const uint8_t* payload) {
+    uint32_t crc = crc32_update(0, (const uint8_t*)&header->seq, sizeof(header->seq) + sizeof(header->length));
+    return crc32_update(crc, payload, header->length);
+}
+
+static bd_addr_t slot_address(uint32_t slot) {
+    return (bd_addr_t)(slot / slots_per_block) * erase_size + (bd_addr_t)(slot % slots_per_block) * slot_size;
+}
+
+// Reads the slot into slot_buffer and classifies it
+static SlotState read_slot(uint32_t slot, uint32_t* seq) {
+    if (store_bd->read(slot_buffer, slot_address(slot), slot_size) != 0) {
+        return SLOT_INVALID;
+    }
+
+    RecordHeader header;
+    memcpy(&header, slot_buffer, sizeof(header));
+    if (header.magic == RECORD_MAGIC && header.length == record_size &&
+            header.crc == record_crc(&header, slot_buffer + sizeof(header))) {
+        *seq = header.seq;
+        return SLOT_VALID;
+    }
+
+    // Without a defined erase value any slot that is not a record is writable
+    if (erase_value < 0) {
+        return SLOT_BLANK;
+    }
+    for (uint32_t i = 0; i < slot_size; i++) {
+        if (slot_buffer[i] != (uint8_t)erase_value) {
+            return SLOT_INVALID;
+        }
+    }
+    return SLOT_BLANK;
+}
+
+// Moves next_slot past slots that cannot be programmed. The first slot of an
+// erase block always qualifies: the block is erased before it is written.
+static void skip_unwritable_slots() {
+    uint32_t seq;
+    for (uint32_t n = 0; n < stats.slots; n++) {
+        if (stats.next_slot % slots_per_block == 0 || read_slot(stats.next_slot, &seq) == SLOT_BLANK) {
+            return;
+        }
+        stats.next_slot = (stats.next_slot + 1) % stats.slots;
+    }
+}
+// -----------------------
+
+bool record_store_init(BlockDevice* bd, uint32_t size) {
+    memset(&stats, 0, sizeof(stats));
+    store_bd = nullptr;
+    has_record = false;
+
+    if (!bd || bd->init() != 0) {
+        printf("Record Store Error: Block device init failed!\n");
+        return false;
+    }
+
+    uint32_t program_size = (uint32_t)bd->get_program_size();
+    erase_size = (uint32_t)bd->get_erase_size(0);
+    slot_size = sizeof(RecordHeader) + size;
+    slot_size = (slot_size + program_size - 1) / program_size * program_size;
+    if (slot_size > sizeof(slot_buffer) || slot_size > erase_size || bd->size() < 2 * (bd_size_t)erase_size) {
+        printf("Record Store Error: %lu byte records do not fit the device!\n", (unsigned long)size);
+        return false;
+    }
+
+    store_bd = bd;
+    record_size = size;
+    erase_value = bd->get_erase_value();
+    slots_per_block = erase_size / slot_size;
+    stats.slots = slots_per_block * (uint32_t)(bd->size() / erase_size);
+
+    // Find the newest valid record; the next save goes after it
+    for (uint32_t slot = 0; slot < stats.slots; slot++) {
+        uint32_t seq = 0;
+        SlotState state = read_slot(slot, &seq);
+        if (state == SLOT_VALID && (!has_record || seq > stats.last_seq)) {
+            has_record = true;
+            newest_slot = slot;
+            stats.last_seq = seq;
+        } else if (state == SLOT_INVALID) {
+            stats.invalid_slots++;
+        }
+    }
+    stats.next_slot = has_record ? (newest_slot + 1) % stats.slots : 0;
+    skip_unwritable_slots();
+
+    printf("Record Store Initialized: %lu slots of %lu bytes, %s (seq %lu)\n",
+           (unsigned long)stats.slots, (unsigned long)slot_size,
+           has_record ? "record found" : "empty", (unsigned long)stats.last_seq);
+    return true;
+}
+
+bool record_store_load(void* data) {
+    uint32_t seq;
+    if (!store_bd || !has_record || read_slot(newest_slot, &seq) != SLOT_VALID) {
+        return false;
+    }
+    memcpy(data, slot_buffer + sizeof(RecordHeader), record_size);
+    return true;
+}
+
+bool record_store_save(const void* data) {
+    if (!store_bd) {
+        return false;
+    }
+
+    // Entering an erase block: erase it. It holds the oldest records; the
+    // newest one is always in the block before.
+    uint32_t slot = stats.next_slot;
+    if (slot % slots_per_block == 0) {
+        if (store_bd->erase(slot_address(slot), erase_size) != 0) {
+            printf("Record Store Error: Erase failed!\n");
+            return false;
+        }
+        stats.erases++;
+    }
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.seq = stats.last_seq + 1;
+    header.length = record_size;
+    header.crc = record_crc(&header, (const uint8_t*)data);
+    memset(slot_buffer, erase_value < 0 ? 0xFF : erase_value, slot_size);
+    memcpy(slot_buffer, &header, sizeof(header));
+    memcpy(slot_buffer + sizeof(header), data, record_size);
+
+    // Whatever happens the slot has been used; a failed program leaves it
+    // to be skipped by the CRC check
+    stats.next_slot = (slot + 1) % stats.slots;
+    if (store_bd->program(slot_buffer, slot_address(slot), slot_size) != 0) {
+        printf("Record Store Error: Program failed!\n");
+        skip_unwritable_slots();
+        return false;
+    }
+
+    has_record = true;
+    newest_slot = slot;
+    stats.last_seq = header.seq;
+    stats.saves++;
+    skip_unwritable_slots();
+    return true;
+}
+
+RecordStoreStats record_store_get_stats() {
+    return stats;
+}
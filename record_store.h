@@ -0,0 +1,35 @@
+#ifndef RECORD_STORE_H
+#define RECORD_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "BlockDevice.h"
+
+// Append-only log of fixed-size records on a BlockDevice, for state that is
+// rewritten periodically. Each save goes to the next free slot, so the erase
+// blocks are used in turn and each is erased once per pass over the device.
+// Records carry a sequence number and a CRC-32; loading returns the newest
+// record that checks out, so a save torn by a reset leaves the previous one.
+// The device needs at least two erase blocks.
+
+// Largest slot (16-byte header + record, rounded up to the program size)
+#define RECORD_STORE_MAX_SLOT_SIZE 512
+
+typedef struct {
+    uint32_t saves;           // records written since record_store_init()
+    uint32_t erases;          // erase blocks erased since record_store_init()
+    uint32_t invalid_slots;   // slots found written but failing the check at init
+    uint32_t slots;           // record slots on the device
+    uint32_t next_slot;       // where the next save goes
+    uint32_t last_seq;        // sequence number of the newest record
+} RecordStoreStats;
+
+// Scans the device. record_size is the payload size of every record.
+// Returns false if the device cannot be used (too small, I/O error).
+bool record_store_init(BlockDevice* bd, uint32_t record_size);
+// Copies the newest valid record into data; false if there is none
+bool record_store_load(void* data);
+bool record_store_save(const void* data);
+RecordStoreStats record_store_get_stats();
+
+#endif // RECORD_STORE_H
@@ -0,0 +1,155 @@
+#include "sample_backlog.h"
+#include "config.h"
+#include "series_codec.h"
+
+// Channels of a compressed report
+enum {
+    BACKLOG_TEMPERATURE,
+    BACKLOG_HUMIDITY,
+    BACKLOG_PRESSURE,
+    BACKLOG_MIN_1H,
+    BACKLOG_MAX_1H,
+    BACKLOG_FLAGS,
+    BACKLOG_CHANNELS
+};
+
+#define FLAG_TEMP_VALID 0x01
+#define FLAG_HUMIDITY_VALID 0x02
+#define FLAG_PRESSURE_VALID 0x04
+#define FLAG_STATS_VALID 0x08
+#define FLAG_ANOMALOUS 0x10
+
+static uint8_t blocks[SAMPLE_BACKLOG_BLOCKS][SAMPLE_BACKLOG_BLOCK_SIZE];
+static uint16_t head = 0;       // oldest block
+static uint16_t used = 0;       // blocks in use, the newest being appended to
+static SeriesEncoder tail;
+static SeriesDecoder reader;    // in the oldest block
+static uint16_t head_popped;    // reports of the oldest block already published
+static BacklogSample peeked;    // decoded, not yet popped
+static bool peeked_ready;
+static SampleBacklogStats stats;
+
+static void start_reading(uint16_t block) {
+    series_decoder_init(&reader, blocks[block], SAMPLE_BACKLOG_BLOCK_SIZE);
+    head_popped = 0;
+    peeked_ready = false;
+}
+
+static void start_block() {
+    uint16_t block = (head + used) % SAMPLE_BACKLOG_BLOCKS;
+    series_encoder_init(&tail, blocks[block], SAMPLE_BACKLOG_BLOCK_SIZE, BACKLOG_CHANNELS);
+    if (used == 0) {
+        start_reading(block);
+    }
+    used++;
+}
+
+static void drop_oldest_block() {
+    uint16_t left = series_block_count(blocks[head]) - head_popped;
+    stats.depth -= left;
+    stats.dropped += left;
+    head = (head + 1) % SAMPLE_BACKLOG_BLOCKS;
+    used--;
+    start_reading(head);
+}
+
+// Every block but the newest counts as full
+static uint16_t bytes_in_use() {
+    return used ? (uint16_t)((used - 1) * SAMPLE_BACKLOG_BLOCK_SIZE + series_encoder_bytes(&tail)) : 0;
+}
+
+void sample_backlog_init() {
+    head = 0;
+    used = 0;
+    peeked_ready = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void sample_backlog_push(uint32_t now_ms, const SensorData& data, const TempStats1Hour& temp_stats, const AnomalyStatus& anomaly) {
+    int32_t values[BACKLOG_CHANNELS];
+    values[BACKLOG_TEMPERATURE] = series_scale(data.temperature);
+    values[BACKLOG_HUMIDITY] = series_scale(data.humidity);
+    values[BACKLOG_PRESSURE] = series_scale(data.pressure);
+    values[BACKLOG_MIN_1H] = series_scale(temp_stats.min_temp);
+    values[BACKLOG_MAX_1H] = series_scale(temp_stats.max_temp);
+    values[BACKLOG_FLAGS] = (data.temp_valid ? FLAG_TEMP_VALID : 0) |
+                            (data.humidity_valid ? FLAG_HUMIDITY_VALID : 0) |
+                            (data.pressure_valid ? FLAG_PRESSURE_VALID : 0) |
+                            (temp_stats.valid ? FLAG_STATS_VALID : 0) |
+                            (anomaly.is_anomalous ? FLAG_ANOMALOUS : 0);
+
+    if (used == 0) {
+        start_block();
+    }
+    if (!series_encoder_append(&tail, now_ms, values)) {
+        if (used == SAMPLE_BACKLOG_BLOCKS) {
+            // Full: the newest reports are worth more than the oldest
+            drop_oldest_block();
+        }
+        start_block();
+        series_encoder_append(&tail, now_ms, values);
+    }
+    stats.depth++;
+    stats.buffered++;
+    if (stats.depth > stats.max_depth) {
+        stats.max_depth = stats.depth;
+    }
+}
+
+bool sample_backlog_peek(BacklogSample* sample) {
+    if (stats.depth == 0) {
+        return false;
+    }
+    if (!peeked_ready) {
+        uint32_t taken_ms;
+        int32_t values[BACKLOG_CHANNELS];
+        if (!series_decoder_next(&reader, &taken_ms, values)) {
+            return false;
+        }
+        int32_t flags = values[BACKLOG_FLAGS];
+        memset(&peeked, 0, sizeof(peeked));
+        peeked.taken_ms = taken_ms;
+        peeked.data.temperature = series_unscale(values[BACKLOG_TEMPERATURE]);
+        peeked.data.humidity = series_unscale(values[BACKLOG_HUMIDITY]);
+        peeked.data.pressure = series_unscale(values[BACKLOG_PRESSURE]);
+        peeked.data.temp_valid = flags & FLAG_TEMP_VALID;
+        peeked.data.humidity_valid = flags & FLAG_HUMIDITY_VALID;
+        peeked.data.pressure_valid = flags & FLAG_PRESSURE_VALID;
+        peeked.stats.min_temp = series_unscale(values[BACKLOG_MIN_1H]);
+        peeked.stats.max_temp = series_unscale(values[BACKLOG_MAX_1H]);
+        peeked.stats.valid = flags & FLAG_STATS_VALID;
+        peeked.anomaly.is_anomalous = flags & FLAG_ANOMALOUS;
+        peeked_ready = true;
+    }
+    *sample = peeked;
+    return true;
+}
+
+void sample_backlog_pop() {
+    BacklogSample skipped;
+    if (!peeked_ready && !sample_backlog_peek(&skipped)) {
+        return;
+    }
+    peeked_ready = false;
+    stats.depth--;
+    head_popped++;
+    if (stats.depth == 0) {
+        // Empty: start again from a fresh block
+        used = 0;
+    } else if (head_popped == series_block_count(blocks[head]) && used > 1) {
+        head = (head + 1) % SAMPLE_BACKLOG_BLOCKS;
+        used--;
+        start_reading(head);
+    }
+}
+
+uint16_t sample_backlog_depth() {
+    return stats.depth;
+}
+
+SampleBacklogStats sample_backlog_get_stats() {
+    SampleBacklogStats current = stats;
+    current.blocks = used;
+    current.bytes = bytes_in_use();
+    return current;
+}
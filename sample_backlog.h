@@ -0,0 +1,41 @@
+#ifndef SAMPLE_BACKLOG_H
+#define SAMPLE_BACKLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensors.h"
+#include "temp_tracker.h"
+#include "anomaly_detector.h"
+
+// Reports taken while there is no MQTT session (during boot, while WiFi
+// associates, or while reconnecting), kept until they can be published.
+// They are compressed (series_codec.h) into a ring of SAMPLE_BACKLOG_BLOCKS
+// blocks; when all are full the oldest block of reports is dropped. Only
+// what the data message carries is kept, to its resolution of 0.01: a
+// report comes back with the same payload, but without the detector's mean
+// and standard deviation.
+typedef struct {
+    uint32_t taken_ms;  // caller's clock when the reading was taken
+    SensorData data;
+    TempStats1Hour stats;
+    AnomalyStatus anomaly;
+} BacklogSample;
+
+typedef struct {
+    uint32_t buffered;   // reports pushed since sample_backlog_init()
+    uint32_t dropped;    // oldest reports overwritten when full
+    uint16_t depth;
+    uint16_t max_depth;
+    uint16_t blocks;     // blocks in use
+    uint16_t bytes;      // compressed bytes in use
+} SampleBacklogStats;
+
+void sample_backlog_init();
+void sample_backlog_push(uint32_t now_ms, const SensorData& data, const TempStats1Hour& stats, const AnomalyStatus& anomaly);
+// Oldest report, left in place until sample_backlog_pop(); false if empty
+bool sample_backlog_peek(BacklogSample* sample);
+void sample_backlog_pop();
+uint16_t sample_backlog_depth();
+SampleBacklogStats sample_backlog_get_stats();
+
+#endif // SAMPLE_BACKLOG_H
@@ -0,0 +1,15 @@
+#ifndef SAMPLE_HISTORY_H
+#define SAMPLE_HISTORY_H
+
+// The channels of a reading as the history compresses it (series_codec.h):
+// one sample per reading, in the records on QSPI (history_store.h) and the
+// chunks of a history query (history_query.h).
+enum {
+    SAMPLE_HISTORY_TEMPERATURE,     // degC * SERIES_SCALE
+    SAMPLE_HISTORY_HUMIDITY,        // %rH * SERIES_SCALE
+    SAMPLE_HISTORY_PRESSURE,        // hPa * SERIES_SCALE
+    SAMPLE_HISTORY_VALID,           // bit 0 temperature, 1 humidity, 2 pressure
+    SAMPLE_HISTORY_CHANNELS
+};
+
+#endif // SAMPLE_HISTORY_H
@@ -0,0 +1,131 @@
+#include "sampling.h"
+#include "config.h"
+#include <cmath> // For fabsf()
+
+// Internal state for the sampling controller
+static uint32_t slow_interval_ms = SENSOR_UPDATE_INTERVAL_MS;
+static uint32_t fast_hold_remaining_ms = 0;
+static float flat_band_start_temp = 0.0f;
+static int flat_sample_count = 0;
+static uint32_t flat_band_elapsed_ms = 0;
+static uint32_t flat_check_elapsed_ms = 0;
+static bool has_flat_band = false;
+static SamplingMode current_mode = SAMPLING_NOMINAL;
+
+static uint32_t since_report_ms = 0;
+static bool reported_anomalous = false;
+static int reported_level = 0;
+static bool has_reported = false;
+
+static bool near_threshold(float temp) {
+    return fabsf(temp - TEMP_THRESHOLD_HIGH) < SAMPLING_THRESHOLD_MARGIN ||
+           fabsf(temp - TEMP_THRESHOLD_CRITICAL) < SAMPLING_THRESHOLD_MARGIN ||
+           fabsf(temp - TEMP_THRESHOLD_LOW) < SAMPLING_THRESHOLD_MARGIN;
+}
+
+// -1 below LOW, 0 normal, 1 above HIGH, 2 above CRITICAL. A reading only
+// drops out of a level once it is REPORT_THRESHOLD_HYSTERESIS inside it.
+static int threshold_level(float temp, int previous_level) {
+    float h = REPORT_THRESHOLD_HYSTERESIS;
+    if (temp > TEMP_THRESHOLD_CRITICAL || (previous_level == 2 && temp > TEMP_THRESHOLD_CRITICAL - h)) return 2;
+    if (temp > TEMP_THRESHOLD_HIGH || (previous_level >= 1 && temp > TEMP_THRESHOLD_HIGH - h)) return 1;
+    if (temp < TEMP_THRESHOLD_LOW || (previous_level == -1 && temp < TEMP_THRESHOLD_LOW + h)) return -1;
+    return 0;
+}
+
+void sampling_init() {
+    slow_interval_ms = SENSOR_UPDATE_INTERVAL_MS;
+    fast_hold_remaining_ms = 0;
+    flat_band_start_temp = 0.0f;
+    flat_sample_count = 0;
+    flat_band_elapsed_ms = 0;
+    flat_check_elapsed_ms = 0;
+    has_flat_band = false;
+    current_mode = SAMPLING_NOMINAL;
+    since_report_ms = 0;
+    reported_anomalous = false;
+    reported_level = 0;
+    has_reported = false;
+    printf("Sampling Controller Initialized (%s).\n", ADAPTIVE_SAMPLING ? "adaptive" : "fixed");
+}
+
+uint32_t sampling_update(float current_temp, bool is_anomalous, uint32_t elapsed_ms) {
+#if !ADAPTIVE_SAMPLING
+    (void)current_temp;
+    (void)is_anomalous;
+    (void)elapsed_ms;
+    return SENSOR_UPDATE_INTERVAL_MS;
+#else
+    // 1. Flat detection: count readings inside the band, restart it when left.
+    // Checked at most once per nominal interval so that fast sampling does
+    // not give sensor noise more chances to leave the band.
+    flat_check_elapsed_ms += elapsed_ms;
+    if (!has_flat_band || flat_check_elapsed_ms >= SENSOR_UPDATE_INTERVAL_MS) {
+        if (!has_flat_band || fabsf(current_temp - flat_band_start_temp) > SAMPLING_FLAT_BAND) {
+            flat_band_start_temp = current_temp;
+            has_flat_band = true;
+            flat_sample_count = 0;
+            flat_band_elapsed_ms = 0;
+            slow_interval_ms = SENSOR_UPDATE_INTERVAL_MS; // Signal moved: back to the nominal rate
+        } else {
+            flat_sample_count++;
+            flat_band_elapsed_ms += flat_check_elapsed_ms;
+        }
+        flat_check_elapsed_ms = 0;
+    }
+
+    // 2. Fast sampling: triggered by an anomaly, or by the temperature moving
+    // near a threshold (sitting flat next to one is not worth the power), and
+    // held for a while after the trigger
+    bool moving = flat_band_elapsed_ms < SAMPLING_FAST_HOLD_MS;
+    if (is_anomalous || (moving && near_threshold(current_temp))) {
+        fast_hold_remaining_ms = SAMPLING_FAST_HOLD_MS;
+    } else if (fast_hold_remaining_ms > elapsed_ms) {
+        fast_hold_remaining_ms -= elapsed_ms;
+    } else {
+        fast_hold_remaining_ms = 0;
+    }
+
+    if (fast_hold_remaining_ms > 0) {
+        flat_sample_count = 0;
+        current_mode = SAMPLING_FAST;
+        return SAMPLE_INTERVAL_MIN_MS;
+    }
+
+    // 3. Back off while flat, doubling the interval up to the maximum
+    if (flat_sample_count >= SAMPLING_FLAT_SAMPLES) {
+        flat_sample_count = 0;
+        slow_interval_ms = slow_interval_ms * 2;
+        if (slow_interval_ms > SAMPLE_INTERVAL_MAX_MS) slow_interval_ms = SAMPLE_INTERVAL_MAX_MS;
+    }
+
+    current_mode = slow_interval_ms > SENSOR_UPDATE_INTERVAL_MS ? SAMPLING_SLOW : SAMPLING_NOMINAL;
+    return slow_interval_ms;
+#endif
+}
+
+bool sampling_report_due(float current_temp, bool is_anomalous, uint32_t elapsed_ms) {
+    since_report_ms += elapsed_ms;
+    int level = threshold_level(current_temp, reported_level);
+    bool due = !has_reported || since_report_ms >= MQTT_PUBLISH_MIN_INTERVAL_MS ||
+               is_anomalous != reported_anomalous || level != reported_level;
+    if (due) {
+        since_report_ms = 0;
+        reported_anomalous = is_anomalous;
+        reported_level = level;
+        has_reported = true;
+    }
+    return due;
+}
+
+SamplingMode sampling_get_mode() {
+    return current_mode;
+}
+
+const char* sampling_mode_name(SamplingMode mode) {
+    switch (mode) {
+        case SAMPLING_FAST: return "fast";
+        case SAMPLING_SLOW: return "slow";
+        default:            return "nominal";
+    }
+}
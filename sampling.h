@@ -0,0 +1,24 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    SAMPLING_FAST,     // near a threshold or anomalous: SAMPLE_INTERVAL_MIN_MS
+    SAMPLING_NOMINAL,  // SENSOR_UPDATE_INTERVAL_MS
+    SAMPLING_SLOW      // flat signal: backing off towards SAMPLE_INTERVAL_MAX_MS
+} SamplingMode;
+
+void sampling_init();
+// Feed the latest reading, the detector's decision and the time since the
+// previous reading; returns the interval to wait before the next reading
+uint32_t sampling_update(float current_temp, bool is_anomalous, uint32_t elapsed_ms);
+// Whether this reading should go to the display and the broker: one per
+// MQTT_PUBLISH_MIN_INTERVAL_MS, plus any reading that changes the anomaly
+// flag or crosses a temperature threshold. Call once per reading.
+bool sampling_report_due(float current_temp, bool is_anomalous, uint32_t elapsed_ms);
+SamplingMode sampling_get_mode();
+const char* sampling_mode_name(SamplingMode mode);
+
+#endif // SAMPLING_H
@@ -7,6 +7,7 @@
 static DevI2C devI2c(I2C_SDA, I2C_SCL);
 static HTS221Sensor hts221_sensor(&devI2c);
 static LPS22HBSensor lps22hb_sensor(&devI2c);
+static float requested_odr = 0.0f; // Last rate passed to set_odr(), 0 = driver default
 
 void sensors_init() {
     printf("Initializing Sensors...\n");
@@ -17,6 +18,7 @@ void sensors_init() {
     // Initialize LPS22HB (Pressure)
     lps22hb_sensor.init(nullptr);
     lps22hb_sensor.enable();
+    requested_odr = 0.0f; // init() restored the drivers' default rates
 
     uint8_t id;
     hts221_sensor.read_id(&id);
@@ -48,4 +50,19 @@ SensorData sensors_read() {
     }
 
     return data;
-}
\ No newline at end of file
+}
+
+void sensors_set_interval_ms(uint32_t interval_ms) {
+    // Both drivers round the requested rate up to the next one the part supports
+    float odr = interval_ms > 0 ? 1000.0f / interval_ms : 1000.0f;
+    if (odr < 1.0f) odr = 1.0f;
+    if (odr == requested_odr) return;
+    requested_odr = odr;
+
+    if (hts221_sensor.set_odr(odr) != 0) {
+        printf("Error setting HTS221 ODR!\n");
+    }
+    if (lps22hb_sensor.set_odr(odr) != 0) {
+        printf("Error setting LPS22HB ODR!\n");
+    }
+}
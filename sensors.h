@@ -1,6 +1,8 @@
 #ifndef SENSORS_H
 #define SENSORS_H
 
+#include <stdint.h>
+
 // Sensor data structure
 typedef struct {
     float temperature;
@@ -14,5 +16,8 @@ typedef struct {
 // Function prototypes
 void sensors_init();
 SensorData sensors_read();
+// Set the sensors' output data rates to the slowest that still gives a fresh
+// conversion for every read at this interval
+void sensors_set_interval_ms(uint32_t interval_ms);
 
 #endif // SENSORS_H
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "series_codec.h"
+#include <math.h>
+#include <string.h>
+
+// Payload bits of the four non-zero buckets (see series_codec.h)
+static const uint8_t time_bits[4] = {7, 9, 12, 32};
+static const uint8_t value_bits[4] = {3, 6, 12, 32};
+
+static uint32_t zigzag(uint32_t v) {
+    return (v << 1) ^ (uint32_t)((int32_t)v >> 31);
+}
+
+static uint32_t unzigzag(uint32_t z) {
+    return (z >> 1) ^ (0u - (z & 1));
+}
+
+// -1 for zero, else the smallest bucket that holds z
+static int bucket_of(uint32_t z, const uint8_t* bits) {
+    if (z == 0) {
+        return -1;
+    }
+    for (int b = 0; b < 3; b++) {
+        if (z < (1u << bits[b])) {
+            return b;
+        }
+    }
+    return 3;
+}
+
+static uint32_t code_length(int bucket, const uint8_t* bits) {
+    if (bucket < 0) {
+        return 1;
+    }
+    return (bucket < 3 ? bucket + 2 : 4) + bits[bucket];
+}
+
+// The block is zeroed when it is started, so bits are only ever set
+static void put_bits(uint8_t* data, uint32_t* pos, uint32_t value, uint32_t n) {
+    while (n > 0) {
+        uint32_t free_bits = 8 - (*pos & 7);
+        uint32_t take = n < free_bits ? n : free_bits;
+        uint32_t chunk = (value >> (n - take)) & ((1u << take) - 1);
+        data[*pos >> 3] |= (uint8_t)(chunk << (free_bits - take));
+        *pos += take;
+        n -= take;
+    }
+}
+
+static void put_code(uint8_t* data, uint32_t* pos, int bucket, uint32_t z, const uint8_t* bits) {
+    if (bucket < 0) {
+        put_bits(data, pos, 0, 1);
+    } else if (bucket < 3) {
+        put_bits(data, pos, (1u << (bucket + 2)) - 2, bucket + 2);
+        put_bits(data, pos, z, bits[bucket]);
+    } else {
+        put_bits(data, pos, 0xF, 4);
+        put_bits(data, pos, z, 32);
+    }
+}
+
+static bool get_bits(SeriesDecoder* dec, uint32_t n, uint32_t* value) {
+    if (dec->bits + n > (uint32_t)dec->size * 8) {
+        return false;
+    }
+    uint32_t v = 0;
+    while (n > 0) {
+        uint32_t avail = 8 - (dec->bits & 7);
+        uint32_t take = n < avail ? n : avail;
+        uint32_t byte = dec->data[dec->bits >> 3];
+        v = (v << take) | ((byte >> (avail - take)) & ((1u << take) - 1));
+        dec->bits += take;
+        n -= take;
+    }
+    *value = v;
+    return true;
+}
+
+static bool get_code(SeriesDecoder* dec, const uint8_t* bits, uint32_t* z) {
+    int bucket = 0;
+    uint32_t bit;
+    // Up to four prefix bits: the number of leading ones picks the bucket
+    for (;;) {
+        if (!get_bits(dec, 1, &bit)) {
+            return false;
+        }
+        if (!bit) {
+            break;
+        }
+        if (++bucket == 4) {
+            break;
+        }
+    }
+    if (bucket == 0) {
+        *z = 0;
+        return true;
+    }
+    return get_bits(dec, bits[bucket - 1], z);
+}
+
+static void write_count(uint8_t* data, uint16_t count) {
+    data[0] = (uint8_t)count;
+    data[1] = (uint8_t)(count >> 8);
+}
+
+void series_encoder_init(SeriesEncoder* enc, uint8_t* data, uint16_t size, uint8_t channels) {
+    memset(enc, 0, sizeof(*enc));
+    memset(data, 0, size);
+    enc->data = data;
+    enc->size = size;
+    enc->channels = channels > SERIES_MAX_CHANNELS ? SERIES_MAX_CHANNELS : channels;
+    data[2] = enc->channels;
+    data[3] = SERIES_CODEC_VERSION;
+    enc->bits = SERIES_BLOCK_HEADER_SIZE * 8;
+}
+
+bool series_encoder_append(SeriesEncoder* enc, uint32_t t_ms, const int32_t* values) {
+    // Size the sample first so a full block is left untouched
+    uint32_t interval = t_ms - enc->last_ms;
+    uint32_t time_z = zigzag(interval - enc->last_interval_ms);
+    int time_bucket = bucket_of(time_z, time_bits);
+    uint32_t length = enc->count == 0 ? 32 : code_length(time_bucket, time_bits);
+
+    uint32_t value_z[SERIES_MAX_CHANNELS];
+    int value_bucket[SERIES_MAX_CHANNELS];
+    for (uint8_t c = 0; c < enc->channels; c++) {
+        value_z[c] = zigzag((uint32_t)values[c] - enc->last[c]);
+        value_bucket[c] = bucket_of(value_z[c], value_bits);
+        length += code_length(value_bucket[c], value_bits);
+    }
+    if (enc->bits + length > (uint32_t)enc->size * 8 || enc->count == UINT16_MAX) {
+        return false;
+    }
+
+    if (enc->count == 0) {
+        put_bits(enc->data, &enc->bits, t_ms, 32);
+    } else {
+        put_code(enc->data, &enc->bits, time_bucket, time_z, time_bits);
+        enc->last_interval_ms = interval;
+    }
+    enc->last_ms = t_ms;
+    for (uint8_t c = 0; c < enc->channels; c++) {
+        put_code(enc->data, &enc->bits, value_bucket[c], value_z[c], value_bits);
+        enc->last[c] = (uint32_t)values[c];
+    }
+    enc->count++;
+    write_count(enc->data, enc->count);
+    return true;
+}
+
+uint16_t series_encoder_bytes(const SeriesEncoder* enc) {
+    return (uint16_t)((enc->bits + 7) / 8);
+}
+
+bool series_decoder_init(SeriesDecoder* dec, const uint8_t* data, uint16_t size) {
+    memset(dec, 0, sizeof(*dec));
+    if (size < SERIES_BLOCK_HEADER_SIZE || data[3] != SERIES_CODEC_VERSION || data[2] > SERIES_MAX_CHANNELS) {
+        return false;
+    }
+    dec->data = data;
+    dec->size = size;
+    dec->channels = data[2];
+    dec->bits = SERIES_BLOCK_HEADER_SIZE * 8;
+    return true;
+}
+
+bool series_decoder_next(SeriesDecoder* dec, uint32_t* t_ms, int32_t* values) {
+    // The count is read each time: the block may still be growing
+    if (!dec->data || dec->index >= series_block_count(dec->data)) {
+        return false;
+    }
+    uint32_t z;
+    if (dec->index == 0) {
+        if (!get_bits(dec, 32, &dec->last_ms)) {
+            return false;
+        }
+    } else {
+        if (!get_code(dec, time_bits, &z)) {
+            return false;
+        }
+        dec->last_interval_ms += unzigzag(z);
+        dec->last_ms += dec->last_interval_ms;
+    }
+    for (uint8_t c = 0; c < dec->channels; c++) {
+        if (!get_code(dec, value_bits, &z)) {
+            return false;
+        }
+        dec->last[c] += unzigzag(z);
+        values[c] = (int32_t)dec->last[c];
+    }
+    *t_ms = dec->last_ms;
+    dec->index++;
+    return true;
+}
+
+uint16_t series_block_count(const uint8_t* data) {
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+int32_t series_scale(float value) {
+    float scaled = value * SERIES_SCALE;
+    // NaN and absurd readings are kept as 0
+    if (!(scaled > -2.0e9f && scaled < 2.0e9f)) {
+        return 0;
+    }
+    return (int32_t)lrintf(scaled);
+}
+
+float series_unscale(int32_t value) {
+    return (float)value / SERIES_SCALE;
+}
@@ -0,0 +1,86 @@
+#ifndef SERIES_CODEC_H
+#define SERIES_CODEC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Streaming compression for slow-moving sensor series, in fixed-size blocks.
+// A sample is a timestamp and up to SERIES_MAX_CHANNELS integer values
+// (readings scaled by SERIES_SCALE, flags as small integers).
+//
+// Each block starts with a 4-byte header (sample count, little-endian, the
+// channel count and SERIES_CODEC_VERSION) and is followed by a bit stream,
+// most significant bit first. The first timestamp is stored as 32 bits; after
+// that, the change in the interval between samples (delta of delta) is coded
+// as
+//   0                      same interval
+//   10   + 7 bits          within -64..63 ms
+//   110  + 9 bits          within -256..255 ms
+//   1110 + 12 bits         within -2048..2047 ms
+//   1111 + 32 bits         anything else
+// and every value as its change from the previous sample in the block
+// (the first against 0), zigzag coded, then
+//   0                      unchanged
+//   10   + 3 bits          within -4..3
+//   110  + 6 bits          within -32..31
+//   1110 + 12 bits         within -2048..2047
+//   1111 + 32 bits         anything else
+// A steady indoor reading costs 1 bit for the time and a few per value,
+// against 32 each uncompressed. Arithmetic wraps at 32 bits, so a clock that
+// rolls over is coded exactly.
+//
+// A block decodes on its own, without the encoder's state. The header is
+// kept current as samples are appended, so a block can be read while it is
+// still being filled.
+
+#define SERIES_CODEC_VERSION 1
+#define SERIES_MAX_CHANNELS 8
+#define SERIES_BLOCK_HEADER_SIZE 4
+// Readings are kept to the resolution of the data message (two decimals)
+#define SERIES_SCALE 100.0f
+
+typedef struct {
+    uint8_t* data;
+    uint16_t size;          // bytes, header included
+    uint8_t channels;
+    uint16_t count;         // samples in the block
+    uint32_t bits;          // bits used, header included
+    uint32_t last_ms;
+    uint32_t last_interval_ms;
+    uint32_t last[SERIES_MAX_CHANNELS];
+} SeriesEncoder;
+
+typedef struct {
+    const uint8_t* data;
+    uint16_t size;
+    uint8_t channels;
+    uint16_t index;         // samples decoded
+    uint32_t bits;          // bits read, header included
+    uint32_t last_ms;
+    uint32_t last_interval_ms;
+    uint32_t last[SERIES_MAX_CHANNELS];
+} SeriesDecoder;
+
+// Starts an empty block in data, which must stay valid while it is in use
+void series_encoder_init(SeriesEncoder* enc, uint8_t* data, uint16_t size, uint8_t channels);
+// Adds one sample; false, leaving the block as it was, if it does not fit.
+// Any sample fits an empty block of at least SERIES_BLOCK_MIN_SIZE(channels).
+bool series_encoder_append(SeriesEncoder* enc, uint32_t t_ms, const int32_t* values);
+// Bytes of the block in use so far
+uint16_t series_encoder_bytes(const SeriesEncoder* enc);
+
+#define SERIES_BLOCK_MIN_SIZE(channels) (SERIES_BLOCK_HEADER_SIZE + (32 + 36 * (channels) + 7) / 8)
+
+// False if data does not hold a block of this version
+bool series_decoder_init(SeriesDecoder* dec, const uint8_t* data, uint16_t size);
+// Next sample, oldest first; false once the block is exhausted or if it is
+// corrupt (the stream runs past size)
+bool series_decoder_next(SeriesDecoder* dec, uint32_t* t_ms, int32_t* values);
+// Samples in a block, from its header
+uint16_t series_block_count(const uint8_t* data);
+
+// A reading in units of 1/SERIES_SCALE, and back
+int32_t series_scale(float value);
+float series_unscale(int32_t value);
+
+#endif // SERIES_CODEC_H
@@ -0,0 +1,63 @@
+#include "system_stats.h"
+#include "mbed_stats.h"
+#include <string.h>
+
+#if !MBED_HEAP_STATS_ENABLED || !MBED_STACK_STATS_ENABLED || !MBED_CPU_STATS_ENABLED
+#error "system_stats needs platform.heap-stats-enabled, stack-stats-enabled and cpu-stats-enabled in mbed_app.json"
+#endif
+
+// CPU times at the previous sample, in us
+static uint64_t last_uptime_us = 0;
+static uint64_t last_idle_us = 0;
+
+// mbed_stats_stack_get_each() and mbed_stats_thread_get_each() malloc a
+// thread list on every call, which would trip NO_HEAP_AFTER_INIT; the
+// threads are enumerated into this array instead.
+static osThreadId_t thread_ids[SYSTEM_STATS_MAX_THREADS];
+
+void system_stats_init() {
+    mbed_stats_cpu_t cpu;
+    mbed_stats_cpu_get(&cpu);
+    last_uptime_us = cpu.uptime;
+    last_idle_us = cpu.idle_time;
+    printf("System Stats Initialized.\n");
+}
+
+SystemStats system_stats_sample() {
+    SystemStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    // 1. CPU idle share since the previous sample
+    mbed_stats_cpu_t cpu;
+    mbed_stats_cpu_get(&cpu);
+    uint64_t elapsed_us = cpu.uptime - last_uptime_us;
+    uint64_t idle_us = cpu.idle_time - last_idle_us;
+    stats.uptime_s = (uint32_t)(cpu.uptime / 1000000);
+    stats.cpu_idle_pct = elapsed_us > 0 ? (uint8_t)(idle_us * 100 / elapsed_us) : 100;
+    last_uptime_us = cpu.uptime;
+    last_idle_us = cpu.idle_time;
+
+    // 2. Heap
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    stats.heap_current = heap.current_size;
+    stats.heap_max = heap.max_size;
+    stats.heap_reserved = heap.reserved_size;
+    stats.heap_alloc_fail = heap.alloc_fail_cnt;
+
+    // 3. Stack high-water mark of each thread (RTX stack watermarking is
+    // enabled together with stack stats)
+    osKernelLock();
+    uint32_t count = osThreadEnumerate(thread_ids, SYSTEM_STATS_MAX_THREADS);
+    for (uint32_t i = 0; i < count; i++) {
+        ThreadStackStats& t = stats.threads[i];
+        const char* name = osThreadGetName(thread_ids[i]);
+        strncpy(t.name, name ? name : "?", sizeof(t.name) - 1);
+        t.stack_size = osThreadGetStackSize(thread_ids[i]);
+        t.stack_used = t.stack_size - osThreadGetStackSpace(thread_ids[i]);
+    }
+    osKernelUnlock();
+    stats.thread_count = (uint8_t)count;
+
+    return stats;
+}
@@ -0,0 +1,28 @@
+#ifndef SYSTEM_STATS_H
+#define SYSTEM_STATS_H
+
+#include <stdint.h>
+#include "config.h"
+
+typedef struct {
+    char name[12];        // thread name, truncated
+    uint32_t stack_size;  // bytes reserved
+    uint32_t stack_used;  // high-water mark in bytes
+} ThreadStackStats;
+
+typedef struct {
+    uint32_t uptime_s;
+    uint8_t cpu_idle_pct;    // share of the time since the previous sample spent idle
+    uint32_t heap_current;   // bytes allocated now
+    uint32_t heap_max;       // high-water mark of heap_current
+    uint32_t heap_reserved;  // size of the heap region
+    uint32_t heap_alloc_fail;
+    uint8_t thread_count;    // entries used in threads[]
+    ThreadStackStats threads[SYSTEM_STATS_MAX_THREADS];
+} SystemStats;
+
+void system_stats_init();
+// Takes a new sample; the CPU idle share covers the time since the previous one
+SystemStats system_stats_sample();
+
+#endif // SYSTEM_STATS_H
@@ -1,52 +1,60 @@
 #include "temp_tracker.h"
 #include "config.h"
-#include <limits> // For infinity()
 
-static float max_temp_current_hour = -std::numeric_limits<float>::infinity();
-static float min_temp_current_hour = std::numeric_limits<float>::infinity();
-static int sample_count_current_hour = 0;
-static bool stats_are_valid = false;
-static bool first_reading_in_hour = true;
+TempTracker::TempTracker() {
+    reset();
+}
 
-void temp_tracker_init() {
-    max_temp_current_hour = -std::numeric_limits<float>::infinity();
-    min_temp_current_hour = std::numeric_limits<float>::infinity();
-    sample_count_current_hour = 0;
-    stats_are_valid = false;
-    first_reading_in_hour = true;
-    printf("Temperature Tracker Initialized.\n");
+void TempTracker::reset() {
+    temp_core_reset(_core);
 }
 
-void temp_tracker_update(float current_temp) {
-    if (first_reading_in_hour) {
-        // Seed the min/max with the first reading of the hour
-        min_temp_current_hour = current_temp;
-        max_temp_current_hour = current_temp;
-        first_reading_in_hour = false;
-    } else {
-        // Update normally
-        if (current_temp > max_temp_current_hour) max_temp_current_hour = current_temp;
-        if (current_temp < min_temp_current_hour) min_temp_current_hour = current_temp;
-    }
+bool TempTracker::update(float value, uint32_t elapsed_ms) {
+    return temp_core_update(_core, value, elapsed_ms);
+}
 
-    sample_count_current_hour++;
+TempStats1Hour TempTracker::get_stats() const {
+    return temp_core_get_stats(_core);
+}
 
-    // Check if the hour has passed
-    if (sample_count_current_hour >= SAMPLES_PER_HOUR) {
-        printf("--- HOURLY MIN/MAX RESET ---\n");
-        // Reset counters and stats for the new hour
-        sample_count_current_hour = 0;
-        stats_are_valid = true; // Stats from the *previous* full hour are now valid
-        first_reading_in_hour = true; // Next reading will seed the new hour
+void TempTracker::get_state(TempTrackerState* state) const {
+    state->min_temp = _core.min_temp_current_hour;
+    state->max_temp = _core.max_temp_current_hour;
+    state->elapsed_ms = _core.elapsed_ms_current_hour;
+    state->valid = _core.stats_are_valid;
+    state->first_reading = _core.first_reading_in_hour;
+}
+
+void TempTracker::set_state(const TempTrackerState* state) {
+    _core.min_temp_current_hour = state->min_temp;
+    _core.max_temp_current_hour = state->max_temp;
+    _core.elapsed_ms_current_hour = state->elapsed_ms;
+    _core.stats_are_valid = state->valid;
+    _core.first_reading_in_hour = state->first_reading;
+}
+
+// --- Default instance ---
+static TempTracker tracker;
 
-        // Note: min/max are reset implicitly by the first_reading_in_hour flag logic
+void temp_tracker_init() {
+    tracker.reset();
+    printf("Temperature Tracker Initialized.\n");
+}
+
+void temp_tracker_update(float current_temp, uint32_t elapsed_ms) {
+    if (tracker.update(current_temp, elapsed_ms)) {
+        printf("--- HOURLY MIN/MAX RESET ---\n");
     }
 }
 
 TempStats1Hour temp_tracker_get_stats() {
-    TempStats1Hour stats;
-    stats.min_temp = min_temp_current_hour;
-    stats.max_temp = max_temp_current_hour;
-    stats.valid = stats_are_valid; // Report if we have completed at least one full hour
-    return stats;
-}
\ No newline at end of file
+    return tracker.get_stats();
+}
+
+void temp_tracker_get_state(TempTrackerState* state) {
+    tracker.get_state(state);
+}
+
+void temp_tracker_set_state(const TempTrackerState* state) {
+    tracker.set_state(state);
+}
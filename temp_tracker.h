@@ -1,14 +1,43 @@
 #ifndef TEMP_TRACKER_H
 #define TEMP_TRACKER_H
 
+#include <stdint.h>
+#include "config.h"
+#include "temp_tracker_core.h"
+
+// Tracker state, for saving across resets
 typedef struct {
     float min_temp;
     float max_temp;
-    bool valid; // Becomes true after the first hour
-} TempStats1Hour;
+    uint32_t elapsed_ms;  // into the current period
+    bool valid;
+    bool first_reading;   // no reading yet in the current period
+} TempTrackerState;
+
+// Min/max over TEMP_STATS_PERIOD_MS for one stream of readings. Instances are
+// independent; each is used from one thread.
+class TempTracker {
+public:
+    TempTracker();
+
+    void reset();
+    // elapsed_ms is the time since the previous reading; the statistics period
+    // is TEMP_STATS_PERIOD_MS of readings whatever the sampling interval.
+    // Returns true when this reading completed a period.
+    bool update(float value, uint32_t elapsed_ms = SAMPLE_INTERVAL_MS);
+    TempStats1Hour get_stats() const;
+    void get_state(TempTrackerState* state) const;
+    void set_state(const TempTrackerState* state);
+
+private:
+    TempTrackerCore<MonitorConfig> _core;
+};
 
+// The firmware's temperature tracker: a default instance
 void temp_tracker_init();
-void temp_tracker_update(float current_temp);
+void temp_tracker_update(float current_temp, uint32_t elapsed_ms = SAMPLE_INTERVAL_MS);
 TempStats1Hour temp_tracker_get_stats();
+void temp_tracker_get_state(TempTrackerState* state);
+void temp_tracker_set_state(const TempTrackerState* state);
 
-#endif // TEMP_TRACKER_H
\ No newline at end of file
+#endif // TEMP_TRACKER_H
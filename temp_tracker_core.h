@@ -0,0 +1,77 @@
+#ifndef TEMP_TRACKER_CORE_H
+#define TEMP_TRACKER_CORE_H
+
+#include <stdint.h>
+#include <limits> // For infinity()
+#include "config.h"
+
+typedef struct {
+    float min_temp;
+    float max_temp;
+    bool valid; // Becomes true after the first hour
+} TempStats1Hour;
+
+// The tracker's per-sample work, templated on a configuration type (see
+// MonitorConfig in config.h) for its statistics period. TempTracker
+// (temp_tracker.h) wraps the MonitorConfig instantiation.
+
+template <typename Config>
+struct TempTrackerCore {
+    float max_temp_current_hour;
+    float min_temp_current_hour;
+    uint32_t elapsed_ms_current_hour;
+    bool stats_are_valid;
+    bool first_reading_in_hour;
+};
+
+template <typename Config>
+void temp_core_reset(TempTrackerCore<Config>& core)
+{
+    core.max_temp_current_hour = -std::numeric_limits<float>::infinity();
+    core.min_temp_current_hour = std::numeric_limits<float>::infinity();
+    core.elapsed_ms_current_hour = 0;
+    core.stats_are_valid = false;
+    core.first_reading_in_hour = true;
+}
+
+// See temp_tracker_update(); true when the reading completed a period
+template <typename Config>
+bool temp_core_update(TempTrackerCore<Config>& core, float current_temp, uint32_t elapsed_ms)
+{
+    if (core.first_reading_in_hour) {
+        // Seed the min/max with the first reading of the hour
+        core.min_temp_current_hour = current_temp;
+        core.max_temp_current_hour = current_temp;
+        core.first_reading_in_hour = false;
+    } else {
+        // Update normally
+        if (current_temp > core.max_temp_current_hour) core.max_temp_current_hour = current_temp;
+        if (current_temp < core.min_temp_current_hour) core.min_temp_current_hour = current_temp;
+    }
+
+    core.elapsed_ms_current_hour += elapsed_ms;
+
+    // Check if the hour has passed
+    if (core.elapsed_ms_current_hour < Config::stats_period_ms) {
+        return false;
+    }
+    // Reset counters and stats for the new hour
+    core.elapsed_ms_current_hour = 0;
+    core.stats_are_valid = true; // Stats from the *previous* full hour are now valid
+    core.first_reading_in_hour = true; // Next reading will seed the new hour
+
+    // Note: min/max are reset implicitly by the first_reading_in_hour flag logic
+    return true;
+}
+
+template <typename Config>
+TempStats1Hour temp_core_get_stats(const TempTrackerCore<Config>& core)
+{
+    TempStats1Hour stats;
+    stats.min_temp = core.min_temp_current_hour;
+    stats.max_temp = core.max_temp_current_hour;
+    stats.valid = core.stats_are_valid; // Report if we have completed at least one full hour
+    return stats;
+}
+
+#endif // TEMP_TRACKER_CORE_H
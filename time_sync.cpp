@@ -0,0 +1,128 @@
+#include "time_sync.h"
+#include "config.h"
+#include "link_manager.h"
+
+// Seconds from the NTP era (1900) to the Unix epoch
+#define NTP_UNIX_OFFSET_S 2208988800UL
+#define NTP_PACKET_SIZE 48
+#define NTP_PORT 123
+
+static NetworkInterface* network = nullptr;
+// Looked up once and kept: mbed's DNS client mallocs its query buffer and
+// cache entries, which NO_HEAP_AFTER_INIT forbids once the heap is locked
+static SocketAddress server;
+static bool server_resolved = false;
+static Timer since_attempt;
+static bool attempted = false;
+static volatile uint8_t synced = false;
+static Mutex stats_mutex;
+static TimeSyncStats stats;
+
+static uint32_t get_u32_be(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static bool resolve_server() {
+    if (network->gethostbyname(TIME_SYNC_SERVER, &server) != NSAPI_ERROR_OK) {
+        printf("Time Sync: Cannot resolve %s\n", TIME_SYNC_SERVER);
+        return false;
+    }
+    server.set_port(NTP_PORT);
+    server_resolved = true;
+    return true;
+}
+
+// One SNTP request (RFC 4330, client mode); the server's transmit time
+// plus half the round trip, in Unix seconds, or 0 on failure
+static time_t request_time(uint32_t* rtt_ms) {
+    static UDPSocket socket;
+    static uint8_t packet[NTP_PACKET_SIZE];
+
+    // Without NO_HEAP_AFTER_INIT a failed lookup is retried with the request;
+    // with it the heap may be locked by now, so the lookup at init stands
+#if !NO_HEAP_AFTER_INIT
+    if (!server_resolved) {
+        resolve_server();
+    }
+#endif
+    if (!server_resolved) {
+        return 0;
+    }
+    if (socket.open(network) != NSAPI_ERROR_OK) {
+        printf("Time Sync: Cannot open a UDP socket\n");
+        return 0;
+    }
+    socket.set_timeout(TIME_SYNC_TIMEOUT_MS);
+
+    memset(packet, 0, sizeof(packet));
+    packet[0] = 0x1B; // LI 0, version 3, mode 3 (client)
+    Timer round_trip;
+    round_trip.start();
+    time_t result = 0;
+    if (socket.sendto(server, packet, sizeof(packet)) == NTP_PACKET_SIZE) {
+        SocketAddress from;
+        nsapi_size_or_error_t len = socket.recvfrom(&from, packet, sizeof(packet));
+        *rtt_ms = chrono::duration_cast<chrono::milliseconds>(round_trip.elapsed_time()).count();
+        // A server reply (mode 4) from a synchronized server (stratum 1-15)
+        uint32_t seconds = len == NTP_PACKET_SIZE ? get_u32_be(packet + 40) : 0;
+        if ((packet[0] & 0x07) == 4 && packet[1] >= 1 && packet[1] <= 15 && seconds > NTP_UNIX_OFFSET_S) {
+            uint32_t fraction_ms = (uint32_t)(((uint64_t)get_u32_be(packet + 44) * 1000) >> 32);
+            result = (time_t)(seconds - NTP_UNIX_OFFSET_S) + (fraction_ms + *rtt_ms / 2 + 500) / 1000;
+        }
+    }
+    socket.close();
+    return result;
+}
+
+void time_sync_init(NetworkInterface* network_interface) {
+    network = network_interface;
+    attempted = false;
+    memset(&stats, 0, sizeof(stats));
+    since_attempt.reset();
+    since_attempt.start();
+    if (network && !server_resolved) {
+        resolve_server();
+    }
+}
+
+uint32_t time_sync_poll() {
+    uint32_t interval_ms = time_sync_is_synced() ? TIME_SYNC_INTERVAL_MS : TIME_SYNC_RETRY_MS;
+    uint32_t elapsed_ms = chrono::duration_cast<chrono::milliseconds>(since_attempt.elapsed_time()).count();
+    if (attempted && elapsed_ms < interval_ms) {
+        return interval_ms - elapsed_ms;
+    }
+    if (!network || !link_manager_is_up()) {
+        return TIME_SYNC_RETRY_MS;
+    }
+    attempted = true;
+    since_attempt.reset();
+
+    uint32_t rtt_ms = 0;
+    time_t now = request_time(&rtt_ms);
+    stats_mutex.lock();
+    stats.attempts++;
+    if (now) {
+        stats.syncs++;
+        stats.last_step_s = (int32_t)(now - time(NULL));
+        stats.last_rtt_ms = rtt_ms;
+    }
+    stats_mutex.unlock();
+    if (!now) {
+        return TIME_SYNC_RETRY_MS;
+    }
+    set_time(now);
+    core_util_atomic_store_u8(&synced, true);
+    printf("Time Sync: RTC set to %lu (moved %ld s)\n", (unsigned long)now, (long)stats.last_step_s);
+    return TIME_SYNC_INTERVAL_MS;
+}
+
+bool time_sync_is_synced() {
+    return core_util_atomic_load_u8(&synced);
+}
+
+TimeSyncStats time_sync_get_stats() {
+    stats_mutex.lock();
+    TimeSyncStats current = stats;
+    stats_mutex.unlock();
+    return current;
+}
@@ -0,0 +1,34 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "NetworkInterface.h"
+
+// Sets the RTC from an SNTP server (TIME_SYNC_SERVER) over the WiFi link.
+// Nothing else sets it, and after a power loss it starts again near 0, so
+// until a sync succeeds the time of day is unknown: the reading history
+// then carries on from its newest reading instead (history_store.h).
+//
+// The server's name is looked up in time_sync_init(), before main() locks
+// the heap (NO_HEAP_AFTER_INIT), and the address is kept for every request.
+//
+// Runs on the network thread, like link_manager_poll(): a request is one
+// UDP exchange, blocking for TIME_SYNC_TIMEOUT_MS at most. The clock is set
+// again every TIME_SYNC_INTERVAL_MS, and retried every TIME_SYNC_RETRY_MS
+// while no sync has succeeded.
+typedef struct {
+    uint32_t attempts;
+    uint32_t syncs;
+    int32_t last_step_s;        // how far the last sync moved the RTC
+    uint32_t last_rtt_ms;
+} TimeSyncStats;
+
+void time_sync_init(NetworkInterface* network_interface);
+// Syncs if one is due and the link is up. Returns the ms until the next is due.
+uint32_t time_sync_poll();
+// True once the RTC has been set since boot; safe from any thread
+bool time_sync_is_synced();
+TimeSyncStats time_sync_get_stats();
+
+#endif // TIME_SYNC_H
@@ -1,30 +1,94 @@
 #include "warnings.h"
 #include "config.h"
 
+// A pattern is a repeating sequence of phases, alternately on and off
+// starting with on. The sequencer steps through them from a Timeout, so
+// the LED pin is only written at phase edges and the pattern keeps its
+// rhythm however often warnings_update() is called.
+#define WARNING_MAX_PHASES 4
+
+typedef struct {
+    uint8_t phase_count;                 // 0 = LED off
+    uint16_t phase_ms[WARNING_MAX_PHASES];
+} WarningPattern;
+
+static const WarningPattern patterns[WARNING_STATE_COUNT] = {
+    {0, {0}},                   // NORMAL
+    {2, {500, 500}},            // LOW
+    {2, {250, 250}},            // HIGH
+    {2, {50, 50}},              // ANOMALY
+    {4, {100, 100, 100, 700}},  // CRITICAL
+};
+
+static const char* const state_names[WARNING_STATE_COUNT] = {
+    "NORMAL", "LOW", "HIGH", "ANOMALY", "CRITICAL"
+};
+
 // Warning LED object
-static PwmOut warning_led(WARNING_LED);
+static DigitalOut warning_led(WARNING_LED, 0);
+static Timeout phase_timeout;
+static WarningState current_state = WARNING_NORMAL;
+static const WarningPattern* pattern = &patterns[WARNING_NORMAL];
+static uint8_t phase = 0;
+
+// --- Helper Functions ---
+static void next_phase();
+
+static void start_phase() {
+    warning_led = (phase % 2 == 0) ? 1 : 0;
+    phase_timeout.attach(callback(next_phase), chrono::milliseconds(pattern->phase_ms[phase]));
+}
+
+// Timeout context
+static void next_phase() {
+    phase = (phase + 1) % pattern->phase_count;
+    start_phase();
+}
+
+static void start_pattern(WarningState state) {
+    phase_timeout.detach();
+    pattern = &patterns[state];
+    phase = 0;
+    if (pattern->phase_count == 0) {
+        warning_led = 0;
+    } else {
+        start_phase();
+    }
+}
+
+// Highest-priority condition that holds for this reading
+static WarningState arbitrate(float current_temp, bool is_anomalous) {
+    uint32_t active = 0;
+    active |= (current_temp < LOWER_THRESHOLD) << WARNING_LOW;
+    active |= (current_temp > UPPER_THRESHOLD) << WARNING_HIGH;
+    active |= is_anomalous << WARNING_ANOMALY;
+    active |= (current_temp > TEMP_THRESHOLD_CRITICAL) << WARNING_CRITICAL;
+
+    for (int state = WARNING_STATE_COUNT - 1; state > WARNING_NORMAL; state--) {
+        if (active & (1u << state)) {
+            return (WarningState)state;
+        }
+    }
+    return WARNING_NORMAL;
+}
+// -----------------------
 
 void warnings_init() {
-    warning_led.period_ms(1000); // Default period
-    warning_led.write(0.0f);     // Start with LED off
+    current_state = WARNING_NORMAL;
+    start_pattern(WARNING_NORMAL); // Start with LED off
     printf("Warning System Initialized.\n");
 }
 
 void warnings_update(float current_temp, bool is_anomalous) {
-    if (is_anomalous) {
-        // ANOMALY: Very fast flash (10Hz)
-        warning_led.period_ms(100);
-        warning_led.pulsewidth_ms(50); // 50% duty cycle
-    } else if (current_temp > UPPER_THRESHOLD) {
-        // HIGH TEMP: Fast flash (2Hz)
-        warning_led.period_ms(500);
-        warning_led.pulsewidth_ms(250);
-    } else if (current_temp < LOWER_THRESHOLD) {
-        // LOW TEMP: Slow flash (1Hz)
-        warning_led.period_ms(1000);
-        warning_led.pulsewidth_ms(500);
-    } else {
-        // NORMAL: LED Off
-        warning_led.write(0.0f); // Set duty cycle to 0
+    WarningState state = arbitrate(current_temp, is_anomalous);
+    if (state == current_state) {
+        return; // Leave the running pattern alone
     }
-}
\ No newline at end of file
+    printf("Warning: %s -> %s\n", state_names[current_state], state_names[state]);
+    current_state = state;
+    start_pattern(state);
+}
+
+WarningState warnings_get_state() {
+    return current_state;
+}
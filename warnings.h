@@ -2,8 +2,23 @@
 #define WARNINGS_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// Warning states in priority order: when several conditions hold, the
+// highest one drives the LED
+typedef enum {
+    WARNING_NORMAL,    // LED off
+    WARNING_LOW,       // below TEMP_THRESHOLD_LOW: slow blink (1 Hz)
+    WARNING_HIGH,      // above TEMP_THRESHOLD_HIGH: fast blink (2 Hz)
+    WARNING_ANOMALY,   // reading flagged by the anomaly detector: flicker (10 Hz)
+    WARNING_CRITICAL,  // above TEMP_THRESHOLD_CRITICAL: double blink once a second
+    WARNING_STATE_COUNT
+} WarningState;
 
 void warnings_init();
+// Arbitrates the conditions for this reading. The LED is only reprogrammed
+// when the resulting state changes; a running pattern is left undisturbed.
 void warnings_update(float current_temp, bool is_anomalous);
+WarningState warnings_get_state();
 
-#endif // WARNINGS_H
\ No newline at end of file
+#endif // WARNINGS_H
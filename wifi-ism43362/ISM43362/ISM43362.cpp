@@ -435,6 +435,15 @@ int8_t ISM43362::getRSSI()
 
     debug_if(_ism_debug, "\tISM43362: getRSSI: %d\r\n", rssi);
 
+    /* The module does not report losing the AP; an RSSI of 0 while joined
+       means it is gone */
+    if (rssi == 0 && _conn_status == NSAPI_STATUS_GLOBAL_UP) {
+        _conn_status = NSAPI_STATUS_DISCONNECTED;
+        if (_conn_stat_cb) {
+            _conn_stat_cb();
+        }
+    }
+
     return rssi;
 }
 /**
@@ -670,13 +679,10 @@ int ISM43362::open(const char *type, int id, const char *addr, int port)
         rnglocalport = 49152;
     }
 
-    if (!UDP_CONNECTION) {/* TCP connection */
-
-        /* Set local port */
-        if (!(_parser.send("P2=%d", rnglocalport) && check_response())) {
-            debug_if(_ism_debug, "\tISM43362: open: P2 issue\n");
-            return NSAPI_ERROR_DEVICE_ERROR;
-        }
+    /* Set local port (P4 is the remote port for UDP too) */
+    if (!(_parser.send("P2=%d", rnglocalport) && check_response())) {
+        debug_if(_ism_debug, "\tISM43362: open: P2 issue\n");
+        return NSAPI_ERROR_DEVICE_ERROR;
     }
 
     /* Set address */
@@ -685,16 +691,10 @@ int ISM43362::open(const char *type, int id, const char *addr, int port)
         return NSAPI_ERROR_DEVICE_ERROR;
     }
 
-       if (UDP_CONNECTION) {
-        if (!(_parser.send("P4=%d", rnglocalport) && check_response())) {
-            debug_if(_ism_debug, "\tISM43362: open: P4 issue\n");
-            return NSAPI_ERROR_DEVICE_ERROR;
-        }
-    } else { /* TCP connection */
-        if (!(_parser.send("P4=%d", port) && check_response())) {
-            debug_if(_ism_debug, "\tISM43362: open: P4 issue\n");
-            return NSAPI_ERROR_DEVICE_ERROR;
-        }
+    /* Set remote port */
+    if (!(_parser.send("P4=%d", port) && check_response())) {
+        debug_if(_ism_debug, "\tISM43362: open: P4 issue\n");
+        return NSAPI_ERROR_DEVICE_ERROR;
     }
 
     /*  In case of UDP, force client mode ORIGIN. */
@@ -826,7 +826,7 @@ int ISM43362::check_recv_status(int id, void *data)
         // debug_if(_ism_debug, "\tISM43362 check_recv_status: recv 2 nothing to read=%d\r\n", read_amount);
         // read_amount -= 6;
         return 0; /* nothing to read */
-    } else if ((read_amount >= 8) && (strncmp((char *)((uint32_t) data + read_amount - 8), "\r\nOK\r\n> ", 8)) == 0) {
+    } else if ((read_amount >= 8) && (strncmp((char *)data + read_amount - 8, "\r\nOK\r\n> ", 8)) == 0) {
         /* bypass ""\r\nOK\r\n> " if present at the end of the chain */
         read_amount -= 8;
     } else {
@@ -119,7 +119,8 @@ public:
 
     /* Return RSSI for active connection
      *
-     * @return      Measured RSSI
+     * @return      Measured RSSI, 0 if not associated (the connection
+     *              status then changes to disconnected)
      */
     int8_t getRSSI();
 
@@ -307,6 +307,9 @@ struct ISM43362_socket {
     volatile uint32_t read_data_size;
 };
 
+// One handle per module socket id, so opening a socket never allocates
+static struct ISM43362_socket ism_socket_pool[ISM43362_SOCKET_COUNT];
+
 int ISM43362Interface::socket_open(void **handle, nsapi_protocol_t proto)
 {
     _mutex.lock();
@@ -325,11 +328,7 @@ int ISM43362Interface::socket_open(void **handle, nsapi_protocol_t proto)
         _mutex.unlock();
         return NSAPI_ERROR_NO_SOCKET;
     }
-    struct ISM43362_socket *socket = new struct ISM43362_socket;
-    if (!socket) {
-        _mutex.unlock();
-        return NSAPI_ERROR_NO_SOCKET;
-    }
+    struct ISM43362_socket *socket = &ism_socket_pool[id];
     socket->id = id;
     debug_if(_ism_debug, "ISM43362Interface: socket_open id=%d proto=%d\n", socket->id, proto);
     memset(socket->read_data, 0, sizeof(socket->read_data));
@@ -357,7 +356,6 @@ int ISM43362Interface::socket_close(void *handle)
     socket->connected = false;
     _ids[socket->id] = false;
     _socket_obj[socket->id] = 0;
-    delete socket;
    _mutex.unlock();
     return err;
 }
@@ -389,7 +387,7 @@ int ISM43362Interface::socket_connect_nolock(void *handle, const SocketAddress &
         return NSAPI_ERROR_DEVICE_ERROR;
     }
     _ids[socket->id]  = true;
-    _socket_obj[socket->id] = (uint32_t)socket;
+    _socket_obj[socket->id] = (uintptr_t)socket;
     socket->connected = true;
     return 0;
 
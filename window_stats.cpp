@@ -0,0 +1,185 @@
+#include "window_stats.h"
+#include <string.h>
+#include "config.h"
+#include "series_codec.h"
+
+#if (WINDOW_STATS_SLOTS & (WINDOW_STATS_SLOTS - 1)) != 0
+#error "WINDOW_STATS_SLOTS must be a power of two"
+#endif
+
+// A slot, or the slots under a node. min and max are INT16_MAX and
+// INT16_MIN while count is 0, so empty nodes merge away.
+typedef struct {
+    int32_t sum;
+    int16_t min;
+    int16_t max;
+    uint32_t count;
+} WindowNode;
+
+// Readings a slot takes at most: 100 fit 8 s at the fastest interval, and
+// 128 x 512 slots of INT16_MAX still fit sum
+#define SLOT_MAX_READINGS 128
+
+// nodes[1] is the root, nodes[WINDOW_STATS_SLOTS + i] slot i
+static WindowNode nodes[2 * WINDOW_STATS_SLOTS];
+static uint16_t current = 0;        // slot the next reading goes into
+static uint16_t used = 0;           // slots since the start, current included
+static uint32_t slot_end_ms = 0;
+static bool started = false;
+
+static const uint32_t window_spans_ms[WINDOW_STATS_COUNT] = {
+    5UL * 60UL * 1000UL,
+    15UL * 60UL * 1000UL,
+    60UL * 60UL * 1000UL
+};
+
+// --- Helper Functions ---
+static void clear_node(WindowNode* node) {
+    node->sum = 0;
+    node->min = INT16_MAX;
+    node->max = INT16_MIN;
+    node->count = 0;
+}
+
+static void merge(WindowNode* into, const WindowNode* node) {
+    into->sum += node->sum;
+    into->count += node->count;
+    if (node->min < into->min) {
+        into->min = node->min;
+    }
+    if (node->max > into->max) {
+        into->max = node->max;
+    }
+}
+
+// Recomputes the nodes above slot i
+static void update_path(uint16_t i) {
+    for (uint32_t n = (WINDOW_STATS_SLOTS + i) >> 1; n >= 1; n >>= 1) {
+        nodes[n] = nodes[2 * n];
+        merge(&nodes[n], &nodes[2 * n + 1]);
+    }
+}
+
+static void clear_all() {
+    for (int n = 0; n < 2 * WINDOW_STATS_SLOTS; n++) {
+        clear_node(&nodes[n]);
+    }
+}
+
+// Merges slots first..last (first <= last) into into
+static void query_range(WindowNode* into, uint32_t first, uint32_t last) {
+    uint32_t l = first + WINDOW_STATS_SLOTS;
+    uint32_t r = last + WINDOW_STATS_SLOTS + 1;
+    while (l < r) {
+        if (l & 1) {
+            merge(into, &nodes[l++]);
+        }
+        if (r & 1) {
+            merge(into, &nodes[--r]);
+        }
+        l >>= 1;
+        r >>= 1;
+    }
+}
+// -----------------------
+
+void window_stats_init() {
+    clear_all();
+    current = 0;
+    used = 0;
+    started = false;
+}
+
+void window_stats_add(uint32_t now_ms, float temperature) {
+    if (!started) {
+        started = true;
+        used = 1;
+        slot_end_ms = now_ms + WINDOW_STATS_SLOT_MS;
+    } else if ((int32_t)(now_ms - slot_end_ms) >= 0) {
+        uint32_t passed = (now_ms - slot_end_ms) / WINDOW_STATS_SLOT_MS + 1;
+        if (passed >= WINDOW_STATS_SLOTS) {
+            // Away longer than the ring covers: nothing in it is recent
+            clear_all();
+            current = 0;
+            used = 1;
+            slot_end_ms = now_ms + WINDOW_STATS_SLOT_MS;
+        } else {
+            // Every slot passed over is emptied, the ones without readings too
+            for (uint32_t i = 0; i < passed; i++) {
+                current = (current + 1) & (WINDOW_STATS_SLOTS - 1);
+                clear_node(&nodes[WINDOW_STATS_SLOTS + current]);
+                update_path(current);
+            }
+            used = used + passed > WINDOW_STATS_SLOTS ? WINDOW_STATS_SLOTS : (uint16_t)(used + passed);
+            slot_end_ms += passed * WINDOW_STATS_SLOT_MS;
+        }
+    }
+
+    if (temperature != temperature) {
+        return;
+    }
+    int32_t value = series_scale(temperature);
+    value = value < INT16_MIN ? INT16_MIN : (value > INT16_MAX ? INT16_MAX : value);
+    WindowNode* slot = &nodes[WINDOW_STATS_SLOTS + current];
+    if (slot->count >= SLOT_MAX_READINGS) {
+        return;
+    }
+    slot->sum += value;
+    slot->count++;
+    if (value < slot->min) {
+        slot->min = (int16_t)value;
+    }
+    if (value > slot->max) {
+        slot->max = (int16_t)value;
+    }
+    update_path(current);
+}
+
+WindowStats window_stats_query(uint32_t window_ms) {
+    WindowStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!started) {
+        return stats;
+    }
+    uint32_t slots = (window_ms + WINDOW_STATS_SLOT_MS - 1) / WINDOW_STATS_SLOT_MS;
+    if (slots == 0) {
+        slots = 1;
+    }
+    if (slots > used) {
+        slots = used;
+    }
+
+    // The slots up to current, in two parts if they wrap past slot 0
+    WindowNode total;
+    clear_node(&total);
+    uint32_t first = (current + WINDOW_STATS_SLOTS + 1 - slots) & (WINDOW_STATS_SLOTS - 1);
+    if (first <= current) {
+        query_range(&total, first, current);
+    } else {
+        query_range(&total, first, WINDOW_STATS_SLOTS - 1);
+        query_range(&total, 0, current);
+    }
+
+    stats.covered_ms = slots * WINDOW_STATS_SLOT_MS;
+    if (stats.covered_ms > window_ms) {
+        stats.covered_ms = window_ms;
+    }
+    stats.readings = total.count;
+    if (total.count > 0) {
+        stats.min_temp = total.min / (float)SERIES_SCALE;
+        stats.max_temp = total.max / (float)SERIES_SCALE;
+        stats.mean_temp = (float)total.sum / total.count / SERIES_SCALE;
+        stats.valid = true;
+    }
+    return stats;
+}
+
+void window_stats_get_all(WindowStats* windows) {
+    for (int i = 0; i < WINDOW_STATS_COUNT; i++) {
+        windows[i] = window_stats_query(window_spans_ms[i]);
+    }
+}
+
+uint32_t window_stats_span_ms(int window) {
+    return window >= 0 && window < WINDOW_STATS_COUNT ? window_spans_ms[window] : 0;
+}
@@ -0,0 +1,45 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Min, max and mean temperature over any trailing window of up to
+// WINDOW_STATS_SLOTS * WINDOW_STATS_SLOT_MS. Readings are folded into a ring
+// of fixed time slots, so the windows cover the same time whatever the
+// sampling interval. Over the ring sits an implicit segment tree (node i
+// has children 2i and 2i+1, the slots are the leaves), so adding a reading
+// updates one path and a window of any length is answered from O(log n)
+// nodes. Values are kept in units of 0.01 degC, as in the data message.
+//
+// Unlike the tracker's hourly min/max (temp_tracker.h), which starts over
+// every hour, these windows slide with every slot.
+
+typedef struct {
+    float min_temp;
+    float max_temp;
+    float mean_temp;
+    uint32_t readings;
+    uint32_t covered_ms;    // of the window, less while the device has not been up that long
+    bool valid;             // there are readings in the window
+} WindowStats;
+
+// The windows the firmware reports (status topic and dashboard)
+enum {
+    WINDOW_STATS_5_MIN,
+    WINDOW_STATS_15_MIN,
+    WINDOW_STATS_60_MIN,
+    WINDOW_STATS_COUNT
+};
+
+void window_stats_init();
+// now_ms is the uptime clock; readings with a time earlier than the current
+// slot's start count towards the current slot
+void window_stats_add(uint32_t now_ms, float temperature);
+// The trailing window_ms up to the last reading, rounded up to whole slots
+WindowStats window_stats_query(uint32_t window_ms);
+// The WINDOW_STATS_COUNT windows above, and their lengths
+void window_stats_get_all(WindowStats* windows);
+uint32_t window_stats_span_ms(int window);
+
+#endif // WINDOW_STATS_H